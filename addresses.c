@@ -1,313 +1,2484 @@
-#include "ip_manager.h"
+#include "addresses.h"
 #include "logger.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <errno.h>
 #include <arpa/inet.h>
 
+#define ADDRESS_FILE_MAGIC 0x32535049  // "IPS2"
+#define ADDRESS_FILE_VERSION 4
+#define ADDRESS_OWNER_INITIAL 64       // Power of two
+#define ADDRESS_LEAF_WORDS_MAX ((1u << (32 - ADDRESS_MIN_PREFIX)) / 64)
+
+// Journal record types
+#define ADDRESS_JOURNAL_POOL_CREATE 1  // address_journal_pool_t
+#define ADDRESS_JOURNAL_POOL_DELETE 2  // int32_t pool number
+#define ADDRESS_JOURNAL_SET 3          // address_journal_set_t, owner truncated to owner_length
+#define ADDRESS_JOURNAL_CLEAR 4        // uint32_t host-order address
+#define ADDRESS_JOURNAL_LEASE 5        // address_journal_lease_t
+
+// ips.dat layout: header, then per pool an address_file_pool_t, its leaf
+// bitmap words and one address_file_entry_t (plus owner bytes) per allocated
+// address.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;  // First journal generation to replay on top
+    int32_t pool_count;
+} address_file_header_t;
+
+typedef struct {
+    int32_t pool_number;
+    uint32_t base_ip;
+    uint32_t netmask;
+    char pool_name[POOL_NAME_LENGTH];
+    uint32_t entry_count;
+} address_file_pool_t;
+
+typedef struct {
+    uint32_t index;
+    uint32_t owner_length;
+    int64_t allocation_time;
+    int64_t expires_at;  // Added in version 4
+} address_file_entry_t;
+
+typedef struct {
+    int32_t pool_number;
+    uint32_t base_ip;
+    uint32_t netmask;
+    char pool_name[POOL_NAME_LENGTH];
+} address_journal_pool_t;
+
+typedef struct {
+    uint32_t host_ip;
+    uint32_t owner_length;
+    int64_t allocation_time;
+    char owner[ADDRESS_OWNER_LENGTH];
+} address_journal_set_t;
+
+typedef struct {
+    uint32_t host_ip;
+    uint32_t reserved;
+    int64_t expires_at;  // 0 removes the lease
+} address_journal_lease_t;
+
 // Global IP context
 static ip_context_t *global_ip_ctx = NULL;
 
-int ip_init(ip_context_t *ip_ctx) {
-    if (!ip_ctx) return -1;
-    
-    memset(ip_ctx, 0, sizeof(ip_context_t));
-    ip_ctx->pool_count = 0;
-    
-    global_ip_ctx = ip_ctx;
-    
-    // Load existing IPs if file exists
-    ip_load_ips(ip_ctx, "ips.dat");
-    
-    log_info("IP management system initialized with %d pools", ip_ctx->pool_count);
+// Owner table; every function takes the table's lock
+
+static uint32_t address_owner_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int address_owner_table_init(address_owner_table_t *table) {
+    memset(table, 0, sizeof(*table));
+    table->entries = calloc(ADDRESS_OWNER_INITIAL, sizeof(address_owner_t));
+    table->buckets = calloc(ADDRESS_OWNER_INITIAL * 2, sizeof(uint32_t));
+    table->sticky = calloc(ADDRESS_STICKY_SLOTS, sizeof(address_sticky_t));
+    if (!table->entries || !table->buckets || !table->sticky) {
+        free(table->entries);
+        free(table->buckets);
+        free(table->sticky);
+        return -1;
+    }
+    table->capacity = ADDRESS_OWNER_INITIAL;
+    table->bucket_count = ADDRESS_OWNER_INITIAL * 2;
+    table->free_head = 0;
+    for (uint32_t i = table->capacity - 1; i >= 1; i--) {
+        table->entries[i].hash = table->free_head;
+        table->free_head = i;
+    }
+    pthread_mutex_init(&table->lock, NULL);
+    return 0;
+}
+
+static void address_owner_table_free(address_owner_table_t *table) {
+    if (table->entries) {
+        for (uint32_t i = 1; i < table->capacity; i++) {
+            free(table->entries[i].name);
+            free(table->entries[i].addresses);
+        }
+        pthread_mutex_destroy(&table->lock);
+    }
+    free(table->entries);
+    free(table->buckets);
+    free(table->sticky);
+    memset(table, 0, sizeof(*table));
+}
+
+static void address_owner_bucket_insert(address_owner_table_t *table, uint32_t id) {
+    uint32_t mask = table->bucket_count - 1;
+    uint32_t slot = table->entries[id].hash & mask;
+    while (table->buckets[slot] != 0) slot = (slot + 1) & mask;
+    table->buckets[slot] = id;
+}
+
+// Doubles entries and buckets; entry ids stay the same
+static int address_owner_table_grow(address_owner_table_t *table) {
+    uint32_t capacity = table->capacity * 2;
+    address_owner_t *entries = realloc(table->entries, capacity * sizeof(address_owner_t));
+    if (!entries) return -1;
+    memset(entries + table->capacity, 0, (capacity - table->capacity) * sizeof(address_owner_t));
+    table->entries = entries;
+
+    uint32_t *buckets = calloc(capacity * 2, sizeof(uint32_t));
+    if (!buckets) return -1;
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = capacity * 2;
+
+    // Only called with an empty free chain, so the new entries become the chain
+    uint32_t old_capacity = table->capacity;
+    table->capacity = capacity;
+    for (uint32_t i = 1; i < old_capacity; i++) {
+        if (table->entries[i].name) address_owner_bucket_insert(table, i);
+    }
+    for (uint32_t i = capacity - 1; i >= old_capacity; i--) {
+        table->entries[i].hash = table->free_head;
+        table->free_head = i;
+    }
+    return 0;
+}
+
+// Looks name up; 0 when it has no entry. The caller holds the lock.
+static uint32_t address_owner_find(const address_owner_table_t *table, const char *name,
+                                   uint32_t hash) {
+    uint32_t mask = table->bucket_count - 1;
+    for (uint32_t slot = hash & mask; table->buckets[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t id = table->buckets[slot];
+        const address_owner_t *entry = &table->entries[id];
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) return id;
+    }
+    return 0;
+}
+
+// Unhooks and frees an entry that holds no addresses. The caller holds the lock.
+static void address_owner_remove(address_owner_table_t *table, uint32_t id) {
+    address_owner_t *entry = &table->entries[id];
+
+    // Backward-shift delete keeps probe chains intact without tombstones
+    uint32_t mask = table->bucket_count - 1;
+    uint32_t slot = entry->hash & mask;
+    while (table->buckets[slot] != id) slot = (slot + 1) & mask;
+
+    uint32_t next = (slot + 1) & mask;
+    while (table->buckets[next] != 0) {
+        uint32_t home = table->entries[table->buckets[next]].hash & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            table->buckets[slot] = table->buckets[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table->buckets[slot] = 0;
+
+    free(entry->name);
+    free(entry->addresses);
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = table->free_head;
+    table->free_head = id;
+}
+
+// Returns the id for name with the address at index added to its list, or
+// 0 on allocation failure. The caller holds the pool's lock.
+static uint32_t address_owner_intern(address_owner_table_t *table, const char *name,
+                                     pool_t *pool, uint32_t index) {
+    uint32_t hash = address_owner_hash(name);
+
+    pthread_mutex_lock(&table->lock);
+
+    uint32_t id = address_owner_find(table, name, hash);
+    if (id == 0) {
+        char *copy = malloc(strlen(name) + 1);
+        if (!copy || (table->free_head == 0 && address_owner_table_grow(table) != 0)) {
+            pthread_mutex_unlock(&table->lock);
+            free(copy);
+            return 0;
+        }
+        strcpy(copy, name);
+
+        id = table->free_head;
+        address_owner_t *entry = &table->entries[id];
+        table->free_head = entry->hash;
+        entry->name = copy;
+        entry->hash = hash;
+        address_owner_bucket_insert(table, id);
+    }
+
+    address_owner_t *entry = &table->entries[id];
+    if (entry->refs == entry->address_capacity) {
+        uint32_t capacity = entry->address_capacity ? entry->address_capacity * 2 : 4;
+        address_ref_t *addresses = realloc(entry->addresses, capacity * sizeof(address_ref_t));
+        if (!addresses) {
+            if (entry->refs == 0) address_owner_remove(table, id);
+            pthread_mutex_unlock(&table->lock);
+            return 0;
+        }
+        entry->addresses = addresses;
+        entry->address_capacity = capacity;
+    }
+
+    entry->addresses[entry->refs].pool = pool;
+    entry->addresses[entry->refs].index = index;
+    pool->meta[index].owner_slot = entry->refs++;
+
+    pthread_mutex_unlock(&table->lock);
+    return id;
+}
+
+// Takes the address at index off its owner's list; the entry is freed with
+// its last address. A release remembers the address for sticky allocation.
+// The caller holds the pool's lock.
+static void address_owner_release(address_owner_table_t *table, pool_t *pool, uint32_t index,
+                                  int remember) {
+    uint32_t id = pool->meta[index].owner;
+    if (id == 0) return;
+
+    pthread_mutex_lock(&table->lock);
+
+    address_owner_t *entry = &table->entries[id];
+    if (id >= table->capacity || !entry->name || entry->refs == 0) {
+        pthread_mutex_unlock(&table->lock);
+        return;
+    }
+
+    // The last address fills the hole
+    uint32_t slot = pool->meta[index].owner_slot;
+    address_ref_t moved = entry->addresses[--entry->refs];
+    entry->addresses[slot] = moved;
+    moved.pool->meta[moved.index].owner_slot = slot;
+
+    if (remember) {
+        address_sticky_t *sticky = &table->sticky[entry->hash & (ADDRESS_STICKY_SLOTS - 1)];
+        sticky->hash = entry->hash;
+        sticky->host_ip = pool->base_ip + index;
+    }
+
+    if (entry->refs == 0) address_owner_remove(table, id);
+
+    pthread_mutex_unlock(&table->lock);
+}
+
+// Host address name last released, or 0 if it is not remembered
+static uint32_t address_owner_previous(address_owner_table_t *table, const char *name) {
+    uint32_t hash = address_owner_hash(name);
+
+    pthread_mutex_lock(&table->lock);
+    address_sticky_t sticky = table->sticky[hash & (ADDRESS_STICKY_SLOTS - 1)];
+    pthread_mutex_unlock(&table->lock);
+
+    return sticky.hash == hash ? sticky.host_ip : 0;
+}
+
+// Copies up to max of name's addresses and returns how many were copied,
+// with the owner's id in *id_out (0 when it holds none). The references
+// stay valid while the caller holds pools_lock.
+static int address_owner_addresses(address_owner_table_t *table, const char *name,
+                                   address_ref_t *refs_out, int max, uint32_t *id_out) {
+    uint32_t hash = address_owner_hash(name);
+    int count = 0;
+
+    pthread_mutex_lock(&table->lock);
+    uint32_t id = address_owner_find(table, name, hash);
+    if (id != 0) {
+        const address_owner_t *entry = &table->entries[id];
+        count = entry->refs < (uint32_t)max ? (int)entry->refs : max;
+        if (count > 0) memcpy(refs_out, entry->addresses, (size_t)count * sizeof(address_ref_t));
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    *id_out = id;
+    return count;
+}
+
+// Copies an owner's name into buf ("" for none) and returns its length.
+// Names are copied out since a concurrent release may free the entry.
+static uint32_t address_owner_copy(address_owner_table_t *table, uint32_t id,
+                                   char *buf, size_t size) {
+    uint32_t length = 0;
+
+    pthread_mutex_lock(&table->lock);
+    if (id != 0 && id < table->capacity && table->entries[id].name) {
+        length = (uint32_t)strlen(table->entries[id].name);
+        if (length >= size) length = (uint32_t)size - 1;
+        memcpy(buf, table->entries[id].name, length);
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    buf[length] = '\0';
+    return length;
+}
+
+// Bitmap helpers. Bits are set lock-free by compare-and-swap; a bit is only
+// cleared by a holder of the pool's lock, so a set bit seen under that lock
+// stays set. The counters move with each transition.
+
+static uint64_t address_word(const pool_t *pool, uint32_t word) {
+    return __atomic_load_n(&pool->used[word], __ATOMIC_ACQUIRE);
+}
+
+static int address_bit_is_set(const pool_t *pool, uint32_t index) {
+    return (address_word(pool, index >> 6) >> (index & 63)) & 1;
+}
+
+static void address_count(pool_t *pool, int used) {
+    __atomic_fetch_add(&pool->used_ips, used, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&pool->available_ips, used, __ATOMIC_RELAXED);
+}
+
+// Flags a leaf word as full in the summary. If a release emptied a bit in
+// the meantime the flag is taken back, since that release may have cleared
+// the summary before the flag went in.
+static void address_summary_full(pool_t *pool, uint32_t word) {
+    uint64_t bit = 1ULL << (word & 63);
+    __atomic_fetch_or(&pool->summary[word >> 6], bit, __ATOMIC_ACQ_REL);
+    if (address_word(pool, word) != ~0ULL) {
+        __atomic_fetch_and(&pool->summary[word >> 6], ~bit, __ATOMIC_ACQ_REL);
+    }
+}
+
+// Sets the bits of take in a leaf word, provided none of them is set yet.
+// *seen is the caller's view of the word and is refreshed when another
+// thread got there first; returns 1 when the bits were claimed.
+static int address_claim_bits(pool_t *pool, uint32_t word, uint64_t *seen, uint64_t take) {
+    if (*seen & take) return 0;
+    if (!__atomic_compare_exchange_n(&pool->used[word], seen, *seen | take, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    if ((*seen | take) == ~0ULL) address_summary_full(pool, word);
+    address_count(pool, __builtin_popcountll(take));
+    return 1;
+}
+
+// Clears bits that are all set; the caller holds the pool's lock
+static void address_release_bits(pool_t *pool, uint32_t word, uint64_t bits) {
+    __atomic_fetch_and(&pool->used[word], ~bits, __ATOMIC_ACQ_REL);
+    __atomic_fetch_and(&pool->summary[word >> 6], ~(1ULL << (word & 63)), __ATOMIC_ACQ_REL);
+    address_count(pool, -__builtin_popcountll(bits));
+}
+
+// Claims one particular address; 0 if it was already taken
+static int address_mark_used(pool_t *pool, uint32_t index) {
+    uint32_t word = index >> 6;
+    uint64_t bit = 1ULL << (index & 63);
+    uint64_t seen = address_word(pool, word);
+
+    while (!(seen & bit)) {
+        if (address_claim_bits(pool, word, &seen, bit)) return 1;
+    }
+    return 0;
+}
+
+// Recomputes the summary after the leaf words were loaded wholesale
+static void address_rebuild_summary(pool_t *pool) {
+    memset(pool->summary, 0, pool->summary_words * sizeof(uint64_t));
+    for (uint32_t word = 0; word < pool->leaf_words; word++) {
+        if (pool->used[word] == ~0ULL) {
+            pool->summary[word >> 6] |= 1ULL << (word & 63);
+        }
+    }
+}
+
+// Claims the first free address, or returns -1 when every address is taken.
+// A word found full behind a stale summary is flagged so later callers skip
+// it. Padding bits of the last summary word point past leaf_words.
+static int64_t address_claim_free(pool_t *pool) {
+    for (uint32_t s = 0; s < pool->summary_words; s++) {
+        uint64_t open_words = ~__atomic_load_n(&pool->summary[s], __ATOMIC_ACQUIRE);
+
+        while (open_words) {
+            uint32_t word = s * 64 + __builtin_ctzll(open_words);
+            if (word >= pool->leaf_words) return -1;
+
+            uint64_t seen = address_word(pool, word);
+            while (seen != ~0ULL) {
+                uint64_t bit = ~seen & (seen + 1);  // Lowest clear bit
+                if (address_claim_bits(pool, word, &seen, bit)) {
+                    return (int64_t)word * 64 + __builtin_ctzll(bit);
+                }
+            }
+            address_summary_full(pool, word);
+            open_words &= open_words - 1;
+        }
+    }
+    return -1;
+}
+
+// True when the aligned power-of-two block [start, start + count) is free
+static int address_block_is_free(const pool_t *pool, uint32_t start, uint32_t count) {
+    if (count < 64) {
+        uint64_t mask = ((1ULL << count) - 1) << (start & 63);
+        return (address_word(pool, start >> 6) & mask) == 0;
+    }
+    for (uint32_t w = start >> 6; w < (start + count) >> 6; w++) {
+        if (address_word(pool, w)) return 0;
+    }
+    return 1;
+}
+
+// First free block of count addresses aligned to count (a power of two), or
+// -1. Within a word, folding the free bits onto themselves leaves bit i set
+// only if bits i..i+count-1 are all free.
+static int64_t address_find_block(const pool_t *pool, uint32_t count) {
+    if (count > pool->size) return -1;
+
+    if (count < 64) {
+        uint64_t aligned = 0;
+        for (uint32_t i = 0; i < 64; i += count) aligned |= 1ULL << i;
+
+        for (uint32_t w = 0; w < pool->leaf_words; w++) {
+            if (__atomic_load_n(&pool->summary[w >> 6], __ATOMIC_ACQUIRE) & (1ULL << (w & 63))) {
+                continue;
+            }
+
+            uint64_t runs = ~address_word(pool, w);
+            for (uint32_t step = 1; step < count; step <<= 1) runs &= runs >> step;
+            runs &= aligned;
+            if (runs) return (int64_t)w * 64 + __builtin_ctzll(runs);
+        }
+        return -1;
+    }
+
+    for (uint32_t start = 0; start + count <= pool->size; start += count) {
+        if (address_block_is_free(pool, start, count)) return start;
+    }
+    return -1;
+}
+
+// Claims a block found by address_find_block(); 0 if another thread took
+// part of it first
+static int address_claim_block(pool_t *pool, uint32_t start, uint32_t count) {
+    if (count < 64) {
+        uint32_t word = start >> 6;
+        uint64_t mask = ((1ULL << count) - 1) << (start & 63);
+        uint64_t seen = address_word(pool, word);
+        while (!(seen & mask)) {
+            if (address_claim_bits(pool, word, &seen, mask)) return 1;
+        }
+        return 0;
+    }
+
+    uint32_t first = start >> 6, end = (start + count) >> 6;
+    for (uint32_t w = first; w < end; w++) {
+        uint64_t seen = 0;
+        if (!address_claim_bits(pool, w, &seen, ~0ULL)) {
+            while (w-- > first) address_release_bits(pool, w, ~0ULL);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t address_count_used(const pool_t *pool) {
+    uint32_t used = 0;
+    for (uint32_t w = 0; w < pool->leaf_words; w++) {
+        used += __builtin_popcountll(pool->used[w]);
+    }
+    return used;
+}
+
+// Network and broadcast addresses. A /31 is a point-to-point link with two
+// usable addresses (RFC 3021) and a /32 a single host, so neither has any.
+static uint32_t address_reserved_count(const pool_t *pool) {
+    return pool->size > 2 ? 2 : 0;
+}
+
+static int address_is_reserved(const pool_t *pool, uint32_t index) {
+    return pool->size > 2 && (index == 0 || index == pool->size - 1);
+}
+
+// Padding past the end of the block and the reserved first and last
+// addresses are set in the bitmap but are not counted as used. Only for
+// pools no other thread can see yet.
+static void address_update_counts(pool_t *pool) {
+    uint32_t padding = pool->leaf_words * 64 - pool->size;
+    uint32_t set = address_count_used(pool) - padding;
+    pool->used_ips = (int)(set - address_reserved_count(pool));
+    pool->available_ips = (int)(pool->size - set);
+}
+
+// One past the last host-order address of a pool
+static uint64_t address_pool_end(const pool_t *pool) {
+    return (uint64_t)pool->base_ip + pool->size;
+}
+
+// Position of the first range starting above host_ip
+static int address_range_upper(const ip_context_t *ip_ctx, uint32_t host_ip) {
+    int low = 0, high = ip_ctx->pool_count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (ip_ctx->ranges[mid]->base_ip <= host_ip) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Finds the pool holding a host-order address and its slot in that pool.
+// Ranges never overlap, so only the last range starting at or below the
+// address can contain it.
+static pool_t *address_locate(ip_context_t *ip_ctx, uint32_t host_ip, int *index) {
+    int pos = address_range_upper(ip_ctx, host_ip);
+    if (pos == 0) return NULL;
+
+    pool_t *pool = ip_ctx->ranges[pos - 1];
+    if (host_ip >= address_pool_end(pool)) return NULL;
+
+    *index = (int)(host_ip - pool->base_ip);
+    return pool;
+}
+
+// Adds a pool to both indexes; -1 if its range overlaps an existing pool
+static int address_attach_pool(ip_context_t *ip_ctx, pool_t *pool) {
+    int pos = address_range_upper(ip_ctx, pool->base_ip);
+    if (pos > 0 && address_pool_end(ip_ctx->ranges[pos - 1]) > pool->base_ip) return -1;
+    if (pos < ip_ctx->pool_count && ip_ctx->ranges[pos]->base_ip < address_pool_end(pool)) return -1;
+
+    memmove(&ip_ctx->ranges[pos + 1], &ip_ctx->ranges[pos],
+            (ip_ctx->pool_count - pos) * sizeof(pool_t *));
+    ip_ctx->ranges[pos] = pool;
+    ip_ctx->pools[pool->pool_number] = pool;
+    ip_ctx->pool_count++;
+    return 0;
+}
+
+static void address_detach_pool(ip_context_t *ip_ctx, pool_t *pool) {
+    int pos = address_range_upper(ip_ctx, pool->base_ip) - 1;
+    memmove(&ip_ctx->ranges[pos], &ip_ctx->ranges[pos + 1],
+            (ip_ctx->pool_count - pos - 1) * sizeof(pool_t *));
+    ip_ctx->pools[pool->pool_number] = NULL;
+    ip_ctx->pool_count--;
+}
+
+// Prefix length of a contiguous netmask, or -1 if the mask has holes
+static int address_prefix_length(uint32_t netmask) {
+    int prefix = netmask ? __builtin_popcount(netmask) : 0;
+    uint32_t expected = prefix ? ~0u << (32 - prefix) : 0;
+    return netmask == expected ? prefix : -1;
+}
+
+// Allocates a pool with its bitmaps and meta in one block. Only the padding
+// bits are set; the caller reserves the ends or loads the bitmap.
+static pool_t *address_new_pool(int pool_number, const char *pool_name,
+                                uint32_t base_ip, uint32_t netmask) {
+    int prefix = address_prefix_length(netmask);
+    uint32_t size = 1u << (32 - prefix);
+    uint32_t leaf_words = (size + 63) / 64;
+    uint32_t summary_words = (leaf_words + 63) / 64;
+
+    size_t bytes = sizeof(pool_t) + (leaf_words + summary_words) * sizeof(uint64_t) +
+                   size * sizeof(address_meta_t);
+    pool_t *pool = calloc(1, bytes);
+    if (!pool) return NULL;
+
+    pool->pool_number = pool_number;
+    pool->base_ip = base_ip;
+    pool->netmask = netmask;
+    pool->prefix_length = prefix;
+    pool->size = size;
+    pool->leaf_words = leaf_words;
+    pool->summary_words = summary_words;
+    pool->used = (uint64_t *)(pool + 1);
+    pool->summary = pool->used + leaf_words;
+    pool->meta = (address_meta_t *)(pool->summary + summary_words);
+    strncpy(pool->pool_name, pool_name, POOL_NAME_LENGTH - 1);
+    pthread_mutex_init(&pool->lock, NULL);
+
+    if (size % 64) {
+        pool->used[leaf_words - 1] = ~0ULL << (size % 64);
+    }
+    return pool;
+}
+
+static void address_free_pool(pool_t *pool) {
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Lease heap; place and sift are called with lease_mutex held
+
+static void address_lease_place(ip_context_t *ip_ctx, uint32_t slot, address_lease_t lease) {
+    ip_ctx->leases[slot] = lease;
+    lease.pool->meta[lease.index].lease_slot = slot + 1;
+}
+
+// Moves the lease at slot to its place in the heap and returns where it landed
+static uint32_t address_lease_sift(ip_context_t *ip_ctx, uint32_t slot) {
+    address_lease_t lease = ip_ctx->leases[slot];
+
+    while (slot > 0 && ip_ctx->leases[(slot - 1) / 2].expires_at > lease.expires_at) {
+        address_lease_place(ip_ctx, slot, ip_ctx->leases[(slot - 1) / 2]);
+        slot = (slot - 1) / 2;
+    }
+
+    for (;;) {
+        uint32_t child = 2 * slot + 1;
+        if (child >= ip_ctx->lease_count) break;
+        if (child + 1 < ip_ctx->lease_count &&
+            ip_ctx->leases[child + 1].expires_at < ip_ctx->leases[child].expires_at) {
+            child++;
+        }
+        if (ip_ctx->leases[child].expires_at >= lease.expires_at) break;
+        address_lease_place(ip_ctx, slot, ip_ctx->leases[child]);
+        slot = child;
+    }
+
+    address_lease_place(ip_ctx, slot, lease);
+    return slot;
+}
+
+static void address_lease_remove_locked(ip_context_t *ip_ctx, pool_t *pool, uint32_t index) {
+    uint32_t slot = pool->meta[index].lease_slot;
+    if (slot == 0) return;
+
+    pool->meta[index].lease_slot = 0;
+    ip_ctx->lease_count--;
+    if (slot - 1 < ip_ctx->lease_count) {
+        address_lease_place(ip_ctx, slot - 1, ip_ctx->leases[ip_ctx->lease_count]);
+        address_lease_sift(ip_ctx, slot - 1);
+    }
+}
+
+// The calls below take lease_mutex; the caller holds the pool's lock
+
+static void address_lease_remove(ip_context_t *ip_ctx, pool_t *pool, uint32_t index) {
+    pthread_mutex_lock(&ip_ctx->lease_mutex);
+    address_lease_remove_locked(ip_ctx, pool, index);
+    pthread_mutex_unlock(&ip_ctx->lease_mutex);
+}
+
+// Gives an address a lease ending at expires_at, or removes it for 0
+static int address_lease_set(ip_context_t *ip_ctx, pool_t *pool, uint32_t index, time_t expires_at) {
+    pthread_mutex_lock(&ip_ctx->lease_mutex);
+
+    if (expires_at == 0) {
+        address_lease_remove_locked(ip_ctx, pool, index);
+        pthread_mutex_unlock(&ip_ctx->lease_mutex);
+        return 0;
+    }
+
+    uint32_t slot = pool->meta[index].lease_slot;
+    if (slot == 0) {
+        if (ip_ctx->lease_count == ip_ctx->lease_capacity) {
+            uint32_t capacity = ip_ctx->lease_capacity ? ip_ctx->lease_capacity * 2 : 64;
+            address_lease_t *leases = realloc(ip_ctx->leases, capacity * sizeof(address_lease_t));
+            if (!leases) {
+                pthread_mutex_unlock(&ip_ctx->lease_mutex);
+                return -1;
+            }
+            ip_ctx->leases = leases;
+            ip_ctx->lease_capacity = capacity;
+        }
+        slot = ++ip_ctx->lease_count;
+    }
+
+    address_lease_t lease = { expires_at, pool, index };
+    address_lease_place(ip_ctx, slot - 1, lease);
+
+    // A new earliest lease moves the expiry thread's deadline forward
+    if (address_lease_sift(ip_ctx, slot - 1) == 0) {
+        pthread_cond_signal(&ip_ctx->expiry_cond);
+    }
+
+    pthread_mutex_unlock(&ip_ctx->lease_mutex);
+    return 0;
+}
+
+static time_t address_lease_expiry(ip_context_t *ip_ctx, const pool_t *pool, uint32_t index) {
+    pthread_mutex_lock(&ip_ctx->lease_mutex);
+    uint32_t slot = pool->meta[index].lease_slot;
+    time_t expires_at = slot ? ip_ctx->leases[slot - 1].expires_at : 0;
+    pthread_mutex_unlock(&ip_ctx->lease_mutex);
+    return expires_at;
+}
+
+// State changes shared by the live calls and journal replay. Each one is
+// idempotent, since replay may see changes already in the snapshot. Pool
+// creation and deletion need pools_lock for writing; the others need it for
+// reading plus the pool's lock.
+
+// Creates a pool with its network and broadcast addresses reserved
+static int address_apply_pool_create(ip_context_t *ip_ctx, int pool_number, const char *pool_name,
+                                     uint32_t base_ip, uint32_t netmask) {
+    pool_t *existing = address_get_pool(ip_ctx, pool_number);
+    if (existing) {
+        return existing->base_ip == base_ip && existing->netmask == netmask ? 0 : -3;
+    }
+
+    pool_t *pool = address_new_pool(pool_number, pool_name, base_ip, netmask);
+    if (!pool) return -1;
+
+    if (address_reserved_count(pool) > 0) {
+        pool->used[0] |= 1;
+        pool->used[(pool->size - 1) >> 6] |= 1ULL << ((pool->size - 1) & 63);
+    }
+    address_rebuild_summary(pool);
+    address_update_counts(pool);
+
+    if (address_attach_pool(ip_ctx, pool) != 0) {
+        address_free_pool(pool);
+        return -8;
+    }
+    return 0;
+}
+
+static void address_apply_pool_delete(ip_context_t *ip_ctx, int pool_number) {
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    if (!pool) return;
+
+    for (uint32_t i = 0; i < pool->size; i++) {
+        address_owner_release(&ip_ctx->owners, pool, i, 0);
+    }
+    pthread_mutex_lock(&ip_ctx->lease_mutex);
+    for (uint32_t i = 0; i < pool->size; i++) {
+        address_lease_remove_locked(ip_ctx, pool, i);
+    }
+    pthread_mutex_unlock(&ip_ctx->lease_mutex);
+
+    address_detach_pool(ip_ctx, pool);
+    address_free_pool(pool);
+}
+
+// Records the meta of a non-reserved slot and marks it used if it is not
+// already (a claimed slot is), keeping any lease. An empty owner means none;
+// 0 on success, -1 if the owner could not be interned, which leaves the
+// slot without an owner.
+static int address_apply_set(ip_context_t *ip_ctx, pool_t *pool, uint32_t index,
+                             time_t allocation_time, const char *owner) {
+    address_owner_release(&ip_ctx->owners, pool, index, 0);
+    pool->meta[index].owner = 0;
+
+    uint32_t owner_id = 0;
+    if (owner[0] != '\0') {
+        owner_id = address_owner_intern(&ip_ctx->owners, owner, pool, index);
+        if (owner_id == 0) return -1;
+    }
+
+    address_mark_used(pool, index);
+    pool->meta[index].allocation_time = allocation_time;
+    pool->meta[index].owner = owner_id;
+    return 0;
+}
+
+// Frees a used, non-reserved slot and drops its owner reference and lease.
+// The owner keeps it as its previous address for sticky allocation.
+static void address_apply_clear(ip_context_t *ip_ctx, pool_t *pool, uint32_t index) {
+    if (!address_bit_is_set(pool, index)) return;
+
+    address_owner_release(&ip_ctx->owners, pool, index, 1);
+    address_lease_remove(ip_ctx, pool, index);
+    pool->meta[index].allocation_time = 0;
+    pool->meta[index].owner = 0;
+    address_release_bits(pool, index >> 6, 1ULL << (index & 63));
+}
+
+// Replay runs before any other thread starts, so it takes no locks
+static int address_journal_replay(void *ctx, uint16_t type, const void *data, uint32_t length) {
+    ip_context_t *ip_ctx = (ip_context_t *)ctx;
+    int index;
+
+    if (type == ADDRESS_JOURNAL_POOL_CREATE && length == sizeof(address_journal_pool_t)) {
+        address_journal_pool_t record;
+        memcpy(&record, data, sizeof(record));
+        record.pool_name[POOL_NAME_LENGTH - 1] = '\0';
+        int prefix = address_prefix_length(record.netmask);
+        if (record.pool_number <= 0 || record.pool_number > MAX_POOLS ||
+            prefix < ADDRESS_MIN_PREFIX || prefix > ADDRESS_MAX_PREFIX) {
+            return -1;
+        }
+        return address_apply_pool_create(ip_ctx, record.pool_number, record.pool_name,
+                                         record.base_ip, record.netmask) == 0 ? 0 : -1;
+    }
+
+    if (type == ADDRESS_JOURNAL_POOL_DELETE && length == sizeof(int32_t)) {
+        int32_t pool_number;
+        memcpy(&pool_number, data, sizeof(pool_number));
+        address_apply_pool_delete(ip_ctx, pool_number);
+        return 0;
+    }
+
+    if (type == ADDRESS_JOURNAL_SET && length >= offsetof(address_journal_set_t, owner)) {
+        address_journal_set_t record;
+        memset(&record, 0, sizeof(record));
+        memcpy(&record, data, length < sizeof(record) ? length : sizeof(record));
+        if (record.owner_length >= ADDRESS_OWNER_LENGTH ||
+            length != offsetof(address_journal_set_t, owner) + record.owner_length) {
+            return -1;
+        }
+        record.owner[record.owner_length] = '\0';
+
+        pool_t *pool = address_locate(ip_ctx, record.host_ip, &index);
+        if (!pool || address_is_reserved(pool, (uint32_t)index)) return -1;
+        return address_apply_set(ip_ctx, pool, (uint32_t)index,
+                                 (time_t)record.allocation_time, record.owner);
+    }
+
+    if (type == ADDRESS_JOURNAL_CLEAR && length == sizeof(uint32_t)) {
+        uint32_t host_ip;
+        memcpy(&host_ip, data, sizeof(host_ip));
+        pool_t *pool = address_locate(ip_ctx, host_ip, &index);
+        if (!pool || address_is_reserved(pool, (uint32_t)index)) return -1;
+        address_apply_clear(ip_ctx, pool, (uint32_t)index);
+        return 0;
+    }
+
+    if (type == ADDRESS_JOURNAL_LEASE && length == sizeof(address_journal_lease_t)) {
+        address_journal_lease_t record;
+        memcpy(&record, data, sizeof(record));
+        pool_t *pool = address_locate(ip_ctx, record.host_ip, &index);
+        if (!pool || !address_bit_is_set(pool, (uint32_t)index)) return -1;
+        return address_lease_set(ip_ctx, pool, (uint32_t)index, (time_t)record.expires_at);
+    }
+
+    return -1;
+}
+
+// Journal records for a slot are appended under the pool's lock, so they
+// reach the journal in the order the changes were made
+
+static uint64_t address_journal_lease(ip_context_t *ip_ctx, const pool_t *pool, uint32_t index) {
+    address_journal_lease_t record;
+    memset(&record, 0, sizeof(record));
+    record.host_ip = pool->base_ip + index;
+    record.expires_at = (int64_t)address_lease_expiry(ip_ctx, pool, index);
+    return journal_append(ip_ctx->journal, ADDRESS_JOURNAL_LEASE, &record, sizeof(record));
+}
+
+// Journals a slot's current state; returns the sequence number of the last
+// record, 0 if unjournaled
+static uint64_t address_journal_slot(ip_context_t *ip_ctx, const pool_t *pool, uint32_t index) {
+    if (!ip_ctx->journal) return 0;
+
+    if (!address_bit_is_set(pool, index)) {
+        uint32_t host_ip = pool->base_ip + index;
+        return journal_append(ip_ctx->journal, ADDRESS_JOURNAL_CLEAR, &host_ip, sizeof(host_ip));
+    }
+
+    address_journal_set_t record;
+    record.host_ip = pool->base_ip + index;
+    record.owner_length = address_owner_copy(&ip_ctx->owners, pool->meta[index].owner,
+                                             record.owner, sizeof(record.owner));
+    record.allocation_time = (int64_t)pool->meta[index].allocation_time;
+    uint64_t lsn = journal_append(ip_ctx->journal, ADDRESS_JOURNAL_SET, &record,
+                                  offsetof(address_journal_set_t, owner) + record.owner_length);
+
+    if (lsn != 0 && address_lease_expiry(ip_ctx, pool, index) != 0) {
+        lsn = address_journal_lease(ip_ctx, pool, index);
+    }
+    return lsn;
+}
+
+static int address_save_locked(ip_context_t *ip_ctx);
+
+// Makes a change durable: waits for the group commit carrying lsn, or writes
+// a full snapshot when there is no journal. Once enough records have piled
+// up, the journal is folded into a new snapshot. Called without any lock.
+static int address_commit(ip_context_t *ip_ctx, uint64_t lsn) {
+    if (!ip_ctx->journal) return address_save_ips(ip_ctx);
+
+    if (lsn == 0 || journal_sync(ip_ctx->journal, lsn) != 0) return -1;
+
+    // The first committer past the threshold snapshots; the others carry on
+    if (journal_pending_records(ip_ctx->journal) >= ADDRESS_SNAPSHOT_RECORDS &&
+        pthread_mutex_trylock(&ip_ctx->save_mutex) == 0) {
+        if (journal_pending_records(ip_ctx->journal) >= ADDRESS_SNAPSHOT_RECORDS &&
+            address_save_locked(ip_ctx) != 0) {
+            log_warning("Failed to snapshot IP pools, journal keeps growing");
+        }
+        pthread_mutex_unlock(&ip_ctx->save_mutex);
+    }
+    return 0;
+}
+
+// Clears slots of a pool after their commit failed, unless the pool has
+// been deleted in the meantime
+static void address_undo_slots(ip_context_t *ip_ctx, pool_t *pool, int pool_number,
+                               const uint32_t *indexes, int count) {
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    if (address_get_pool(ip_ctx, pool_number) == pool) {
+        pthread_mutex_lock(&pool->lock);
+        for (int i = 0; i < count; i++) address_apply_clear(ip_ctx, pool, indexes[i]);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+}
+
+// Releases every lease due by now, journaling each release. Returns how
+// many were released and the last record's sequence number in *lsn. The
+// caller holds pools_lock for reading. The earliest lease is read under
+// lease_mutex, then checked again under its pool's lock, since it may have
+// been renewed or released in between.
+static int address_expire_due(ip_context_t *ip_ctx, time_t now, uint64_t *lsn) {
+    int expired = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&ip_ctx->lease_mutex);
+        if (ip_ctx->lease_count == 0 || ip_ctx->leases[0].expires_at > now) {
+            pthread_mutex_unlock(&ip_ctx->lease_mutex);
+            break;
+        }
+        pool_t *pool = ip_ctx->leases[0].pool;
+        uint32_t index = ip_ctx->leases[0].index;
+        pthread_mutex_unlock(&ip_ctx->lease_mutex);
+
+        pthread_mutex_lock(&pool->lock);
+        time_t expires_at = address_lease_expiry(ip_ctx, pool, index);
+        if (expires_at != 0 && expires_at <= now) {
+            address_apply_clear(ip_ctx, pool, index);
+            *lsn = address_journal_slot(ip_ctx, pool, index);
+            expired++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return expired;
+}
+
+// Sleeps until the earliest lease is due, releases what expired and commits
+// the releases together
+static void *address_expiry_worker(void *arg) {
+    ip_context_t *ip_ctx = (ip_context_t *)arg;
+
+    pthread_mutex_lock(&ip_ctx->lease_mutex);
+
+    while (ip_ctx->expiry_running) {
+        pthread_mutex_unlock(&ip_ctx->lease_mutex);
+
+        uint64_t lsn = 0;
+        time_t now = time(NULL);
+        pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+        int expired = address_expire_due(ip_ctx, now, &lsn);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+        if (expired > 0) {
+            if (address_commit(ip_ctx, lsn) != 0) {
+                log_error("Failed to save expired IP leases to disk");
+            }
+            log_info("Expired %d IP leases", expired);
+        }
+
+        pthread_mutex_lock(&ip_ctx->lease_mutex);
+        if (expired > 0 || !ip_ctx->expiry_running) continue;
+
+        struct timespec deadline = { now + ADDRESS_EXPIRY_INTERVAL, 0 };
+        if (ip_ctx->lease_count > 0 && ip_ctx->leases[0].expires_at < deadline.tv_sec) {
+            deadline.tv_sec = ip_ctx->leases[0].expires_at;
+        }
+        pthread_cond_timedwait(&ip_ctx->expiry_cond, &ip_ctx->lease_mutex, &deadline);
+    }
+
+    pthread_mutex_unlock(&ip_ctx->lease_mutex);
+    return NULL;
+}
+
+// Lifecycle
+
+static void address_free_pools(ip_context_t *ip_ctx) {
+    while (ip_ctx->pool_count > 0) {
+        pool_t *pool = ip_ctx->ranges[ip_ctx->pool_count - 1];
+        address_detach_pool(ip_ctx, pool);
+        address_free_pool(pool);
+    }
+    free(ip_ctx->leases);
+    ip_ctx->leases = NULL;
+    ip_ctx->lease_count = 0;
+    ip_ctx->lease_capacity = 0;
+}
+
+static void address_destroy_locks(ip_context_t *ip_ctx) {
+    pthread_cond_destroy(&ip_ctx->expiry_cond);
+    pthread_mutex_destroy(&ip_ctx->lease_mutex);
+    pthread_mutex_destroy(&ip_ctx->save_mutex);
+    pthread_rwlock_destroy(&ip_ctx->pools_lock);
+}
+
+int address_init(ip_context_t *ip_ctx) {
+    if (!ip_ctx) return -1;
+
+    memset(ip_ctx, 0, sizeof(ip_context_t));
+    ip_ctx->pool_count = 0;
+    ip_ctx->default_lease = ADDRESS_DEFAULT_LEASE;
+    if (address_owner_table_init(&ip_ctx->owners) != 0) {
+        log_error("Failed to allocate IP owner table");
+        return -1;
+    }
+    pthread_rwlock_init(&ip_ctx->pools_lock, NULL);
+    pthread_mutex_init(&ip_ctx->save_mutex, NULL);
+    pthread_mutex_init(&ip_ctx->lease_mutex, NULL);
+    pthread_cond_init(&ip_ctx->expiry_cond, NULL);
+
+    global_ip_ctx = ip_ctx;
+
+    // Load the last snapshot, then replay the journal written since
+    if (address_load_ips(ip_ctx, ADDRESS_IPS_FILE) != 0) {
+        log_error("Failed to load %s", ADDRESS_IPS_FILE);
+        address_free_pools(ip_ctx);
+        address_owner_table_free(&ip_ctx->owners);
+        address_destroy_locks(ip_ctx);
+        return -1;
+    }
+    ip_ctx->journal = journal_open(ADDRESS_JOURNAL_FILE, ip_ctx->snapshot_generation,
+                                   address_journal_replay, ip_ctx);
+    if (!ip_ctx->journal && errno == EWOULDBLOCK) {
+        // Another process owns the pools; running alongside it would
+        // overwrite its snapshots
+        address_free_pools(ip_ctx);
+        address_owner_table_free(&ip_ctx->owners);
+        address_destroy_locks(ip_ctx);
+        return -1;
+    }
+    if (!ip_ctx->journal) {
+        log_warning("IP journal unavailable, falling back to full snapshots");
+    }
+
+    ip_ctx->expiry_running = 1;
+    if (pthread_create(&ip_ctx->expiry_thread, NULL, address_expiry_worker, ip_ctx) != 0) {
+        log_warning("Failed to start IP lease expiry thread");
+        ip_ctx->expiry_running = 0;
+    }
+
+    log_info("IP management system initialized with %d pools, %u leases",
+             ip_ctx->pool_count, ip_ctx->lease_count);
+    return 0;
+}
+
+void address_cleanup(ip_context_t *ip_ctx) {
+    if (!ip_ctx) return;
+
+    if (ip_ctx->expiry_running) {
+        pthread_mutex_lock(&ip_ctx->lease_mutex);
+        ip_ctx->expiry_running = 0;
+        pthread_cond_signal(&ip_ctx->expiry_cond);
+        pthread_mutex_unlock(&ip_ctx->lease_mutex);
+        pthread_join(ip_ctx->expiry_thread, NULL);
+    }
+
+    // Save IPs before cleanup; this also compacts the journal
+    address_save_ips(ip_ctx);
+    journal_close(ip_ctx->journal);
+    ip_ctx->journal = NULL;
+
+    address_free_pools(ip_ctx);
+    address_owner_table_free(&ip_ctx->owners);
+    address_destroy_locks(ip_ctx);
+
+    if (global_ip_ctx == ip_ctx) global_ip_ctx = NULL;
+    log_info("IP management system cleaned up");
+}
+
+// Pools
+
+int address_create_pool(ip_context_t *ip_ctx, int pool_number, const char *pool_name,
+                        const char *base_ip, const char *netmask) {
+    if (!ip_ctx || !pool_name || !base_ip || !netmask) return -1;
+
+    // Validate pool number
+    if (pool_number <= 0 || pool_number > MAX_POOLS) {
+        log_warning("Invalid pool number: %d", pool_number);
+        return -2;
+    }
+
+    // Convert base IP and netmask
+    struct in_addr base_addr, mask_addr;
+    if (inet_pton(AF_INET, base_ip, &base_addr) != 1) {
+        log_warning("Invalid base IP address: %s", base_ip);
+        return -5;
+    }
+
+    int prefix = -1;
+    if (inet_pton(AF_INET, netmask, &mask_addr) == 1) {
+        prefix = address_prefix_length(ntohl(mask_addr.s_addr));
+    }
+    if (prefix < ADDRESS_MIN_PREFIX || prefix > ADDRESS_MAX_PREFIX) {
+        log_warning("Invalid netmask: %s (prefix must be /%d to /%d)", netmask,
+                    ADDRESS_MIN_PREFIX, ADDRESS_MAX_PREFIX);
+        return -6;
+    }
+
+    // The base must be the network address of the block
+    if (ntohl(base_addr.s_addr) & ~ntohl(mask_addr.s_addr)) {
+        log_warning("Base IP %s is not aligned to /%d", base_ip, prefix);
+        return -5;
+    }
+
+    uint32_t host_base = ntohl(base_addr.s_addr);
+    uint32_t host_mask = ntohl(mask_addr.s_addr);
+
+    pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+
+    // Check if pool already exists
+    if (ip_ctx->pools[pool_number] != NULL) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("Pool already exists: %d", pool_number);
+        return -3;
+    }
+
+    // Check if we have space for new pool
+    if (ip_ctx->pool_count >= MAX_POOLS) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_error("Maximum pools reached");
+        return -4;
+    }
+
+    int rc = address_apply_pool_create(ip_ctx, pool_number, pool_name, host_base, host_mask);
+    if (rc != 0) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        if (rc == -8) {
+            log_warning("Pool %d (%s) overlaps an existing pool", pool_number, base_ip);
+            return -8;
+        }
+        log_error("Failed to allocate memory for pool %d", pool_number);
+        return -1;
+    }
+
+    uint64_t lsn = 0;
+    if (ip_ctx->journal) {
+        address_journal_pool_t record;
+        memset(&record, 0, sizeof(record));
+        record.pool_number = pool_number;
+        record.base_ip = host_base;
+        record.netmask = host_mask;
+        strncpy(record.pool_name, pool_name, POOL_NAME_LENGTH - 1);
+        lsn = journal_append(ip_ctx->journal, ADDRESS_JOURNAL_POOL_CREATE, &record, sizeof(record));
+    }
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IP pool to disk");
+        pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+        address_apply_pool_delete(ip_ctx, pool_number);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -7;
+    }
+
+    log_info("Pool created: %s (Number: %d, %s/%d)", pool_name, pool_number, base_ip, prefix);
+    return 0;
+}
+
+int address_delete_pool(ip_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
+    }
+
+    char pool_name[POOL_NAME_LENGTH];
+    memcpy(pool_name, pool->pool_name, POOL_NAME_LENGTH);
+    address_apply_pool_delete(ip_ctx, pool_number);
+
+    uint64_t lsn = 0;
+    if (ip_ctx->journal) {
+        int32_t number = pool_number;
+        lsn = journal_append(ip_ctx->journal, ADDRESS_JOURNAL_POOL_DELETE, &number, sizeof(number));
+    }
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save pool deletion to disk");
+    }
+
+    log_info("Pool deleted: %s (Number: %d)", pool_name, pool_number);
+    return 0;
+}
+
+pool_t* address_get_pool(ip_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx || pool_number <= 0 || pool_number > MAX_POOLS) return NULL;
+    return ip_ctx->pools[pool_number];
+}
+
+// Allocation
+
+// Claims the address the owner released last, if it is in pool and still
+// free; -1 otherwise
+static int64_t address_claim_previous(ip_context_t *ip_ctx, pool_t *pool, const char *owner) {
+    uint32_t index = address_owner_previous(&ip_ctx->owners, owner) - pool->base_ip;
+    if (index >= pool->size || address_is_reserved(pool, index) ||
+        !address_mark_used(pool, index)) {
+        return -1;
+    }
+    return index;
+}
+
+// The address is claimed in the bitmap without a lock; the pool's lock is
+// only taken to record who got it. A sticky allocation first tries the
+// owner's previous address. A lease of 0 makes the allocation permanent.
+static unsigned int address_allocate(ip_context_t *ip_ctx, int pool_number, const char *allocated_to,
+                                     int sticky, time_t lease) {
+    if (!ip_ctx || !allocated_to) return 0;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("Pool not found: %d", pool_number);
+        return 0;
+    }
+
+    int64_t found = sticky ? address_claim_previous(ip_ctx, pool, allocated_to) : -1;
+    if (found < 0) found = address_claim_free(pool);
+    if (found < 0) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("Pool %d is full", pool_number);
+        return 0;
+    }
+
+    uint32_t index = (uint32_t)found;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (address_apply_set(ip_ctx, pool, index, now, allocated_to) != 0 ||
+        (lease > 0 && address_lease_set(ip_ctx, pool, index, now + lease) != 0)) {
+        // A snapshot may already hold the claimed bit, so the undo is journaled
+        address_apply_clear(ip_ctx, pool, index);
+        address_journal_slot(ip_ctx, pool, index);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_error("Failed to record allocation in pool %d", pool_number);
+        return 0;
+    }
+
+    uint64_t lsn = address_journal_slot(ip_ctx, pool, index);
+    unsigned int ip_address = htonl(pool->base_ip + index);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    // Wait for the group commit that carries this allocation
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IP allocation to disk");
+        address_undo_slots(ip_ctx, pool, pool_number, &index, 1);
+        return 0;
+    }
+
+    log_info("IP %s allocated to %s in pool %d",
+             address_ip_to_string(ip_address), allocated_to, pool_number);
+    return ip_address;
+}
+
+unsigned int address_allocate_ip(ip_context_t *ip_ctx, int pool_number, const char *allocated_to) {
+    return address_allocate(ip_ctx, pool_number, allocated_to, 0, ip_ctx ? ip_ctx->default_lease : 0);
+}
+
+// Hands the owner back the address it released last when that is still
+// free, e.g. to re-provision a VPS on its old IP
+unsigned int address_allocate_sticky(ip_context_t *ip_ctx, int pool_number, const char *allocated_to) {
+    return address_allocate(ip_ctx, pool_number, allocated_to, 1, ip_ctx ? ip_ctx->default_lease : 0);
+}
+
+// Allocation that the expiry thread releases after lease_seconds unless it
+// is renewed; 0 makes it permanent whatever the default lease
+unsigned int address_allocate_leased(ip_context_t *ip_ctx, int pool_number, const char *allocated_to,
+                                     time_t lease_seconds, bool sticky) {
+    if (lease_seconds < 0) return 0;
+    return address_allocate(ip_ctx, pool_number, allocated_to, sticky, lease_seconds);
+}
+
+// Records count claimed slots as allocated to one owner, with the default
+// lease, journals them and returns the last record's sequence number. On
+// failure the slots are cleared again and *ok is 0. The caller holds the
+// pool's lock.
+static uint64_t address_take_slots(ip_context_t *ip_ctx, pool_t *pool, const uint32_t *indexes,
+                                   int count, const char *allocated_to, int *ok) {
+    time_t now = time(NULL);
+    uint64_t lsn = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (address_apply_set(ip_ctx, pool, indexes[i], now, allocated_to) != 0 ||
+            (ip_ctx->default_lease > 0 &&
+             address_lease_set(ip_ctx, pool, indexes[i], now + ip_ctx->default_lease) != 0)) {
+            for (int j = 0; j < count; j++) address_apply_clear(ip_ctx, pool, indexes[j]);
+            *ok = 0;
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        lsn = address_journal_slot(ip_ctx, pool, indexes[i]);
+    }
+    *ok = 1;
+    return lsn;
+}
+
+// Claims up to count free addresses, taking as many as it can from each
+// word with one compare-and-swap. Returns how many were claimed.
+static int address_claim_many(pool_t *pool, uint32_t *indexes, int count) {
+    int found = 0;
+
+    for (uint32_t w = 0; w < pool->leaf_words && found < count; w++) {
+        if (__atomic_load_n(&pool->summary[w >> 6], __ATOMIC_ACQUIRE) & (1ULL << (w & 63))) {
+            continue;
+        }
+
+        uint64_t seen = address_word(pool, w);
+        for (;;) {
+            uint64_t free_bits = ~seen, take = 0;
+            for (int n = found; free_bits && n < count; n++) {
+                take |= free_bits & -free_bits;
+                free_bits &= free_bits - 1;
+            }
+            if (!take) break;
+            if (!address_claim_bits(pool, w, &seen, take)) continue;
+
+            while (take) {
+                indexes[found++] = w * 64 + __builtin_ctzll(take);
+                take &= take - 1;
+            }
+            break;
+        }
+    }
+    return found;
+}
+
+// Allocates count addresses from a pool in one operation and one commit.
+// All or nothing: returns count, or -1 bad arguments, -2 pool not found,
+// -3 not enough free addresses, -4 save failed.
+int address_allocate_batch(ip_context_t *ip_ctx, int pool_number, const char *allocated_to,
+                           int count, unsigned int *ips_out) {
+    if (!ip_ctx || !allocated_to || !ips_out || count <= 0) return -1;
+
+    uint32_t *indexes = malloc((size_t)count * sizeof(uint32_t));
+    if (!indexes) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        free(indexes);
+        return -2;
+    }
+
+    // Claiming under the pool's lock keeps a snapshot from seeing a partial
+    // batch that is then given back
+    pthread_mutex_lock(&pool->lock);
+
+    int found = address_claim_many(pool, indexes, count);
+    if (found < count) {
+        for (int i = 0; i < found; i++) {
+            address_release_bits(pool, indexes[i] >> 6, 1ULL << (indexes[i] & 63));
+        }
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        free(indexes);
+        log_warning("Pool %d has %d free addresses, %d requested", pool_number, found, count);
+        return -3;
+    }
+
+    int ok;
+    uint64_t lsn = address_take_slots(ip_ctx, pool, indexes, count, allocated_to, &ok);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (!ok) {
+        free(indexes);
+        log_error("Failed to record batch allocation in pool %d", pool_number);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        ips_out[i] = htonl(pool->base_ip + indexes[i]);
+    }
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save batch allocation to disk");
+        address_undo_slots(ip_ctx, pool, pool_number, indexes, count);
+        free(indexes);
+        return -4;
+    }
+
+    free(indexes);
+    log_info("%d IPs allocated to %s in pool %d", count, allocated_to, pool_number);
+    return count;
+}
+
+// Allocates a whole aligned block, e.g. a /29 for one host, in one commit.
+// Returns the block's first address in network byte order, 0 on failure.
+unsigned int address_allocate_block(ip_context_t *ip_ctx, int pool_number, const char *allocated_to,
+                                    int prefix_length) {
+    if (!ip_ctx || !allocated_to) return 0;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    if (!pool || prefix_length <= pool->prefix_length || prefix_length > 32) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("Invalid block /%d for pool %d", prefix_length, pool_number);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    // The reserved network and broadcast bits keep the ends out of any block.
+    // Single allocations may take part of a block between the search and the
+    // claim, in which case the search runs again.
+    uint32_t count = 1u << (32 - prefix_length);
+    int64_t start;
+    do {
+        start = address_find_block(pool, count);
+    } while (start >= 0 && !address_claim_block(pool, (uint32_t)start, count));
+
+    uint32_t *indexes = start >= 0 ? malloc(count * sizeof(uint32_t)) : NULL;
+    if (!indexes) {
+        for (uint32_t i = 0; start >= 0 && i < count; i++) {
+            address_apply_clear(ip_ctx, pool, (uint32_t)start + i);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("No free /%d block in pool %d", prefix_length, pool_number);
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) indexes[i] = (uint32_t)start + i;
+
+    int ok;
+    uint64_t lsn = address_take_slots(ip_ctx, pool, indexes, (int)count, allocated_to, &ok);
+    unsigned int block_address = htonl(pool->base_ip + (uint32_t)start);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (!ok || address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save block allocation to disk");
+        if (ok) address_undo_slots(ip_ctx, pool, pool_number, indexes, (int)count);
+        free(indexes);
+        return 0;
+    }
+
+    free(indexes);
+    log_info("Block %s/%d allocated to %s in pool %d",
+             address_ip_to_string(block_address), prefix_length, allocated_to, pool_number);
+    return block_address;
+}
+
+// Marks a specific address in a pool as used, e.g. for a static assignment.
+// Registered addresses have no lease.
+int address_register_ip(ip_context_t *ip_ctx, unsigned int ip_address, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    uint32_t host_ip = ntohl(ip_address);
+    if (!pool || host_ip - pool->base_ip >= pool->size) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IP %s is not in pool %d", address_ip_to_string(ip_address), pool_number);
+        return -2;
+    }
+
+    uint32_t index = host_ip - pool->base_ip;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (!address_mark_used(pool, index)) {
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -3;
+    }
+
+    address_apply_set(ip_ctx, pool, index, time(NULL), "");
+    uint64_t lsn = address_journal_slot(ip_ctx, pool, index);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IP registration to disk");
+        address_undo_slots(ip_ctx, pool, pool_number, &index, 1);
+        return -4;
+    }
+
+    return 0;
+}
+
+// An address claimed by an allocation still in progress has its bit set but
+// no allocation time yet, and is not the caller's to release. The caller
+// holds the pool's lock.
+static int address_is_releasable(const pool_t *pool, int index) {
+    // Network and broadcast addresses are never handed out or released
+    return !address_is_reserved(pool, (uint32_t)index) && address_bit_is_set(pool, index) &&
+           pool->meta[index].allocation_time != 0;
+}
+
+int address_release_ip(ip_context_t *ip_ctx, unsigned int ip_address) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    int index;
+    pool_t *pool = address_locate(ip_ctx, ntohl(ip_address), &index);
+    if (pool) pthread_mutex_lock(&pool->lock);
+    if (!pool || !address_is_releasable(pool, index)) {
+        if (pool) pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IP not found or already free: %s", address_ip_to_string(ip_address));
+        return -3;
+    }
+
+    // Keep what is needed to roll the release back
+    int pool_number = pool->pool_number;
+    address_meta_t previous = pool->meta[index];
+    time_t previous_expiry = address_lease_expiry(ip_ctx, pool, (uint32_t)index);
+    char owner[ADDRESS_OWNER_LENGTH];
+    address_owner_copy(&ip_ctx->owners, previous.owner, owner, sizeof(owner));
+
+    address_apply_clear(ip_ctx, pool, (uint32_t)index);
+    uint64_t lsn = address_journal_slot(ip_ctx, pool, (uint32_t)index);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IP release to disk");
+        pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+        if (address_get_pool(ip_ctx, pool_number) == pool) {
+            pthread_mutex_lock(&pool->lock);
+            if (address_mark_used(pool, (uint32_t)index)) {
+                address_apply_set(ip_ctx, pool, (uint32_t)index, previous.allocation_time, owner);
+                address_lease_set(ip_ctx, pool, (uint32_t)index, previous_expiry);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -2;
+    }
+
+    log_info("IP %s released", address_ip_to_string(ip_address));
+    return 0;
+}
+
+// Moves an allocation's lease to end at new_expiry; 0 makes it permanent.
+// An expiry already in the past is rejected with -4.
+int address_renew_allocation(ip_context_t *ip_ctx, unsigned int ip_address, time_t new_expiry) {
+    if (!ip_ctx) return -1;
+    if (new_expiry != 0 && new_expiry <= time(NULL)) return -4;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    int index;
+    pool_t *pool = address_locate(ip_ctx, ntohl(ip_address), &index);
+    if (pool) pthread_mutex_lock(&pool->lock);
+    if (!pool || !address_is_releasable(pool, index)) {
+        if (pool) pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -3;
+    }
+
+    int pool_number = pool->pool_number;
+    time_t previous = address_lease_expiry(ip_ctx, pool, (uint32_t)index);
+    if (address_lease_set(ip_ctx, pool, (uint32_t)index, new_expiry) != 0) {
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
+    }
+    uint64_t lsn = ip_ctx->journal ? address_journal_lease(ip_ctx, pool, (uint32_t)index) : 0;
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IP renewal to disk");
+        pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+        if (address_get_pool(ip_ctx, pool_number) == pool) {
+            pthread_mutex_lock(&pool->lock);
+            if (address_is_releasable(pool, index)) {
+                address_lease_set(ip_ctx, pool, (uint32_t)index, previous);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -2;
+    }
+    return 0;
+}
+
+// Releases every lease that ended at or before now. The expiry thread does
+// this on its own; calling it only forces an early pass.
+void address_cleanup_expired(ip_context_t *ip_ctx, time_t now) {
+    if (!ip_ctx) return;
+
+    uint64_t lsn = 0;
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    int expired_count = address_expire_due(ip_ctx, now, &lsn);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (expired_count > 0) {
+        if (address_commit(ip_ctx, lsn) != 0) {
+            log_error("Failed to save expired IP releases to disk");
+        }
+        log_info("Cleaned up %d expired IP allocations", expired_count);
+    }
+}
+
+// Queries
+
+int address_get_ip(ip_context_t *ip_ctx, unsigned int ip_address, ip_t *ip_out) {
+    if (!ip_ctx || !ip_out) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    int index;
+    pool_t *pool = address_locate(ip_ctx, ntohl(ip_address), &index);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    memset(ip_out, 0, sizeof(ip_t));
+    ip_out->ip_address = ip_address;
+    ip_out->is_used = address_bit_is_set(pool, index);
+    ip_out->pool_number = pool->pool_number;
+    ip_out->allocation_time = pool->meta[index].allocation_time;
+    ip_out->expires_at = address_lease_expiry(ip_ctx, pool, (uint32_t)index);
+    address_owner_copy(&ip_ctx->owners, pool->meta[index].owner,
+                       ip_out->allocated_to, sizeof(ip_out->allocated_to));
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
     return 0;
 }
 
-void ip_cleanup(ip_context_t *ip_ctx) {
-    if (!ip_ctx) return;
-    
-    // Save IPs before cleanup
-    ip_save_ips(ip_ctx, "ips.dat");
-    
-    log_info("IP management system cleaned up");
+int address_get_available_ips(ip_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    int available = pool ? __atomic_load_n(&pool->available_ips, __ATOMIC_RELAXED) : -1;
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return available;
 }
 
-int ip_create_pool(ip_context_t *ip_ctx, int pool_number, const char *pool_name, 
-                  const char *base_ip, const char *netmask) {
-    if (!ip_ctx || !pool_name || !base_ip || !netmask) return -1;
-    
-    // Validate pool number
-    if (pool_number <= 0 || pool_number > MAX_POOLS) {
-        log_warning("Invalid pool number: %d", pool_number);
-        return -2;
-    }
-    
-    // Check if pool already exists
-    if (ip_get_pool(ip_ctx, pool_number) != NULL) {
-        log_warning("Pool already exists: %d", pool_number);
-        return -3;
-    }
-    
-    // Check if we have space for new pool
-    if (ip_ctx->pool_count >= MAX_POOLS) {
-        log_error("Maximum pools reached");
-        return -4;
-    }
-    
-    // Create new pool
-    pool_t *pool = &ip_ctx->pools[ip_ctx->pool_count];
-    pool->pool_number = pool_number;
-    strncpy(pool->pool_name, pool_name, POOL_NAME_LENGTH - 1);
-    
-    // Convert and store base IP and netmask
-    if (inet_pton(AF_INET, base_ip, &pool->base_ip) != 1) {
-        log_warning("Invalid base IP address: %s", base_ip);
-        return -5;
-    }
-    
-    if (inet_pton(AF_INET, netmask, &pool->netmask) != 1) {
-        log_warning("Invalid netmask: %s", netmask);
-        return -6;
+int address_get_used_ips(ip_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
+    int used = pool ? __atomic_load_n(&pool->used_ips, __ATOMIC_RELAXED) : -1;
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return used;
+}
+
+bool address_is_ip_available(ip_context_t *ip_ctx, unsigned int ip_address) {
+    if (!ip_ctx) return false;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    int index;
+    pool_t *pool = address_locate(ip_ctx, ntohl(ip_address), &index);
+    bool available = pool && !address_bit_is_set(pool, index);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return available;
+}
+
+// Fills pools_out with up to max_pools pools in address order and returns
+// how many were written. Allocations take pools_lock for reading too and
+// the counters are atomic, so polling this never waits for an allocation.
+int address_list_pools(ip_context_t *ip_ctx, address_pool_info_t *pools_out, int max_pools) {
+    if (!ip_ctx || !pools_out || max_pools < 0) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    int count = ip_ctx->pool_count < max_pools ? ip_ctx->pool_count : max_pools;
+    for (int p = 0; p < count; p++) {
+        const pool_t *pool = ip_ctx->ranges[p];
+        address_pool_info_t *info = &pools_out[p];
+
+        info->pool_number = pool->pool_number;
+        memcpy(info->pool_name, pool->pool_name, POOL_NAME_LENGTH);
+        info->base_ip = htonl(pool->base_ip);
+        info->prefix_length = pool->prefix_length;
+        info->size = pool->size;
+        info->available_ips = __atomic_load_n(&pool->available_ips, __ATOMIC_RELAXED);
+        info->used_ips = __atomic_load_n(&pool->used_ips, __ATOMIC_RELAXED);
     }
-    
-    // Initialize all IPs in the pool as available
-    for (int i = 0; i < MAX_ADDRESSES_POOL; i++) {
-        pool->addresses[i].ip_address = htonl(ntohl(pool->base_ip) + i);
-        pool->addresses[i].is_used = false;
-        pool->addresses[i].pool_number = pool_number;
-        memset(pool->addresses[i].allocated_to, 0, sizeof(pool->addresses[i].allocated_to));
-        pool->addresses[i].allocation_time = 0;
-    }
-    
-    // First and last addresses are reserved
-    pool->addresses[0].is_used = true;
-    pool->addresses[MAX_ADDRESSES_POOL-1].is_used = true;
-    
-    pool->available_ips = MAX_ADDRESSES_POOL - 2; // Subtract 2 for network and broadcast
-    pool->used_ips = 2;
-    pool->is_full = false;
-    
-    ip_ctx->pool_count++;
-    
-    // Immediately save to disk
-    if (ip_save_ips(ip_ctx, "ips.dat") != 0) {
-        log_error("Failed to save IP pool to disk");
-        ip_ctx->pool_count--;
-        return -7;
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return count;
+}
+
+// Fills ips_out with up to max_ips of the owner's allocations, found through
+// the owner index rather than by scanning pools; returns how many were filled
+int address_list_owner(ip_context_t *ip_ctx, const char *owner, ip_t *ips_out, int max_ips) {
+    if (!ip_ctx || !owner || max_ips < 0 || (max_ips > 0 && !ips_out)) return -1;
+    if (max_ips == 0) return 0;
+
+    address_ref_t *refs = malloc((size_t)max_ips * sizeof(address_ref_t));
+    if (!refs) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    uint32_t owner_id;
+    int count = address_owner_addresses(&ip_ctx->owners, owner, refs, max_ips, &owner_id);
+    int filled = 0;
+
+    for (int i = 0; i < count; i++) {
+        pool_t *pool = refs[i].pool;
+        uint32_t index = refs[i].index;
+
+        pthread_mutex_lock(&pool->lock);
+        // Skip addresses that changed hands since the list was copied
+        if (pool->meta[index].owner == owner_id) {
+            ip_t *ip = &ips_out[filled++];
+            memset(ip, 0, sizeof(ip_t));
+            ip->ip_address = htonl(pool->base_ip + index);
+            ip->is_used = true;
+            ip->pool_number = pool->pool_number;
+            ip->allocation_time = pool->meta[index].allocation_time;
+            ip->expires_at = address_lease_expiry(ip_ctx, pool, index);
+            strncpy(ip->allocated_to, owner, sizeof(ip->allocated_to) - 1);
+        }
+        pthread_mutex_unlock(&pool->lock);
     }
-    
-    log_info("Pool created: %s (Number: %d)", pool_name, pool_number);
-    return 0;
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    free(refs);
+    return filled;
 }
 
-unsigned int ip_allocate_ip(ip_context_t *ip_ctx, int pool_number, const char *allocated_to) {
-    if (!ip_ctx || !allocated_to) return 0;
-    
-    pool_t *pool = ip_get_pool(ip_ctx, pool_number);
+// Splits each free run into maximal aligned blocks, as a buddy allocator's
+// free lists would hold it. Allocations running alongside can make the
+// figures slightly stale, never inconsistent.
+int address_get_fragmentation(ip_context_t *ip_ctx, int pool_number,
+                              address_fragmentation_t *stats_out) {
+    if (!ip_ctx || !stats_out) return -1;
+
+    memset(stats_out, 0, sizeof(address_fragmentation_t));
+    stats_out->largest_free_prefix = -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool_t *pool = address_get_pool(ip_ctx, pool_number);
     if (!pool) {
-        log_warning("Pool not found: %d", pool_number);
-        return 0;
-    }
-    
-    if (pool->is_full) {
-        log_warning("Pool %d is full", pool_number);
-        return 0;
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
     }
-    
-    // Find first available IP
-    for (int i = 1; i < MAX_ADDRESSES_POOL-1; i++) { // Skip first and last
-        if (!pool->addresses[i].is_used) {
-            pool->addresses[i].is_used = true;
-            strncpy(pool->addresses[i].allocated_to, allocated_to, 
-                   sizeof(pool->addresses[i].allocated_to) - 1);
-            pool->addresses[i].allocation_time = time(NULL);
-            
-            pool->available_ips--;
-            pool->used_ips++;
-            
-            if (pool->available_ips == 0) {
-                pool->is_full = true;
-            }
-            
-            // Immediately save to disk
-            if (ip_save_ips(ip_ctx, "ips.dat") != 0) {
-                log_error("Failed to save IP allocation to disk");
-                // Roll back
-                pool->addresses[i].is_used = false;
-                pool->available_ips++;
-                pool->used_ips--;
-                return 0;
-            }
-            
-            log_info("IP %s allocated to %s in pool %d", 
-                    ip_to_string(pool->addresses[i].ip_address),
-                    allocated_to, pool_number);
-            
-            return pool->addresses[i].ip_address;
+
+    uint32_t index = 0;
+    while (index < pool->size) {
+        if (address_word(pool, index >> 6) == ~0ULL) {
+            index = (index | 63) + 1;
+            continue;
+        }
+        if (address_bit_is_set(pool, index)) {
+            index++;
+            continue;
+        }
+
+        // Largest aligned free block starting here
+        uint32_t count = index ? (index & -index) : pool->size;
+        while (count > 1 && !address_block_is_free(pool, index, count)) count >>= 1;
+
+        int prefix = 32 - __builtin_ctz(count);
+        stats_out->free_blocks[prefix]++;
+        stats_out->free_addresses += count;
+        if (stats_out->largest_free_prefix < 0 || prefix < stats_out->largest_free_prefix) {
+            stats_out->largest_free_prefix = prefix;
         }
+        index += count;
     }
-    
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
     return 0;
 }
 
-int ip_release_ip(ip_context_t *ip_ctx, unsigned int ip_address) {
-    if (!ip_ctx) return -1;
-    
-    for (int p = 0; p < ip_ctx->pool_count; p++) {
-        pool_t *pool = &ip_ctx->pools[p];
-        for (int i = 0; i < MAX_ADDRESSES_POOL; i++) {
-            if (pool->addresses[i].ip_address == ip_address && pool->addresses[i].is_used) {
-                pool->addresses[i].is_used = false;
-                memset(pool->addresses[i].allocated_to, 0, sizeof(pool->addresses[i].allocated_to));
-                pool->addresses[i].allocation_time = 0;
-                
-                pool->available_ips++;
-                pool->used_ips--;
-                pool->is_full = false;
-                
-                // Immediately save to disk
-                if (ip_save_ips(ip_ctx, "ips.dat") != 0) {
-                    log_error("Failed to save IP release to disk");
-                    // Roll back
-                    pool->addresses[i].is_used = true;
-                    pool->available_ips--;
-                    pool->used_ips++;
-                    return -2;
+// Persistence
+
+// Writes every pool to filename through a temporary file, so a crash leaves
+// either the old snapshot or the new one. The caller holds pools_lock for
+// reading. Each pool's bitmap is copied under the pool's lock, so the
+// entries match the bits written; a bit claimed by an allocation still in
+// progress goes out with empty meta and is completed by that allocation's
+// journal record.
+static int address_write_snapshot(ip_context_t *ip_ctx, const char *filename, uint64_t generation) {
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+    FILE *file = fopen(temp_filename, "wb");
+    if (!file) {
+        log_error("Failed to open IP file for writing: %s", temp_filename);
+        return -1;
+    }
+
+    address_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ADDRESS_FILE_MAGIC;
+    header.version = ADDRESS_FILE_VERSION;
+    header.generation = generation;
+    header.pool_count = ip_ctx->pool_count;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // Pools hold only the bitmap; metadata goes out for allocated addresses
+    uint64_t used[ADDRESS_LEAF_WORDS_MAX];
+    for (int p = 0; p < ip_ctx->pool_count && ok; p++) {
+        pool_t *pool = ip_ctx->ranges[p];
+
+        pthread_mutex_lock(&pool->lock);
+
+        // Claims still in progress have no allocation time yet. They are
+        // written as free: after a crash nothing would ever release them,
+        // and the journal record that completes one comes after this file.
+        uint32_t entries = 0;
+        for (uint32_t w = 0; w < pool->leaf_words; w++) {
+            uint64_t word = address_word(pool, w);
+            for (uint64_t bits = word; bits; bits &= bits - 1) {
+                uint32_t i = w * 64 + (uint32_t)__builtin_ctzll(bits);
+                if (i >= pool->size || address_is_reserved(pool, i)) continue;
+                if (pool->meta[i].allocation_time == 0) {
+                    word &= ~(1ULL << (i & 63));
+                } else {
+                    entries++;
                 }
-                
-                log_info("IP %s released from pool %d", 
-                        ip_to_string(ip_address), pool->pool_number);
-                return 0;
             }
+            used[w] = word;
         }
-    }
-    
-    log_warning("IP not found or already free: %s", ip_to_string(ip_address));
-    return -3;
-}
 
-pool_t* ip_get_pool(ip_context_t *ip_ctx, int pool_number) {
-    if (!ip_ctx) return NULL;
-    
-    for (int i = 0; i < ip_ctx->pool_count; i++) {
-        if (ip_ctx->pools[i].pool_number == pool_number) {
-            return &ip_ctx->pools[i];
-        }
-    }
-    
-    return NULL;
-}
+        address_file_pool_t record;
+        memset(&record, 0, sizeof(record));
+        record.pool_number = pool->pool_number;
+        record.base_ip = pool->base_ip;
+        record.netmask = pool->netmask;
+        memcpy(record.pool_name, pool->pool_name, POOL_NAME_LENGTH);
+        record.entry_count = entries;
+        ok = fwrite(&record, sizeof(record), 1, file) == 1 &&
+             fwrite(used, sizeof(uint64_t), pool->leaf_words, file) == pool->leaf_words;
 
-ip_t* ip_get_ip(ip_context_t *ip_ctx, unsigned int ip_address) {
-    if (!ip_ctx) return NULL;
-    
-    for (int p = 0; p < ip_ctx->pool_count; p++) {
-        for (int i = 0; i < MAX_ADDRESSES_POOL; i++) {
-            if (ip_ctx->pools[p].addresses[i].ip_address == ip_address) {
-                return &ip_ctx->pools[p].addresses[i];
+        // Every used, non-reserved address has an entry
+        for (uint32_t i = 0; i < pool->size && ok; i++) {
+            if (!((used[i >> 6] >> (i & 63)) & 1)) {
+                // Skip whole free words
+                if (used[i >> 6] == 0) i |= 63;
+                continue;
             }
+            if (address_is_reserved(pool, i)) continue;
+
+            char owner[ADDRESS_OWNER_LENGTH];
+            address_file_entry_t entry;
+            entry.index = i;
+            entry.owner_length = address_owner_copy(&ip_ctx->owners, pool->meta[i].owner,
+                                                    owner, sizeof(owner));
+            entry.allocation_time = (int64_t)pool->meta[i].allocation_time;
+            entry.expires_at = (int64_t)address_lease_expiry(ip_ctx, pool, i);
+            ok = fwrite(&entry, sizeof(entry), 1, file) == 1 &&
+                 fwrite(owner, 1, entry.owner_length, file) == entry.owner_length;
         }
+
+        pthread_mutex_unlock(&pool->lock);
     }
-    
-    return NULL;
+
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(temp_filename, filename) != 0) {
+        unlink(temp_filename);
+        log_error("Failed to write IP file: %s", filename);
+        return -1;
+    }
+    return 0;
 }
 
-int ip_save_ips(ip_context_t *ip_ctx, const char *filename) {
-    if (!ip_ctx || !filename) return -1;
-    
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        log_error("Failed to open IP file for writing: %s", filename);
+// Snapshots the pools to ips.dat, naming the first journal generation not
+// covered, then drops the journal generations before it. The caller holds
+// save_mutex.
+static int address_save_locked(ip_context_t *ip_ctx) {
+    // A record appended before the rotation was appended under its pool's
+    // lock after the change it describes, so the snapshot sees the change.
+    // Records after the rotation are replayed on top of the snapshot.
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    uint64_t generation = ip_ctx->snapshot_generation;
+    if (ip_ctx->journal && journal_rotate(ip_ctx->journal, &generation) != 0) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_error("Failed to rotate IP journal");
         return -1;
     }
-    
-    // Write pool count
-    fwrite(&ip_ctx->pool_count, sizeof(int), 1, file);
-    
-    // Write each pool
-    for (int i = 0; i < ip_ctx->pool_count; i++) {
-        // Write pool metadata
-        fwrite(&ip_ctx->pools[i], sizeof(pool_t), 1, file);
+
+    int pool_count = ip_ctx->pool_count;
+    int rc = address_write_snapshot(ip_ctx, ADDRESS_IPS_FILE, generation);
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    if (rc != 0) return -1;
+
+    ip_ctx->snapshot_generation = generation;
+    if (ip_ctx->journal) {
+        journal_discard_before(ip_ctx->journal, generation);
     }
-    
-    fclose(file);
-    log_info("Saved %d IP pools to %s", ip_ctx->pool_count, filename);
+
+    log_info("Saved %d IP pools to %s", pool_count, ADDRESS_IPS_FILE);
     return 0;
 }
 
-int ip_load_ips(ip_context_t *ip_ctx, const char *filename) {
+int address_save_ips(ip_context_t *ip_ctx) {
+    if (!ip_ctx) return -1;
+
+    pthread_mutex_lock(&ip_ctx->save_mutex);
+    int rc = address_save_locked(ip_ctx);
+    pthread_mutex_unlock(&ip_ctx->save_mutex);
+    return rc;
+}
+
+int address_load_ips(ip_context_t *ip_ctx, const char *filename) {
     if (!ip_ctx || !filename) return -1;
-    
+
     FILE *file = fopen(filename, "rb");
     if (!file) {
         log_info("IP file not found, starting with empty database");
         return 0;
     }
-    
-    // Read pool count
-    if (fread(&ip_ctx->pool_count, sizeof(int), 1, file) != 1) {
-        log_error("Failed to read pool count from file");
+
+    address_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != ADDRESS_FILE_MAGIC || header.version < 3 ||
+        header.version > ADDRESS_FILE_VERSION) {
+        log_error("Unsupported IP file format: %s", filename);
         fclose(file);
         return -1;
     }
-    
+
+    ip_ctx->snapshot_generation = header.generation;
+
     // Validate pool count
-    if (ip_ctx->pool_count > MAX_POOLS) {
-        log_error("Invalid pool count in file: %d", ip_ctx->pool_count);
+    if (header.pool_count < 0 || header.pool_count > MAX_POOLS) {
+        log_error("Invalid pool count in file: %d", header.pool_count);
         fclose(file);
         return -1;
     }
-    
-    // Read each pool
-    for (int i = 0; i < ip_ctx->pool_count; i++) {
-        if (fread(&ip_ctx->pools[i], sizeof(pool_t), 1, file) != 1) {
-            log_error("Failed to read pool %d from file", i);
+
+    for (int p = 0; p < header.pool_count; p++) {
+        address_file_pool_t record;
+        if (fread(&record, sizeof(record), 1, file) != 1 ||
+            record.pool_number <= 0 || record.pool_number > MAX_POOLS ||
+            ip_ctx->pools[record.pool_number] != NULL) {
+            log_error("Failed to read pool %d from file", p);
+            fclose(file);
+            return -1;
+        }
+
+        int prefix = address_prefix_length(record.netmask);
+        if (prefix < ADDRESS_MIN_PREFIX || prefix > ADDRESS_MAX_PREFIX) {
+            log_error("Pool %d in %s has an invalid netmask", record.pool_number, filename);
+            fclose(file);
+            return -1;
+        }
+
+        record.pool_name[POOL_NAME_LENGTH - 1] = '\0';
+        pool_t *pool = address_new_pool(record.pool_number, record.pool_name,
+                                        record.base_ip, record.netmask);
+        if (!pool) {
+            fclose(file);
+            return -1;
+        }
+        if (fread(pool->used, sizeof(uint64_t), pool->leaf_words, file) != pool->leaf_words) {
+            log_error("Failed to read bitmap of pool %d from file", record.pool_number);
+            address_free_pool(pool);
+            fclose(file);
+            return -1;
+        }
+        address_rebuild_summary(pool);
+        address_update_counts(pool);
+        if (address_attach_pool(ip_ctx, pool) != 0) {
+            log_error("Pool %d in %s overlaps another pool", record.pool_number, filename);
+            address_free_pool(pool);
             fclose(file);
             return -1;
         }
+
+        for (uint32_t e = 0; e < record.entry_count; e++) {
+            // Version 3 entries end before expires_at
+            address_file_entry_t entry;
+            size_t entry_size = header.version >= 4 ? sizeof(entry)
+                                                    : offsetof(address_file_entry_t, expires_at);
+            char owner[ADDRESS_OWNER_LENGTH];
+            memset(&entry, 0, sizeof(entry));
+            if (fread(&entry, entry_size, 1, file) != 1 || entry.index >= pool->size ||
+                entry.owner_length >= sizeof(owner) ||
+                fread(owner, 1, entry.owner_length, file) != entry.owner_length) {
+                log_error("Failed to read allocations of pool %d from file", record.pool_number);
+                fclose(file);
+                return -1;
+            }
+            owner[entry.owner_length] = '\0';
+
+            pool->meta[entry.index].allocation_time = (time_t)entry.allocation_time;
+            if (entry.owner_length > 0) {
+                address_owner_release(&ip_ctx->owners, pool, entry.index, 0);
+                pool->meta[entry.index].owner =
+                    address_owner_intern(&ip_ctx->owners, owner, pool, entry.index);
+            }
+            if (entry.expires_at != 0 &&
+                address_lease_set(ip_ctx, pool, entry.index, (time_t)entry.expires_at) != 0) {
+                log_error("Failed to restore lease of pool %d", record.pool_number);
+                fclose(file);
+                return -1;
+            }
+        }
     }
-    
+
     fclose(file);
     log_info("Loaded %d IP pools from %s", ip_ctx->pool_count, filename);
     return 0;
 }
 
-char* ip_to_string(unsigned int ip_address) {
-    static char str[INET_ADDRSTRLEN];
+// Bulk import and export
+
+#define ADDRESS_IMPORT_OK 0
+#define ADDRESS_IMPORT_CONFLICT 1
+#define ADDRESS_IMPORT_INVALID 2
+
+typedef struct {
+    uint64_t number;  // Position in the stream, from 1
+    uint32_t host_ip;
+    uint32_t index;
+    pool_t *pool;
+    time_t allocation_time;
+    time_t expires_at;
+    int status;
+    char owner[ADDRESS_OWNER_LENGTH];
+} address_import_record_t;
+
+// One batch, split into runs of records that share a pool. Workers take
+// runs off next_run, so each pool's lock is held by one worker at a time.
+typedef struct {
+    ip_context_t *ip_ctx;
+    address_import_record_t *records;
+    uint32_t *runs;       // run_count + 1 offsets into records
+    int run_count;
+    int next_run;         // Atomic
+    uint64_t lsn;         // Highest journal record of the batch; atomic
+    int failed;           // A record could not be journaled; atomic
+} address_import_batch_t;
+
+// The HTTP API's rule for owner names: no quotes, backslashes or control
+// characters. Tabs and newlines would also break the text export's lines.
+static int address_is_plain_owner(const char *owner) {
+    for (; *owner; owner++) {
+        if (*owner == '"' || *owner == '\\' || (unsigned char)*owner < 0x20) return 0;
+    }
+    return 1;
+}
+
+// Parses "ip<TAB>owner[<TAB>allocation_time[<TAB>expires_at]]". Returns 1
+// for a record, 0 for a blank or comment line and -1 if it is malformed.
+static int address_parse_line(char *line, address_import_record_t *record) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0' || line[0] == '#') return 0;
+
+    char *fields[4] = { line, NULL, NULL, NULL };
+    int count = 1;
+    for (char *cursor = line; *cursor && count < 4; cursor++) {
+        if (*cursor == '\t') {
+            *cursor = '\0';
+            fields[count++] = cursor + 1;
+        }
+    }
+    if (count < 2 || strchr(fields[count - 1], '\t')) return -1;
+
+    struct in_addr addr;
+    if (inet_pton(AF_INET, fields[0], &addr) != 1) return -1;
+    record->host_ip = ntohl(addr.s_addr);
+
+    size_t owner_length = strlen(fields[1]);
+    if (owner_length >= ADDRESS_OWNER_LENGTH || !address_is_plain_owner(fields[1])) return -1;
+    memcpy(record->owner, fields[1], owner_length + 1);
+
+    time_t *times[2] = { &record->allocation_time, &record->expires_at };
+    for (int i = 0; i < 2; i++) {
+        *times[i] = 0;
+        if (i + 2 >= count) continue;
+        char *end;
+        long long value = strtoll(fields[i + 2], &end, 10);
+        if (end == fields[i + 2] || *end != '\0' || value < 0) return -1;
+        *times[i] = (time_t)value;
+    }
+    return 1;
+}
+
+// Reads the next record. Returns 1 for a record, 0 at the end, -1 for an
+// invalid record that can be skipped and -2 when the stream is unreadable.
+static int address_import_next(FILE *in, int format, address_import_record_t *record) {
+    if (format == ADDRESS_FORMAT_TEXT) {
+        char line[ADDRESS_OWNER_LENGTH + 64];
+        while (fgets(line, sizeof(line), in)) {
+            if (!strchr(line, '\n') && !feof(in)) {
+                // Too long to be valid; drop the rest of the line
+                int c;
+                while ((c = fgetc(in)) != EOF && c != '\n') {}
+                return -1;
+            }
+            int rc = address_parse_line(line, record);
+            if (rc != 0) return rc;
+        }
+        return ferror(in) ? -2 : 0;
+    }
+
+    address_export_record_t entry;
+    size_t got = fread(&entry, 1, sizeof(entry), in);
+    if (got == 0 && feof(in)) return 0;
+    if (got != sizeof(entry) || entry.owner_length >= ADDRESS_OWNER_LENGTH ||
+        fread(record->owner, 1, entry.owner_length, in) != entry.owner_length) {
+        return -2;
+    }
+    record->owner[entry.owner_length] = '\0';
+    record->host_ip = ntohl(entry.ip_address);
+    record->allocation_time = (time_t)entry.allocation_time;
+    record->expires_at = (time_t)entry.expires_at;
+    if (entry.allocation_time < 0 || entry.expires_at < 0 ||
+        strlen(record->owner) != entry.owner_length || !address_is_plain_owner(record->owner)) {
+        return -1;
+    }
+    return 1;
+}
+
+static void address_import_invalid(address_import_stats_t *stats, uint64_t number) {
+    stats->invalid++;
+    if (stats->first_invalid == 0 || number < stats->first_invalid) stats->first_invalid = number;
+}
+
+static int address_import_compare(const void *a, const void *b) {
+    const address_import_record_t *left = a, *right = b;
+    if (left->pool != right->pool) {
+        return left->pool->pool_number < right->pool->pool_number ? -1 : 1;
+    }
+    return left->index < right->index ? -1 : left->index > right->index;
+}
+
+// Applies one run under its pool's lock; the batch's caller holds pools_lock
+static void address_import_run(address_import_batch_t *batch, int run) {
+    ip_context_t *ip_ctx = batch->ip_ctx;
+    address_import_record_t *first = &batch->records[batch->runs[run]];
+    address_import_record_t *last = &batch->records[batch->runs[run + 1]];
+    pool_t *pool = first->pool;
+    uint64_t lsn = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (address_import_record_t *record = first; record < last; record++) {
+        if (!address_mark_used(pool, record->index)) {
+            record->status = ADDRESS_IMPORT_CONFLICT;
+            continue;
+        }
+        if (address_apply_set(ip_ctx, pool, record->index, record->allocation_time, record->owner) != 0 ||
+            (record->expires_at != 0 &&
+             address_lease_set(ip_ctx, pool, record->index, record->expires_at) != 0)) {
+            address_apply_clear(ip_ctx, pool, record->index);
+            address_journal_slot(ip_ctx, pool, record->index);
+            record->status = ADDRESS_IMPORT_INVALID;
+            continue;
+        }
+        uint64_t record_lsn = address_journal_slot(ip_ctx, pool, record->index);
+        if (ip_ctx->journal && record_lsn == 0) __atomic_store_n(&batch->failed, 1, __ATOMIC_RELAXED);
+        if (record_lsn > lsn) lsn = record_lsn;
+        record->status = ADDRESS_IMPORT_OK;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    uint64_t seen = __atomic_load_n(&batch->lsn, __ATOMIC_RELAXED);
+    while (lsn > seen && !__atomic_compare_exchange_n(&batch->lsn, &seen, lsn, 0,
+                                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static void *address_import_worker(void *arg) {
+    address_import_batch_t *batch = (address_import_batch_t *)arg;
+    int run;
+    while ((run = __atomic_fetch_add(&batch->next_run, 1, __ATOMIC_RELAXED)) < batch->run_count) {
+        address_import_run(batch, run);
+    }
+    return NULL;
+}
+
+// Applies a parsed batch with its pools in parallel and commits it with a
+// single journal sync. Invalid records are marked and left out.
+static int address_import_batch(ip_context_t *ip_ctx, address_import_record_t *records, int count,
+                                uint32_t *runs, address_import_stats_t *stats) {
+    time_t now = time(NULL);
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    // Resolve pools first; invalid records sort to the end as pool-less
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        address_import_record_t *record = &records[i];
+        int index;
+        record->pool = address_locate(ip_ctx, record->host_ip, &index);
+        if (!record->pool || address_is_reserved(record->pool, (uint32_t)index) ||
+            (record->expires_at != 0 && record->expires_at <= now)) {
+            record->status = ADDRESS_IMPORT_INVALID;
+            address_import_invalid(stats, record->number);
+            continue;
+        }
+        record->index = (uint32_t)index;
+        if (record->allocation_time == 0) record->allocation_time = now;
+        if (valid != i) {
+            address_import_record_t swap = records[valid];
+            records[valid] = *record;
+            *record = swap;
+        }
+        valid++;
+    }
+    qsort(records, valid, sizeof(address_import_record_t), address_import_compare);
+
+    address_import_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.ip_ctx = ip_ctx;
+    batch.records = records;
+    batch.runs = runs;
+    for (int i = 0; i < valid; i++) {
+        if (i == 0 || records[i].pool != records[i - 1].pool) runs[batch.run_count++] = (uint32_t)i;
+    }
+    runs[batch.run_count] = (uint32_t)valid;
+
+    pthread_t threads[ADDRESS_IMPORT_THREADS - 1];
+    int thread_count = 0;
+    while (thread_count < ADDRESS_IMPORT_THREADS - 1 && thread_count + 1 < batch.run_count &&
+           pthread_create(&threads[thread_count], NULL, address_import_worker, &batch) == 0) {
+        thread_count++;
+    }
+    address_import_worker(&batch);
+    for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (batch.failed || (batch.lsn > 0 && address_commit(ip_ctx, batch.lsn) != 0) ||
+        (!ip_ctx->journal && address_commit(ip_ctx, 0) != 0)) {
+        log_error("Failed to save IP import batch, rolling it back");
+        for (int i = 0; i < valid; i++) {
+            if (records[i].status != ADDRESS_IMPORT_OK) continue;
+            address_undo_slots(ip_ctx, records[i].pool, records[i].pool->pool_number,
+                               &records[i].index, 1);
+        }
+        return -1;
+    }
+
+    for (int i = 0; i < valid; i++) {
+        if (records[i].status == ADDRESS_IMPORT_OK) stats->imported++;
+        else if (records[i].status == ADDRESS_IMPORT_CONFLICT) stats->conflicts++;
+        else address_import_invalid(stats, records[i].number);
+    }
+    return 0;
+}
+
+// Imports allocations from a stream in batches of ADDRESS_IMPORT_BATCH
+// records, each made durable with one commit. Addresses that are already
+// allocated are left alone. Returns 0, or -1 if the stream is unreadable
+// or a batch could not be saved; batches before it stay imported.
+int address_import(ip_context_t *ip_ctx, FILE *in, int format, address_import_stats_t *stats_out) {
+    if (!ip_ctx || !in || (format != ADDRESS_FORMAT_TEXT && format != ADDRESS_FORMAT_BINARY)) return -1;
+
+    address_import_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    if (format == ADDRESS_FORMAT_BINARY) {
+        address_export_header_t header;
+        if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != ADDRESS_EXPORT_MAGIC ||
+            header.version != 1) {
+            log_error("IP import stream is not in the binary export format");
+            return -1;
+        }
+    }
+
+    address_import_record_t *records = malloc(ADDRESS_IMPORT_BATCH * sizeof(address_import_record_t));
+    uint32_t *runs = malloc((ADDRESS_IMPORT_BATCH + 1) * sizeof(uint32_t));
+    if (!records || !runs) {
+        free(records);
+        free(runs);
+        return -1;
+    }
+
+    int rc = 0;
+    uint64_t record_number = 0;
+    for (;;) {
+        int count = 0, read_rc = 0;
+        while (count < ADDRESS_IMPORT_BATCH &&
+               (read_rc = address_import_next(in, format, &records[count])) != 0 && read_rc != -2) {
+            record_number++;
+            if (read_rc == 1) {
+                records[count++].number = record_number;
+            } else {
+                address_import_invalid(&stats, record_number);
+            }
+        }
+
+        if (count > 0 && address_import_batch(ip_ctx, records, count, runs, &stats) != 0) {
+            rc = -1;
+            break;
+        }
+        if (read_rc == -2) {
+            log_error("IP import stream is truncated or corrupt after %llu records",
+                      (unsigned long long)record_number);
+            rc = -1;
+            break;
+        }
+        if (read_rc == 0) break;
+    }
+
+    free(records);
+    free(runs);
+
+    log_info("IP import: %llu imported, %llu already allocated, %llu invalid",
+             (unsigned long long)stats.imported, (unsigned long long)stats.conflicts,
+             (unsigned long long)stats.invalid);
+    if (stats_out) *stats_out = stats;
+    return rc;
+}
+
+typedef struct {
+    uint32_t index;
+    uint32_t owner_length;
+    time_t allocation_time;
+    time_t expires_at;
+    char owner[ADDRESS_OWNER_LENGTH];
+} address_export_entry_t;
+
+// Buffers output so the writer sees large writes
+typedef struct {
+    address_write_fn write;
+    void *write_ctx;
+    char data[65536];
+    size_t length;
+    int failed;
+} address_export_buffer_t;
+
+static void address_export_flush(address_export_buffer_t *buffer) {
+    if (buffer->length > 0 && !buffer->failed &&
+        buffer->write(buffer->write_ctx, buffer->data, buffer->length) != 0) {
+        buffer->failed = 1;
+    }
+    buffer->length = 0;
+}
+
+static void address_export_put(address_export_buffer_t *buffer, const void *data, size_t length) {
+    if (buffer->length + length > sizeof(buffer->data)) address_export_flush(buffer);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+// Copies up to ADDRESS_EXPORT_CHUNK allocations at or after *cursor and moves
+// the cursor past them. The caller holds the pool's lock.
+static int address_export_chunk(ip_context_t *ip_ctx, pool_t *pool, uint32_t *cursor,
+                                address_export_entry_t *entries) {
+    int count = 0;
+    uint32_t i = *cursor;
+    for (; i < pool->size && count < ADDRESS_EXPORT_CHUNK; i++) {
+        uint64_t word = address_word(pool, i >> 6);
+        if (!((word >> (i & 63)) & 1)) {
+            if (word == 0) i |= 63;  // Skip whole free words
+            continue;
+        }
+        // Claims still in progress have no allocation time yet
+        if (pool->meta[i].allocation_time == 0) continue;
+
+        address_export_entry_t *entry = &entries[count++];
+        entry->index = i;
+        entry->allocation_time = pool->meta[i].allocation_time;
+        entry->expires_at = address_lease_expiry(ip_ctx, pool, i);
+        entry->owner_length = address_owner_copy(&ip_ctx->owners, pool->meta[i].owner,
+                                                 entry->owner, sizeof(entry->owner));
+    }
+    *cursor = i;
+    return count;
+}
+
+// Streams every allocation to write, a chunk of a pool at a time, so
+// allocations only wait for one chunk and the dataset is never held whole.
+// Pools cannot be created or deleted while the export runs.
+int address_export(ip_context_t *ip_ctx, int format, address_write_fn write, void *write_ctx) {
+    if (!ip_ctx || !write || (format != ADDRESS_FORMAT_TEXT && format != ADDRESS_FORMAT_BINARY)) return -1;
+
+    address_export_buffer_t *buffer = malloc(sizeof(address_export_buffer_t));
+    address_export_entry_t *entries = malloc(ADDRESS_EXPORT_CHUNK * sizeof(address_export_entry_t));
+    if (!buffer || !entries) {
+        free(buffer);
+        free(entries);
+        return -1;
+    }
+    buffer->write = write;
+    buffer->write_ctx = write_ctx;
+    buffer->length = 0;
+    buffer->failed = 0;
+
+    if (format == ADDRESS_FORMAT_BINARY) {
+        address_export_header_t header = { ADDRESS_EXPORT_MAGIC, 1 };
+        address_export_put(buffer, &header, sizeof(header));
+    } else {
+        const char *comment = "# ip\towner\tallocation_time\texpires_at\n";
+        address_export_put(buffer, comment, strlen(comment));
+    }
+
+    uint64_t exported = 0;
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    for (int p = 0; p < ip_ctx->pool_count && !buffer->failed; p++) {
+        pool_t *pool = ip_ctx->ranges[p];
+        uint32_t cursor = 0;
+        while (cursor < pool->size && !buffer->failed) {
+            pthread_mutex_lock(&pool->lock);
+            int count = address_export_chunk(ip_ctx, pool, &cursor, entries);
+            pthread_mutex_unlock(&pool->lock);
+
+            for (int i = 0; i < count; i++) {
+                address_export_entry_t *entry = &entries[i];
+                if (format == ADDRESS_FORMAT_BINARY) {
+                    address_export_record_t record;
+                    record.ip_address = htonl(pool->base_ip + entry->index);
+                    record.owner_length = entry->owner_length;
+                    record.allocation_time = (int64_t)entry->allocation_time;
+                    record.expires_at = (int64_t)entry->expires_at;
+                    address_export_put(buffer, &record, sizeof(record));
+                    address_export_put(buffer, entry->owner, entry->owner_length);
+                } else {
+                    char line[ADDRESS_OWNER_LENGTH + 64];
+                    int length = snprintf(line, sizeof(line), "%s\t%s\t%lld\t%lld\n",
+                                          address_ip_to_string(htonl(pool->base_ip + entry->index)),
+                                          entry->owner, (long long)entry->allocation_time,
+                                          (long long)entry->expires_at);
+                    address_export_put(buffer, line, (size_t)length);
+                }
+            }
+            exported += count;
+        }
+    }
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    address_export_flush(buffer);
+    int rc = buffer->failed ? -1 : 0;
+    free(buffer);
+    free(entries);
+
+    if (rc == 0) log_info("IP export: %llu allocations", (unsigned long long)exported);
+    return rc;
+}
+
+// Utilities
+
+char* address_ip_to_string(unsigned int ip_address) {
+    static __thread char str[INET_ADDRSTRLEN];  // One per thread, allocations log concurrently
     struct in_addr addr;
     addr.s_addr = ip_address;
     inet_ntop(AF_INET, &addr, str, INET_ADDRSTRLEN);
     return str;
 }
 
-unsigned int ip_string_to_ip(const char *ip_str) {
+unsigned int address_string_to_ip(const char *ip_str) {
     struct in_addr addr;
     if (inet_pton(AF_INET, ip_str, &addr) != 1) {
         return 0;
     }
     return addr.s_addr;
 }
-
-void ip_cleanup_expired(ip_context_t *ip_ctx, time_t expiry_time) {
-    if (!ip_ctx) return;
-    
-    time_t now = time(NULL);
-    int expired_count = 0;
-    
-    for (int p = 0; p < ip_ctx->pool_count; p++) {
-        pool_t *pool = &ip_ctx->pools[p];
-        for (int i = 0; i < MAX_ADDRESSES_POOL; i++) {
-            if (pool->addresses[i].is_used && 
-                (now - pool->addresses[i].allocation_time) > expiry_time) {
-                ip_release_ip(ip_ctx, pool->addresses[i].ip_address);
-                expired_count++;
-            }
-        }
-    }
-    
-    if (expired_count > 0) {
-        log_info("Cleaned up %d expired IP allocations", expired_count);
-    }
-}
\ No newline at end of file
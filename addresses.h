@@ -2,33 +2,194 @@
 #define IP_MANAGEMENT_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
+#include <pthread.h>
+#include "journal.h"
 
-#define MAX_ADDRESSES_POOL 256
-#define MAX_ADDRESSES_POOL_USE 254
+// Pools keep per-address metadata in one allocation sized by prefix, 24
+// bytes an address, and snapshots copy a pool's bitmap on the stack. A /16
+// costs ~1.5 MB; a /8 would need ~400 MB per pool up front, so larger
+// blocks are split into several /16 pools. /31 and /32 pools reserve no
+// network or broadcast address.
+#define ADDRESS_MIN_PREFIX 16  // Largest pool: 65536 addresses
+#define ADDRESS_MAX_PREFIX 32  // Smallest pool: a single host
 #define MAX_POOLS 500
 #define POOL_NAME_LENGTH 64
+#define ADDRESS_OWNER_LENGTH 128
+#define ADDRESS_IPS_FILE "ips.dat"
+#define ADDRESS_JOURNAL_FILE "ips.journal"
+#define ADDRESS_SNAPSHOT_RECORDS 1000  // Journal records that trigger a new ips.dat
+#define ADDRESS_DEFAULT_LEASE 0        // Lease for allocations that don't ask for one; 0 = permanent
+#define ADDRESS_EXPIRY_INTERVAL 60     // Longest the expiry thread sleeps
+#define ADDRESS_STICKY_SLOTS 4096      // Owners whose last address is remembered; power of two
+#define ADDRESS_IMPORT_BATCH 8192      // Records applied per import commit
+#define ADDRESS_IMPORT_THREADS 4       // Pools of one batch applied in parallel
+#define ADDRESS_EXPORT_CHUNK 1024      // Allocations copied per pool lock hold
 
+// Bulk formats. Text is one allocation per line,
+// "ip<TAB>owner<TAB>allocation_time<TAB>expires_at", the times optional and
+// 0 for none. Binary is an address_export_header_t followed by one
+// address_export_record_t plus owner bytes per allocation.
+#define ADDRESS_FORMAT_TEXT 0
+#define ADDRESS_FORMAT_BINARY 1
+#define ADDRESS_EXPORT_MAGIC 0x31585049  // "IPX1"
+
+// IP addresses passed to and returned from this API are in network byte
+// order, as produced by inet_pton() / address_string_to_ip().
+
+// Snapshot of one address, filled in by address_get_ip()
 typedef struct {
     unsigned int ip_address;
     bool is_used;
     int pool_number;
     time_t allocation_time;
-    char allocated_to[128];
+    time_t expires_at;  // 0 when the address has no lease
+    char allocated_to[ADDRESS_OWNER_LENGTH];
 } ip_t;
 
+// Cold per-address data; only touched when an address changes hands
+typedef struct {
+    time_t allocation_time;
+    uint32_t owner;       // Index into the owner table, 0 = none
+    uint32_t lease_slot;  // Heap position plus one, 0 = no lease; under lease_mutex
+    uint32_t owner_slot;  // Position in the owner's address list; under the owner table's lock
+} address_meta_t;
+
+// A pool covers one CIDR block and keeps its free/used state in a bitmap
+// (bit set = in use). A summary bitmap has one bit per leaf word, set when
+// that word is full, so finding a free address in a /16 is a ctz over at
+// most 16 summary words and then one leaf word. The network and broadcast
+// addresses, and the padding bits of a partial last word, are kept set.
+// The bitmaps and meta share the pool's allocation and are sized by prefix.
+//
+// Bits are set with compare-and-swap and only cleared under the pool's lock,
+// so allocation claims an address without any lock and takes the pool lock
+// only to fill in the address's meta and journal it.
 typedef struct {
     int pool_number;
-    bool is_full;
-    int available_ips;
+    uint32_t base_ip;   // Host byte order, aligned to the netmask
+    uint32_t netmask;   // Host byte order
+    int prefix_length;
+    uint32_t size;      // Addresses in the block, including the reserved two
+    int available_ips;  // Both counters are updated atomically
     int used_ips;
+    uint32_t leaf_words;
+    uint32_t summary_words;
+    uint64_t *used;
+    uint64_t *summary;
     char pool_name[POOL_NAME_LENGTH];
-    ip_t addresses[MAX_ADDRESSES_POOL];
+    pthread_mutex_t lock;  // Guards meta and orders the pool's journal records
+    address_meta_t *meta;  // size entries
 } pool_t;
 
+// One address, as the pool it lives in and its index there
+typedef struct {
+    pool_t *pool;
+    uint32_t index;
+} address_ref_t;
+
+// Interned owner strings, shared by every address allocated to the same
+// owner. Each entry also lists the owner's addresses, so finding them does
+// not scan the pools; an address's meta holds its position in the list.
+typedef struct {
+    char *name;                  // NULL when the entry is free
+    uint32_t hash;
+    uint32_t refs;               // Addresses held, the length of addresses
+    address_ref_t *addresses;
+    uint32_t address_capacity;
+} address_owner_t;
+
+// Last address released by an owner, for sticky allocation. The table is
+// direct-mapped on the owner's hash, so a colliding owner overwrites it.
+typedef struct {
+    uint32_t hash;
+    uint32_t host_ip;  // 0 when empty
+} address_sticky_t;
+
+typedef struct {
+    address_owner_t *entries;  // Entry 0 is reserved for "no owner"
+    uint32_t capacity;
+    uint32_t *buckets;         // Open-addressed, entry index or 0 when empty
+    uint32_t bucket_count;     // Power of two
+    uint32_t free_head;        // First released entry; free entries chain through hash
+    address_sticky_t *sticky;  // ADDRESS_STICKY_SLOTS entries
+    pthread_mutex_t lock;
+} address_owner_table_t;
+
+// Free space of a pool split into maximal aligned blocks, the way a buddy
+// allocator would hold it
 typedef struct {
-    pool_t pools[MAX_POOLS];
+    uint32_t free_blocks[33];  // Indexed by the block's prefix length
+    int largest_free_prefix;   // -1 when the pool is full
+    uint32_t free_addresses;
+} address_fragmentation_t;
+
+// Summary of one pool, filled in by address_list_pools()
+typedef struct {
+    int pool_number;
+    char pool_name[POOL_NAME_LENGTH];
+    unsigned int base_ip;  // Network byte order
+    int prefix_length;
+    uint32_t size;
+    int available_ips;
+    int used_ips;
+} address_pool_info_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} address_export_header_t;
+
+typedef struct {
+    uint32_t ip_address;  // Network byte order
+    uint32_t owner_length;
+    int64_t allocation_time;
+    int64_t expires_at;
+} address_export_record_t;
+
+// Outcome of address_import()
+typedef struct {
+    uint64_t imported;
+    uint64_t conflicts;        // Address already allocated, left as it was
+    uint64_t invalid;          // Unparsable or bad owner, outside every pool, reserved or expired
+    uint64_t first_invalid;    // Record number of the first invalid record, 0 if none
+} address_import_stats_t;
+
+// Receives exported data; returns 0 to carry on
+typedef int (*address_write_fn)(void *ctx, const void *data, size_t length);
+
+// Leases form a min-heap on expires_at, so expiry only touches the leases
+// that are due and a renewal is one sift
+typedef struct {
+    time_t expires_at;
+    pool_t *pool;
+    uint32_t index;
+} address_lease_t;
+
+// Locks are taken in the order pools_lock, a pool's lock, then lease_mutex
+// or the owner table's lock
+typedef struct {
+    pthread_rwlock_t pools_lock;   // Read to use pools, write to create or delete them
+    pool_t *pools[MAX_POOLS + 1];  // Indexed by pool number, allocated on demand
+    pool_t *ranges[MAX_POOLS];     // The same pools sorted by base_ip, for lookups by address
     int pool_count;
+    address_owner_table_t owners;
+    journal_t *journal;            // Changes since the last ips.dat snapshot
+    uint64_t snapshot_generation;  // First journal generation not in ips.dat
+
+    pthread_mutex_t save_mutex;    // One snapshot at a time
+
+    pthread_mutex_t lease_mutex;   // Guards the lease heap
+    address_lease_t *leases;
+    uint32_t lease_count;
+    uint32_t lease_capacity;
+    time_t default_lease;          // Given to allocations without their own, 0 = none
+
+    pthread_t expiry_thread;
+    pthread_cond_t expiry_cond;    // Wakes the expiry thread for an earlier lease
+    int expiry_running;
 } ip_context_t;
 
 // Initialization and cleanup
@@ -38,28 +199,45 @@ void address_cleanup(ip_context_t *address_ctx);
 // IP Address Management
 int address_register_ip(ip_context_t *address_ctx, unsigned int ip_address, int pool_number);
 int address_release_ip(ip_context_t *address_ctx, unsigned int ip_address);
-ip_t* address_get_ip(ip_context_t *address_ctx, unsigned int ip_address);
+int address_get_ip(ip_context_t *address_ctx, unsigned int ip_address, ip_t *ip_out);
 
 // Pool Management
-int address_create_pool(ip_context_t *address_ctx, int pool_number, const char *pool_name);
+int address_create_pool(ip_context_t *address_ctx, int pool_number, const char *pool_name,
+                        const char *base_ip, const char *netmask);
 int address_delete_pool(ip_context_t *address_ctx, int pool_number);
 pool_t* address_get_pool(ip_context_t *address_ctx, int pool_number);
 
 // Allocation Management
 unsigned int address_allocate_ip(ip_context_t *address_ctx, int pool_number, const char *allocated_to);
+unsigned int address_allocate_sticky(ip_context_t *address_ctx, int pool_number, const char *allocated_to);
+unsigned int address_allocate_leased(ip_context_t *address_ctx, int pool_number, const char *allocated_to,
+                                     time_t lease_seconds, bool sticky);
+int address_allocate_batch(ip_context_t *address_ctx, int pool_number, const char *allocated_to,
+                           int count, unsigned int *ips_out);
+unsigned int address_allocate_block(ip_context_t *address_ctx, int pool_number, const char *allocated_to,
+                                    int prefix_length);
 int address_renew_allocation(ip_context_t *address_ctx, unsigned int ip_address, time_t new_expiry);
+void address_cleanup_expired(ip_context_t *address_ctx, time_t now);
 
 // Query Functions
 int address_get_available_ips(ip_context_t *address_ctx, int pool_number);
 int address_get_used_ips(ip_context_t *address_ctx, int pool_number);
 bool address_is_ip_available(ip_context_t *address_ctx, unsigned int ip_address);
+int address_list_pools(ip_context_t *address_ctx, address_pool_info_t *pools_out, int max_pools);
+int address_list_owner(ip_context_t *address_ctx, const char *owner, ip_t *ips_out, int max_ips);
+int address_get_fragmentation(ip_context_t *address_ctx, int pool_number,
+                              address_fragmentation_t *stats_out);
 
 // Persistence
-int address_save_ips(ip_context_t *address_ctx, const char *filename);
+int address_save_ips(ip_context_t *address_ctx);
 int address_load_ips(ip_context_t *address_ctx, const char *filename);
 
+// Bulk Import and Export
+int address_import(ip_context_t *address_ctx, FILE *in, int format, address_import_stats_t *stats_out);
+int address_export(ip_context_t *address_ctx, int format, address_write_fn write, void *write_ctx);
+
 // Utility Functions
 char* address_ip_to_string(unsigned int ip_address);
 unsigned int address_string_to_ip(const char *ip_str);
 
-#endif // IP_MANAGEMENT_H
\ No newline at end of file
+#endif // IP_MANAGEMENT_H
@@ -0,0 +1,1261 @@
+#include "addresses6.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#define ADDRESS6_FILE_MAGIC 0x36535049  // "IPS6"
+#define ADDRESS6_FILE_VERSION 1
+#define ADDRESS6_INITIAL_BUCKETS 16     // Power of two
+#define ADDRESS6_OWNER_INITIAL 64       // Power of two
+
+// Journal record types
+#define ADDRESS6_JOURNAL_POOL_CREATE 1  // address6_journal_pool_t
+#define ADDRESS6_JOURNAL_POOL_DELETE 2  // int32_t pool number
+#define ADDRESS6_JOURNAL_SET 3          // address6_journal_set_t, owner truncated to owner_length
+#define ADDRESS6_JOURNAL_CLEAR 4        // address6_journal_clear_t
+
+// ips6.dat layout: header, then per pool an address6_file_pool_t and one
+// address6_file_entry_t (plus owner bytes) per allocated prefix. The bitmap
+// pages are rebuilt from the entries.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;  // First journal generation to replay on top
+    int32_t pool_count;
+} address6_file_header_t;
+
+typedef struct {
+    int32_t pool_number;
+    int32_t prefix_length;
+    int32_t delegated_length;
+    uint32_t reserved;
+    uint64_t base_high;
+    uint64_t base_low;
+    char pool_name[POOL_NAME_LENGTH];
+} address6_journal_pool_t;
+
+typedef struct {
+    address6_journal_pool_t pool;
+    uint32_t entry_count;
+} address6_file_pool_t;
+
+typedef struct {
+    uint32_t index;
+    uint32_t owner_length;
+    int64_t allocation_time;
+} address6_file_entry_t;
+
+typedef struct {
+    int32_t pool_number;
+    uint32_t index;
+    int64_t allocation_time;
+    uint32_t owner_length;
+    uint32_t reserved;
+    char owner[ADDRESS_OWNER_LENGTH];
+} address6_journal_set_t;
+
+typedef struct {
+    int32_t pool_number;
+    uint32_t index;
+} address6_journal_clear_t;
+
+// 128-bit addresses are handled as two host-order halves
+
+static void address6_split(const struct in6_addr *address, uint64_t *high, uint64_t *low) {
+    *high = 0;
+    *low = 0;
+    for (int i = 0; i < 8; i++) {
+        *high = (*high << 8) | address->s6_addr[i];
+        *low = (*low << 8) | address->s6_addr[i + 8];
+    }
+}
+
+static void address6_join(uint64_t high, uint64_t low, struct in6_addr *address) {
+    for (int i = 7; i >= 0; i--) {
+        address->s6_addr[i] = (uint8_t)high;
+        address->s6_addr[i + 8] = (uint8_t)low;
+        high >>= 8;
+        low >>= 8;
+    }
+}
+
+// The halves of a mask with the top length bits set
+static void address6_mask(int length, uint64_t *high, uint64_t *low) {
+    *high = length <= 0 ? 0 : length >= 64 ? ~0ULL : ~0ULL << (64 - length);
+    *low = length <= 64 ? 0 : length >= 128 ? ~0ULL : ~0ULL << (128 - length);
+}
+
+// Low 64 bits of the address shifted right by shift (0 to 127)
+static uint64_t address6_shift_right(uint64_t high, uint64_t low, int shift) {
+    if (shift == 0) return low;
+    if (shift < 64) return (low >> shift) | (high << (64 - shift));
+    return high >> (shift - 64);
+}
+
+// Index of the delegated prefix holding an address, or -1 if the address is
+// outside the pool
+static int64_t address6_index(const pool6_t *pool, uint64_t high, uint64_t low) {
+    uint64_t mask_high, mask_low;
+    address6_mask(pool->prefix_length, &mask_high, &mask_low);
+    if (((high ^ pool->base_high) & mask_high) != 0 || ((low ^ pool->base_low) & mask_low) != 0) {
+        return -1;
+    }
+    return (int64_t)(address6_shift_right(high, low, 128 - pool->delegated_length) &
+                     (pool->count - 1));
+}
+
+// The delegated prefix at index
+static void address6_prefix_at(const pool6_t *pool, uint32_t index, struct in6_addr *prefix) {
+    int shift = 128 - pool->delegated_length;
+    uint64_t high = pool->base_high, low = pool->base_low;
+    if (shift >= 64) {
+        high |= (uint64_t)index << (shift - 64);
+    } else {
+        low |= (uint64_t)index << shift;
+        if (shift > 32) high |= (uint64_t)index >> (64 - shift);
+    }
+    address6_join(high, low, prefix);
+}
+
+static int address6_compare(uint64_t high_a, uint64_t low_a, uint64_t high_b, uint64_t low_b) {
+    if (high_a != high_b) return high_a < high_b ? -1 : 1;
+    if (low_a != low_b) return low_a < low_b ? -1 : 1;
+    return 0;
+}
+
+// Bitmap pages. The page table and the record table are both open-addressed
+// with backward-shift deletion, and shrink again as prefixes are released.
+
+static uint32_t address6_hash(uint64_t key) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// Bucket holding a page, or the empty bucket where it would go
+static uint32_t address6_page_bucket(const pool6_t *pool, uint64_t number) {
+    uint32_t mask = pool->page_buckets - 1;
+    uint32_t slot = address6_hash(number) & mask;
+    while (pool->pages[slot] && pool->pages[slot]->number != number) slot = (slot + 1) & mask;
+    return slot;
+}
+
+static address6_page_t *address6_page(const pool6_t *pool, uint64_t number) {
+    return pool->pages[address6_page_bucket(pool, number)];
+}
+
+static int address6_resize_pages(pool6_t *pool, uint32_t buckets) {
+    address6_page_t **pages = calloc(buckets, sizeof(address6_page_t *));
+    if (!pages) return -1;
+
+    address6_page_t **old = pool->pages;
+    uint32_t old_buckets = pool->page_buckets;
+    pool->pages = pages;
+    pool->page_buckets = buckets;
+    for (uint32_t i = 0; i < old_buckets; i++) {
+        if (old[i]) pool->pages[address6_page_bucket(pool, old[i]->number)] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+// The page for number, created empty if needed; NULL on allocation failure
+static address6_page_t *address6_page_get(pool6_t *pool, uint64_t number) {
+    address6_page_t *page = address6_page(pool, number);
+    if (page) return page;
+
+    if ((pool->page_count + 1) * 4 > pool->page_buckets * 3 &&
+        address6_resize_pages(pool, pool->page_buckets * 2) != 0) {
+        return NULL;
+    }
+
+    page = calloc(1, sizeof(address6_page_t));
+    if (!page) return NULL;
+    page->number = number;
+    pool->pages[address6_page_bucket(pool, number)] = page;
+    pool->page_count++;
+    return page;
+}
+
+static void address6_page_remove(pool6_t *pool, address6_page_t *page) {
+    uint32_t mask = pool->page_buckets - 1;
+    uint32_t slot = address6_page_bucket(pool, page->number);
+
+    uint32_t next = (slot + 1) & mask;
+    while (pool->pages[next]) {
+        uint32_t home = address6_hash(pool->pages[next]->number) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            pool->pages[slot] = pool->pages[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    pool->pages[slot] = NULL;
+    pool->page_count--;
+    free(page);
+
+    if (pool->page_buckets > ADDRESS6_INITIAL_BUCKETS && pool->page_count * 8 < pool->page_buckets) {
+        address6_resize_pages(pool, pool->page_buckets / 2);  // Keeps the old table on failure
+    }
+}
+
+// Owner table; every function takes the table's lock
+
+static uint32_t address6_owner_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int address6_owner_table_init(address6_owner_table_t *table) {
+    memset(table, 0, sizeof(*table));
+    table->entries = calloc(ADDRESS6_OWNER_INITIAL, sizeof(address6_owner_t));
+    table->buckets = calloc(ADDRESS6_OWNER_INITIAL * 2, sizeof(uint32_t));
+    if (!table->entries || !table->buckets) {
+        free(table->entries);
+        free(table->buckets);
+        return -1;
+    }
+    table->capacity = ADDRESS6_OWNER_INITIAL;
+    table->bucket_count = ADDRESS6_OWNER_INITIAL * 2;
+    for (uint32_t i = table->capacity - 1; i >= 1; i--) {
+        table->entries[i].hash = table->free_head;
+        table->free_head = i;
+    }
+    pthread_mutex_init(&table->lock, NULL);
+    return 0;
+}
+
+static void address6_owner_table_free(address6_owner_table_t *table) {
+    if (table->entries) {
+        for (uint32_t i = 1; i < table->capacity; i++) free(table->entries[i].name);
+        pthread_mutex_destroy(&table->lock);
+    }
+    free(table->entries);
+    free(table->buckets);
+    memset(table, 0, sizeof(*table));
+}
+
+static void address6_owner_bucket_insert(address6_owner_table_t *table, uint32_t id) {
+    uint32_t mask = table->bucket_count - 1;
+    uint32_t slot = table->entries[id].hash & mask;
+    while (table->buckets[slot] != 0) slot = (slot + 1) & mask;
+    table->buckets[slot] = id;
+}
+
+// Doubles entries and buckets; entry ids stay the same. Only called with an
+// empty free chain, so the new entries become the chain.
+static int address6_owner_table_grow(address6_owner_table_t *table) {
+    uint32_t capacity = table->capacity * 2;
+    address6_owner_t *entries = realloc(table->entries, capacity * sizeof(address6_owner_t));
+    if (!entries) return -1;
+    memset(entries + table->capacity, 0, (capacity - table->capacity) * sizeof(address6_owner_t));
+    table->entries = entries;
+
+    uint32_t *buckets = calloc(capacity * 2, sizeof(uint32_t));
+    if (!buckets) return -1;
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = capacity * 2;
+
+    uint32_t old_capacity = table->capacity;
+    table->capacity = capacity;
+    for (uint32_t i = 1; i < old_capacity; i++) {
+        if (table->entries[i].name) address6_owner_bucket_insert(table, i);
+    }
+    for (uint32_t i = capacity - 1; i >= old_capacity; i--) {
+        table->entries[i].hash = table->free_head;
+        table->free_head = i;
+    }
+    return 0;
+}
+
+// Returns the id for name with one more reference, or 0 on allocation failure
+static uint32_t address6_owner_intern(address6_owner_table_t *table, const char *name) {
+    uint32_t hash = address6_owner_hash(name);
+
+    pthread_mutex_lock(&table->lock);
+
+    uint32_t mask = table->bucket_count - 1;
+    for (uint32_t slot = hash & mask; table->buckets[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t id = table->buckets[slot];
+        address6_owner_t *entry = &table->entries[id];
+        if (entry->hash == hash && strcmp(entry->name, name) == 0) {
+            entry->refs++;
+            pthread_mutex_unlock(&table->lock);
+            return id;
+        }
+    }
+
+    char *copy = malloc(strlen(name) + 1);
+    if (!copy || (table->free_head == 0 && address6_owner_table_grow(table) != 0)) {
+        pthread_mutex_unlock(&table->lock);
+        free(copy);
+        return 0;
+    }
+    strcpy(copy, name);
+
+    uint32_t id = table->free_head;
+    address6_owner_t *entry = &table->entries[id];
+    table->free_head = entry->hash;
+    entry->name = copy;
+    entry->hash = hash;
+    entry->refs = 1;
+    address6_owner_bucket_insert(table, id);
+
+    pthread_mutex_unlock(&table->lock);
+    return id;
+}
+
+// Drops one reference; the entry is freed with its last one
+static void address6_owner_release(address6_owner_table_t *table, uint32_t id) {
+    if (id == 0) return;
+
+    pthread_mutex_lock(&table->lock);
+
+    address6_owner_t *entry = &table->entries[id];
+    if (id >= table->capacity || !entry->name || --entry->refs > 0) {
+        pthread_mutex_unlock(&table->lock);
+        return;
+    }
+
+    // Backward-shift delete, as for pages and records
+    uint32_t mask = table->bucket_count - 1;
+    uint32_t slot = entry->hash & mask;
+    while (table->buckets[slot] != id) slot = (slot + 1) & mask;
+
+    uint32_t next = (slot + 1) & mask;
+    while (table->buckets[next] != 0) {
+        uint32_t home = table->entries[table->buckets[next]].hash & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            table->buckets[slot] = table->buckets[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table->buckets[slot] = 0;
+
+    free(entry->name);
+    memset(entry, 0, sizeof(*entry));
+    entry->hash = table->free_head;
+    table->free_head = id;
+
+    pthread_mutex_unlock(&table->lock);
+}
+
+// Copies an owner's name into buf and returns its length
+static uint32_t address6_owner_copy(address6_owner_table_t *table, uint32_t id,
+                                    char *buf, size_t size) {
+    uint32_t length = 0;
+
+    pthread_mutex_lock(&table->lock);
+    if (id != 0 && id < table->capacity && table->entries[id].name) {
+        length = (uint32_t)strlen(table->entries[id].name);
+        if (length >= size) length = (uint32_t)size - 1;
+        memcpy(buf, table->entries[id].name, length);
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    buf[length] = '\0';
+    return length;
+}
+
+// Records
+
+static uint32_t address6_record_bucket(const pool6_t *pool, uint32_t index) {
+    uint32_t mask = pool->record_buckets - 1;
+    uint32_t slot = address6_hash(index) & mask;
+    while (pool->records[slot].owner != 0 && pool->records[slot].index != index) slot = (slot + 1) & mask;
+    return slot;
+}
+
+static address6_record_t *address6_record(const pool6_t *pool, uint32_t index) {
+    address6_record_t *record = &pool->records[address6_record_bucket(pool, index)];
+    return record->owner != 0 ? record : NULL;
+}
+
+static int address6_resize_records(pool6_t *pool, uint32_t buckets) {
+    address6_record_t *records = calloc(buckets, sizeof(address6_record_t));
+    if (!records) return -1;
+
+    address6_record_t *old = pool->records;
+    uint32_t old_buckets = pool->record_buckets;
+    pool->records = records;
+    pool->record_buckets = buckets;
+    for (uint32_t i = 0; i < old_buckets; i++) {
+        if (old[i].owner != 0) pool->records[address6_record_bucket(pool, old[i].index)] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+static void address6_record_remove(pool6_t *pool, address6_owner_table_t *owners, uint32_t index) {
+    uint32_t mask = pool->record_buckets - 1;
+    uint32_t slot = address6_record_bucket(pool, index);
+    if (pool->records[slot].owner == 0) return;
+    address6_owner_release(owners, pool->records[slot].owner);
+
+    uint32_t next = (slot + 1) & mask;
+    while (pool->records[next].owner != 0) {
+        uint32_t home = address6_hash(pool->records[next].index) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            pool->records[slot] = pool->records[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    memset(&pool->records[slot], 0, sizeof(address6_record_t));
+    pool->record_count--;
+
+    if (pool->record_buckets > ADDRESS6_INITIAL_BUCKETS &&
+        pool->record_count * 8 < pool->record_buckets) {
+        address6_resize_records(pool, pool->record_buckets / 2);
+    }
+}
+
+// Pools
+
+static pool6_t *address6_new_pool(int pool_number, const char *pool_name, uint64_t base_high,
+                                  uint64_t base_low, int prefix_length, int delegated_length) {
+    pool6_t *pool = calloc(1, sizeof(pool6_t));
+    if (!pool) return NULL;
+
+    pool->pages = calloc(ADDRESS6_INITIAL_BUCKETS, sizeof(address6_page_t *));
+    pool->records = calloc(ADDRESS6_INITIAL_BUCKETS, sizeof(address6_record_t));
+    if (!pool->pages || !pool->records) {
+        free(pool->pages);
+        free(pool->records);
+        free(pool);
+        return NULL;
+    }
+
+    pool->pool_number = pool_number;
+    snprintf(pool->pool_name, sizeof(pool->pool_name), "%s", pool_name);
+    pool->base_high = base_high;
+    pool->base_low = base_low;
+    pool->prefix_length = prefix_length;
+    pool->delegated_length = delegated_length;
+    pool->count = 1ULL << (delegated_length - prefix_length);
+    pool->page_buckets = ADDRESS6_INITIAL_BUCKETS;
+    pool->record_buckets = ADDRESS6_INITIAL_BUCKETS;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+static void address6_free_pool(pool6_t *pool, address6_owner_table_t *owners) {
+    for (uint32_t i = 0; i < pool->page_buckets; i++) free(pool->pages[i]);
+    for (uint32_t i = 0; i < pool->record_buckets; i++) {
+        address6_owner_release(owners, pool->records[i].owner);
+    }
+    free(pool->pages);
+    free(pool->records);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static pool6_t *address6_get_pool(ip6_context_t *ip_ctx, int pool_number) {
+    if (pool_number <= 0 || pool_number > MAX_POOLS) return NULL;
+    return ip_ctx->pools[pool_number];
+}
+
+// Position of the first range starting above the address
+static int address6_range_upper(const ip6_context_t *ip_ctx, uint64_t high, uint64_t low) {
+    int lower = 0, upper = ip_ctx->pool_count;
+    while (lower < upper) {
+        int mid = (lower + upper) / 2;
+        const pool6_t *pool = ip_ctx->ranges[mid];
+        if (address6_compare(pool->base_high, pool->base_low, high, low) <= 0) {
+            lower = mid + 1;
+        } else {
+            upper = mid;
+        }
+    }
+    return lower;
+}
+
+// Finds the pool holding an address and the index of its delegated prefix.
+// Pools never overlap, so only the last one starting at or below the
+// address can contain it.
+static pool6_t *address6_locate(ip6_context_t *ip_ctx, const struct in6_addr *address,
+                                uint32_t *index) {
+    uint64_t high, low;
+    address6_split(address, &high, &low);
+
+    int pos = address6_range_upper(ip_ctx, high, low);
+    if (pos == 0) return NULL;
+
+    pool6_t *pool = ip_ctx->ranges[pos - 1];
+    int64_t found = address6_index(pool, high, low);
+    if (found < 0) return NULL;
+
+    *index = (uint32_t)found;
+    return pool;
+}
+
+// Adds a pool to both indexes; -1 if it overlaps an existing pool. Two
+// prefixes overlap when one contains the other, so only the neighbours in
+// prefix order need checking.
+static int address6_attach_pool(ip6_context_t *ip_ctx, pool6_t *pool) {
+    int pos = address6_range_upper(ip_ctx, pool->base_high, pool->base_low);
+    if (pos > 0 && address6_index(ip_ctx->ranges[pos - 1], pool->base_high, pool->base_low) >= 0) {
+        return -1;
+    }
+    if (pos < ip_ctx->pool_count &&
+        address6_index(pool, ip_ctx->ranges[pos]->base_high, ip_ctx->ranges[pos]->base_low) >= 0) {
+        return -1;
+    }
+
+    memmove(&ip_ctx->ranges[pos + 1], &ip_ctx->ranges[pos],
+            (ip_ctx->pool_count - pos) * sizeof(pool6_t *));
+    ip_ctx->ranges[pos] = pool;
+    ip_ctx->pools[pool->pool_number] = pool;
+    ip_ctx->pool_count++;
+    return 0;
+}
+
+static void address6_detach_pool(ip6_context_t *ip_ctx, pool6_t *pool) {
+    int pos = address6_range_upper(ip_ctx, pool->base_high, pool->base_low) - 1;
+    memmove(&ip_ctx->ranges[pos], &ip_ctx->ranges[pos + 1],
+            (ip_ctx->pool_count - pos - 1) * sizeof(pool6_t *));
+    ip_ctx->pools[pool->pool_number] = NULL;
+    ip_ctx->pool_count--;
+}
+
+// Lowest free index, or -1 when the pool is full. A missing page is all
+// free; full pages below the hint are skipped.
+static int64_t address6_find_free(pool6_t *pool) {
+    uint64_t page_total = (pool->count + ADDRESS6_PAGE_SIZE - 1) / ADDRESS6_PAGE_SIZE;
+
+    for (uint64_t number = pool->free_page_hint; number < page_total; number++) {
+        uint64_t first = number * ADDRESS6_PAGE_SIZE;
+        address6_page_t *page = address6_page(pool, number);
+        if (!page) return (int64_t)first;
+
+        uint64_t page_size = pool->count - first < ADDRESS6_PAGE_SIZE ? pool->count - first
+                                                                      : ADDRESS6_PAGE_SIZE;
+        if (page->used < page_size) {
+            for (uint32_t w = 0; w < ADDRESS6_PAGE_WORDS; w++) {
+                if (page->bits[w] != ~0ULL) {
+                    return (int64_t)(first + w * 64 + __builtin_ctzll(~page->bits[w]));
+                }
+            }
+        }
+        pool->free_page_hint = number + 1;
+    }
+    return -1;
+}
+
+// State changes shared by the API and journal replay. They are idempotent,
+// since replay may see changes already in the snapshot. Pool creation and
+// deletion need pools_lock for writing; the others need it for reading plus
+// the pool's lock.
+
+static int address6_apply_pool_create(ip6_context_t *ip_ctx, const address6_journal_pool_t *record) {
+    pool6_t *existing = address6_get_pool(ip_ctx, record->pool_number);
+    if (existing) {
+        return existing->base_high == record->base_high && existing->base_low == record->base_low &&
+               existing->prefix_length == record->prefix_length &&
+               existing->delegated_length == record->delegated_length ? 0 : -3;
+    }
+
+    pool6_t *pool = address6_new_pool(record->pool_number, record->pool_name, record->base_high,
+                                      record->base_low, record->prefix_length,
+                                      record->delegated_length);
+    if (!pool) return -1;
+
+    if (address6_attach_pool(ip_ctx, pool) != 0) {
+        address6_free_pool(pool, &ip_ctx->owners);
+        return -8;
+    }
+    return 0;
+}
+
+static void address6_apply_pool_delete(ip6_context_t *ip_ctx, int pool_number) {
+    pool6_t *pool = address6_get_pool(ip_ctx, pool_number);
+    if (!pool) return;
+
+    address6_detach_pool(ip_ctx, pool);
+    address6_free_pool(pool, &ip_ctx->owners);
+}
+
+// Marks index used and records its owner; -1 on allocation failure, which
+// leaves the index as it was
+static int address6_apply_set(pool6_t *pool, address6_owner_table_t *owners, uint32_t index,
+                              time_t allocation_time, const char *owner) {
+    address6_record_t *record = address6_record(pool, index);
+    uint32_t id = address6_owner_intern(owners, owner);
+    if (id == 0) return -1;
+
+    if (record) {
+        address6_owner_release(owners, record->owner);
+        record->owner = id;
+        record->allocation_time = allocation_time;
+        return 0;
+    }
+
+    address6_page_t *page = address6_page_get(pool, index / ADDRESS6_PAGE_SIZE);
+    if (!page || ((pool->record_count + 1) * 4 > pool->record_buckets * 3 &&
+                  address6_resize_records(pool, pool->record_buckets * 2) != 0)) {
+        if (page && page->used == 0) address6_page_remove(pool, page);
+        address6_owner_release(owners, id);
+        return -1;
+    }
+
+    record = &pool->records[address6_record_bucket(pool, index)];
+    record->index = index;
+    record->allocation_time = allocation_time;
+    record->owner = id;
+    pool->record_count++;
+
+    uint32_t bit = index % ADDRESS6_PAGE_SIZE;
+    page->bits[bit / 64] |= 1ULL << (bit % 64);
+    page->used++;
+    pool->used++;
+    return 0;
+}
+
+static void address6_apply_clear(pool6_t *pool, address6_owner_table_t *owners, uint32_t index) {
+    if (!address6_record(pool, index)) return;
+    address6_record_remove(pool, owners, index);
+
+    uint64_t number = index / ADDRESS6_PAGE_SIZE;
+    address6_page_t *page = address6_page(pool, number);
+    uint32_t bit = index % ADDRESS6_PAGE_SIZE;
+    page->bits[bit / 64] &= ~(1ULL << (bit % 64));
+    pool->used--;
+    if (--page->used == 0) address6_page_remove(pool, page);
+    if (number < pool->free_page_hint) pool->free_page_hint = number;
+}
+
+static int address6_valid_pool_record(const address6_journal_pool_t *record) {
+    return record->pool_number > 0 && record->pool_number <= MAX_POOLS &&
+           record->prefix_length >= ADDRESS6_MIN_PREFIX &&
+           record->delegated_length > record->prefix_length &&
+           record->delegated_length <= 128 &&
+           record->delegated_length - record->prefix_length <= ADDRESS6_MAX_DELEGATION;
+}
+
+// Replay runs before any other thread starts, so it takes no locks
+static int address6_journal_replay(void *ctx, uint16_t type, const void *data, uint32_t length) {
+    ip6_context_t *ip_ctx = (ip6_context_t *)ctx;
+
+    if (type == ADDRESS6_JOURNAL_POOL_CREATE && length == sizeof(address6_journal_pool_t)) {
+        address6_journal_pool_t record;
+        memcpy(&record, data, sizeof(record));
+        record.pool_name[POOL_NAME_LENGTH - 1] = '\0';
+        if (!address6_valid_pool_record(&record)) return -1;
+        return address6_apply_pool_create(ip_ctx, &record) == 0 ? 0 : -1;
+    }
+
+    if (type == ADDRESS6_JOURNAL_POOL_DELETE && length == sizeof(int32_t)) {
+        int32_t pool_number;
+        memcpy(&pool_number, data, sizeof(pool_number));
+        address6_apply_pool_delete(ip_ctx, pool_number);
+        return 0;
+    }
+
+    if (type == ADDRESS6_JOURNAL_SET && length >= offsetof(address6_journal_set_t, owner)) {
+        address6_journal_set_t record;
+        memset(&record, 0, sizeof(record));
+        memcpy(&record, data, length < sizeof(record) ? length : sizeof(record));
+        if (record.owner_length >= ADDRESS_OWNER_LENGTH ||
+            length != offsetof(address6_journal_set_t, owner) + record.owner_length) {
+            return -1;
+        }
+        record.owner[record.owner_length] = '\0';
+
+        pool6_t *pool = address6_get_pool(ip_ctx, record.pool_number);
+        if (!pool || record.index >= pool->count) return -1;
+        return address6_apply_set(pool, &ip_ctx->owners, record.index,
+                                  (time_t)record.allocation_time, record.owner);
+    }
+
+    if (type == ADDRESS6_JOURNAL_CLEAR && length == sizeof(address6_journal_clear_t)) {
+        address6_journal_clear_t record;
+        memcpy(&record, data, sizeof(record));
+        pool6_t *pool = address6_get_pool(ip_ctx, record.pool_number);
+        if (!pool || record.index >= pool->count) return -1;
+        address6_apply_clear(pool, &ip_ctx->owners, record.index);
+        return 0;
+    }
+
+    log_warning("Skipping unknown IPv6 journal record type %u", type);
+    return 0;
+}
+
+// Journals the current state of an index. The caller holds the pool's lock,
+// which keeps the pool's records in the order of its changes.
+static uint64_t address6_journal_index(ip6_context_t *ip_ctx, const pool6_t *pool, uint32_t index) {
+    if (!ip_ctx->journal) return 0;
+
+    const address6_record_t *record = address6_record(pool, index);
+    if (!record) {
+        address6_journal_clear_t clear = { pool->pool_number, index };
+        return journal_append(ip_ctx->journal, ADDRESS6_JOURNAL_CLEAR, &clear, sizeof(clear));
+    }
+
+    address6_journal_set_t set;
+    memset(&set, 0, offsetof(address6_journal_set_t, owner));
+    set.pool_number = pool->pool_number;
+    set.index = index;
+    set.allocation_time = (int64_t)record->allocation_time;
+    set.owner_length = address6_owner_copy(&ip_ctx->owners, record->owner, set.owner, sizeof(set.owner));
+    return journal_append(ip_ctx->journal, ADDRESS6_JOURNAL_SET, &set,
+                          offsetof(address6_journal_set_t, owner) + set.owner_length);
+}
+
+static int address6_save_locked(ip6_context_t *ip_ctx);
+
+// Makes a change durable: waits for the group commit carrying lsn, or writes
+// a full snapshot when there is no journal. Called without any lock.
+static int address6_commit(ip6_context_t *ip_ctx, uint64_t lsn) {
+    if (!ip_ctx->journal) return address6_save(ip_ctx);
+
+    if (lsn == 0 || journal_sync(ip_ctx->journal, lsn) != 0) return -1;
+
+    if (journal_pending_records(ip_ctx->journal) >= ADDRESS_SNAPSHOT_RECORDS &&
+        pthread_mutex_trylock(&ip_ctx->save_mutex) == 0) {
+        if (journal_pending_records(ip_ctx->journal) >= ADDRESS_SNAPSHOT_RECORDS &&
+            address6_save_locked(ip_ctx) != 0) {
+            log_warning("Failed to snapshot IPv6 pools, journal keeps growing");
+        }
+        pthread_mutex_unlock(&ip_ctx->save_mutex);
+    }
+    return 0;
+}
+
+// Persistence
+
+static int address6_write_snapshot(ip6_context_t *ip_ctx, const char *filename, uint64_t generation) {
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+    FILE *file = fopen(temp_filename, "wb");
+    if (!file) {
+        log_error("Failed to open IPv6 file for writing: %s", temp_filename);
+        return -1;
+    }
+
+    address6_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ADDRESS6_FILE_MAGIC;
+    header.version = ADDRESS6_FILE_VERSION;
+    header.generation = generation;
+    header.pool_count = ip_ctx->pool_count;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (int p = 0; p < ip_ctx->pool_count && ok; p++) {
+        pool6_t *pool = ip_ctx->ranges[p];
+
+        pthread_mutex_lock(&pool->lock);
+
+        address6_file_pool_t record;
+        memset(&record, 0, sizeof(record));
+        record.pool.pool_number = pool->pool_number;
+        record.pool.prefix_length = pool->prefix_length;
+        record.pool.delegated_length = pool->delegated_length;
+        record.pool.base_high = pool->base_high;
+        record.pool.base_low = pool->base_low;
+        memcpy(record.pool.pool_name, pool->pool_name, POOL_NAME_LENGTH);
+        record.entry_count = pool->record_count;
+        ok = fwrite(&record, sizeof(record), 1, file) == 1;
+
+        for (uint32_t i = 0; i < pool->record_buckets && ok; i++) {
+            const address6_record_t *allocation = &pool->records[i];
+            if (allocation->owner == 0) continue;
+
+            address6_file_entry_t entry;
+            char owner[ADDRESS_OWNER_LENGTH];
+            entry.index = allocation->index;
+            entry.owner_length = address6_owner_copy(&ip_ctx->owners, allocation->owner,
+                                                     owner, sizeof(owner));
+            entry.allocation_time = (int64_t)allocation->allocation_time;
+            ok = fwrite(&entry, sizeof(entry), 1, file) == 1 &&
+                 fwrite(owner, 1, entry.owner_length, file) == entry.owner_length;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(temp_filename, filename) != 0) {
+        unlink(temp_filename);
+        log_error("Failed to write IPv6 file: %s", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Snapshots the pools to ips6.dat and drops the journal generations it
+// covers. The caller holds save_mutex.
+static int address6_save_locked(ip6_context_t *ip_ctx) {
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    uint64_t generation = ip_ctx->snapshot_generation;
+    if (ip_ctx->journal && journal_rotate(ip_ctx->journal, &generation) != 0) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_error("Failed to rotate IPv6 journal");
+        return -1;
+    }
+
+    int pool_count = ip_ctx->pool_count;
+    int rc = address6_write_snapshot(ip_ctx, ADDRESS6_IPS_FILE, generation);
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    if (rc != 0) return -1;
+
+    ip_ctx->snapshot_generation = generation;
+    if (ip_ctx->journal) {
+        journal_discard_before(ip_ctx->journal, generation);
+    }
+
+    log_info("Saved %d IPv6 pools to %s", pool_count, ADDRESS6_IPS_FILE);
+    return 0;
+}
+
+int address6_save(ip6_context_t *ip_ctx) {
+    if (!ip_ctx) return -1;
+
+    pthread_mutex_lock(&ip_ctx->save_mutex);
+    int rc = address6_save_locked(ip_ctx);
+    pthread_mutex_unlock(&ip_ctx->save_mutex);
+    return rc;
+}
+
+static int address6_load(ip6_context_t *ip_ctx, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        log_info("IPv6 file not found, starting with empty database");
+        return 0;
+    }
+
+    address6_file_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != ADDRESS6_FILE_MAGIC ||
+        header.version != ADDRESS6_FILE_VERSION ||
+        header.pool_count < 0 || header.pool_count > MAX_POOLS) {
+        log_error("Unsupported IPv6 file format: %s", filename);
+        fclose(file);
+        return -1;
+    }
+    ip_ctx->snapshot_generation = header.generation;
+
+    for (int p = 0; p < header.pool_count; p++) {
+        address6_file_pool_t record;
+        if (fread(&record, sizeof(record), 1, file) != 1 ||
+            !address6_valid_pool_record(&record.pool) ||
+            ip_ctx->pools[record.pool.pool_number] != NULL) {
+            log_error("Failed to read IPv6 pool %d from file", p);
+            fclose(file);
+            return -1;
+        }
+        record.pool.pool_name[POOL_NAME_LENGTH - 1] = '\0';
+        if (address6_apply_pool_create(ip_ctx, &record.pool) != 0) {
+            log_error("IPv6 pool %d in %s could not be restored", record.pool.pool_number, filename);
+            fclose(file);
+            return -1;
+        }
+
+        pool6_t *pool = ip_ctx->pools[record.pool.pool_number];
+        for (uint32_t e = 0; e < record.entry_count; e++) {
+            address6_file_entry_t entry;
+            char owner[ADDRESS_OWNER_LENGTH];
+            if (fread(&entry, sizeof(entry), 1, file) != 1 || entry.index >= pool->count ||
+                entry.owner_length >= sizeof(owner) ||
+                fread(owner, 1, entry.owner_length, file) != entry.owner_length) {
+                log_error("Failed to read allocations of IPv6 pool %d", pool->pool_number);
+                fclose(file);
+                return -1;
+            }
+            owner[entry.owner_length] = '\0';
+            if (address6_apply_set(pool, &ip_ctx->owners, entry.index,
+                                   (time_t)entry.allocation_time, owner) != 0) {
+                log_error("Failed to restore allocations of IPv6 pool %d", pool->pool_number);
+                fclose(file);
+                return -1;
+            }
+        }
+    }
+
+    fclose(file);
+    log_info("Loaded %d IPv6 pools from %s", ip_ctx->pool_count, filename);
+    return 0;
+}
+
+// Initialization and cleanup
+
+static void address6_free_pools(ip6_context_t *ip_ctx) {
+    while (ip_ctx->pool_count > 0) {
+        pool6_t *pool = ip_ctx->ranges[ip_ctx->pool_count - 1];
+        address6_detach_pool(ip_ctx, pool);
+        address6_free_pool(pool, &ip_ctx->owners);
+    }
+}
+
+int address6_init(ip6_context_t *ip_ctx) {
+    if (!ip_ctx) return -1;
+
+    memset(ip_ctx, 0, sizeof(ip6_context_t));
+    if (address6_owner_table_init(&ip_ctx->owners) != 0) {
+        log_error("Failed to allocate IPv6 owner table");
+        return -1;
+    }
+    pthread_rwlock_init(&ip_ctx->pools_lock, NULL);
+    pthread_mutex_init(&ip_ctx->save_mutex, NULL);
+
+    if (address6_load(ip_ctx, ADDRESS6_IPS_FILE) != 0) {
+        log_error("Failed to load %s", ADDRESS6_IPS_FILE);
+        address6_free_pools(ip_ctx);
+        address6_owner_table_free(&ip_ctx->owners);
+        pthread_mutex_destroy(&ip_ctx->save_mutex);
+        pthread_rwlock_destroy(&ip_ctx->pools_lock);
+        return -1;
+    }
+    ip_ctx->journal = journal_open(ADDRESS6_JOURNAL_FILE, ip_ctx->snapshot_generation,
+                                   address6_journal_replay, ip_ctx);
+    if (!ip_ctx->journal && errno == EWOULDBLOCK) {
+        address6_free_pools(ip_ctx);
+        address6_owner_table_free(&ip_ctx->owners);
+        pthread_mutex_destroy(&ip_ctx->save_mutex);
+        pthread_rwlock_destroy(&ip_ctx->pools_lock);
+        return -1;
+    }
+    if (!ip_ctx->journal) {
+        log_warning("IPv6 journal unavailable, falling back to full snapshots");
+    }
+
+    log_info("IPv6 management initialized with %d pools", ip_ctx->pool_count);
+    return 0;
+}
+
+void address6_cleanup(ip6_context_t *ip_ctx) {
+    if (!ip_ctx) return;
+
+    address6_save(ip_ctx);
+    journal_close(ip_ctx->journal);
+    ip_ctx->journal = NULL;
+
+    address6_free_pools(ip_ctx);
+    address6_owner_table_free(&ip_ctx->owners);
+    pthread_mutex_destroy(&ip_ctx->save_mutex);
+    pthread_rwlock_destroy(&ip_ctx->pools_lock);
+    log_info("IPv6 management cleaned up");
+}
+
+// Pool Management
+
+int address6_create_pool(ip6_context_t *ip_ctx, int pool_number, const char *pool_name,
+                         const char *prefix, int delegated_length) {
+    if (!ip_ctx || !pool_name || !prefix) return -1;
+
+    if (pool_number <= 0 || pool_number > MAX_POOLS) {
+        log_warning("Invalid IPv6 pool number: %d", pool_number);
+        return -2;
+    }
+
+    struct in6_addr base;
+    int prefix_length;
+    uint64_t high, low, mask_high, mask_low;
+    if (address6_string_to_prefix(prefix, &base, &prefix_length) != 0 ||
+        prefix_length < ADDRESS6_MIN_PREFIX) {
+        log_warning("Invalid IPv6 prefix: %s", prefix);
+        return -5;
+    }
+    address6_split(&base, &high, &low);
+    address6_mask(prefix_length, &mask_high, &mask_low);
+    if ((high & ~mask_high) || (low & ~mask_low)) {
+        log_warning("IPv6 prefix %s has host bits set", prefix);
+        return -5;
+    }
+
+    address6_journal_pool_t record;
+    memset(&record, 0, sizeof(record));
+    record.pool_number = pool_number;
+    record.prefix_length = prefix_length;
+    record.delegated_length = delegated_length;
+    record.base_high = high;
+    record.base_low = low;
+    strncpy(record.pool_name, pool_name, POOL_NAME_LENGTH - 1);
+    if (!address6_valid_pool_record(&record)) {
+        log_warning("Invalid delegated length /%d for %s (at most %d bits of delegation)",
+                    delegated_length, prefix, ADDRESS6_MAX_DELEGATION);
+        return -6;
+    }
+
+    pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+
+    if (ip_ctx->pools[pool_number] != NULL) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IPv6 pool already exists: %d", pool_number);
+        return -3;
+    }
+
+    int rc = address6_apply_pool_create(ip_ctx, &record);
+    if (rc != 0) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        if (rc == -8) {
+            log_warning("IPv6 pool %d (%s) overlaps an existing pool", pool_number, prefix);
+            return -8;
+        }
+        log_error("Failed to allocate memory for IPv6 pool %d", pool_number);
+        return -1;
+    }
+
+    uint64_t lsn = 0;
+    if (ip_ctx->journal) {
+        lsn = journal_append(ip_ctx->journal, ADDRESS6_JOURNAL_POOL_CREATE, &record, sizeof(record));
+    }
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address6_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IPv6 pool to disk");
+        pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+        address6_apply_pool_delete(ip_ctx, pool_number);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -7;
+    }
+
+    log_info("IPv6 pool created: %s (Number: %d, %s as /%d)", pool_name, pool_number, prefix,
+             delegated_length);
+    return 0;
+}
+
+int address6_delete_pool(ip6_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_wrlock(&ip_ctx->pools_lock);
+
+    if (!address6_get_pool(ip_ctx, pool_number)) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
+    }
+    address6_apply_pool_delete(ip_ctx, pool_number);
+
+    uint64_t lsn = 0;
+    if (ip_ctx->journal) {
+        int32_t number = pool_number;
+        lsn = journal_append(ip_ctx->journal, ADDRESS6_JOURNAL_POOL_DELETE, &number, sizeof(number));
+    }
+
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address6_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IPv6 pool deletion to disk");
+    }
+
+    log_info("IPv6 pool deleted: %d", pool_number);
+    return 0;
+}
+
+// Allocation Management
+
+// Clears an index after its commit failed, unless the pool has been
+// deleted in the meantime
+static void address6_undo(ip6_context_t *ip_ctx, pool6_t *pool, int pool_number, uint32_t index) {
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    if (address6_get_pool(ip_ctx, pool_number) == pool) {
+        pthread_mutex_lock(&pool->lock);
+        address6_apply_clear(pool, &ip_ctx->owners, index);
+        address6_journal_index(ip_ctx, pool, index);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+}
+
+// Delegates the lowest free prefix of a pool. Returns 0, -2 if the pool
+// does not exist, -3 if it is full or -4 if the allocation could not be
+// recorded.
+int address6_allocate(ip6_context_t *ip_ctx, int pool_number, const char *allocated_to,
+                      struct in6_addr *prefix_out, int *prefix_length_out) {
+    if (!ip_ctx || !allocated_to || !prefix_out) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    pool6_t *pool = address6_get_pool(ip_ctx, pool_number);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IPv6 pool not found: %d", pool_number);
+        return -2;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    int64_t found = address6_find_free(pool);
+    if (found < 0) {
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IPv6 pool %d is full", pool_number);
+        return -3;
+    }
+
+    uint32_t index = (uint32_t)found;
+    uint64_t lsn = 0;
+    if (address6_apply_set(pool, &ip_ctx->owners, index, time(NULL), allocated_to) != 0 ||
+        (ip_ctx->journal && (lsn = address6_journal_index(ip_ctx, pool, index)) == 0)) {
+        address6_apply_clear(pool, &ip_ctx->owners, index);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_error("Failed to record IPv6 allocation in pool %d", pool_number);
+        return -4;
+    }
+
+    address6_prefix_at(pool, index, prefix_out);
+    if (prefix_length_out) *prefix_length_out = pool->delegated_length;
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address6_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IPv6 allocation to disk");
+        address6_undo(ip_ctx, pool, pool_number, index);
+        return -4;
+    }
+
+    log_info("IPv6 prefix %s allocated to %s in pool %d",
+             address6_prefix_to_string(prefix_out, pool->delegated_length), allocated_to, pool_number);
+    return 0;
+}
+
+// Releases the delegated prefix holding an address. Returns 0, -3 if it is
+// not allocated or -2 if the release could not be saved.
+int address6_release(ip6_context_t *ip_ctx, const struct in6_addr *prefix) {
+    if (!ip_ctx || !prefix) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    uint32_t index;
+    pool6_t *pool = address6_locate(ip_ctx, prefix, &index);
+    if (pool) pthread_mutex_lock(&pool->lock);
+    address6_record_t *record = pool ? address6_record(pool, index) : NULL;
+    if (!record) {
+        if (pool) pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        log_warning("IPv6 prefix not found or already free");
+        return -3;
+    }
+
+    // Keep what is needed to roll the release back
+    int pool_number = pool->pool_number;
+    int delegated_length = pool->delegated_length;
+    struct in6_addr released;
+    address6_prefix_at(pool, index, &released);
+    time_t allocation_time = record->allocation_time;
+    char owner[ADDRESS_OWNER_LENGTH];
+    address6_owner_copy(&ip_ctx->owners, record->owner, owner, sizeof(owner));
+
+    address6_apply_clear(pool, &ip_ctx->owners, index);
+    uint64_t lsn = address6_journal_index(ip_ctx, pool, index);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+
+    if (address6_commit(ip_ctx, lsn) != 0) {
+        log_error("Failed to save IPv6 release to disk");
+        pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+        if (address6_get_pool(ip_ctx, pool_number) == pool) {
+            pthread_mutex_lock(&pool->lock);
+            if (!address6_record(pool, index)) {
+                address6_apply_set(pool, &ip_ctx->owners, index, allocation_time, owner);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -2;
+    }
+
+    log_info("IPv6 prefix %s released", address6_prefix_to_string(&released, delegated_length));
+    return 0;
+}
+
+// Query Functions
+
+// Describes the delegated prefix holding an address; -1 if no pool holds it
+int address6_lookup(ip6_context_t *ip_ctx, const struct in6_addr *address, ip6_t *ip_out) {
+    if (!ip_ctx || !address || !ip_out) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+
+    uint32_t index;
+    pool6_t *pool = address6_locate(ip_ctx, address, &index);
+    if (!pool) {
+        pthread_rwlock_unlock(&ip_ctx->pools_lock);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    memset(ip_out, 0, sizeof(ip6_t));
+    address6_prefix_at(pool, index, &ip_out->prefix);
+    ip_out->prefix_length = pool->delegated_length;
+    ip_out->pool_number = pool->pool_number;
+    const address6_record_t *record = address6_record(pool, index);
+    if (record) {
+        ip_out->is_used = true;
+        ip_out->allocation_time = record->allocation_time;
+        address6_owner_copy(&ip_ctx->owners, record->owner, ip_out->allocated_to,
+                            sizeof(ip_out->allocated_to));
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return 0;
+}
+
+int64_t address6_get_used(ip6_context_t *ip_ctx, int pool_number) {
+    if (!ip_ctx) return -1;
+
+    pthread_rwlock_rdlock(&ip_ctx->pools_lock);
+    pool6_t *pool = address6_get_pool(ip_ctx, pool_number);
+    int64_t used = -1;
+    if (pool) {
+        pthread_mutex_lock(&pool->lock);
+        used = (int64_t)pool->used;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    pthread_rwlock_unlock(&ip_ctx->pools_lock);
+    return used;
+}
+
+// Utility Functions
+
+char* address6_prefix_to_string(const struct in6_addr *prefix, int prefix_length) {
+    static __thread char str[INET6_ADDRSTRLEN + 4];  // One per thread, like address_ip_to_string()
+    if (!inet_ntop(AF_INET6, prefix, str, INET6_ADDRSTRLEN)) {
+        str[0] = '\0';
+        return str;
+    }
+    size_t length = strlen(str);
+    snprintf(str + length, sizeof(str) - length, "/%d", prefix_length);
+    return str;
+}
+
+// Parses "2001:db8::/48"; a bare address is taken as a /128
+int address6_string_to_prefix(const char *str, struct in6_addr *prefix_out, int *prefix_length_out) {
+    if (!str || !prefix_out || !prefix_length_out) return -1;
+
+    char address[INET6_ADDRSTRLEN];
+    size_t length = strcspn(str, "/");
+    if (length >= sizeof(address)) return -1;
+    memcpy(address, str, length);
+    address[length] = '\0';
+
+    int prefix_length = 128;
+    if (str[length] == '/') {
+        char *end;
+        long parsed = strtol(str + length + 1, &end, 10);
+        if (end == str + length + 1 || *end != '\0' || parsed < 0 || parsed > 128) return -1;
+        prefix_length = (int)parsed;
+    }
+
+    if (inet_pton(AF_INET6, address, prefix_out) != 1) return -1;
+    *prefix_length_out = prefix_length;
+    return 0;
+}
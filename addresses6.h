@@ -0,0 +1,126 @@
+#ifndef IP6_MANAGEMENT_H
+#define IP6_MANAGEMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include "addresses.h"
+#include "journal.h"
+
+#define ADDRESS6_MIN_PREFIX 16         // Largest pool
+#define ADDRESS6_MAX_DELEGATION 32     // At most 2^32 prefixes per pool
+#define ADDRESS6_PAGE_SIZE 512         // Prefixes per bitmap page
+#define ADDRESS6_PAGE_WORDS (ADDRESS6_PAGE_SIZE / 64)
+#define ADDRESS6_IPS_FILE "ips6.dat"
+#define ADDRESS6_JOURNAL_FILE "ips6.journal"
+
+// An IPv6 pool is a prefix that is handed out as fixed-length delegated
+// prefixes, e.g. a /48 as /64s, one per VPS. A pool can hold billions of
+// prefixes, so nothing is sized by the pool: the used bitmap is split into
+// pages that exist only while they have a prefix in use, found through a
+// hash on the page number, and each delegated prefix has a record in a
+// second hash keyed by its index. Memory follows the allocated prefixes.
+// Owners are interned per context, so a record holds an id rather than a
+// copy of the name.
+
+// Snapshot of one delegated prefix, filled in by address6_lookup()
+typedef struct {
+    struct in6_addr prefix;
+    int prefix_length;
+    bool is_used;
+    int pool_number;
+    time_t allocation_time;
+    char allocated_to[ADDRESS_OWNER_LENGTH];
+} ip6_t;
+
+typedef struct {
+    uint64_t number;  // Covers indexes number * ADDRESS6_PAGE_SIZE onwards
+    uint32_t used;
+    uint64_t bits[ADDRESS6_PAGE_WORDS];
+} address6_page_t;
+
+typedef struct {
+    uint32_t index;
+    uint32_t owner;  // Index into the owner table, 0 when the bucket is empty
+    time_t allocation_time;
+} address6_record_t;
+
+// An interned owner string with the number of records holding it
+typedef struct {
+    char *name;      // NULL when the entry is free
+    uint32_t hash;   // Next free entry while the entry is free
+    uint32_t refs;
+} address6_owner_t;
+
+typedef struct {
+    address6_owner_t *entries;  // Entry 0 is reserved for "no owner"
+    uint32_t capacity;
+    uint32_t *buckets;          // Open-addressed, entry index or 0 when empty
+    uint32_t bucket_count;      // Power of two
+    uint32_t free_head;         // First free entry
+    pthread_mutex_t lock;
+} address6_owner_table_t;
+
+typedef struct {
+    int pool_number;
+    char pool_name[POOL_NAME_LENGTH];
+    uint64_t base_high;              // Host byte order halves of the pool prefix
+    uint64_t base_low;
+    int prefix_length;
+    int delegated_length;
+    uint64_t count;                  // Delegated prefixes in the pool
+    uint64_t used;
+
+    address6_page_t **pages;         // Open-addressed on the page number
+    uint32_t page_buckets;           // Power of two
+    uint32_t page_count;
+    uint64_t free_page_hint;         // No page below this has a free prefix
+
+    address6_record_t *records;      // Open-addressed on the index
+    uint32_t record_buckets;         // Power of two
+    uint32_t record_count;
+
+    pthread_mutex_t lock;
+} pool6_t;
+
+// Locks are taken in the order pools_lock, a pool's lock, then the owner
+// table's lock
+typedef struct {
+    pthread_rwlock_t pools_lock;    // Read to use pools, write to create or delete them
+    pool6_t *pools[MAX_POOLS + 1];  // Indexed by pool number
+    pool6_t *ranges[MAX_POOLS];     // The same pools sorted by prefix, for lookups
+    int pool_count;
+    address6_owner_table_t owners;
+    journal_t *journal;
+    uint64_t snapshot_generation;
+    pthread_mutex_t save_mutex;
+} ip6_context_t;
+
+// Initialization and cleanup
+int address6_init(ip6_context_t *address_ctx);
+void address6_cleanup(ip6_context_t *address_ctx);
+
+// Pool Management. prefix is "2001:db8::/48".
+int address6_create_pool(ip6_context_t *address_ctx, int pool_number, const char *pool_name,
+                         const char *prefix, int delegated_length);
+int address6_delete_pool(ip6_context_t *address_ctx, int pool_number);
+
+// Allocation Management
+int address6_allocate(ip6_context_t *address_ctx, int pool_number, const char *allocated_to,
+                      struct in6_addr *prefix_out, int *prefix_length_out);
+int address6_release(ip6_context_t *address_ctx, const struct in6_addr *prefix);
+
+// Query Functions
+int address6_lookup(ip6_context_t *address_ctx, const struct in6_addr *address, ip6_t *ip_out);
+int64_t address6_get_used(ip6_context_t *address_ctx, int pool_number);
+
+// Persistence
+int address6_save(ip6_context_t *address_ctx);
+
+// Utility Functions
+char* address6_prefix_to_string(const struct in6_addr *prefix, int prefix_length);
+int address6_string_to_prefix(const char *str, struct in6_addr *prefix_out, int *prefix_length_out);
+
+#endif // IP6_MANAGEMENT_H
@@ -2,29 +2,605 @@
 #include "logger.h"
 #include "utils.h"
 #include "http_server.h"
+#include "crypto.h"
+#include "session_shm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Journal record types for user mutations
+#define AUTH_JOURNAL_USER_PUT 1    // Full user_t record
+#define AUTH_JOURNAL_USER_LOGIN 2  // auth_login_record_t
+
+#define USERS_SNAPSHOT_MAGIC 0x53525355  // "USRS"
+#define USERS_SNAPSHOT_VERSION 2
+
+typedef struct {
+    int user_id;
+    time_t last_login;
+} auth_login_record_t;
+
+#define SESSIONS_SNAPSHOT_MAGIC 0x53534553  // "SESS"
+#define SESSIONS_SNAPSHOT_VERSION 2  // 1 had no revocations
+
+// sessions.dat header, followed by session_record_t entries sorted by hash
+// and then the unexpired revoked_token_t entries
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t revoked_count;  // Reserved, always 0, in version 1
+    uint64_t count;
+    uint32_t pad;
+    uint32_t crc;         // CRC-32 of the fields above
+} sessions_snapshot_header_t;
+
+// users.dat header; files without it are the original count + array format
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;  // Journal generation to replay from
+    int32_t user_count;
+    uint32_t crc;         // CRC-32 of the user records
+} users_snapshot_header_t;
+
+// Password hashing job handed to the compute pool
+typedef struct {
+    const char *password;
+    const char *salt;
+    const char *expected_hash;  // NULL when hashing a new password
+    char *hash;
+    int result;
+} auth_hash_job_t;
 
 // Global authentication context
 static auth_context_t *global_auth_ctx = NULL;
 
+// Signed token payload: user id (4), role (1), expiry (8), token id (8)
+#define SIGNED_TOKEN_PAYLOAD_SIZE 21
+
+static void auth_init_secret(auth_context_t *auth_ctx) {
+    // An explicit secret lets tokens stay valid across restarts and replicas
+    const char *env_secret = getenv("AUTH_JWT_SECRET");
+    if (env_secret && strlen(env_secret) >= 32) {
+        strncpy(auth_ctx->jwt_secret, env_secret, sizeof(auth_ctx->jwt_secret) - 1);
+        auth_ctx->jwt_secret[sizeof(auth_ctx->jwt_secret) - 1] = '\0';
+        return;
+    }
+
+    // Otherwise keep a generated secret on disk so restarts don't invalidate
+    // every signed token
+    FILE *file = fopen(AUTH_KEY_FILE, "r");
+    if (file) {
+        size_t got = fread(auth_ctx->jwt_secret, 1, sizeof(auth_ctx->jwt_secret) - 1, file);
+        fclose(file);
+        auth_ctx->jwt_secret[got] = '\0';
+        if (got == sizeof(auth_ctx->jwt_secret) - 1) return;
+        log_warning("Ignoring malformed token secret in %s", AUTH_KEY_FILE);
+    }
+    
+    uint8_t key[32];
+    crypto_random_bytes(key, sizeof(key));
+    crypto_to_hex(key, sizeof(key), auth_ctx->jwt_secret);
+    memset(key, 0, sizeof(key));
+    
+    int fd = open(AUTH_KEY_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, auth_ctx->jwt_secret, strlen(auth_ctx->jwt_secret)) < 0 ||
+        fsync(fd) != 0) {
+        log_warning("Failed to persist token secret to %s", AUTH_KEY_FILE);
+    }
+    if (fd >= 0) close(fd);
+}
+
+// FNV-1a; spreads usernames and tokens over shards and slots
+static uint64_t auth_hash_string(const char *str) {
+    uint64_t hash = 1469598103934665603ULL;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static user_t *auth_user_record(auth_context_t *auth_ctx, int user_id) {
+    return (user_t *)user_store_record(auth_ctx->user_store, (uint64_t)(user_id - 1));
+}
+
+// Seqlock writer side for a published user record
+static void auth_user_write_begin(auth_context_t *auth_ctx, int user_id) {
+    pthread_mutex_lock(&auth_ctx->user_locks[user_id & (AUTH_SHARD_COUNT - 1)]);
+    unsigned int *seq = &auth_ctx->user_store->seq[user_id - 1];
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void auth_user_write_end(auth_context_t *auth_ctx, int user_id) {
+    unsigned int *seq = &auth_ctx->user_store->seq[user_id - 1];
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&auth_ctx->user_locks[user_id & (AUTH_SHARD_COUNT - 1)]);
+}
+
+// Used until the index has been built; usernames never change once published
+static int auth_scan_for_username(auth_context_t *auth_ctx, const char *username) {
+    int count = auth_get_user_count(auth_ctx);
+    for (int user_id = 1; user_id <= count; user_id++) {
+        if (strcmp(auth_user_record(auth_ctx, user_id)->username, username) == 0) {
+            return user_id;
+        }
+    }
+    return 0;
+}
+
+static int auth_index_lookup(auth_context_t *auth_ctx, const char *username) {
+    if (!__atomic_load_n(&auth_ctx->index_ready, __ATOMIC_ACQUIRE)) {
+        return auth_scan_for_username(auth_ctx, username);
+    }
+    
+    uint64_t hash = auth_hash_string(username);
+    user_index_shard_t *shard = &auth_ctx->user_index[hash & (AUTH_SHARD_COUNT - 1)];
+    int found = 0;
+    
+    pthread_rwlock_rdlock(&shard->lock);
+    int mask = shard->capacity - 1;
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        int user_id = shard->slots[((size_t)(hash >> 8) + probe) & mask];
+        if (user_id == 0) break;
+        if (user_id > 0 && strcmp(auth_user_record(auth_ctx, user_id)->username, username) == 0) {
+            found = user_id;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    
+    return found;
+}
+
+// Places a user id without checking for duplicates; the caller holds the
+// shard's write lock and has made sure a free slot exists.
+static void auth_index_place(auth_context_t *auth_ctx, user_index_shard_t *shard, int user_id) {
+    uint64_t hash = auth_hash_string(auth_user_record(auth_ctx, user_id)->username);
+    int mask = shard->capacity - 1;
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        int *slot = &shard->slots[((size_t)(hash >> 8) + probe) & mask];
+        if (*slot <= 0) {
+            if (*slot == 0) shard->used++;
+            *slot = user_id;
+            shard->count++;
+            return;
+        }
+    }
+}
+
+// Doubles the shard (or just sweeps tombstones) so one more insert stays
+// under 3/4 load; the caller holds the write lock.
+static int auth_index_grow(auth_context_t *auth_ctx, user_index_shard_t *shard) {
+    int capacity = shard->capacity;
+    while ((shard->count + 1) * 2 > capacity) capacity *= 2;
+    
+    int *old_slots = shard->slots;
+    int old_capacity = shard->capacity;
+    int *slots = calloc((size_t)capacity, sizeof(int));
+    if (!slots) return -1;
+    
+    shard->slots = slots;
+    shard->capacity = capacity;
+    shard->count = 0;
+    shard->used = 0;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old_slots[i] > 0) auth_index_place(auth_ctx, shard, old_slots[i]);
+    }
+    
+    free(old_slots);
+    return 0;
+}
+
+// Idempotent, so the startup build and concurrent registrations can overlap
+static int auth_index_insert(auth_context_t *auth_ctx, int user_id, const char *username) {
+    uint64_t hash = auth_hash_string(username);
+    user_index_shard_t *shard = &auth_ctx->user_index[hash & (AUTH_SHARD_COUNT - 1)];
+    int rc = 0;
+    
+    pthread_rwlock_wrlock(&shard->lock);
+    int mask = shard->capacity - 1;
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        int slot = shard->slots[((size_t)(hash >> 8) + probe) & mask];
+        if (slot == 0) break;
+        if (slot == user_id) {
+            pthread_rwlock_unlock(&shard->lock);
+            return 0;
+        }
+    }
+    
+    if ((shard->used + 1) * 4 > shard->capacity * 3) {
+        rc = auth_index_grow(auth_ctx, shard);
+    }
+    if (rc == 0) {
+        auth_index_place(auth_ctx, shard, user_id);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    
+    if (rc != 0) {
+        log_error("Failed to grow username index, user %s not indexed", username);
+    }
+    return rc;
+}
+
+static void auth_index_remove(auth_context_t *auth_ctx, int user_id, const char *username) {
+    uint64_t hash = auth_hash_string(username);
+    user_index_shard_t *shard = &auth_ctx->user_index[hash & (AUTH_SHARD_COUNT - 1)];
+    
+    pthread_rwlock_wrlock(&shard->lock);
+    int mask = shard->capacity - 1;
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        int *slot = &shard->slots[((size_t)(hash >> 8) + probe) & mask];
+        if (*slot == 0) break;
+        if (*slot == user_id) {
+            *slot = -1;  // Tombstone keeps later probe chains intact
+            shard->count--;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+// Sorted indexes: user ids ordered by username and by email, so a prefix
+// listing is a binary search plus a walk over the matches. Usernames and
+// emails never change once a record is published, so the keys are read
+// straight from the store. Inserting shifts the arrays, which is cheap next
+// to the password hash every registration already pays for.
+
+typedef struct {
+    const char *key;
+    int user_id;
+} auth_sort_entry_t;
+
+static const char *auth_sorted_key(auth_context_t *auth_ctx, size_t offset, int user_id) {
+    return (const char *)auth_user_record(auth_ctx, user_id) + offset;
+}
+
+static int auth_sorted_compare(const char *key_a, int id_a, const char *key_b, int id_b) {
+    int cmp = strcmp(key_a, key_b);
+    if (cmp != 0) return cmp;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+static int auth_compare_sort_entries(const void *a, const void *b) {
+    const auth_sort_entry_t *entry_a = (const auth_sort_entry_t *)a;
+    const auth_sort_entry_t *entry_b = (const auth_sort_entry_t *)b;
+    return auth_sorted_compare(entry_a->key, entry_a->user_id, entry_b->key, entry_b->user_id);
+}
+
+// First position in ids that does not sort before (key, user_id); the
+// caller holds sorted_lock
+static int auth_sorted_lower_bound(auth_context_t *auth_ctx, const int *ids, size_t offset,
+                                   const char *key, int user_id) {
+    int low = 0, high = auth_ctx->sorted_count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (auth_sorted_compare(auth_sorted_key(auth_ctx, offset, ids[mid]), ids[mid], key, user_id) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// The caller holds users_mutex and the sorted_lock write lock
+static int auth_sorted_insert_locked(auth_context_t *auth_ctx, int user_id) {
+    if (auth_ctx->sorted_count == auth_ctx->sorted_capacity) {
+        int capacity = auth_ctx->sorted_capacity * 2;
+        int *by_username = realloc(auth_ctx->by_username, (size_t)capacity * sizeof(int));
+        if (!by_username) return -1;
+        auth_ctx->by_username = by_username;
+        int *by_email = realloc(auth_ctx->by_email, (size_t)capacity * sizeof(int));
+        if (!by_email) return -1;
+        auth_ctx->by_email = by_email;
+        auth_ctx->sorted_capacity = capacity;
+    }
+    
+    int *arrays[2] = { auth_ctx->by_username, auth_ctx->by_email };
+    size_t offsets[2] = { offsetof(user_t, username), offsetof(user_t, email) };
+    for (int i = 0; i < 2; i++) {
+        int pos = auth_sorted_lower_bound(auth_ctx, arrays[i], offsets[i],
+                                          auth_sorted_key(auth_ctx, offsets[i], user_id), user_id);
+        memmove(&arrays[i][pos + 1], &arrays[i][pos],
+                (size_t)(auth_ctx->sorted_count - pos) * sizeof(int));
+        arrays[i][pos] = user_id;
+    }
+    auth_ctx->sorted_count++;
+    return 0;
+}
+
+// Called with users_mutex held, right after a registration is published
+static void auth_sorted_insert(auth_context_t *auth_ctx, int user_id) {
+    if (!auth_ctx->sorted_ready) return;  // The index thread picks the user up
+    
+    pthread_rwlock_wrlock(&auth_ctx->sorted_lock);
+    int rc = auth_sorted_insert_locked(auth_ctx, user_id);
+    pthread_rwlock_unlock(&auth_ctx->sorted_lock);
+    if (rc != 0) {
+        log_error("Failed to grow sorted user indexes, user %d not listed by prefix", user_id);
+    }
+}
+
+// Called with users_mutex held
+static void auth_sorted_remove(auth_context_t *auth_ctx, int user_id) {
+    if (!auth_ctx->sorted_ready) return;
+    
+    pthread_rwlock_wrlock(&auth_ctx->sorted_lock);
+    int *arrays[2] = { auth_ctx->by_username, auth_ctx->by_email };
+    size_t offsets[2] = { offsetof(user_t, username), offsetof(user_t, email) };
+    int removed = 0;
+    for (int i = 0; i < 2; i++) {
+        int pos = auth_sorted_lower_bound(auth_ctx, arrays[i], offsets[i],
+                                          auth_sorted_key(auth_ctx, offsets[i], user_id), user_id);
+        if (pos < auth_ctx->sorted_count && arrays[i][pos] == user_id) {
+            memmove(&arrays[i][pos], &arrays[i][pos + 1],
+                    (size_t)(auth_ctx->sorted_count - pos - 1) * sizeof(int));
+            removed = 1;
+        }
+    }
+    if (removed) auth_ctx->sorted_count--;
+    pthread_rwlock_unlock(&auth_ctx->sorted_lock);
+}
+
+// Sorts the users present when the index thread starts without holding any
+// lock, then adds the ones registered meanwhile under users_mutex
+static int auth_sorted_build(auth_context_t *auth_ctx) {
+    int count = auth_get_user_count(auth_ctx);
+    int capacity = count + 64;
+    auth_sort_entry_t *entries = malloc((size_t)capacity * sizeof(auth_sort_entry_t));
+    int *by_username = malloc((size_t)capacity * sizeof(int));
+    int *by_email = malloc((size_t)capacity * sizeof(int));
+    if (!entries || !by_username || !by_email) {
+        free(entries);
+        free(by_username);
+        free(by_email);
+        return -1;
+    }
+    
+    int *arrays[2] = { by_username, by_email };
+    size_t offsets[2] = { offsetof(user_t, username), offsetof(user_t, email) };
+    int sorted = 0;
+    for (int i = 0; i < 2; i++) {
+        sorted = 0;
+        for (int user_id = 1; user_id <= count; user_id++) {
+            if (auth_user_record(auth_ctx, user_id)->user_id != user_id) continue;
+            entries[sorted].key = auth_sorted_key(auth_ctx, offsets[i], user_id);
+            entries[sorted].user_id = user_id;
+            sorted++;
+        }
+        qsort(entries, (size_t)sorted, sizeof(auth_sort_entry_t), auth_compare_sort_entries);
+        for (int j = 0; j < sorted; j++) arrays[i][j] = entries[j].user_id;
+    }
+    free(entries);
+    
+    pthread_mutex_lock(&auth_ctx->users_mutex);
+    pthread_rwlock_wrlock(&auth_ctx->sorted_lock);
+    auth_ctx->by_username = by_username;
+    auth_ctx->by_email = by_email;
+    auth_ctx->sorted_count = sorted;
+    auth_ctx->sorted_capacity = capacity;
+    
+    int rc = 0;
+    int user_count = auth_ctx->user_count;
+    for (int user_id = count + 1; user_id <= user_count && rc == 0; user_id++) {
+        if (auth_user_record(auth_ctx, user_id)->user_id != user_id) continue;
+        rc = auth_sorted_insert_locked(auth_ctx, user_id);
+    }
+    if (rc == 0) __atomic_store_n(&auth_ctx->sorted_ready, 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&auth_ctx->sorted_lock);
+    pthread_mutex_unlock(&auth_ctx->users_mutex);
+    return rc;
+}
+
+// Builds the username index in the background so startup doesn't touch every
+// record; lookups fall back to scanning the store until it is ready.
+static void *auth_index_worker(void *arg) {
+    auth_context_t *auth_ctx = (auth_context_t *)arg;
+    
+    int count = auth_get_user_count(auth_ctx);
+    for (int user_id = 1; user_id <= count; user_id++) {
+        user_t *user = auth_user_record(auth_ctx, user_id);
+        if (user->user_id == user_id) {
+            auth_index_insert(auth_ctx, user_id, user->username);
+        }
+    }
+    
+    __atomic_store_n(&auth_ctx->index_ready, 1, __ATOMIC_RELEASE);
+    log_info("Username index built for %d users", count);
+    
+    if (auth_sorted_build(auth_ctx) != 0) {
+        log_warning("Failed to build sorted user indexes, prefix listings unavailable");
+    }
+    return NULL;
+}
+
+static int auth_journal_replay(void *ctx, uint16_t type, const void *data, uint32_t length) {
+    auth_context_t *auth_ctx = (auth_context_t *)ctx;
+    
+    if (type == AUTH_JOURNAL_USER_PUT && length == sizeof(user_t)) {
+        const user_t *user = (const user_t *)data;
+        if (user->user_id <= 0 ||
+            user_store_reserve(auth_ctx->user_store, (uint64_t)user->user_id) != 0) {
+            return -1;
+        }
+        
+        *auth_user_record(auth_ctx, user->user_id) = *user;
+        if (user->user_id > auth_ctx->user_count) {
+            auth_ctx->user_count = user->user_id;
+        }
+        return 0;
+    }
+    
+    if (type == AUTH_JOURNAL_USER_LOGIN && length == sizeof(auth_login_record_t)) {
+        const auth_login_record_t *record = (const auth_login_record_t *)data;
+        user_t *user = auth_get_user_by_id(auth_ctx, record->user_id);
+        if (!user) return -1;
+        
+        user->last_login = record->last_login;
+        return 0;
+    }
+    
+    return -1;
+}
+
+// Records a user mutation; returns the journal sequence number, 0 if unjournaled
+static uint64_t auth_journal_user(auth_context_t *auth_ctx, const user_t *user) {
+    if (!auth_ctx->journal) return 0;
+    
+    uint64_t lsn = journal_append(auth_ctx->journal, AUTH_JOURNAL_USER_PUT, user, sizeof(user_t));
+    if (journal_pending_records(auth_ctx->journal) >= AUTH_SNAPSHOT_RECORDS) {
+        pthread_cond_signal(&auth_ctx->snapshot_cond);
+    }
+    return lsn;
+}
+
+// Background snapshot + compaction: runs on an interval, or early once enough
+// journal records have piled up. Sessions are snapshotted on the interval.
+static void *auth_snapshot_worker(void *arg) {
+    auth_context_t *auth_ctx = (auth_context_t *)arg;
+    
+    pthread_mutex_lock(&auth_ctx->snapshot_mutex);
+    
+    while (auth_ctx->snapshot_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += AUTH_SNAPSHOT_INTERVAL;
+        
+        int rc = 0;
+        while (auth_ctx->snapshot_running && rc != ETIMEDOUT &&
+               journal_pending_records(auth_ctx->journal) < AUTH_SNAPSHOT_RECORDS) {
+            rc = pthread_cond_timedwait(&auth_ctx->snapshot_cond, &auth_ctx->snapshot_mutex,
+                                        &deadline);
+        }
+        
+        if (!auth_ctx->snapshot_running) break;
+        
+        pthread_mutex_unlock(&auth_ctx->snapshot_mutex);
+        if (journal_pending_records(auth_ctx->journal) > 0) {
+            auth_save_users(auth_ctx);
+        }
+        if (rc == ETIMEDOUT) {
+            auth_cleanup_expired_sessions(auth_ctx);
+            if (__atomic_exchange_n(&auth_ctx->sessions_dirty, 0, __ATOMIC_RELAXED)) {
+                auth_save_sessions(auth_ctx, AUTH_SESSIONS_FILE);
+            }
+        }
+        pthread_mutex_lock(&auth_ctx->snapshot_mutex);
+    }
+    
+    pthread_mutex_unlock(&auth_ctx->snapshot_mutex);
+    return NULL;
+}
+
+static revoked_table_t *auth_revoked_table_create(size_t capacity) {
+    revoked_table_t *table = calloc(1, sizeof(revoked_table_t) + capacity * sizeof(revoked_token_t));
+    if (table) table->capacity = capacity;
+    return table;
+}
+
 int auth_init(auth_context_t *auth_ctx) {
     if (!auth_ctx) return -1;
     
     memset(auth_ctx, 0, sizeof(auth_context_t));
     auth_ctx->user_count = 0;
-    auth_ctx->session_count = 0;
+    auth_ctx->signed_tokens = 0;
+    
+    if (pthread_mutex_init(&auth_ctx->revoke_mutex, NULL) != 0) {
+        log_error("Failed to initialize revocation mutex");
+        return -1;
+    }
+    auth_ctx->revoked = auth_revoked_table_create(AUTH_REVOKED_INITIAL);
+    if (!auth_ctx->revoked) {
+        log_error("Failed to allocate token revocation table");
+        return -1;
+    }
+    pthread_mutex_init(&auth_ctx->users_mutex, NULL);
+    pthread_mutex_init(&auth_ctx->save_mutex, NULL);
+    pthread_mutex_init(&auth_ctx->snapshot_mutex, NULL);
+    pthread_cond_init(&auth_ctx->snapshot_cond, NULL);
+    pthread_rwlock_init(&auth_ctx->sorted_lock, NULL);
+    
+    for (int i = 0; i < AUTH_SHARD_COUNT; i++) {
+        pthread_mutex_init(&auth_ctx->user_locks[i], NULL);
+        pthread_rwlock_init(&auth_ctx->user_index[i].lock, NULL);
+        pthread_mutex_init(&auth_ctx->session_shards[i].lock, NULL);
+        auth_ctx->user_index[i].slots = calloc(AUTH_INDEX_SHARD_INITIAL, sizeof(int));
+        auth_ctx->user_index[i].capacity = AUTH_INDEX_SHARD_INITIAL;
+        auth_ctx->session_shards[i].sessions = calloc(AUTH_SESSION_SHARD_INITIAL, sizeof(session_t));
+        auth_ctx->session_shards[i].capacity = AUTH_SESSION_SHARD_INITIAL;
+        if (!auth_ctx->user_index[i].slots || !auth_ctx->session_shards[i].sessions) {
+            log_error("Failed to allocate authentication tables");
+            return -1;
+        }
+    }
+    
+    // Opening the store maps the file without reading any records
+    auth_ctx->user_store = user_store_open(AUTH_USER_STORE_FILE, sizeof(user_t));
+    if (!auth_ctx->user_store) {
+        log_error("Failed to open user store %s", AUTH_USER_STORE_FILE);
+        return -1;
+    }
+    auth_ctx->user_count = (int)user_store_count(auth_ctx->user_store);
+    auth_ctx->snapshot_generation = user_store_generation(auth_ctx->user_store);
+    
+    // Map the session snapshot; entries are restored on first use
+    auth_load_sessions(auth_ctx, AUTH_SESSIONS_FILE);
     
     // Generate JWT secret
-    auth_generate_token(auth_ctx->jwt_secret, sizeof(auth_ctx->jwt_secret));
+    auth_init_secret(auth_ctx);
+    
+    // Size the hashing pool to the machine so logins can't starve other routes
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    auth_ctx->hash_pool = compute_pool_create(cpus > 0 ? (int)cpus : 1, AUTH_HASH_QUEUE_LIMIT);
+    if (!auth_ctx->hash_pool) {
+        log_warning("Password hashing pool unavailable, hashing inline");
+    }
     
     global_auth_ctx = auth_ctx;
     
-    // Load existing users if file exists
-    auth_load_users(auth_ctx, "users.dat");
+    // A fresh store picks up users.dat from older versions, then the journal
+    // written since the last checkpoint is replayed on top
+    int imported = 0;
+    if (auth_ctx->user_count == 0 && auth_ctx->snapshot_generation == 0) {
+        imported = auth_load_users(auth_ctx, AUTH_USERS_FILE) > 0;
+    }
+    auth_ctx->journal = journal_open(AUTH_JOURNAL_FILE, auth_ctx->snapshot_generation,
+                                     auth_journal_replay, auth_ctx);
+    if (!auth_ctx->journal) {
+        log_warning("User journal unavailable, falling back to full checkpoints");
+    }
+    
+    if (imported && auth_save_users(auth_ctx) == 0) {
+        char backup[sizeof(AUTH_USERS_FILE) + 4];
+        snprintf(backup, sizeof(backup), "%s.bak", AUTH_USERS_FILE);
+        if (rename(AUTH_USERS_FILE, backup) == 0) {
+            log_info("Imported %s into %s, original kept as %s",
+                     AUTH_USERS_FILE, AUTH_USER_STORE_FILE, backup);
+        }
+    }
+    
+    if (pthread_create(&auth_ctx->index_thread, NULL, auth_index_worker, auth_ctx) == 0) {
+        auth_ctx->index_building = 1;
+    } else {
+        log_warning("Failed to start username index thread, building inline");
+        auth_index_worker(auth_ctx);
+    }
+    
+    auth_ctx->snapshot_running = 1;
+    if (pthread_create(&auth_ctx->snapshot_thread, NULL, auth_snapshot_worker, auth_ctx) != 0) {
+        log_warning("Failed to start user snapshot thread");
+        auth_ctx->snapshot_running = 0;
+    }
     
     log_info("Authentication system initialized with %d users", auth_ctx->user_count);
     return 0;
@@ -33,12 +609,93 @@ int auth_init(auth_context_t *auth_ctx) {
 void auth_cleanup(auth_context_t *auth_ctx) {
     if (!auth_ctx) return;
     
-    // Save users before cleanup
-    auth_save_users(auth_ctx, "users.dat");
+    if (auth_ctx->snapshot_running) {
+        pthread_mutex_lock(&auth_ctx->snapshot_mutex);
+        auth_ctx->snapshot_running = 0;
+        pthread_cond_signal(&auth_ctx->snapshot_cond);
+        pthread_mutex_unlock(&auth_ctx->snapshot_mutex);
+        pthread_join(auth_ctx->snapshot_thread, NULL);
+    }
+    
+    if (auth_ctx->index_building) {
+        pthread_join(auth_ctx->index_thread, NULL);
+        auth_ctx->index_building = 0;
+    }
+    
+    // Save users before cleanup; this also compacts the journal
+    auth_save_users(auth_ctx);
+    auth_save_sessions(auth_ctx, AUTH_SESSIONS_FILE);
+    if (auth_ctx->restored_map) {
+        munmap(auth_ctx->restored_map, auth_ctx->restored_map_size);
+        auth_ctx->restored_map = NULL;
+        auth_ctx->restored_sessions = NULL;
+        auth_ctx->restored_count = 0;
+    }
+    journal_close(auth_ctx->journal);
+    auth_ctx->journal = NULL;
+    
+    compute_pool_destroy(auth_ctx->hash_pool);
+    auth_ctx->hash_pool = NULL;
+    pthread_mutex_destroy(&auth_ctx->revoke_mutex);
+    while (auth_ctx->revoked) {
+        revoked_table_t *retired = auth_ctx->revoked->retired;
+        free(auth_ctx->revoked);
+        auth_ctx->revoked = retired;
+    }
+    
+    for (int i = 0; i < AUTH_SHARD_COUNT; i++) {
+        pthread_mutex_destroy(&auth_ctx->user_locks[i]);
+        pthread_rwlock_destroy(&auth_ctx->user_index[i].lock);
+        pthread_mutex_destroy(&auth_ctx->session_shards[i].lock);
+        free(auth_ctx->user_index[i].slots);
+        free(auth_ctx->session_shards[i].sessions);
+        auth_ctx->user_index[i].slots = NULL;
+        auth_ctx->session_shards[i].sessions = NULL;
+    }
+    
+    pthread_rwlock_destroy(&auth_ctx->sorted_lock);
+    free(auth_ctx->by_username);
+    free(auth_ctx->by_email);
+    auth_ctx->by_username = NULL;
+    auth_ctx->by_email = NULL;
+    auth_ctx->sorted_ready = 0;
+    
+    user_store_close(auth_ctx->user_store);
+    auth_ctx->user_store = NULL;
+    session_shm_close(auth_ctx->shared_sessions);
+    auth_ctx->shared_sessions = NULL;
     
     log_info("Authentication system cleaned up");
 }
 
+static void auth_hash_job_run(void *arg) {
+    auth_hash_job_t *job = (auth_hash_job_t *)arg;
+    
+    if (job->expected_hash) {
+        job->result = auth_verify_password(job->password, job->salt, job->expected_hash);
+    } else {
+        auth_hash_password(job->password, job->salt, job->hash);
+        job->result = 1;
+    }
+}
+
+// Withdraws a registration that could not be made durable, so the client can
+// retry under the same name. The slot is reclaimed if it is the last one;
+// otherwise it is left zeroed, which lookups and index builds already skip.
+// The caller holds users_mutex.
+static void auth_unpublish_user(auth_context_t *auth_ctx, const user_t *user) {
+    auth_index_remove(auth_ctx, user->user_id, user->username);
+    auth_sorted_remove(auth_ctx, user->user_id);
+    
+    auth_user_write_begin(auth_ctx, user->user_id);
+    memset(auth_user_record(auth_ctx, user->user_id), 0, sizeof(user_t));
+    auth_user_write_end(auth_ctx, user->user_id);
+    
+    if (auth_ctx->user_count == user->user_id) {
+        __atomic_store_n(&auth_ctx->user_count, user->user_id - 1, __ATOMIC_RELEASE);
+    }
+}
+
 int auth_register_user(auth_context_t *auth_ctx, const char *username, 
                        const char *email, const char *password) {
     if (!auth_ctx || !username || !email || !password) return -1;
@@ -65,165 +722,534 @@ int auth_register_user(auth_context_t *auth_ctx, const char *username,
         return -5;
     }
     
-    // Check if we have space for new user
-    if (auth_ctx->user_count >= MAX_USERS) {
-        log_error("Maximum users reached");
-        return -6;
-    }
+    // Build the record outside the table so hashing holds no locks
+    user_t new_user;
+    memset(&new_user, 0, sizeof(new_user));
+    
+    strncpy(new_user.username, username, MAX_USERNAME_LENGTH - 1);
+    strncpy(new_user.email, email, MAX_EMAIL_LENGTH - 1);
     
-    // Create new user
-    user_t *user = &auth_ctx->users[auth_ctx->user_count];
-    user->user_id = auth_ctx->user_count + 1;
+    // Generate salt and hash password on the compute pool
+    auth_generate_salt(new_user.salt, sizeof(new_user.salt));
+    auth_hash_job_t job = { password, new_user.salt, NULL, new_user.password_hash, 0 };
+    if (compute_pool_run(auth_ctx->hash_pool, auth_hash_job_run, &job) != 0) {
+        log_warning("Registration rejected, password hashing queue full: %s", username);
+        return -8;
+    }
     
-    strncpy(user->username, username, MAX_USERNAME_LENGTH - 1);
-    user->username[MAX_USERNAME_LENGTH - 1] = '\0';
+    new_user.created_at = time(NULL);
+    new_user.last_login = 0;
+    new_user.is_active = 1;
+    new_user.role = 0;  // Default to regular user
     
-    strncpy(user->email, email, MAX_EMAIL_LENGTH - 1);
-    user->email[MAX_EMAIL_LENGTH - 1] = '\0';
+    pthread_mutex_lock(&auth_ctx->users_mutex);
     
-    // Generate salt and hash password
-    auth_generate_salt(user->salt, sizeof(user->salt));
-    auth_hash_password(password, user->salt, user->password_hash);
+    // Re-check now that we hold the writer lock
+    if (auth_get_user_by_username(auth_ctx, username)) {
+        pthread_mutex_unlock(&auth_ctx->users_mutex);
+        log_warning("User already exists: %s", username);
+        return -5;
+    }
     
-    user->created_at = time(NULL);
-    user->last_login = 0;
-    user->is_active = 1;
-    user->role = 0;  // Default to regular user
+    // Grow the store if the new record doesn't fit; only the disk limits this
+    if (user_store_reserve(auth_ctx->user_store, (uint64_t)auth_ctx->user_count + 1) != 0) {
+        pthread_mutex_unlock(&auth_ctx->users_mutex);
+        log_error("User store is full");
+        return -6;
+    }
     
-    auth_ctx->user_count++;
+    // Fill the record before publishing the new count to lock-free readers
+    new_user.user_id = auth_ctx->user_count + 1;
+    *auth_user_record(auth_ctx, new_user.user_id) = new_user;
+    __atomic_store_n(&auth_ctx->user_count, new_user.user_id, __ATOMIC_RELEASE);
+    auth_index_insert(auth_ctx, new_user.user_id, new_user.username);
+    auth_sorted_insert(auth_ctx, new_user.user_id);
+    
+    uint64_t lsn = auth_journal_user(auth_ctx, &new_user);
+    
+    pthread_mutex_unlock(&auth_ctx->users_mutex);
+    
+    // Wait for the group commit that carries this record
+    int saved;
+    if (auth_ctx->journal) {
+        saved = lsn != 0 && journal_sync(auth_ctx->journal, lsn) == 0;
+        if (!saved) log_error("Failed to journal user registration: %s", username);
+    } else {
+        saved = auth_save_users(auth_ctx) == 0;
+        if (!saved) log_error("Failed to save user registration to disk");
+    }
     
-    // Immediately save the updated user list to disk
-    if (auth_save_users(auth_ctx, "users.dat") != 0) {
-        log_error("Failed to save user registration to disk");
-        // Roll back the user count
-        auth_ctx->user_count--;
+    if (!saved) {
+        pthread_mutex_lock(&auth_ctx->users_mutex);
+        auth_unpublish_user(auth_ctx, &new_user);
+        pthread_mutex_unlock(&auth_ctx->users_mutex);
         return -7;  // New error code for save failure
     }
     
-    log_info("User registered and saved: %s (ID: %d)", username, user->user_id);
-    return user->user_id;
+    log_info("User registered and saved: %s (ID: %d)", username, new_user.user_id);
+    return new_user.user_id;
 }
 
 int auth_authenticate_user(auth_context_t *auth_ctx, const char *username, 
                           const char *password) {
     if (!auth_ctx || !username || !password) return -1;
     
-    user_t *user = auth_get_user_by_username(auth_ctx, username);
-    if (!user) {
+    user_t user;
+    int user_id = auth_index_lookup(auth_ctx, username);
+    if (user_id <= 0 || auth_get_user_copy(auth_ctx, user_id, &user) != 0) {
         log_warning("Authentication failed: user not found: %s", username);
         return -1;
     }
     
-    if (!user->is_active) {
+    if (!user.is_active) {
         log_warning("Authentication failed: user inactive: %s", username);
         return -2;
     }
     
-    if (!auth_verify_password(password, user->salt, user->password_hash)) {
+    auth_hash_job_t job = { password, user.salt, user.password_hash, NULL, 0 };
+    if (compute_pool_run(auth_ctx->hash_pool, auth_hash_job_run, &job) != 0) {
+        log_warning("Authentication rejected, password hashing queue full: %s", username);
+        return -4;
+    }
+    
+    if (!job.result) {
         log_warning("Authentication failed: wrong password for user: %s", username);
         return -3;
     }
     
-    // Update last login
-    user->last_login = time(NULL);
+    // Upgrade legacy hashes now that we know the plaintext
+    if (strlen(user.password_hash) == LEGACY_HASH_LENGTH) {
+        char upgraded[PASSWORD_HASH_LENGTH];
+        auth_hash_job_t rehash = { password, user.salt, NULL, upgraded, 0 };
+        if (compute_pool_run(auth_ctx->hash_pool, auth_hash_job_run, &rehash) == 0) {
+            auth_user_write_begin(auth_ctx, user_id);
+            strcpy(auth_user_record(auth_ctx, user_id)->password_hash, upgraded);
+            auth_journal_user(auth_ctx, auth_user_record(auth_ctx, user_id));
+            auth_user_write_end(auth_ctx, user_id);
+            log_info("Upgraded password hash for user: %s", username);
+        }
+    }
+    
+    // Update last login; durability can ride along with the next group commit
+    auth_login_record_t login = { user_id, time(NULL) };
+    auth_user_write_begin(auth_ctx, user_id);
+    auth_user_record(auth_ctx, user_id)->last_login = login.last_login;
+    auth_user_write_end(auth_ctx, user_id);
+    if (auth_ctx->journal) {
+        journal_append(auth_ctx->journal, AUTH_JOURNAL_USER_LOGIN, &login, sizeof(login));
+    }
     
     log_info("User authenticated: %s", username);
-    return user->user_id;
+    return user_id;
 }
 
-user_t* auth_get_user_by_id(auth_context_t *auth_ctx, int user_id) {
-    if (!auth_ctx || user_id <= 0) return NULL;
+int auth_get_user_count(auth_context_t *auth_ctx) {
+    if (!auth_ctx) return 0;
+    return __atomic_load_n(&auth_ctx->user_count, __ATOMIC_ACQUIRE);
+}
+
+// Copies the user into user_out and checks it against filter
+static int auth_list_match(auth_context_t *auth_ctx, const auth_user_filter_t *filter,
+                           int user_id, user_t *user_out) {
+    if (auth_get_user_copy(auth_ctx, user_id, user_out) != 0) return 0;
+    if (filter->role >= 0 && user_out->role != filter->role) return 0;
+    if (filter->is_active >= 0 && !user_out->is_active != !filter->is_active) return 0;
+    if (filter->username_prefix &&
+        strncmp(user_out->username, filter->username_prefix, strlen(filter->username_prefix)) != 0) {
+        return 0;
+    }
+    if (filter->email_prefix &&
+        strncmp(user_out->email, filter->email_prefix, strlen(filter->email_prefix)) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// One page of the users matching filter, starting after the user id in
+// cursor (0 for the first page). Pages are ordered by user id, or by
+// username or email when filtering on a prefix of it. At most
+// AUTH_LIST_SCAN_LIMIT records are examined, so a page can come back short
+// with more to follow. Returns the number of users copied and sets
+// *next_cursor to pass for the next page, 0 after the last one; -2 while
+// the sorted indexes are being built, -3 for an unknown cursor.
+int auth_list_users(auth_context_t *auth_ctx, const auth_user_filter_t *filter, int cursor,
+                    int limit, user_t *users_out, int *next_cursor) {
+    if (!auth_ctx || !filter || !users_out || !next_cursor || limit <= 0 || cursor < 0) return -1;
+    if (limit > AUTH_LIST_MAX_LIMIT) limit = AUTH_LIST_MAX_LIMIT;
+    
+    *next_cursor = 0;
+    int user_count = auth_get_user_count(auth_ctx);
+    if (cursor > user_count) return -3;
+    
+    int count = 0, scanned = 0, last = 0, more = 0;
+    const char *prefix = NULL;
+    size_t offset = 0;
+    if (filter->username_prefix && filter->username_prefix[0]) {
+        prefix = filter->username_prefix;
+        offset = offsetof(user_t, username);
+    } else if (filter->email_prefix && filter->email_prefix[0]) {
+        prefix = filter->email_prefix;
+        offset = offsetof(user_t, email);
+    }
     
-    for (int i = 0; i < auth_ctx->user_count; i++) {
-        if (auth_ctx->users[i].user_id == user_id) {
-            return &auth_ctx->users[i];
+    if (!prefix) {
+        for (int user_id = cursor + 1; user_id <= user_count; user_id++) {
+            if (count == limit || scanned == AUTH_LIST_SCAN_LIMIT) {
+                more = 1;
+                break;
+            }
+            scanned++;
+            last = user_id;
+            if (auth_list_match(auth_ctx, filter, user_id, &users_out[count])) count++;
         }
+        *next_cursor = more ? last : 0;
+        return count;
     }
     
-    return NULL;
+    if (!__atomic_load_n(&auth_ctx->sorted_ready, __ATOMIC_ACQUIRE)) return -2;
+    
+    pthread_rwlock_rdlock(&auth_ctx->sorted_lock);
+    const int *ids = offset == offsetof(user_t, username) ? auth_ctx->by_username : auth_ctx->by_email;
+    int pos;
+    if (cursor == 0) {
+        pos = auth_sorted_lower_bound(auth_ctx, ids, offset, prefix, 0);
+    } else {
+        pos = auth_sorted_lower_bound(auth_ctx, ids, offset,
+                                      auth_sorted_key(auth_ctx, offset, cursor), cursor);
+        if (pos < auth_ctx->sorted_count && ids[pos] == cursor) pos++;
+    }
+    
+    size_t prefix_length = strlen(prefix);
+    for (; pos < auth_ctx->sorted_count; pos++) {
+        int user_id = ids[pos];
+        if (strncmp(auth_sorted_key(auth_ctx, offset, user_id), prefix, prefix_length) != 0) break;
+        if (count == limit || scanned == AUTH_LIST_SCAN_LIMIT) {
+            more = 1;
+            break;
+        }
+        scanned++;
+        last = user_id;
+        if (auth_list_match(auth_ctx, filter, user_id, &users_out[count])) count++;
+    }
+    pthread_rwlock_unlock(&auth_ctx->sorted_lock);
+    
+    *next_cursor = more ? last : 0;
+    return count;
+}
+
+// User ids are assigned sequentially, so a record lives at index user_id - 1.
+// The returned pointer stays valid while the store grows, but fields may
+// change underneath callers that don't use auth_get_user_copy().
+user_t* auth_get_user_by_id(auth_context_t *auth_ctx, int user_id) {
+    if (!auth_ctx || user_id <= 0 || user_id > auth_get_user_count(auth_ctx)) return NULL;
+    
+    user_t *user = auth_user_record(auth_ctx, user_id);
+    return user->user_id == user_id ? user : NULL;
 }
 
 user_t* auth_get_user_by_username(auth_context_t *auth_ctx, const char *username) {
     if (!auth_ctx || !username) return NULL;
     
-    for (int i = 0; i < auth_ctx->user_count; i++) {
-        if (strcmp(auth_ctx->users[i].username, username) == 0) {
-            return &auth_ctx->users[i];
+    int user_id = auth_index_lookup(auth_ctx, username);
+    return user_id > 0 ? auth_user_record(auth_ctx, user_id) : NULL;
+}
+
+// Consistent copy of a user record without taking any lock
+int auth_get_user_copy(auth_context_t *auth_ctx, int user_id, user_t *user_out) {
+    if (!auth_ctx || !user_out || user_id <= 0 || user_id > auth_get_user_count(auth_ctx)) {
+        return -1;
+    }
+    
+    unsigned int *seq = &auth_ctx->user_store->seq[user_id - 1];
+    const user_t *user = auth_user_record(auth_ctx, user_id);
+    unsigned int before, after;
+    do {
+        before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;  // Writer in progress
+        memcpy(user_out, user, sizeof(user_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    
+    return user_out->user_id == user_id ? 0 : -1;
+}
+
+// Seqlock read of just the fields authorization needs, so the hot path does
+// not copy the whole record
+static int auth_user_access(auth_context_t *auth_ctx, int user_id, int *role, int *is_active) {
+    if (user_id <= 0 || user_id > auth_get_user_count(auth_ctx)) return -1;
+    
+    unsigned int *seq = &auth_ctx->user_store->seq[user_id - 1];
+    const user_t *user = auth_user_record(auth_ctx, user_id);
+    unsigned int before, after;
+    int id;
+    do {
+        before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;  // Writer in progress
+        id = user->user_id;
+        *role = user->role;
+        *is_active = user->is_active;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    
+    return id == user_id ? 0 : -1;
+}
+
+static session_shard_t *auth_session_shard(auth_context_t *auth_ctx, const char *token,
+                                           uint64_t *hash) {
+    *hash = auth_hash_string(token);
+    return &auth_ctx->session_shards[*hash & (AUTH_SHARD_COUNT - 1)];
+}
+
+// Rebuilds a shard with only live sessions, doubling it as needed so one more
+// session keeps the table at most half full. The caller holds the shard lock.
+static int auth_session_rehash(session_shard_t *shard, time_t now) {
+    int live = 0;
+    for (int i = 0; i < shard->capacity; i++) {
+        if (shard->sessions[i].is_valid && now < shard->sessions[i].expires_at) live++;
+    }
+    
+    int capacity = shard->capacity;
+    while ((live + 1) * 2 > capacity) capacity *= 2;
+    
+    session_t *sessions = calloc((size_t)capacity, sizeof(session_t));
+    if (!sessions) return -1;
+    
+    for (int i = 0; i < shard->capacity; i++) {
+        session_t *session = &shard->sessions[i];
+        if (!session->is_valid || now >= session->expires_at) continue;
+        
+        size_t slot = (size_t)(auth_hash_string(session->token) >> 8);
+        while (sessions[slot & (capacity - 1)].token[0] != '\0') slot++;
+        sessions[slot & (capacity - 1)] = *session;
+    }
+    
+    free(shard->sessions);
+    shard->sessions = sessions;
+    shard->capacity = capacity;
+    shard->active = live;
+    shard->used = live;
+    return 0;
+}
+
+// Claims the slot a new session with this hash goes into; the caller holds
+// the shard lock and fills in the session.
+static session_t *auth_insert_session(session_shard_t *shard, uint64_t hash, time_t now) {
+    // Keep probe chains short; a rebuild also drops dead sessions
+    if ((shard->used + 1) * 4 > shard->capacity * 3 && auth_session_rehash(shard, now) != 0) {
+        return NULL;
+    }
+    
+    // Take the first empty, destroyed or expired slot on the probe path
+    session_t *session = NULL;
+    size_t home = (size_t)(hash >> 8);
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        session_t *candidate = &shard->sessions[(home + probe) & (shard->capacity - 1)];
+        if (candidate->token[0] == '\0' || !candidate->is_valid || now >= candidate->expires_at) {
+            session = candidate;
+            break;
+        }
+    }
+    
+    if (session->token[0] == '\0') shard->used++;
+    if (!session->is_valid) shard->active++;
+    return session;
+}
+
+// Binary search of the sessions restored at startup. Entries are only read
+// or changed under the lock of the shard their hash maps to.
+static session_record_t *auth_find_restored_session(auth_context_t *auth_ctx, uint64_t hash,
+                                                    const char *token) {
+    session_record_t *records = auth_ctx->restored_sessions;
+    size_t low = 0, high = auth_ctx->restored_count;
+    
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (records[mid].token_hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
     
+    for (; low < auth_ctx->restored_count && records[low].token_hash == hash; low++) {
+        if (strncmp(records[low].session.token, token, MAX_SESSION_TOKEN_LENGTH) == 0) {
+            return &records[low];
+        }
+    }
     return NULL;
 }
 
 char* auth_create_session(auth_context_t *auth_ctx, int user_id, const char *ip_address) {
     if (!auth_ctx || user_id <= 0) return NULL;
     
-    // Clean up expired sessions first
-    auth_cleanup_expired_sessions(auth_ctx);
+    // Stateless mode: everything needed to authorize lives in the token
+    if (auth_ctx->signed_tokens) {
+        user_t user;
+        if (auth_get_user_copy(auth_ctx, user_id, &user) != 0) return NULL;
+        return auth_create_signed_token(auth_ctx, user_id, user.role,
+                                        time(NULL) + SESSION_DURATION);
+    }
     
-    // Check if we have space for new session
-    if (auth_ctx->session_count >= MAX_SESSIONS) {
-        log_error("Maximum sessions reached");
-        return NULL;
+    char token[MAX_SESSION_TOKEN_LENGTH];
+    auth_generate_token(token, sizeof(token));
+    
+    uint64_t hash;
+    session_shard_t *shard = auth_session_shard(auth_ctx, token, &hash);
+    time_t now = time(NULL);
+    
+    if (auth_ctx->shared_sessions) {
+        session_t shared;
+        memset(&shared, 0, sizeof(shared));
+        memcpy(shared.token, token, sizeof(shared.token));
+        shared.user_id = user_id;
+        shared.created_at = now;
+        shared.expires_at = now + SESSION_DURATION;
+        shared.is_valid = 1;
+        if (ip_address) {
+            strncpy(shared.ip_address, ip_address, sizeof(shared.ip_address) - 1);
+        }
+        
+        if (session_shm_insert(auth_ctx->shared_sessions, hash, &shared) != 0) {
+            log_error("Maximum sessions reached");
+            return NULL;
+        }
+        
+        log_info("Session created for user ID: %d", user_id);
+        char *token_copy = malloc(strlen(token) + 1);
+        if (token_copy) strcpy(token_copy, token);
+        return token_copy;
     }
     
-    // Create new session
-    session_t *session = &auth_ctx->sessions[auth_ctx->session_count];
+    pthread_mutex_lock(&shard->lock);
     
-    auth_generate_token(session->token, sizeof(session->token));
+    session_t *session = auth_insert_session(shard, hash, now);
+    if (!session) {
+        pthread_mutex_unlock(&shard->lock);
+        log_error("Failed to grow session table");
+        return NULL;
+    }
+    
+    memcpy(session->token, token, sizeof(session->token));
     session->user_id = user_id;
-    session->created_at = time(NULL);
+    session->created_at = now;
     session->expires_at = session->created_at + SESSION_DURATION;
     session->is_valid = 1;
+    session->ip_address[0] = '\0';
     
     if (ip_address) {
         strncpy(session->ip_address, ip_address, sizeof(session->ip_address) - 1);
         session->ip_address[sizeof(session->ip_address) - 1] = '\0';
     }
     
-    auth_ctx->session_count++;
+    pthread_mutex_unlock(&shard->lock);
+    __atomic_store_n(&auth_ctx->sessions_dirty, 1, __ATOMIC_RELAXED);
     
     log_info("Session created for user ID: %d", user_id);
     
     // Return a copy of the token
-    char *token_copy = malloc(strlen(session->token) + 1);
+    char *token_copy = malloc(strlen(token) + 1);
     if (token_copy) {
-        strcpy(token_copy, session->token);
+        strcpy(token_copy, token);
     }
     
     return token_copy;
 }
 
-session_t* auth_validate_session(auth_context_t *auth_ctx, const char *token) {
-    if (!auth_ctx || !token) return NULL;
+// Finds a session slot by token; the caller holds the shard lock
+static session_t *auth_find_session(session_shard_t *shard, uint64_t hash, const char *token) {
+    size_t home = (size_t)(hash >> 8);
+    for (int probe = 0; probe < shard->capacity; probe++) {
+        session_t *session = &shard->sessions[(home + probe) & (shard->capacity - 1)];
+        if (session->token[0] == '\0') return NULL;
+        if (strcmp(session->token, token) == 0) return session;
+    }
+    return NULL;
+}
+
+int auth_validate_session(auth_context_t *auth_ctx, const char *token, session_t *session_out) {
+    if (!auth_ctx || !token || token[0] == '\0') return -1;
     
+    uint64_t hash;
+    session_shard_t *shard = auth_session_shard(auth_ctx, token, &hash);
     time_t now = time(NULL);
+    int rc = -1;
+    
+    // Shared table: one lock-free probe in memory every worker process sees
+    if (auth_ctx->shared_sessions) {
+        session_t shared;
+        if (session_shm_lookup(auth_ctx->shared_sessions, hash, token, &shared) != 0 ||
+            !shared.is_valid || now >= shared.expires_at) {
+            return -1;
+        }
+        if (session_out) *session_out = shared;
+        return 0;
+    }
     
-    for (int i = 0; i < auth_ctx->session_count; i++) {
-        session_t *session = &auth_ctx->sessions[i];
-        
-        if (session->is_valid && 
-            strcmp(session->token, token) == 0 && 
-            now < session->expires_at) {
-            return session;
+    pthread_mutex_lock(&shard->lock);
+    session_t *session = auth_find_session(shard, hash, token);
+    
+    // Sessions from before a restart move into the live table on first use
+    if (!session && auth_ctx->restored_count > 0) {
+        session_record_t *record = auth_find_restored_session(auth_ctx, hash, token);
+        if (record && record->session.is_valid && now < record->session.expires_at) {
+            session = auth_insert_session(shard, hash, now);
+            if (session) {
+                *session = record->session;
+                record->session.is_valid = 0;
+            }
         }
     }
     
-    return NULL;
+    if (session && session->is_valid && now < session->expires_at) {
+        if (session_out) *session_out = *session;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    
+    return rc;
 }
 
 int auth_destroy_session(auth_context_t *auth_ctx, const char *token) {
     if (!auth_ctx || !token) return -1;
     
-    for (int i = 0; i < auth_ctx->session_count; i++) {
-        if (strcmp(auth_ctx->sessions[i].token, token) == 0) {
-            auth_ctx->sessions[i].is_valid = 0;
-            log_info("Session destroyed");
-            return 0;
+    if (auth_is_signed_token(token)) {
+        return auth_revoke_signed_token(auth_ctx, token);
+    }
+    
+    if (token[0] == '\0') return -1;
+    
+    uint64_t hash;
+    session_shard_t *shard = auth_session_shard(auth_ctx, token, &hash);
+    
+    if (auth_ctx->shared_sessions) {
+        if (session_shm_invalidate(auth_ctx->shared_sessions, hash, token) != 0) return -1;
+        log_info("Session destroyed");
+        return 0;
+    }
+    
+    pthread_mutex_lock(&shard->lock);
+    int destroyed = 0;
+    session_t *session = auth_find_session(shard, hash, token);
+    if (session && session->is_valid) {
+        session->is_valid = 0;
+        shard->active--;
+        destroyed = 1;
+    } else if (!session && auth_ctx->restored_count > 0) {
+        session_record_t *record = auth_find_restored_session(auth_ctx, hash, token);
+        if (record && record->session.is_valid) {
+            record->session.is_valid = 0;
+            destroyed = 1;
         }
     }
+    pthread_mutex_unlock(&shard->lock);
     
-    return -1;
+    if (!destroyed) return -1;
+    __atomic_store_n(&auth_ctx->sessions_dirty, 1, __ATOMIC_RELAXED);
+    
+    log_info("Session destroyed");
+    return 0;
 }
 
 void auth_cleanup_expired_sessions(auth_context_t *auth_ctx) {
@@ -232,11 +1258,22 @@ void auth_cleanup_expired_sessions(auth_context_t *auth_ctx) {
     time_t now = time(NULL);
     int expired_count = 0;
     
-    for (int i = 0; i < auth_ctx->session_count; i++) {
-        if (auth_ctx->sessions[i].is_valid && now >= auth_ctx->sessions[i].expires_at) {
-            auth_ctx->sessions[i].is_valid = 0;
-            expired_count++;
+    if (auth_ctx->shared_sessions) {
+        expired_count = session_shm_expire(auth_ctx->shared_sessions, now);
+    }
+    
+    for (int s = 0; s < AUTH_SHARD_COUNT; s++) {
+        session_shard_t *shard = &auth_ctx->session_shards[s];
+        
+        pthread_mutex_lock(&shard->lock);
+        for (int i = 0; i < shard->capacity; i++) {
+            if (shard->sessions[i].is_valid && now >= shard->sessions[i].expires_at) {
+                shard->sessions[i].is_valid = 0;
+                shard->active--;
+                expired_count++;
+            }
         }
+        pthread_mutex_unlock(&shard->lock);
     }
     
     if (expired_count > 0) {
@@ -244,42 +1281,260 @@ void auth_cleanup_expired_sessions(auth_context_t *auth_ctx) {
     }
 }
 
-void auth_generate_salt(char *salt, size_t length) {
-    const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+// Moves session storage into a shared memory table so that every webserver
+// process on the host can validate every session. Call once after auth_init.
+int auth_enable_shared_sessions(auth_context_t *auth_ctx, const char *name) {
+    if (!auth_ctx || !name) return -1;
+    
+    auth_ctx->shared_sessions = session_shm_open(name, AUTH_SHARED_SESSION_SLOTS);
+    if (!auth_ctx->shared_sessions) {
+        log_error("Shared sessions unavailable, keeping per-process sessions");
+        return -1;
+    }
+    
+    // The shared region outlives individual processes; the per-process
+    // snapshot is no longer consulted
+    if (auth_ctx->restored_map) {
+        munmap(auth_ctx->restored_map, auth_ctx->restored_map_size);
+        auth_ctx->restored_map = NULL;
+        auth_ctx->restored_sessions = NULL;
+        auth_ctx->restored_count = 0;
+    }
+    return 0;
+}
+
+int auth_is_signed_token(const char *token) {
+    return token && strncmp(token, SIGNED_TOKEN_PREFIX, strlen(SIGNED_TOKEN_PREFIX)) == 0;
+}
+
+static void auth_sign(auth_context_t *auth_ctx, const char *data, size_t length,
+                      uint8_t mac[SHA256_DIGEST_SIZE]) {
+    hmac_sha256(auth_ctx->jwt_secret, strlen(auth_ctx->jwt_secret), data, length, mac);
+}
+
+// Token layout: "v1." base64url(payload) "." base64url(HMAC-SHA256(secret, prefix))
+char* auth_create_signed_token(auth_context_t *auth_ctx, int user_id, int role, time_t expires_at) {
+    if (!auth_ctx || user_id <= 0) return NULL;
+    
+    uint8_t payload[SIGNED_TOKEN_PAYLOAD_SIZE];
+    uint64_t expiry = (uint64_t)expires_at;
+    uint64_t token_id = crypto_random_u64();
+    
+    for (int i = 0; i < 4; i++) payload[i] = (uint8_t)((uint32_t)user_id >> (24 - i * 8));
+    payload[4] = (uint8_t)role;
+    for (int i = 0; i < 8; i++) payload[5 + i] = (uint8_t)(expiry >> (56 - i * 8));
+    for (int i = 0; i < 8; i++) payload[13 + i] = (uint8_t)(token_id >> (56 - i * 8));
+    
+    char *token = malloc(MAX_BEARER_TOKEN_LENGTH);
+    if (!token) return NULL;
+    
+    size_t offset = strlen(SIGNED_TOKEN_PREFIX);
+    memcpy(token, SIGNED_TOKEN_PREFIX, offset);
+    offset += base64url_encode(payload, sizeof(payload), token + offset,
+                               MAX_BEARER_TOKEN_LENGTH - offset);
+    
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    auth_sign(auth_ctx, token, offset, mac);
+    
+    token[offset++] = '.';
+    base64url_encode(mac, sizeof(mac), token + offset, MAX_BEARER_TOKEN_LENGTH - offset);
+    
+    log_info("Signed token issued for user ID: %d", user_id);
+    return token;
+}
+
+static int auth_is_token_revoked(auth_context_t *auth_ctx, uint64_t token_id) {
+    revoked_table_t *table = __atomic_load_n(&auth_ctx->revoked, __ATOMIC_ACQUIRE);
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)(token_id & mask);
+    
+    // Readers never lock: writers publish expires_at before token_id
+    for (size_t probe = 0; probe < table->capacity; probe++) {
+        revoked_token_t *entry = &table->slots[(slot + probe) & mask];
+        uint64_t id = __atomic_load_n(&entry->token_id, __ATOMIC_ACQUIRE);
+        if (id == 0) return 0;
+        if (id == token_id) return 1;
+    }
+    
+    return 0;
+}
+
+// Writer side, under revoke_mutex. Entries past their token's expiry are
+// recycled in place; -1 only if every slot holds a live revocation.
+static int auth_revoked_insert(revoked_table_t *table, uint64_t token_id, time_t expires_at, time_t now) {
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)(token_id & mask);
+    
+    for (size_t probe = 0; probe < table->capacity; probe++) {
+        revoked_token_t *entry = &table->slots[(slot + probe) & mask];
+        if (entry->token_id == token_id) return 0;
+        if (entry->token_id == 0 || entry->expires_at <= now) {
+            if (entry->token_id == 0) table->used++;
+            __atomic_store_n(&entry->expires_at, expires_at, __ATOMIC_RELAXED);
+            __atomic_store_n(&entry->token_id, token_id, __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+    
+    return -1;
+}
+
+// Replaces the table with one holding only the unexpired revocations, with
+// room for as many again. Readers may still be probing the old table, so it
+// is only freed AUTH_REVOKED_GRACE seconds later. Under revoke_mutex.
+static int auth_revoked_rebuild(auth_context_t *auth_ctx, time_t now) {
+    revoked_table_t *old = auth_ctx->revoked;
+    
+    size_t live = 0;
+    for (size_t i = 0; i < old->capacity; i++) {
+        if (old->slots[i].token_id != 0 && old->slots[i].expires_at > now) live++;
+    }
+    size_t capacity = AUTH_REVOKED_INITIAL;
+    while (live * 4 >= capacity) capacity *= 2;
+    
+    revoked_table_t *table = auth_revoked_table_create(capacity);
+    if (!table) return -1;
+    for (size_t i = 0; i < old->capacity; i++) {
+        if (old->slots[i].token_id != 0 && old->slots[i].expires_at > now) {
+            auth_revoked_insert(table, old->slots[i].token_id, old->slots[i].expires_at, now);
+        }
+    }
+    
+    // Retirement times only decrease along the list, so everything after the
+    // first table past its grace period can go
+    old->retired_at = now;
+    revoked_table_t **link = &old->retired;
+    while (*link && (*link)->retired_at + AUTH_REVOKED_GRACE > now) {
+        link = &(*link)->retired;
+    }
+    while (*link) {
+        revoked_table_t *expired = *link;
+        *link = expired->retired;
+        free(expired);
+    }
+    table->retired = old;
+    
+    __atomic_store_n(&auth_ctx->revoked, table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int auth_validate_signed_token(auth_context_t *auth_ctx, const char *token,
+                               auth_token_claims_t *claims) {
+    if (!auth_ctx || !auth_is_signed_token(token)) return -1;
+    
+    const char *payload_start = token + strlen(SIGNED_TOKEN_PREFIX);
+    const char *dot = strchr(payload_start, '.');
+    if (!dot) return -1;
+    
+    uint8_t payload[SIGNED_TOKEN_PAYLOAD_SIZE];
+    if (base64url_decode(payload_start, dot - payload_start, payload, sizeof(payload)) !=
+        SIGNED_TOKEN_PAYLOAD_SIZE) {
+        return -1;
+    }
+    
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    if (base64url_decode(dot + 1, strlen(dot + 1), mac, sizeof(mac)) != SHA256_DIGEST_SIZE) {
+        return -1;
+    }
+    auth_sign(auth_ctx, token, dot - token, expected);
+    if (!crypto_equal(mac, expected, sizeof(mac))) {
+        return -2;
+    }
     
-    for (size_t i = 0; i < length - 1; i++) {
-        salt[i] = charset[rand() % (sizeof(charset) - 1)];
+    auth_token_claims_t parsed = {0};
+    uint32_t user_id = 0;
+    uint64_t expiry = 0;
+    for (int i = 0; i < 4; i++) user_id = (user_id << 8) | payload[i];
+    for (int i = 0; i < 8; i++) expiry = (expiry << 8) | payload[5 + i];
+    for (int i = 0; i < 8; i++) parsed.token_id = (parsed.token_id << 8) | payload[13 + i];
+    parsed.user_id = (int)user_id;
+    parsed.role = payload[4];
+    parsed.expires_at = (time_t)expiry;
+    
+    if (time(NULL) >= parsed.expires_at) {
+        return -3;
+    }
+    
+    if (auth_is_token_revoked(auth_ctx, parsed.token_id)) {
+        return -4;
     }
+    
+    if (claims) *claims = parsed;
+    return 0;
+}
+
+int auth_revoke_signed_token(auth_context_t *auth_ctx, const char *token) {
+    auth_token_claims_t claims;
+    if (auth_validate_signed_token(auth_ctx, token, &claims) != 0) return -1;
+    
+    // A zero id marks an empty slot
+    if (claims.token_id == 0) claims.token_id = 1;
+    
+    pthread_mutex_lock(&auth_ctx->revoke_mutex);
+    
+    time_t now = time(NULL);
+    if ((auth_ctx->revoked->used + 1) * 2 > auth_ctx->revoked->capacity &&
+        auth_revoked_rebuild(auth_ctx, now) != 0) {
+        pthread_mutex_unlock(&auth_ctx->revoke_mutex);
+        log_error("Failed to grow the token revocation table");
+        return -1;
+    }
+    // At most half full, so there is always a free slot
+    auth_revoked_insert(auth_ctx->revoked, claims.token_id, claims.expires_at, now);
+    
+    pthread_mutex_unlock(&auth_ctx->revoke_mutex);
+    __atomic_store_n(&auth_ctx->sessions_dirty, 1, __ATOMIC_RELAXED);
+    
+    log_info("Signed token revoked for user ID: %d", claims.user_id);
+    return 0;
+}
+
+void auth_generate_salt(char *salt, size_t length) {
+    crypto_random_base62(salt, length - 1);
     salt[length - 1] = '\0';
 }
 
-void auth_hash_password(const char *password, const char *salt, char *hash) {
+// Old demo hash, kept only so existing users.dat entries can still log in
+static void auth_legacy_hash_password(const char *password, const char *salt, char *hash) {
     char salted_password[512];
     snprintf(salted_password, sizeof(salted_password), "%s%s", password, salt);
     
-    // Simple hash function (not cryptographically secure, but functional for demo)
     unsigned long hash_value = 0;
     const char *str = salted_password;
     while (*str) {
         hash_value = hash_value * 33 + *str++;
     }
     
-    // Convert to hex string (simplified to 16 characters for demo)
     snprintf(hash, PASSWORD_HASH_LENGTH, "%016lx", hash_value);
 }
 
+void auth_hash_password(const char *password, const char *salt, char *hash) {
+    uint8_t derived[SHA256_DIGEST_SIZE];
+    
+    pbkdf2_hmac_sha256(password, strlen(password), salt, strlen(salt),
+                       AUTH_PBKDF2_ITERATIONS, derived, sizeof(derived));
+    
+    crypto_to_hex(derived, sizeof(derived), hash);
+    memset(derived, 0, sizeof(derived));
+}
+
 int auth_verify_password(const char *password, const char *salt, const char *hash) {
     char computed_hash[PASSWORD_HASH_LENGTH];
-    auth_hash_password(password, salt, computed_hash);
-    return strcmp(computed_hash, hash) == 0;
+    
+    if (strlen(hash) == LEGACY_HASH_LENGTH) {
+        auth_legacy_hash_password(password, salt, computed_hash);
+    } else {
+        auth_hash_password(password, salt, computed_hash);
+    }
+    
+    return crypto_equal(computed_hash, hash, strlen(computed_hash) + 1);
 }
 
+// Session tokens come from the per-thread CSPRNG, so creating them takes no
+// shared lock
 void auth_generate_token(char *token, size_t length) {
-    const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
-    
-    for (size_t i = 0; i < length - 1; i++) {
-        token[i] = charset[rand() % (sizeof(charset) - 1)];
-    }
+    crypto_random_base62(token, length - 1);
     token[length - 1] = '\0';
 }
 
@@ -292,14 +1547,17 @@ int auth_parse_bearer_token(const char *auth_header, char *token) {
     }
     
     const char *token_start = auth_header + 7;
-    strncpy(token, token_start, MAX_SESSION_TOKEN_LENGTH - 1);
-    token[MAX_SESSION_TOKEN_LENGTH - 1] = '\0';
+    strncpy(token, token_start, MAX_BEARER_TOKEN_LENGTH - 1);
+    token[MAX_BEARER_TOKEN_LENGTH - 1] = '\0';
     
     return 0;
 }
 
-int auth_require_login(http_request_t *request, http_response_t *response, 
-                       auth_context_t *auth_ctx) {
+// Resolves the caller's user id and current role. Signed tokens are checked
+// without taking a lock, but the account is re-read so deactivation and role
+// changes apply to tokens already issued.
+static int auth_authorize_request(http_request_t *request, http_response_t *response,
+                                  auth_context_t *auth_ctx, int *role) {
     const char *auth_header = http_request_get_header(request, "Authorization");
     
     if (!auth_header) {
@@ -309,7 +1567,7 @@ int auth_require_login(http_request_t *request, http_response_t *response,
         return -1;
     }
     
-    char token[MAX_SESSION_TOKEN_LENGTH];
+    char token[MAX_BEARER_TOKEN_LENGTH];
     if (auth_parse_bearer_token(auth_header, token) != 0) {
         http_response_set_status(response, 401);
         http_response_set_header(response, "Content-Type", "application/json");
@@ -317,24 +1575,51 @@ int auth_require_login(http_request_t *request, http_response_t *response,
         return -1;
     }
     
-    session_t *session = auth_validate_session(auth_ctx, token);
-    if (!session) {
+    int user_id;
+    if (auth_is_signed_token(token)) {
+        auth_token_claims_t claims;
+        if (auth_validate_signed_token(auth_ctx, token, &claims) != 0) {
+            http_response_set_status(response, 401);
+            http_response_set_header(response, "Content-Type", "application/json");
+            http_response_set_body(response, "{\"error\":\"Invalid or expired session\"}");
+            return -1;
+        }
+        user_id = claims.user_id;
+    } else {
+        session_t session;
+        if (auth_validate_session(auth_ctx, token, &session) != 0) {
+            http_response_set_status(response, 401);
+            http_response_set_header(response, "Content-Type", "application/json");
+            http_response_set_body(response, "{\"error\":\"Invalid or expired session\"}");
+            return -1;
+        }
+        user_id = session.user_id;
+    }
+    
+    int current_role, is_active;
+    if (auth_user_access(auth_ctx, user_id, &current_role, &is_active) != 0 || !is_active) {
         http_response_set_status(response, 401);
         http_response_set_header(response, "Content-Type", "application/json");
         http_response_set_body(response, "{\"error\":\"Invalid or expired session\"}");
         return -1;
     }
     
-    return session->user_id;
+    if (role) *role = current_role;
+    return user_id;
+}
+
+int auth_require_login(http_request_t *request, http_response_t *response, 
+                       auth_context_t *auth_ctx) {
+    return auth_authorize_request(request, response, auth_ctx, NULL);
 }
 
 int auth_require_admin(http_request_t *request, http_response_t *response, 
                        auth_context_t *auth_ctx) {
-    int user_id = auth_require_login(request, response, auth_ctx);
+    int role = -1;
+    int user_id = auth_authorize_request(request, response, auth_ctx, &role);
     if (user_id < 0) return user_id;
     
-    user_t *user = auth_get_user_by_id(auth_ctx, user_id);
-    if (!user || user->role != 1) {
+    if (role != 1) {
         http_response_set_status(response, 403);
         http_response_set_header(response, "Content-Type", "application/json");
         http_response_set_body(response, "{\"error\":\"Admin access required\"}");
@@ -344,28 +1629,48 @@ int auth_require_admin(http_request_t *request, http_response_t *response,
     return user_id;
 }
 
-int auth_save_users(auth_context_t *auth_ctx, const char *filename) {
-    if (!auth_ctx || !filename) return -1;
-    
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        log_error("Failed to open users file for writing: %s", filename);
+// Checkpoints the user store: flushes its records and publishes a header
+// naming the first journal generation not covered, then drops the journal
+// generations before it.
+int auth_save_users(auth_context_t *auth_ctx) {
+    if (!auth_ctx || !auth_ctx->user_store) return -1;
+    
+    pthread_mutex_lock(&auth_ctx->save_mutex);
+    pthread_mutex_lock(&auth_ctx->users_mutex);
+    
+    // Every mutation journaled before the rotation is already in the mapping;
+    // later ones may reach the file too, and replaying them is idempotent
+    uint64_t generation = auth_ctx->snapshot_generation;
+    if (auth_ctx->journal && journal_rotate(auth_ctx->journal, &generation) != 0) {
+        pthread_mutex_unlock(&auth_ctx->users_mutex);
+        pthread_mutex_unlock(&auth_ctx->save_mutex);
+        log_error("Failed to rotate user journal");
         return -1;
     }
+    int user_count = auth_ctx->user_count;
     
-    // Write user count
-    fwrite(&auth_ctx->user_count, sizeof(int), 1, file);
+    pthread_mutex_unlock(&auth_ctx->users_mutex);
     
-    // Write users
-    fwrite(auth_ctx->users, sizeof(user_t), auth_ctx->user_count, file);
+    if (user_store_checkpoint(auth_ctx->user_store, (uint64_t)user_count, generation) != 0) {
+        pthread_mutex_unlock(&auth_ctx->save_mutex);
+        log_error("Failed to checkpoint user store");
+        return -1;
+    }
     
-    fclose(file);
-    log_info("Saved %d users to %s", auth_ctx->user_count, filename);
+    auth_ctx->snapshot_generation = generation;
+    if (auth_ctx->journal) {
+        journal_discard_before(auth_ctx->journal, generation);
+    }
+    
+    pthread_mutex_unlock(&auth_ctx->save_mutex);
+    log_info("Checkpointed %d users to %s", user_count, AUTH_USER_STORE_FILE);
     return 0;
 }
 
+// Imports a users.dat snapshot written by earlier versions into the empty
+// user store. Returns the number of users imported.
 int auth_load_users(auth_context_t *auth_ctx, const char *filename) {
-    if (!auth_ctx || !filename) return -1;
+    if (!auth_ctx || !auth_ctx->user_store || !filename) return -1;
     
     FILE *file = fopen(filename, "rb");
     if (!file) {
@@ -373,30 +1678,241 @@ int auth_load_users(auth_context_t *auth_ctx, const char *filename) {
         return 0;  // Not an error, just no existing users
     }
     
-    // Read user count
-    if (fread(&auth_ctx->user_count, sizeof(int), 1, file) != 1) {
+    // Read the header, or the user count of the original format
+    users_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    if (fread(&header.magic, sizeof(header.magic), 1, file) != 1) {
         log_error("Failed to read user count from file");
         fclose(file);
         return -1;
     }
     
+    if (header.magic == USERS_SNAPSHOT_MAGIC) {
+        if (fread((char *)&header + sizeof(header.magic), sizeof(header) - sizeof(header.magic),
+                  1, file) != 1 || header.version != USERS_SNAPSHOT_VERSION) {
+            log_error("Unsupported users snapshot header in %s", filename);
+            fclose(file);
+            return -1;
+        }
+    } else {
+        header.user_count = (int32_t)header.magic;
+    }
+    
     // Validate user count
-    if (auth_ctx->user_count > MAX_USERS) {
-        log_error("Invalid user count in file: %d", auth_ctx->user_count);
+    if (header.user_count < 0 || header.user_count > MAX_USERS ||
+        user_store_reserve(auth_ctx->user_store, (uint64_t)header.user_count) != 0) {
+        log_error("Invalid user count in file: %d", header.user_count);
         fclose(file);
         return -1;
     }
     
-    // Read users
-    if (fread(auth_ctx->users, sizeof(user_t), auth_ctx->user_count, file) != 
-        (size_t)auth_ctx->user_count) {
+    // Read users straight into the store
+    user_t *users = auth_user_record(auth_ctx, 1);
+    if (fread(users, sizeof(user_t), header.user_count, file) != (size_t)header.user_count) {
         log_error("Failed to read users from file");
+        memset(users, 0, sizeof(user_t) * header.user_count);
         fclose(file);
         return -1;
     }
-    
     fclose(file);
+    
+    if (header.magic == USERS_SNAPSHOT_MAGIC &&
+        crc32_compute(users, sizeof(user_t) * header.user_count) != header.crc) {
+        log_error("Users snapshot checksum mismatch in %s", filename);
+        memset(users, 0, sizeof(user_t) * header.user_count);
+        return -1;
+    }
+    
+    auth_ctx->user_count = header.user_count;
+    auth_ctx->snapshot_generation = header.generation;
     log_info("Loaded %d users from %s", auth_ctx->user_count, filename);
+    return auth_ctx->user_count;
+}
+
+static int auth_compare_session_records(const void *a, const void *b) {
+    uint64_t x = ((const session_record_t *)a)->token_hash;
+    uint64_t y = ((const session_record_t *)b)->token_hash;
+    return (x > y) - (x < y);
+}
+
+// Appends a live session to a growing snapshot array
+static int auth_push_session_record(session_record_t **records, size_t *count,
+                                    size_t *capacity, uint64_t hash, const session_t *session) {
+    if (*count == *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 256;
+        session_record_t *grown = realloc(*records, grown_capacity * sizeof(session_record_t));
+        if (!grown) return -1;
+        *records = grown;
+        *capacity = grown_capacity;
+    }
+    
+    session_record_t *record = &(*records)[(*count)++];
+    memset(record, 0, sizeof(*record));
+    record->token_hash = hash;
+    record->session = *session;
+    return 0;
+}
+
+// Writes every unexpired session, including restored ones not used yet,
+// sorted by token hash so the next start can binary search the file in place.
+// Sessions in shared memory outlive the process and are not saved, but
+// revocations of signed tokens are: the token secret survives restarts, so
+// a logged-out token would otherwise become valid again.
+int auth_save_sessions(auth_context_t *auth_ctx, const char *filename) {
+    if (!auth_ctx || !filename) return -1;
+    
+    session_record_t *records = NULL;
+    size_t count = 0, capacity = 0;
+    time_t now = time(NULL);
+    int ok = 1;
+    
+    for (int s = 0; s < AUTH_SHARD_COUNT && ok && !auth_ctx->shared_sessions; s++) {
+        session_shard_t *shard = &auth_ctx->session_shards[s];
+        
+        pthread_mutex_lock(&shard->lock);
+        for (int i = 0; i < shard->capacity && ok; i++) {
+            session_t *session = &shard->sessions[i];
+            if (session->is_valid && now < session->expires_at) {
+                ok = auth_push_session_record(&records, &count, &capacity,
+                                              auth_hash_string(session->token), session) == 0;
+            }
+        }
+        for (size_t i = 0; i < auth_ctx->restored_count && ok; i++) {
+            session_record_t *record = &auth_ctx->restored_sessions[i];
+            if ((record->token_hash & (AUTH_SHARD_COUNT - 1)) == (uint64_t)s &&
+                record->session.is_valid && now < record->session.expires_at) {
+                ok = auth_push_session_record(&records, &count, &capacity,
+                                              record->token_hash, &record->session) == 0;
+            }
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    // Copy the table while writers are held off; readers don't matter here
+    revoked_token_t *revoked = NULL;
+    size_t revoked_count = 0;
+    if (ok) {
+        pthread_mutex_lock(&auth_ctx->revoke_mutex);
+        revoked_table_t *table = auth_ctx->revoked;
+        revoked = malloc(table->used * sizeof(revoked_token_t) + 1);
+        ok = revoked != NULL;
+        for (size_t i = 0; i < table->capacity && ok; i++) {
+            if (table->slots[i].token_id != 0 && table->slots[i].expires_at > now) {
+                revoked[revoked_count++] = table->slots[i];
+            }
+        }
+        pthread_mutex_unlock(&auth_ctx->revoke_mutex);
+    }
+    
+    if (!ok) {
+        free(records);
+        free(revoked);
+        log_error("Failed to allocate memory for session snapshot");
+        return -1;
+    }
+    
+    qsort(records, count, sizeof(session_record_t), auth_compare_session_records);
+    
+    sessions_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SESSIONS_SNAPSHOT_MAGIC;
+    header.version = SESSIONS_SNAPSHOT_VERSION;
+    header.record_size = sizeof(session_record_t);
+    header.revoked_count = (uint32_t)revoked_count;
+    header.count = count;
+    header.crc = crc32_compute(&header, offsetof(sessions_snapshot_header_t, crc));
+    
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    
+    FILE *file = fopen(temp_filename, "wb");
+    if (!file) {
+        free(records);
+        free(revoked);
+        log_error("Failed to open sessions file for writing: %s", temp_filename);
+        return -1;
+    }
+    
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(records, sizeof(session_record_t), count, file) == count &&
+         fwrite(revoked, sizeof(revoked_token_t), revoked_count, file) == revoked_count &&
+         fflush(file) == 0 &&
+         fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    free(records);
+    free(revoked);
+    
+    if (!ok || rename(temp_filename, filename) != 0) {
+        unlink(temp_filename);
+        log_error("Failed to write sessions snapshot: %s", filename);
+        return -1;
+    }
+    sync_parent_directory(filename);
+    
+    log_info("Saved %zu sessions and %zu revoked tokens to %s", count, revoked_count, filename);
+    return 0;
+}
+
+// Maps a session snapshot privately. Only the header is checked here, so
+// startup cost doesn't depend on the number of sessions; entries are found
+// by binary search when a token misses the live table. Revocations are
+// copied into the revocation table right away.
+int auth_load_sessions(auth_context_t *auth_ctx, const char *filename) {
+    if (!auth_ctx || !filename) return -1;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;  // No snapshot yet
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(sessions_snapshot_header_t)) {
+        close(fd);
+        log_warning("Ignoring truncated sessions snapshot %s", filename);
+        return -1;
+    }
+    
+    // Private and writable: consumed entries are marked in place, never on disk
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_error("Failed to map sessions snapshot %s: %s", filename, strerror(errno));
+        return -1;
+    }
+    
+    const sessions_snapshot_header_t *header = (const sessions_snapshot_header_t *)map;
+    size_t payload = (size_t)st.st_size - sizeof(*header);
+    if (header->magic != SESSIONS_SNAPSHOT_MAGIC ||
+        (header->version != 1 && header->version != SESSIONS_SNAPSHOT_VERSION) ||
+        header->record_size != sizeof(session_record_t) ||
+        header->crc != crc32_compute(header, offsetof(sessions_snapshot_header_t, crc)) ||
+        header->count > payload / sizeof(session_record_t) ||
+        payload != header->count * sizeof(session_record_t) +
+                   (size_t)header->revoked_count * sizeof(revoked_token_t)) {
+        munmap(map, (size_t)st.st_size);
+        log_warning("Ignoring invalid sessions snapshot %s", filename);
+        return -1;
+    }
+    
+    const revoked_token_t *revoked = (const revoked_token_t *)
+        ((char *)map + sizeof(*header) + header->count * sizeof(session_record_t));
+    time_t now = time(NULL);
+    pthread_mutex_lock(&auth_ctx->revoke_mutex);
+    for (uint32_t i = 0; i < header->revoked_count; i++) {
+        if (revoked[i].expires_at <= now) continue;
+        if ((auth_ctx->revoked->used + 1) * 2 > auth_ctx->revoked->capacity &&
+            auth_revoked_rebuild(auth_ctx, now) != 0) {
+            log_error("Failed to restore all revoked tokens from %s", filename);
+            break;
+        }
+        auth_revoked_insert(auth_ctx->revoked, revoked[i].token_id, revoked[i].expires_at, now);
+    }
+    pthread_mutex_unlock(&auth_ctx->revoke_mutex);
+    
+    auth_ctx->restored_map = map;
+    auth_ctx->restored_map_size = (size_t)st.st_size;
+    auth_ctx->restored_sessions = (session_record_t *)((char *)map + sizeof(*header));
+    auth_ctx->restored_count = (size_t)header->count;
+    
+    log_info("Mapped %zu sessions from %s", auth_ctx->restored_count, filename);
     return 0;
 }
 
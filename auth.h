@@ -4,8 +4,13 @@
 #include <time.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <pthread.h>
+#include "compute_pool.h"
+#include "journal.h"
+#include "user_store.h"
 
 // Forward declarations
+struct session_shm;
 struct http_request;
 struct http_response;
 typedef struct http_request http_request_t;
@@ -15,10 +20,31 @@ typedef struct http_response http_response_t;
 #define MAX_PASSWORD_LENGTH 256
 #define MAX_EMAIL_LENGTH 128
 #define MAX_SESSION_TOKEN_LENGTH 64
-#define MAX_USERS 1000
-#define MAX_SESSIONS 1000
+#define MAX_BEARER_TOKEN_LENGTH 128  // Large enough for signed tokens
+#define MAX_USERS 1000  // Capacity of the legacy users.dat format, used only for import
 #define SESSION_DURATION 3600  // 1 hour in seconds
 #define PASSWORD_HASH_LENGTH 65  // SHA-256 hex string + null terminator
+#define LEGACY_HASH_LENGTH 16  // Hex digits of the old djb2 password hash
+#define AUTH_PBKDF2_ITERATIONS 100000
+#define AUTH_HASH_QUEUE_LIMIT 64  // Logins waiting for a hash thread before 503
+#define AUTH_USERS_FILE "users.dat"      // Legacy snapshot, imported once into the store
+#define AUTH_USER_STORE_FILE "users.db"
+#define AUTH_SESSIONS_FILE "sessions.dat"
+#define AUTH_SHARED_SESSIONS_NAME "/cserver-sessions"  // POSIX shared memory object
+#define AUTH_SHARED_SESSION_SLOTS 65536  // Power of two; fixed once the region exists
+#define AUTH_KEY_FILE "auth.key"        // Generated token secret when AUTH_JWT_SECRET is unset
+#define AUTH_JOURNAL_FILE "users.journal"
+#define AUTH_SNAPSHOT_INTERVAL 60     // Seconds between background snapshots
+#define AUTH_SNAPSHOT_RECORDS 1000    // Journal records that trigger one early
+#define AUTH_SHARD_COUNT 16           // Power of two
+#define AUTH_INDEX_SHARD_INITIAL 16   // Power of two, username index slots per shard at start
+#define AUTH_SESSION_SHARD_INITIAL 16 // Power of two, session slots per shard at start
+#define AUTH_LIST_DEFAULT_LIMIT 100
+#define AUTH_LIST_MAX_LIMIT 1000     // Users in one page of a listing
+#define AUTH_LIST_SCAN_LIMIT 10000   // Records examined per page before returning a short one
+#define AUTH_REVOKED_INITIAL 1024  // Power of two, slots in the first revocation table
+#define AUTH_REVOKED_GRACE 60      // Seconds a replaced revocation table stays readable
+#define SIGNED_TOKEN_PREFIX "v1."
 
 // User structure
 typedef struct {
@@ -43,13 +69,105 @@ typedef struct {
     int is_valid;
 } session_t;
 
+// Session snapshot entry; files keep these sorted by token_hash
+typedef struct {
+    uint64_t token_hash;
+    session_t session;
+} session_record_t;
+
+// One shard of the username -> user id index; doubles when 3/4 full
+typedef struct {
+    pthread_rwlock_t lock;
+    int *slots;     // User ids, 0 = empty, -1 = tombstone
+    int capacity;   // Power of two
+    int count;
+    int used;       // Live entries plus tombstones
+} user_index_shard_t;
+
+// One shard of the session store, an open-addressed table keyed by token hash
+typedef struct {
+    pthread_mutex_t lock;
+    session_t *sessions;
+    int capacity;   // Power of two
+    int active;
+    int used;       // Slots that have ever held a token
+} session_shard_t;
+
+// Claims carried by a signed token
+typedef struct {
+    int user_id;
+    int role;
+    time_t expires_at;
+    uint64_t token_id;
+} auth_token_claims_t;
+
+// Revoked signed token, kept until the token would have expired anyway
+typedef struct {
+    uint64_t token_id;
+    time_t expires_at;
+} revoked_token_t;
+
+// Open-addressed revocation table, probed by readers without locking. When
+// it is half full it is replaced by one sized for the live entries; the old
+// table stays readable for AUTH_REVOKED_GRACE seconds before it is freed.
+typedef struct revoked_table {
+    size_t capacity;               // Power of two
+    size_t used;                   // Occupied slots, expired ones included
+    time_t retired_at;
+    struct revoked_table *retired; // Replaced tables not yet freed
+    revoked_token_t slots[];
+} revoked_table_t;
+
+// Filters for auth_list_users(); -1 or NULL matches anything
+typedef struct {
+    int role;
+    int is_active;
+    const char *username_prefix;
+    const char *email_prefix;
+} auth_user_filter_t;
+
 // Authentication context
+//
+// Concurrency: user records live in a memory-mapped store and are read
+// lock-free. user_count is published with release semantics after a record is
+// filled in, and later field updates are bracketed by a per-record seqlock
+// (user_store->seq) under a striped writer mutex. Username lookups go through
+// a sharded index guarded by reader/writer locks, and sessions live in
+// independently locked shards.
 typedef struct {
-    user_t users[MAX_USERS];
-    session_t sessions[MAX_SESSIONS];
+    user_store_t *user_store;                      // Records, indexed by user_id - 1
+    pthread_mutex_t user_locks[AUTH_SHARD_COUNT];  // Striped record writer locks
+    user_index_shard_t user_index[AUTH_SHARD_COUNT];
+    session_shard_t session_shards[AUTH_SHARD_COUNT];
     int user_count;
-    int session_count;
     char jwt_secret[65];  // Secret for token signing
+    int signed_tokens;    // Issue stateless signed tokens instead of sessions
+    revoked_table_t *revoked;      // Replaced atomically as it grows
+    pthread_mutex_t revoke_mutex;  // Serializes revocation writers only
+    compute_pool_t *hash_pool;     // Runs password hashing off connection threads
+    journal_t *journal;            // Write-ahead log of user mutations
+    uint64_t snapshot_generation;  // First journal generation not in the store checkpoint
+    pthread_mutex_t users_mutex;   // Serializes registrations (id assignment)
+    pthread_mutex_t save_mutex;    // Serializes snapshots
+    pthread_mutex_t snapshot_mutex;
+    pthread_cond_t snapshot_cond;
+    pthread_t snapshot_thread;
+    int snapshot_running;
+    pthread_t index_thread;        // Builds the username index after startup
+    int index_building;            // index_thread needs joining
+    void *restored_map;            // Private mapping of the session snapshot
+    size_t restored_map_size;
+    session_record_t *restored_sessions;  // Not yet moved into session_shards
+    size_t restored_count;
+    int sessions_dirty;            // Sessions changed since the last snapshot
+    struct session_shm *shared_sessions;  // Replaces session_shards when set
+    int index_ready;               // Until set, lookups scan the store
+    pthread_rwlock_t sorted_lock;  // Guards the sorted indexes
+    int *by_username;              // User ids ordered by username, for prefix listings
+    int *by_email;                 // User ids ordered by email, then id
+    int sorted_count;
+    int sorted_capacity;
+    int sorted_ready;              // Set by the index thread once both are complete
 } auth_context_t;
 
 // Authentication functions
@@ -63,12 +181,24 @@ int auth_authenticate_user(auth_context_t *auth_ctx, const char *username,
                           const char *password);
 user_t* auth_get_user_by_id(auth_context_t *auth_ctx, int user_id);
 user_t* auth_get_user_by_username(auth_context_t *auth_ctx, const char *username);
+int auth_get_user_copy(auth_context_t *auth_ctx, int user_id, user_t *user_out);
+int auth_get_user_count(auth_context_t *auth_ctx);
+int auth_list_users(auth_context_t *auth_ctx, const auth_user_filter_t *filter, int cursor,
+                    int limit, user_t *users_out, int *next_cursor);
 
 // Session management
 char* auth_create_session(auth_context_t *auth_ctx, int user_id, const char *ip_address);
-session_t* auth_validate_session(auth_context_t *auth_ctx, const char *token);
+int auth_validate_session(auth_context_t *auth_ctx, const char *token, session_t *session_out);
 int auth_destroy_session(auth_context_t *auth_ctx, const char *token);
 void auth_cleanup_expired_sessions(auth_context_t *auth_ctx);
+int auth_enable_shared_sessions(auth_context_t *auth_ctx, const char *name);
+
+// Signed (stateless) tokens
+int auth_is_signed_token(const char *token);
+char* auth_create_signed_token(auth_context_t *auth_ctx, int user_id, int role, time_t expires_at);
+int auth_validate_signed_token(auth_context_t *auth_ctx, const char *token,
+                               auth_token_claims_t *claims);
+int auth_revoke_signed_token(auth_context_t *auth_ctx, const char *token);
 
 // Password utilities
 void auth_generate_salt(char *salt, size_t length);
@@ -86,8 +216,10 @@ int auth_require_admin(http_request_t *request, http_response_t *response,
                        auth_context_t *auth_ctx);
 
 // Data persistence
-int auth_save_users(auth_context_t *auth_ctx, const char *filename);
+int auth_save_users(auth_context_t *auth_ctx);
 int auth_load_users(auth_context_t *auth_ctx, const char *filename);
+int auth_save_sessions(auth_context_t *auth_ctx, const char *filename);
+int auth_load_sessions(auth_context_t *auth_ctx, const char *filename);
 
 // Utility functions
 const char* auth_get_role_name(int role);
@@ -0,0 +1,172 @@
+#include "bench.h"
+#include "addresses6.h"
+#include <pthread.h>
+#include <string.h>
+
+// IPv6 prefix delegation with a million /64s assigned out of a /32: the fill
+// rate, lookups of assigned prefixes, release-and-allocate churn at that
+// occupancy, and the memory the sparse pages and records take per prefix.
+// Allocations and releases wait for their journal group commit, so they run
+// on several threads; pass the prefix count and thread count to change them.
+//
+//   address6_bench [prefixes] [threads]
+
+#define BENCH_POOL 1
+#define BENCH_LOOKUP_SECONDS 2.0
+#define BENCH_CHURN_SECONDS 3.0
+
+static ip6_context_t ip_ctx;
+static struct in6_addr *prefixes;  // Every assigned prefix, filled by slice
+static long prefix_count;
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    long first;                    // Slice of prefixes[] this thread owns
+    long count;
+    volatile int *stop;
+    unsigned long operations;
+    unsigned long failures;
+} bench_worker_t;
+
+static void *bench_fill_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    char owner[32];
+    snprintf(owner, sizeof(owner), "vps-%d", worker->index);
+
+    int length;
+    for (long i = worker->first; i < worker->first + worker->count; i++) {
+        if (address6_allocate(&ip_ctx, BENCH_POOL, owner, &prefixes[i], &length) != 0) {
+            worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void *bench_lookup_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    uint64_t state = 0x9e3779b97f4a7c15ULL * (uint64_t)(worker->index + 1);
+    ip6_t ip;
+
+    while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        long i = (long)(state % (uint64_t)prefix_count);
+        if (address6_lookup(&ip_ctx, &prefixes[i], &ip) != 0 || !ip.is_used) worker->failures++;
+        worker->operations++;
+    }
+    return NULL;
+}
+
+// Releases this thread's prefixes in turn and allocates a replacement for
+// each, so occupancy stays at prefix_count
+static void *bench_churn_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    char owner[32];
+    snprintf(owner, sizeof(owner), "vps-%d", worker->index);
+
+    int length;
+    for (long n = 0; !__atomic_load_n(worker->stop, __ATOMIC_RELAXED); n++) {
+        struct in6_addr *prefix = &prefixes[worker->first + n % worker->count];
+        if (address6_release(&ip_ctx, prefix) != 0 ||
+            address6_allocate(&ip_ctx, BENCH_POOL, owner, prefix, &length) != 0) {
+            worker->failures++;
+        }
+        worker->operations++;
+    }
+    return NULL;
+}
+
+static double bench_run(void *(*run)(void *), bench_worker_t *workers, int threads, double seconds,
+                        unsigned long *operations, unsigned long *failures) {
+    volatile int stop = 0;
+    double start = bench_now();
+    for (int i = 0; i < threads; i++) {
+        workers[i].stop = &stop;
+        workers[i].operations = 0;
+        workers[i].failures = 0;
+        pthread_create(&workers[i].thread, NULL, run, &workers[i]);
+    }
+    if (seconds > 0) {
+        struct timespec duration = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+        nanosleep(&duration, NULL);
+        __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    }
+
+    *operations = 0;
+    *failures = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        *operations += workers[i].operations;
+        *failures += workers[i].failures;
+    }
+    return bench_now() - start;
+}
+
+int main(int argc, char **argv) {
+    prefix_count = argc > 1 ? atol(argv[1]) : 1000000;
+    int threads = argc > 2 ? atoi(argv[2]) : 16;
+    if (prefix_count < 1 || threads < 1) return 1;
+
+    bench_enter_scratch_dir();
+    if (address6_init(&ip_ctx) != 0 ||
+        address6_create_pool(&ip_ctx, BENCH_POOL, "bench", "2001:db8::/32", 64) != 0) {
+        fprintf(stderr, "Failed to set up the IPv6 pool\n");
+        return 1;
+    }
+
+    prefixes = calloc((size_t)prefix_count, sizeof(struct in6_addr));
+    bench_worker_t *workers = calloc((size_t)threads, sizeof(bench_worker_t));
+    if (!prefixes || !workers) return 1;
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        workers[i].first = prefix_count * i / threads;
+        workers[i].count = prefix_count * (i + 1) / threads - workers[i].first;
+    }
+
+    unsigned long operations, failures;
+    printf("%ld /64 prefixes from 2001:db8::/32, %d threads\n", prefix_count, threads);
+
+    double elapsed = bench_run(bench_fill_run, workers, threads, 0, &operations, &failures);
+    printf("fill       %10.0f allocations/s\n", prefix_count / elapsed);
+    if (failures > 0 || address6_get_used(&ip_ctx, BENCH_POOL) != prefix_count) {
+        fprintf(stderr, "Fill failed: %lu errors, %lld used\n", failures,
+                (long long)address6_get_used(&ip_ctx, BENCH_POOL));
+        return 1;
+    }
+
+    // Pages, records and the interned owners with their names
+    pool6_t *pool = ip_ctx.pools[BENCH_POOL];
+    address6_owner_table_t *owners = &ip_ctx.owners;
+    size_t bytes = pool->page_buckets * sizeof(address6_page_t *) +
+                   (size_t)pool->page_count * sizeof(address6_page_t) +
+                   pool->record_buckets * sizeof(address6_record_t) +
+                   owners->capacity * sizeof(address6_owner_t) +
+                   owners->bucket_count * sizeof(uint32_t);
+    int owner_count = 0;
+    for (uint32_t i = 1; i < owners->capacity; i++) {
+        if (!owners->entries[i].name) continue;
+        bytes += strlen(owners->entries[i].name) + 1;
+        owner_count++;
+    }
+    printf("memory     %10.1f bytes/prefix (%u pages, %u record buckets, %d owners)\n",
+           (double)bytes / prefix_count, pool->page_count, pool->record_buckets, owner_count);
+
+    elapsed = bench_run(bench_lookup_run, workers, 1, BENCH_LOOKUP_SECONDS, &operations, &failures);
+    printf("lookup     %10.0f lookups/s, 1 thread\n", operations / elapsed);
+    elapsed = bench_run(bench_lookup_run, workers, threads, BENCH_LOOKUP_SECONDS,
+                        &operations, &failures);
+    printf("lookup     %10.0f lookups/s, %d threads\n", operations / elapsed, threads);
+    if (failures > 0) fprintf(stderr, "  %lu lookups missed\n", failures);
+
+    elapsed = bench_run(bench_churn_run, workers, threads, BENCH_CHURN_SECONDS,
+                        &operations, &failures);
+    printf("churn      %10.0f release+allocate pairs/s\n", operations / elapsed);
+    if (failures > 0) fprintf(stderr, "  %lu churn operations failed\n", failures);
+
+    free(workers);
+    free(prefixes);
+    address6_cleanup(&ip_ctx);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "bench.h"
+#include "addresses.h"
+#include <pthread.h>
+#include <string.h>
+
+// Concurrent allocate and release on one /16 pool, from one thread up to one
+// per core (or the count given on the command line). Every operation waits
+// for its journal group commit, as it does behind the HTTP API.
+
+#define BENCH_OPERATIONS 16384  // Addresses allocated, then released, per run
+
+static ip_context_t ip_ctx;
+
+typedef struct {
+    pthread_t thread;
+    int count;
+    unsigned int *ips;
+    int failures;
+} bench_worker_t;
+
+static pthread_barrier_t barrier;
+static double phase_start[3];
+
+static void bench_phase(int phase) {
+    // The last thread through the barrier stamps the phase boundary
+    if (pthread_barrier_wait(&barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+        phase_start[phase] = bench_now();
+    }
+    pthread_barrier_wait(&barrier);
+}
+
+static void *bench_worker_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    char owner[32];
+    snprintf(owner, sizeof(owner), "bench-%p", (void *)worker);
+
+    bench_phase(0);
+    for (int i = 0; i < worker->count; i++) {
+        worker->ips[i] = address_allocate_ip(&ip_ctx, 1, owner);
+        if (worker->ips[i] == 0) worker->failures++;
+    }
+    bench_phase(1);
+    for (int i = 0; i < worker->count; i++) {
+        if (worker->ips[i] != 0 && address_release_ip(&ip_ctx, worker->ips[i]) != 0) {
+            worker->failures++;
+        }
+    }
+    bench_phase(2);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : bench_cpu_count();
+    if (max_threads < 1) max_threads = 1;
+
+    bench_enter_scratch_dir();
+    if (address_init(&ip_ctx) != 0 ||
+        address_create_pool(&ip_ctx, 1, "bench", "10.0.0.0", "255.255.0.0") != 0) {
+        fprintf(stderr, "Failed to set up the IP pool\n");
+        return 1;
+    }
+
+    printf("%d allocations then releases per run\n", BENCH_OPERATIONS);
+    printf("%7s %14s %14s\n", "threads", "allocations/s", "releases/s");
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        bench_worker_t *workers = calloc((size_t)threads, sizeof(bench_worker_t));
+        pthread_barrier_init(&barrier, NULL, (unsigned)threads);
+        for (int i = 0; i < threads; i++) {
+            workers[i].count = BENCH_OPERATIONS / threads;
+            workers[i].ips = calloc((size_t)workers[i].count, sizeof(unsigned int));
+            pthread_create(&workers[i].thread, NULL, bench_worker_run, &workers[i]);
+        }
+
+        int operations = 0, failures = 0;
+        for (int i = 0; i < threads; i++) {
+            pthread_join(workers[i].thread, NULL);
+            operations += workers[i].count;
+            failures += workers[i].failures;
+            free(workers[i].ips);
+        }
+        pthread_barrier_destroy(&barrier);
+        free(workers);
+
+        printf("%7d %14.0f %14.0f\n", threads,
+               operations / (phase_start[1] - phase_start[0]),
+               operations / (phase_start[2] - phase_start[1]));
+        if (failures > 0) fprintf(stderr, "  %d operations failed\n", failures);
+        if (address_get_used_ips(&ip_ctx, 1) != 0) {
+            fprintf(stderr, "  pool not empty after releases: %d used\n",
+                    address_get_used_ips(&ip_ctx, 1));
+            return 1;
+        }
+        if (threads == max_threads) break;
+    }
+
+    address_cleanup(&ip_ctx);
+    return 0;
+}
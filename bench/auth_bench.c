@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "auth.h"
+#include <pthread.h>
+#include <string.h>
+
+// Login and token validation throughput from one thread up to one per core
+// (or the count given on the command line). Login is dominated by PBKDF2 on
+// the hash pool; validation should scale with cores since it only takes a
+// shard lock (sessions) or no lock at all (signed tokens).
+
+#define BENCH_USERS 4
+#define BENCH_TOKENS 1024
+#define BENCH_PASSWORD "Password123!"
+
+static auth_context_t auth_ctx;
+static char *session_tokens[BENCH_TOKENS];
+static char *signed_tokens[BENCH_TOKENS];
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    int (*op)(int index, unsigned long iteration);
+    volatile int *stop;
+    unsigned long count;
+    unsigned long failures;
+} bench_worker_t;
+
+static int op_login(int index, unsigned long iteration) {
+    char username[32];
+    snprintf(username, sizeof(username), "benchuser%d", (int)((index + iteration) % BENCH_USERS));
+    int user_id = auth_authenticate_user(&auth_ctx, username, BENCH_PASSWORD);
+    if (user_id <= 0) return -1;
+    char *token = auth_create_session(&auth_ctx, user_id, "127.0.0.1");
+    if (!token) return -1;
+    auth_destroy_session(&auth_ctx, token);
+    free(token);
+    return 0;
+}
+
+static int op_validate_session(int index, unsigned long iteration) {
+    session_t session;
+    return auth_validate_session(&auth_ctx, session_tokens[(index * 131 + iteration) % BENCH_TOKENS],
+                                 &session);
+}
+
+static int op_validate_signed(int index, unsigned long iteration) {
+    auth_token_claims_t claims;
+    return auth_validate_signed_token(&auth_ctx, signed_tokens[(index * 131 + iteration) % BENCH_TOKENS],
+                                      &claims);
+}
+
+static void *bench_worker_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    unsigned long iteration = 0;
+    while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+        if (worker->op(worker->index, iteration++) != 0) worker->failures++;
+    }
+    worker->count = iteration;
+    return NULL;
+}
+
+// Runs op on `threads` threads for `seconds` and returns operations per second
+static double bench_run(int (*op)(int, unsigned long), int threads, double seconds) {
+    bench_worker_t *workers = calloc((size_t)threads, sizeof(bench_worker_t));
+    volatile int stop = 0;
+
+    double start = bench_now();
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        workers[i].op = op;
+        workers[i].stop = &stop;
+        pthread_create(&workers[i].thread, NULL, bench_worker_run, &workers[i]);
+    }
+    struct timespec duration = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&duration, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    unsigned long total = 0, failures = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total += workers[i].count;
+        failures += workers[i].failures;
+    }
+    double elapsed = bench_now() - start;
+    free(workers);
+
+    if (failures > 0) fprintf(stderr, "  %lu operations failed\n", failures);
+    return total / elapsed;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : bench_cpu_count();
+    if (max_threads < 1) max_threads = 1;
+
+    bench_enter_scratch_dir();
+    if (auth_init(&auth_ctx) != 0) {
+        fprintf(stderr, "auth_init failed\n");
+        return 1;
+    }
+
+    for (int i = 0; i < BENCH_USERS; i++) {
+        char username[32], email[64];
+        snprintf(username, sizeof(username), "benchuser%d", i);
+        snprintf(email, sizeof(email), "benchuser%d@example.com", i);
+        if (auth_register_user(&auth_ctx, username, email, BENCH_PASSWORD) <= 0) {
+            fprintf(stderr, "Failed to register %s\n", username);
+            return 1;
+        }
+    }
+    for (int i = 0; i < BENCH_TOKENS; i++) {
+        session_tokens[i] = auth_create_session(&auth_ctx, 1 + i % BENCH_USERS, "127.0.0.1");
+        signed_tokens[i] = auth_create_signed_token(&auth_ctx, 1 + i % BENCH_USERS, 0,
+                                                    time(NULL) + SESSION_DURATION);
+        if (!session_tokens[i] || !signed_tokens[i]) {
+            fprintf(stderr, "Failed to create tokens\n");
+            return 1;
+        }
+    }
+
+    printf("%7s %12s %16s %16s\n", "threads", "logins/s", "sessions/s", "signed/s");
+    double base_session = 0, base_signed = 0;
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        double logins = bench_run(op_login, threads, 3.0);
+        double sessions = bench_run(op_validate_session, threads, 1.0);
+        double signed_rate = bench_run(op_validate_signed, threads, 1.0);
+        if (threads == 1) {
+            base_session = sessions;
+            base_signed = signed_rate;
+        }
+        printf("%7d %12.1f %10.0f (%4.1fx) %10.0f (%4.1fx)\n", threads, logins,
+               sessions, sessions / base_session, signed_rate, signed_rate / base_signed);
+        if (threads == max_threads) break;
+    }
+
+    for (int i = 0; i < BENCH_TOKENS; i++) {
+        free(session_tokens[i]);
+        free(signed_tokens[i]);
+    }
+    auth_cleanup(&auth_ctx);
+    return 0;
+}
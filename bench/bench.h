@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "logger.h"
+
+// Shared helpers for the programs under bench/, built and run by `make bench`
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int bench_cpu_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Moves into a fresh directory under /tmp so the data files a benchmark
+// creates never touch the working tree, and sends log output there too
+static inline void bench_enter_scratch_dir(void) {
+    char path[] = "/tmp/cserver-bench-XXXXXX";
+    if (!mkdtemp(path) || chdir(path) != 0) {
+        perror("bench: scratch directory");
+        exit(1);
+    }
+    logger_init("bench.log");
+}
+
+#endif
@@ -0,0 +1,290 @@
+#include "bench.h"
+#include "auth.h"
+#include <pthread.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// End-to-end load on POST /api/ip/allocate: each client thread allocates an
+// address over HTTP and releases it again, one connection per request as the
+// server closes every connection. Reports allocations per second and
+// allocation latency.
+//
+// By default it starts ./webserver in a scratch directory with an admin
+// account made for the run, and stops it afterwards. Pass -t with a bearer
+// token of a support-role account to load an already running server instead.
+//
+//   http_load [-c clients] [-d seconds] [-p port] [-t token]
+
+#define LOAD_SERVER_PORT 5000  // Where main.c listens
+#define LOAD_POOL 500          // Pool number used for the run
+#define LOAD_USER "loadadmin"
+#define LOAD_PASSWORD "LoadTest123!"
+#define LOAD_LATENCY_BUCKETS 32  // Powers of two of microseconds
+
+static int port = LOAD_SERVER_PORT;
+static char token[MAX_BEARER_TOKEN_LENGTH];
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    volatile int *stop;
+    unsigned long allocations;
+    unsigned long releases;
+    unsigned long errors;
+    unsigned long latency[LOAD_LATENCY_BUCKETS];
+} load_client_t;
+
+static int load_connect(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends one request on a fresh connection and reads the response until the
+// server closes it. Returns the status code, or -1 on a socket error.
+static int load_request(const char *method, const char *path, const char *body,
+                        char *response, size_t size) {
+    int fd = load_connect();
+    if (fd < 0) return -1;
+
+    char request[1024];
+    int length = snprintf(request, sizeof(request),
+                          "%s %s HTTP/1.1\r\nHost: localhost\r\n"
+                          "Authorization: Bearer %s\r\n"
+                          "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+                          method, path, token, body ? strlen(body) : 0, body ? body : "");
+    for (int sent = 0; sent < length; ) {
+        ssize_t n = send(fd, request + sent, (size_t)(length - sent), MSG_NOSIGNAL);
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        sent += (int)n;
+    }
+
+    size_t received = 0;
+    ssize_t n;
+    while ((n = recv(fd, response + received, size - 1 - received, 0)) > 0) {
+        received += (size_t)n;
+        if (received == size - 1) break;
+    }
+    close(fd);
+    response[received] = '\0';
+
+    int status;
+    return sscanf(response, "HTTP/1.%*d %d", &status) == 1 ? status : -1;
+}
+
+static const char *load_body(const char *response) {
+    const char *body = strstr(response, "\r\n\r\n");
+    return body ? body + 4 : "";
+}
+
+// Copies the string value of "key" from a flat JSON body
+static int load_json_string(const char *json, const char *key, char *out, size_t size) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *start = strstr(json, pattern);
+    if (!start) return -1;
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || (size_t)(end - start) >= size) return -1;
+    memcpy(out, start, (size_t)(end - start));
+    out[end - start] = '\0';
+    return 0;
+}
+
+static void *load_client_run(void *arg) {
+    load_client_t *client = (load_client_t *)arg;
+    char body[256], response[4096], ip[INET_ADDRSTRLEN];
+
+    snprintf(body, sizeof(body), "{\"pool_number\":%d,\"owner\":\"load-%d\"}",
+             LOAD_POOL, client->index);
+    while (!__atomic_load_n(client->stop, __ATOMIC_RELAXED)) {
+        double start = bench_now();
+        int status = load_request("POST", "/api/ip/allocate", body, response, sizeof(response));
+        double elapsed_us = (bench_now() - start) * 1e6;
+        if (status != 201 || load_json_string(load_body(response), "ip", ip, sizeof(ip)) != 0) {
+            client->errors++;
+            continue;
+        }
+        client->allocations++;
+        int bucket = 0;
+        while (bucket < LOAD_LATENCY_BUCKETS - 1 && (1UL << bucket) < elapsed_us) bucket++;
+        client->latency[bucket]++;
+
+        char release[64];
+        snprintf(release, sizeof(release), "{\"ip\":\"%s\"}", ip);
+        if (load_request("POST", "/api/ip/release", release, response, sizeof(response)) == 200) {
+            client->releases++;
+        } else {
+            client->errors++;
+        }
+    }
+    return NULL;
+}
+
+// Registers the run's account straight into the scratch directory's store
+// and gives it the role the IP routes require
+static int load_prepare_store(void) {
+    static auth_context_t auth_ctx;
+    if (auth_init(&auth_ctx) != 0) return -1;
+
+    int user_id = auth_register_user(&auth_ctx, LOAD_USER, LOAD_USER "@example.com", LOAD_PASSWORD);
+    user_t *user = user_id > 0 ? auth_get_user_by_id(&auth_ctx, user_id) : NULL;
+    if (user) user->role = 1;
+    auth_cleanup(&auth_ctx);  // Checkpoints the store
+    return user ? 0 : -1;
+}
+
+static pid_t load_start_server(const char *binary) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        execl(binary, binary, (char *)NULL);
+        _exit(127);
+    }
+    if (pid < 0) return -1;
+
+    // Wait for the listener
+    for (int i = 0; i < 200; i++) {
+        int fd = load_connect();
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        if (waitpid(pid, NULL, WNOHANG) == pid) return -1;
+        struct timespec pause = { 0, 50 * 1000000L };
+        nanosleep(&pause, NULL);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    int clients = bench_cpu_count() * 4;
+    double seconds = 5.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-c") == 0) clients = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0) seconds = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-p") == 0) port = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0) snprintf(token, sizeof(token), "%s", argv[i + 1]);
+    }
+    if (clients < 1) clients = 1;
+
+    char response[4096];
+    pid_t server = 0;
+    if (token[0] == '\0') {
+        if (port != LOAD_SERVER_PORT) {
+            fprintf(stderr, "-p needs -t: a started server always listens on %d\n", LOAD_SERVER_PORT);
+            return 1;
+        }
+        int fd = load_connect();
+        if (fd >= 0) {
+            close(fd);
+            fprintf(stderr, "Port %d is in use; stop that server or pass -t\n", port);
+            return 1;
+        }
+
+        char binary[1024];
+        if (!getcwd(binary, sizeof(binary) - 16)) return 1;
+        strcat(binary, "/webserver");
+
+        bench_enter_scratch_dir();
+        if (load_prepare_store() != 0) {
+            fprintf(stderr, "Failed to create the load test account\n");
+            return 1;
+        }
+        server = load_start_server(binary);
+        if (server < 0) {
+            fprintf(stderr, "Failed to start %s\n", binary);
+            return 1;
+        }
+
+        if (load_request("POST", "/api/login",
+                         "{\"username\":\"" LOAD_USER "\",\"password\":\"" LOAD_PASSWORD "\"}",
+                         response, sizeof(response)) != 200 ||
+            load_json_string(load_body(response), "token", token, sizeof(token)) != 0) {
+            fprintf(stderr, "Login failed: %s\n", load_body(response));
+            kill(server, SIGKILL);
+            return 1;
+        }
+    }
+
+    // 409 means the pool is left over from an earlier run, which is fine
+    char pool[256];
+    snprintf(pool, sizeof(pool),
+             "{\"pool_number\":%d,\"name\":\"loadtest\",\"base_ip\":\"10.250.0.0\","
+             "\"netmask\":\"255.255.0.0\"}", LOAD_POOL);
+    int status = load_request("POST", "/api/ip/pools", pool, response, sizeof(response));
+    if (status != 201 && status != 409) {
+        fprintf(stderr, "Creating pool %d failed (%d): %s\n", LOAD_POOL, status, load_body(response));
+        if (server > 0) kill(server, SIGKILL);
+        return 1;
+    }
+
+    load_client_t *workers = calloc((size_t)clients, sizeof(load_client_t));
+    volatile int stop = 0;
+    double start = bench_now();
+    for (int i = 0; i < clients; i++) {
+        workers[i].index = i;
+        workers[i].stop = &stop;
+        pthread_create(&workers[i].thread, NULL, load_client_run, &workers[i]);
+    }
+    struct timespec duration = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&duration, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    unsigned long allocations = 0, releases = 0, errors = 0;
+    unsigned long latency[LOAD_LATENCY_BUCKETS] = {0};
+    for (int i = 0; i < clients; i++) {
+        pthread_join(workers[i].thread, NULL);
+        allocations += workers[i].allocations;
+        releases += workers[i].releases;
+        errors += workers[i].errors;
+        for (int b = 0; b < LOAD_LATENCY_BUCKETS; b++) latency[b] += workers[i].latency[b];
+    }
+    double elapsed = bench_now() - start;
+    free(workers);
+
+    // Upper bounds of the buckets holding the median and the 99th percentile
+    unsigned long seen = 0, p50 = 0, p99 = 0;
+    for (int b = 0; b < LOAD_LATENCY_BUCKETS; b++) {
+        seen += latency[b];
+        if (!p50 && seen * 2 >= allocations) p50 = 1UL << b;
+        if (!p99 && seen * 100 >= allocations * 99) p99 = 1UL << b;
+    }
+
+    printf("%d clients for %.1f s\n", clients, elapsed);
+    printf("allocations/s %10.0f\n", allocations / elapsed);
+    printf("releases/s    %10.0f\n", releases / elapsed);
+    printf("allocate latency p50 <= %lu us, p99 <= %lu us\n", p50, p99);
+    if (errors > 0) printf("errors        %10lu\n", errors);
+
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+    return allocations > 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "bench.h"
+#include "json.h"
+#include "auth.h"
+#include "addresses.h"
+#include <string.h>
+
+// Request body parsing as the API handlers do it: json_parse() followed by
+// the field lookups and copies of register, login and IP allocate, on
+// bodies shaped like real clients send them, pretty-printed and with
+// escaped strings as well as compact
+
+static const char register_body[] =
+    "{\n"
+    "  \"username\": \"maria.gonzalez\",\n"
+    "  \"email\": \"maria.gonzalez@example.com\",\n"
+    "  \"password\": \"Tr0ub4dor&3 \\\"horse\\\" \\u00e9t\\u00e9\"\n"
+    "}\n";
+
+static const char login_body[] =
+    "{\"username\":\"maria.gonzalez\",\"password\":\"Tr0ub4dor&3\"}";
+
+static const char allocate_body[] =
+    "{\r\n"
+    "\t\"pool_number\": 12,\r\n"
+    "\t\"owner\": \"vps-4821.fra1\",\r\n"
+    "\t\"sticky\": true,\r\n"
+    "\t\"lease_seconds\": 86400\r\n"
+    "}";
+
+static int parse_register(const char *body, size_t length) {
+    char username[MAX_USERNAME_LENGTH], email[MAX_EMAIL_LENGTH], password[MAX_PASSWORD_LENGTH];
+    json_document_t doc;
+    if (json_parse(&doc, body, length) != 0 ||
+        json_get_string(&doc, "username", username, sizeof(username)) != 0 ||
+        json_get_string(&doc, "email", email, sizeof(email)) != 0 ||
+        json_get_string(&doc, "password", password, sizeof(password)) != 0) {
+        return -1;
+    }
+    return password[0];
+}
+
+static int parse_login(const char *body, size_t length) {
+    char username[MAX_USERNAME_LENGTH], password[MAX_PASSWORD_LENGTH];
+    json_document_t doc;
+    if (json_parse(&doc, body, length) != 0 ||
+        json_get_string(&doc, "username", username, sizeof(username)) != 0 ||
+        json_get_string(&doc, "password", password, sizeof(password)) != 0) {
+        return -1;
+    }
+    return password[0];
+}
+
+static int parse_allocate(const char *body, size_t length) {
+    char owner[ADDRESS_OWNER_LENGTH];
+    int64_t pool_number, lease_seconds = 0;
+    bool sticky = false;
+    json_document_t doc;
+    if (json_parse(&doc, body, length) != 0 ||
+        json_get_int(&doc, "pool_number", &pool_number) != 0 ||
+        json_get_string(&doc, "owner", owner, sizeof(owner)) != 0) {
+        return -1;
+    }
+    if (json_find(&doc, 0, "lease_seconds") >= 0 &&
+        json_get_int(&doc, "lease_seconds", &lease_seconds) != 0) {
+        return -1;
+    }
+    json_get_bool(&doc, "sticky", &sticky);
+    return (int)(pool_number + lease_seconds + sticky);
+}
+
+static int bench_body(const char *name, int (*parse)(const char *, size_t), const char *body) {
+    size_t length = strlen(body);
+    if (parse(body, length) < 0) {
+        fprintf(stderr, "%s body failed to parse\n", name);
+        return -1;
+    }
+
+    long iterations = 2000000;
+    volatile int sink = 0;
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++) sink += parse(body, length);
+    double elapsed = bench_now() - start;
+    (void)sink;
+
+    printf("%-8s %4zu bytes: %9.0f bodies/s %8.1f MiB/s\n", name, length,
+           iterations / elapsed, iterations * (double)length / elapsed / (1 << 20));
+    return 0;
+}
+
+int main(void) {
+    if (bench_body("register", parse_register, register_body) != 0 ||
+        bench_body("login", parse_login, login_body) != 0 ||
+        bench_body("allocate", parse_allocate, allocate_body) != 0) {
+        return 1;
+    }
+    return 0;
+}
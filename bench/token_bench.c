@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "auth.h"
+#include <pthread.h>
+#include <string.h>
+
+// Session token generation per thread: the per-thread ChaCha20 CSPRNG
+// against the rand()-per-character generator it replaced, which serializes
+// every caller on the libc lock
+
+#define BENCH_SECONDS 1.0
+
+static void legacy_generate_token(char *token, size_t length) {
+    const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+    for (size_t i = 0; i < length - 1; i++) {
+        token[i] = charset[rand() % (sizeof(charset) - 1)];
+    }
+    token[length - 1] = '\0';
+}
+
+typedef struct {
+    pthread_t thread;
+    void (*generate)(char *token, size_t length);
+    volatile int *stop;
+    unsigned long count;
+    unsigned char checksum;  // Keeps the generated bytes observable
+} bench_worker_t;
+
+static void *bench_worker_run(void *arg) {
+    bench_worker_t *worker = (bench_worker_t *)arg;
+    char token[MAX_SESSION_TOKEN_LENGTH];
+    unsigned long count = 0;
+    while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+        worker->generate(token, sizeof(token));
+        worker->checksum ^= (unsigned char)token[count % (sizeof(token) - 1)];
+        count++;
+    }
+    worker->count = count;
+    return NULL;
+}
+
+static double bench_run(void (*generate)(char *, size_t), int threads) {
+    bench_worker_t *workers = calloc((size_t)threads, sizeof(bench_worker_t));
+    volatile int stop = 0;
+
+    double start = bench_now();
+    for (int i = 0; i < threads; i++) {
+        workers[i].generate = generate;
+        workers[i].stop = &stop;
+        pthread_create(&workers[i].thread, NULL, bench_worker_run, &workers[i]);
+    }
+    struct timespec duration = { (time_t)BENCH_SECONDS, 0 };
+    nanosleep(&duration, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+    unsigned long total = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total += workers[i].count;
+    }
+    double elapsed = bench_now() - start;
+    free(workers);
+    return total / elapsed;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : bench_cpu_count();
+    if (max_threads < 1) max_threads = 1;
+
+    printf("%d-character tokens, per thread\n", MAX_SESSION_TOKEN_LENGTH - 1);
+    printf("%7s %16s %16s %8s\n", "threads", "rand() tokens/s", "csprng tokens/s", "speedup");
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        double legacy = bench_run(legacy_generate_token, threads) / threads;
+        double csprng = bench_run(auth_generate_token, threads) / threads;
+        printf("%7d %16.0f %16.0f %7.1fx\n", threads, legacy, csprng, csprng / legacy);
+        if (threads == max_threads) break;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "compute_pool.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void *compute_pool_worker(void *arg) {
+    compute_pool_t *pool = (compute_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (1) {
+        while (pool->running && !pool->head) {
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+
+        if (!pool->head) break;  // Stopped and drained
+
+        compute_job_t *job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+        pool->queued--;
+
+        pthread_mutex_unlock(&pool->mutex);
+        job->fn(job->arg);
+        pthread_mutex_lock(&pool->mutex);
+
+        job->done = 1;
+        pthread_cond_signal(&job->done_cond);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+compute_pool_t *compute_pool_create(int thread_count, int max_queue) {
+    if (thread_count <= 0 || max_queue <= 0) return NULL;
+
+    compute_pool_t *pool = malloc(sizeof(compute_pool_t));
+    if (!pool) {
+        log_error("Failed to allocate memory for compute pool");
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(compute_pool_t));
+    pool->max_queue = max_queue;
+    pool->running = 1;
+
+    pool->threads = malloc(sizeof(pthread_t) * thread_count);
+    if (!pool->threads) {
+        log_error("Failed to allocate memory for compute pool threads");
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, compute_pool_worker, pool) != 0) {
+            log_error("Failed to create compute pool thread");
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        compute_pool_destroy(pool);
+        return NULL;
+    }
+
+    log_info("Compute pool started with %d threads (queue limit %d)",
+             pool->thread_count, max_queue);
+    return pool;
+}
+
+void compute_pool_destroy(compute_pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+int compute_pool_run(compute_pool_t *pool, compute_job_fn fn, void *arg) {
+    if (!fn) return -1;
+
+    // Without a pool the job simply runs on the calling thread
+    if (!pool) {
+        fn(arg);
+        return 0;
+    }
+
+    compute_job_t job;
+    job.fn = fn;
+    job.arg = arg;
+    job.done = 0;
+    job.next = NULL;
+    pthread_cond_init(&job.done_cond, NULL);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (!pool->running || pool->queued >= pool->max_queue) {
+        pthread_mutex_unlock(&pool->mutex);
+        pthread_cond_destroy(&job.done_cond);
+        return -1;
+    }
+
+    if (pool->tail) {
+        pool->tail->next = &job;
+    } else {
+        pool->head = &job;
+    }
+    pool->tail = &job;
+    pool->queued++;
+    pthread_cond_signal(&pool->work_cond);
+
+    // Park this connection until a worker has finished the job
+    while (!job.done) {
+        pthread_cond_wait(&job.done_cond, &pool->mutex);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_cond_destroy(&job.done_cond);
+    return 0;
+}
+
+int compute_pool_queue_depth(compute_pool_t *pool) {
+    if (!pool) return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    int depth = pool->queued;
+    pthread_mutex_unlock(&pool->mutex);
+    return depth;
+}
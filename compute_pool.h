@@ -0,0 +1,43 @@
+#ifndef COMPUTE_POOL_H
+#define COMPUTE_POOL_H
+
+#include <pthread.h>
+
+// Fixed-size worker pool for CPU-heavy jobs (password hashing). Connection
+// threads hand work over and park until it finishes, so at most
+// thread_count jobs burn CPU at once no matter how many clients are waiting.
+
+typedef void (*compute_job_fn)(void *arg);
+
+typedef struct compute_job {
+    compute_job_fn fn;
+    void *arg;
+    int done;
+    pthread_cond_t done_cond;
+    struct compute_job *next;
+} compute_job_t;
+
+typedef struct {
+    pthread_t *threads;
+    int thread_count;
+    int max_queue;        // Jobs allowed to wait before callers are turned away
+    int queued;
+    int running;
+    compute_job_t *head;
+    compute_job_t *tail;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+} compute_pool_t;
+
+// Pool lifecycle
+compute_pool_t *compute_pool_create(int thread_count, int max_queue);
+void compute_pool_destroy(compute_pool_t *pool);
+
+// Runs fn(arg) on a pool thread and waits for it. Returns 0 when the job ran,
+// -1 when the queue is full and the job was rejected without running.
+int compute_pool_run(compute_pool_t *pool, compute_job_fn fn, void *arg);
+
+// Number of jobs currently waiting for a worker
+int compute_pool_queue_depth(compute_pool_t *pool);
+
+#endif
@@ -0,0 +1,539 @@
+#include "crypto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/random.h>
+
+// SHA-256 round constants (FIPS 180-4, section 4.2.2)
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_transform(uint32_t state[8], const uint8_t block[SHA256_BLOCK_SIZE]) {
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+        uint32_t s0 = ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_init(sha256_ctx_t *ctx) {
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->bit_count = 0;
+    ctx->buffer_length = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    ctx->bit_count += (uint64_t)length * 8;
+
+    // Top up a partially filled block first
+    if (ctx->buffer_length > 0) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->buffer_length;
+        if (take > length) take = length;
+        memcpy(ctx->buffer + ctx->buffer_length, bytes, take);
+        ctx->buffer_length += take;
+        bytes += take;
+        length -= take;
+
+        if (ctx->buffer_length < SHA256_BLOCK_SIZE) return;
+        sha256_transform(ctx->state, ctx->buffer);
+        ctx->buffer_length = 0;
+    }
+
+    // Hash whole blocks straight from the input
+    while (length >= SHA256_BLOCK_SIZE) {
+        sha256_transform(ctx->state, bytes);
+        bytes += SHA256_BLOCK_SIZE;
+        length -= SHA256_BLOCK_SIZE;
+    }
+
+    if (length > 0) {
+        memcpy(ctx->buffer, bytes, length);
+        ctx->buffer_length = length;
+    }
+}
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bit_count = ctx->bit_count;
+    size_t i = ctx->buffer_length;
+
+    // Padding: 0x80, zeros, then the 64-bit big-endian message length
+    ctx->buffer[i++] = 0x80;
+    if (i > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->buffer + i, 0, SHA256_BLOCK_SIZE - i);
+        sha256_transform(ctx->state, ctx->buffer);
+        i = 0;
+    }
+    memset(ctx->buffer + i, 0, SHA256_BLOCK_SIZE - 8 - i);
+    for (int j = 0; j < 8; j++) {
+        ctx->buffer[SHA256_BLOCK_SIZE - 1 - j] = (uint8_t)(bit_count >> (j * 8));
+    }
+    sha256_transform(ctx->state, ctx->buffer);
+
+    for (int j = 0; j < 8; j++) {
+        digest[j * 4] = (uint8_t)(ctx->state[j] >> 24);
+        digest[j * 4 + 1] = (uint8_t)(ctx->state[j] >> 16);
+        digest[j * 4 + 2] = (uint8_t)(ctx->state[j] >> 8);
+        digest[j * 4 + 3] = (uint8_t)ctx->state[j];
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void sha256(const void *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, length);
+    sha256_final(&ctx, digest);
+}
+
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const void *key, size_t key_length) {
+    uint8_t key_block[SHA256_BLOCK_SIZE] = {0};
+    uint8_t pad[SHA256_BLOCK_SIZE];
+
+    // Keys longer than a block are hashed down first (RFC 2104)
+    if (key_length > SHA256_BLOCK_SIZE) {
+        sha256(key, key_length, key_block);
+    } else if (key_length > 0) {
+        memcpy(key_block, key, key_length);
+    }
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = key_block[i] ^ 0x36;
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, sizeof(pad));
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = key_block[i] ^ 0x5c;
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, sizeof(pad));
+
+    memset(key_block, 0, sizeof(key_block));
+    memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const void *data, size_t length) {
+    sha256_update(&ctx->inner, data, length);
+}
+
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    uint8_t inner_digest[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx->inner, inner_digest);
+    sha256_update(&ctx->outer, inner_digest, sizeof(inner_digest));
+    sha256_final(&ctx->outer, mac);
+    memset(inner_digest, 0, sizeof(inner_digest));
+}
+
+void hmac_sha256(const void *key, size_t key_length, const void *data, size_t length,
+                 uint8_t mac[SHA256_DIGEST_SIZE]) {
+    hmac_sha256_ctx_t ctx;
+    hmac_sha256_init(&ctx, key, key_length);
+    hmac_sha256_update(&ctx, data, length);
+    hmac_sha256_final(&ctx, mac);
+}
+
+void pbkdf2_hmac_sha256(const void *password, size_t password_length,
+                        const void *salt, size_t salt_length, uint32_t iterations,
+                        uint8_t *out, size_t out_length) {
+    hmac_sha256_ctx_t keyed;
+    uint8_t u[SHA256_DIGEST_SIZE];
+    uint8_t t[SHA256_DIGEST_SIZE];
+
+    // The keyed inner/outer states are computed once and copied for every
+    // iteration, halving the compression calls per HMAC.
+    hmac_sha256_init(&keyed, password, password_length);
+
+    for (uint32_t block = 1; out_length > 0; block++) {
+        uint8_t block_index[4] = {
+            (uint8_t)(block >> 24), (uint8_t)(block >> 16), (uint8_t)(block >> 8), (uint8_t)block
+        };
+
+        hmac_sha256_ctx_t ctx = keyed;
+        hmac_sha256_update(&ctx, salt, salt_length);
+        hmac_sha256_update(&ctx, block_index, sizeof(block_index));
+        hmac_sha256_final(&ctx, u);
+        memcpy(t, u, sizeof(t));
+
+        for (uint32_t i = 1; i < iterations; i++) {
+            ctx = keyed;
+            hmac_sha256_update(&ctx, u, sizeof(u));
+            hmac_sha256_final(&ctx, u);
+            for (int j = 0; j < SHA256_DIGEST_SIZE; j++) t[j] ^= u[j];
+        }
+
+        size_t take = out_length < sizeof(t) ? out_length : sizeof(t);
+        memcpy(out, t, take);
+        out += take;
+        out_length -= take;
+    }
+
+    memset(&keyed, 0, sizeof(keyed));
+    memset(u, 0, sizeof(u));
+    memset(t, 0, sizeof(t));
+}
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_transform(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = ROTL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = ROTL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROTL32(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// SHA-1 (FIPS 180-4). Broken for signatures; only used where a protocol
+// requires it, such as the WebSocket handshake.
+void sha1(const void *data, size_t length, uint8_t digest[SHA1_DIGEST_SIZE]) {
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t remaining = length;
+
+    while (remaining >= 64) {
+        sha1_transform(state, bytes);
+        bytes += 64;
+        remaining -= 64;
+    }
+
+    uint8_t block[128] = {0};
+    memcpy(block, bytes, remaining);
+    block[remaining] = 0x80;
+    size_t padded = remaining < 56 ? 64 : 128;
+    uint64_t bit_count = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++) {
+        block[padded - 1 - i] = (uint8_t)(bit_count >> (i * 8));
+    }
+    sha1_transform(state, block);
+    if (padded == 128) sha1_transform(state, block + 64);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
+
+#define CHACHA_QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = ROTL32(d, 16);   \
+    c += d; b ^= c; b = ROTL32(b, 12);   \
+    a += b; d ^= a; d = ROTL32(d, 8);    \
+    c += d; b ^= c; b = ROTL32(b, 7)
+
+// One ChaCha20 block (RFC 8439) with a 64-bit block counter and zero nonce
+static void chacha20_block(const uint32_t key[8], uint64_t counter, uint8_t out[64]) {
+    uint32_t input[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        (uint32_t)counter, (uint32_t)(counter >> 32), 0, 0
+    };
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        CHACHA_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        CHACHA_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        CHACHA_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        CHACHA_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        CHACHA_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        CHACHA_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        CHACHA_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        CHACHA_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t v = x[i] + input[i];
+        out[i * 4] = (uint8_t)v;
+        out[i * 4 + 1] = (uint8_t)(v >> 8);
+        out[i * 4 + 2] = (uint8_t)(v >> 16);
+        out[i * 4 + 3] = (uint8_t)(v >> 24);
+    }
+}
+
+// Per-thread generator state, so callers never share a lock
+typedef struct {
+    uint32_t key[8];
+    uint64_t counter;
+    uint8_t buffer[CRYPTO_RNG_BUFFER_SIZE];
+    size_t available;  // Unused bytes at the end of buffer
+    int seeded;
+} crypto_rng_t;
+
+static __thread crypto_rng_t crypto_rng;
+
+static void crypto_rng_seed(crypto_rng_t *rng) {
+    uint8_t seed[32];
+    size_t got = 0;
+
+    while (got < sizeof(seed)) {
+        ssize_t n = getrandom(seed + got, sizeof(seed) - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        got += (size_t)n;
+    }
+
+    // Kernels without getrandom() still have /dev/urandom
+    if (got < sizeof(seed)) {
+        FILE *urandom = fopen("/dev/urandom", "rb");
+        got = urandom ? fread(seed, 1, sizeof(seed), urandom) : 0;
+        if (urandom) fclose(urandom);
+    }
+
+    // Handing out predictable tokens is worse than not running at all
+    if (got < sizeof(seed)) abort();
+
+    memcpy(rng->key, seed, sizeof(rng->key));
+    memset(seed, 0, sizeof(seed));
+    rng->counter = 0;
+    rng->available = 0;
+    rng->seeded = 1;
+}
+
+// Generates a buffer of keystream and immediately replaces the key with its
+// first 32 bytes, so a later memory disclosure can't recover earlier output.
+static void crypto_rng_refill(crypto_rng_t *rng) {
+    if (!rng->seeded) crypto_rng_seed(rng);
+
+    for (size_t offset = 0; offset < CRYPTO_RNG_BUFFER_SIZE; offset += 64) {
+        chacha20_block(rng->key, rng->counter++, rng->buffer + offset);
+    }
+
+    memcpy(rng->key, rng->buffer, sizeof(rng->key));
+    memset(rng->buffer, 0, sizeof(rng->key));
+    rng->available = CRYPTO_RNG_BUFFER_SIZE - sizeof(rng->key);
+}
+
+void crypto_random_bytes(void *out, size_t length) {
+    crypto_rng_t *rng = &crypto_rng;
+    uint8_t *dst = (uint8_t *)out;
+
+    while (length > 0) {
+        if (rng->available == 0) crypto_rng_refill(rng);
+
+        size_t take = length < rng->available ? length : rng->available;
+        uint8_t *src = rng->buffer + CRYPTO_RNG_BUFFER_SIZE - rng->available;
+        memcpy(dst, src, take);
+        memset(src, 0, take);  // Output is never handed out twice or left behind
+        rng->available -= take;
+        dst += take;
+        length -= take;
+    }
+}
+
+uint64_t crypto_random_u64(void) {
+    uint64_t value;
+    crypto_random_bytes(&value, sizeof(value));
+    return value;
+}
+
+static const char base62_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+// Maps each 32-bit random word to [0, 62) with a multiply-shift instead of
+// modulo + rejection: no branches, and the bias is below 2^-26 per character.
+void crypto_random_base62(char *out, size_t length) {
+    uint32_t words[64];
+
+    while (length > 0) {
+        size_t batch = length < 64 ? length : 64;
+        crypto_random_bytes(words, batch * sizeof(uint32_t));
+        for (size_t i = 0; i < batch; i++) {
+            out[i] = base62_alphabet[((uint64_t)words[i] * 62) >> 32];
+        }
+        out += batch;
+        length -= batch;
+    }
+
+    memset(words, 0, sizeof(words));
+}
+
+static const char base64url_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Unpadded base64url (RFC 4648 section 5). Returns the encoded length, or 0 if
+// the output buffer is too small.
+size_t base64url_encode(const uint8_t *data, size_t length, char *out, size_t out_size) {
+    size_t needed = (length / 3) * 4 + ((length % 3) ? (length % 3) + 1 : 0);
+    if (!out || out_size < needed + 1) return 0;
+
+    size_t j = 0;
+    size_t i = 0;
+    for (; i + 2 < length; i += 3) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        out[j++] = base64url_alphabet[(v >> 18) & 0x3f];
+        out[j++] = base64url_alphabet[(v >> 12) & 0x3f];
+        out[j++] = base64url_alphabet[(v >> 6) & 0x3f];
+        out[j++] = base64url_alphabet[v & 0x3f];
+    }
+
+    if (length - i == 1) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        out[j++] = base64url_alphabet[(v >> 18) & 0x3f];
+        out[j++] = base64url_alphabet[(v >> 12) & 0x3f];
+    } else if (length - i == 2) {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
+        out[j++] = base64url_alphabet[(v >> 18) & 0x3f];
+        out[j++] = base64url_alphabet[(v >> 12) & 0x3f];
+        out[j++] = base64url_alphabet[(v >> 6) & 0x3f];
+    }
+
+    out[j] = '\0';
+    return j;
+}
+
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Padded base64 (RFC 4648 section 4). Returns the encoded length, or 0 if the
+// output buffer is too small.
+size_t base64_encode(const uint8_t *data, size_t length, char *out, size_t out_size) {
+    size_t needed = (length + 2) / 3 * 4;
+    if (!out || out_size < needed + 1) return 0;
+
+    size_t j = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < length) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length) v |= data[i + 2];
+        out[j++] = base64_alphabet[(v >> 18) & 0x3f];
+        out[j++] = base64_alphabet[(v >> 12) & 0x3f];
+        out[j++] = i + 1 < length ? base64_alphabet[(v >> 6) & 0x3f] : '=';
+        out[j++] = i + 2 < length ? base64_alphabet[v & 0x3f] : '=';
+    }
+
+    out[j] = '\0';
+    return j;
+}
+
+static int base64url_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+// Returns the decoded length, or -1 on malformed input or a short buffer
+int base64url_decode(const char *in, size_t in_length, uint8_t *out, size_t out_size) {
+    if (!in || !out || in_length % 4 == 1) return -1;
+
+    size_t needed = (in_length / 4) * 3 + ((in_length % 4) ? (in_length % 4) - 1 : 0);
+    if (needed > out_size) return -1;
+
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < in_length; i++) {
+        int v = base64url_value(in[i]);
+        if (v < 0) return -1;
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[j++] = (uint8_t)(acc >> bits);
+        }
+    }
+
+    return (int)j;
+}
+
+void crypto_to_hex(const uint8_t *data, size_t length, char *out) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[i * 2] = hex[data[i] >> 4];
+        out[i * 2 + 1] = hex[data[i] & 0x0f];
+    }
+    out[length * 2] = '\0';
+}
+
+int crypto_equal(const void *a, const void *b, size_t length) {
+    const volatile uint8_t *x = (const volatile uint8_t *)a;
+    const volatile uint8_t *y = (const volatile uint8_t *)b;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < length; i++) {
+        diff |= x[i] ^ y[i];
+    }
+    return diff == 0;
+}
@@ -0,0 +1,61 @@
+#ifndef CRYPTO_H
+#define CRYPTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+#define SHA1_DIGEST_SIZE 20
+#define CRYPTO_RNG_BUFFER_SIZE 512  // Keystream generated per refill, multiple of 64
+
+// SHA-256 streaming context
+typedef struct {
+    uint32_t state[8];
+    uint64_t bit_count;
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    size_t buffer_length;
+} sha256_ctx_t;
+
+// HMAC-SHA256 context (inner and outer hash states)
+typedef struct {
+    sha256_ctx_t inner;
+    sha256_ctx_t outer;
+} hmac_sha256_ctx_t;
+
+// SHA-256
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t length);
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256(const void *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// HMAC-SHA256
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const void *key, size_t key_length);
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const void *data, size_t length);
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t mac[SHA256_DIGEST_SIZE]);
+void hmac_sha256(const void *key, size_t key_length, const void *data, size_t length,
+                 uint8_t mac[SHA256_DIGEST_SIZE]);
+
+// PBKDF2-HMAC-SHA256 (RFC 8018)
+void pbkdf2_hmac_sha256(const void *password, size_t password_length,
+                        const void *salt, size_t salt_length, uint32_t iterations,
+                        uint8_t *out, size_t out_length);
+
+// SHA-1, for protocols that mandate it
+void sha1(const void *data, size_t length, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+// Per-thread ChaCha20 CSPRNG seeded from getrandom(); never fails
+void crypto_random_bytes(void *out, size_t length);
+uint64_t crypto_random_u64(void);
+void crypto_random_base62(char *out, size_t length);
+
+// Encoding helpers
+size_t base64_encode(const uint8_t *data, size_t length, char *out, size_t out_size);
+size_t base64url_encode(const uint8_t *data, size_t length, char *out, size_t out_size);
+int base64url_decode(const char *in, size_t in_length, uint8_t *out, size_t out_size);
+void crypto_to_hex(const uint8_t *data, size_t length, char *out);
+
+// Comparison that does not leak the position of the first mismatch
+int crypto_equal(const void *a, const void *b, size_t length);
+
+#endif
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
@@ -13,12 +14,15 @@
 
 // Status code strings
 static const char *status_strings[] = {
+    [101] = "Switching Protocols",
     [200] = "OK",
     [201] = "Created",
     [400] = "Bad Request",
     [404] = "Not Found",
     [405] = "Method Not Allowed",
-    [500] = "Internal Server Error"
+    [426] = "Upgrade Required",
+    [500] = "Internal Server Error",
+    [503] = "Service Unavailable"
 };
 
 http_server_t *http_server_create(const char *host, int port) {
@@ -297,13 +301,22 @@ void *handle_client(void *args) {
     }
     
     // Route request
+    response->client_socket = client_socket;
     router_handle_request(server->router, request, response);
     
-    // Serialize and send response
-    char *response_str = http_serialize_response(response);
-    if (response_str) {
-        send(client_socket, response_str, strlen(response_str), 0);
-        free(response_str);
+    if (response->detached) {
+        // The connection now belongs to whoever detached it
+        client_socket = -1;
+    } else if (response->stream_mode != HTTP_STREAM_NONE) {
+        // Streamed by the handler; only the terminating chunk may be missing
+        http_response_stream_end(response);
+    } else {
+        // Serialize and send response
+        char *response_str = http_serialize_response(response);
+        if (response_str) {
+            send(client_socket, response_str, strlen(response_str), 0);
+            free(response_str);
+        }
     }
     
     // Cleanup
@@ -311,7 +324,7 @@ void *handle_client(void *args) {
     http_response_destroy(response);
     
 cleanup:
-    close(client_socket);
+    if (client_socket >= 0) close(client_socket);
     free(handler_args);
     return NULL;
 }
@@ -321,6 +334,7 @@ void http_server_stop(http_server_t *server) {
         server->running = 0;
         if (server->socket_fd >= 0) {
             close(server->socket_fd);
+            server->socket_fd = -1;
         }
     }
 }
@@ -367,12 +381,45 @@ const char *http_request_get_body(http_request_t *request) {
     return request ? request->body : NULL;
 }
 
+// Copies the URL-decoded value of query parameter name into value.
+// Returns 0 if the parameter is present, -1 otherwise.
+int http_request_get_query(http_request_t *request, const char *name, char *value, size_t size) {
+    if (!request || !name || !value || size == 0) return -1;
+
+    const char *query = strchr(request->path, '?');
+    if (!query) return -1;
+
+    size_t name_length = strlen(name);
+    for (const char *param = query + 1; *param; ) {
+        size_t param_length = strcspn(param, "&");
+        if (param_length > name_length && strncmp(param, name, name_length) == 0 &&
+            param[name_length] == '=') {
+            char raw[1024];
+            size_t raw_length = param_length - name_length - 1;
+            if (raw_length >= sizeof(raw)) raw_length = sizeof(raw) - 1;
+            memcpy(raw, param + name_length + 1, raw_length);
+            raw[raw_length] = '\0';
+
+            char *decoded = url_decode(raw);
+            if (!decoded) return -1;
+            strncpy(value, decoded, size - 1);
+            value[size - 1] = '\0';
+            free(decoded);
+            return 0;
+        }
+        param += param_length;
+        if (*param == '&') param++;
+    }
+    return -1;
+}
+
 // Response functions
 http_response_t *http_response_create(void) {
     http_response_t *response = malloc(sizeof(http_response_t));
     if (response) {
         memset(response, 0, sizeof(http_response_t));
         response->status_code = 200;
+        response->client_socket = -1;
     }
     return response;
 }
@@ -382,6 +429,7 @@ void http_response_destroy(http_response_t *response) {
         if (response->body) {
             free(response->body);
         }
+        free(response->stream_buffer);
         free(response);
     }
 }
@@ -434,6 +482,19 @@ void http_response_set_body(http_response_t *response, const char *body) {
     }
 }
 
+// Like http_response_set_body, but takes ownership of a malloc'ed body
+// instead of copying it
+void http_response_set_body_buffer(http_response_t *response, char *body, size_t length) {
+    if (!response) {
+        free(body);
+        return;
+    }
+
+    free(response->body);
+    response->body = body;
+    response->body_length = body ? length : 0;
+}
+
 
 
 // HTTP parsing
@@ -467,11 +528,18 @@ int http_parse_request(const char *raw_request, http_request_t *request) {
     
     return 0;
 }
+static const char *http_status_text(int status_code) {
+    const char *text = NULL;
+    if (status_code >= 0 && status_code < (int)(sizeof(status_strings) / sizeof(status_strings[0]))) {
+        text = status_strings[status_code];
+    }
+    return text ? text : "Unknown";
+}
+
 char *http_serialize_response(http_response_t *response) {
     if (!response) return NULL;
     
-    const char *status_text = status_strings[response->status_code];
-    if (!status_text) status_text = "Unknown";
+    const char *status_text = http_status_text(response->status_code);
     
     // Calculate total size needed
     size_t total_size = 1024; // Initial buffer for status line and headers
@@ -509,3 +577,147 @@ char *http_serialize_response(http_response_t *response) {
     return buffer;
 }
 
+// Streaming responses
+
+#define HTTP_CHUNK_HEADER_SPACE 16  // Hex length and CRLF, written just before the data
+
+static int http_send_all(int socket, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;  // Includes EAGAIN once SO_SNDTIMEO expires
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static void http_stream_fail(http_response_t *response, const char *what) {
+    if (!response->stream_failed) {
+        log_warning("Streaming response aborted while %s: %s", what, strerror(errno));
+    }
+    response->stream_failed = 1;
+}
+
+// Sends the buffered body as one chunk, framing it in place so it takes a
+// single send
+static int http_stream_flush(http_response_t *response) {
+    if (response->stream_failed) return -1;
+    if (response->stream_length == 0) return 0;
+
+    char *data = response->stream_buffer + HTTP_CHUNK_HEADER_SPACE;
+    char *start = data;
+    size_t length = response->stream_length;
+    if (response->stream_mode == HTTP_STREAM_CHUNKED) {
+        char header[HTTP_CHUNK_HEADER_SPACE];
+        int header_length = snprintf(header, sizeof(header), "%zx\r\n", length);
+        start -= header_length;
+        memcpy(start, header, (size_t)header_length);
+        memcpy(data + length, "\r\n", 2);
+        length += (size_t)header_length + 2;
+    }
+
+    response->stream_length = 0;
+    if (http_send_all(response->client_socket, start, length) != 0) {
+        http_stream_fail(response, "sending a chunk");
+        return -1;
+    }
+    return 0;
+}
+
+int http_response_stream_begin(http_request_t *request, http_response_t *response) {
+    if (!request || !response || response->client_socket < 0 ||
+        response->stream_mode != HTTP_STREAM_NONE) {
+        return -1;
+    }
+
+    response->stream_buffer = malloc(HTTP_CHUNK_HEADER_SPACE + HTTP_STREAM_BUFFER + 2);
+    if (!response->stream_buffer) return -1;
+
+    // Chunked encoding is HTTP/1.1; older clients read until the connection closes
+    response->stream_mode = strcmp(request->version, "HTTP/1.0") == 0 ? HTTP_STREAM_CLOSE
+                                                                       : HTTP_STREAM_CHUNKED;
+    struct timeval timeout = { HTTP_STREAM_SEND_TIMEOUT, 0 };
+    setsockopt(response->client_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    size_t size = 256 + (size_t)response->header_count * sizeof(http_header_t);
+    char *head = malloc(size);
+    if (!head) {
+        http_stream_fail(response, "allocating headers");
+        return -1;
+    }
+
+    size_t offset = snprintf(head, size, "HTTP/1.1 %d %s\r\n",
+                             response->status_code, http_status_text(response->status_code));
+    for (int i = 0; i < response->header_count; i++) {
+        offset += snprintf(head + offset, size - offset, "%s: %s\r\n",
+                           response->headers[i].name, response->headers[i].value);
+    }
+    if (response->stream_mode == HTTP_STREAM_CHUNKED) {
+        offset += snprintf(head + offset, size - offset, "Transfer-Encoding: chunked\r\n");
+    }
+    offset += snprintf(head + offset, size - offset, "Connection: close\r\n\r\n");
+
+    int rc = http_send_all(response->client_socket, head, offset);
+    free(head);
+    if (rc != 0) {
+        http_stream_fail(response, "sending headers");
+        return -1;
+    }
+    return 0;
+}
+
+int http_response_stream_write(http_response_t *response, const void *data, size_t length) {
+    if (!response || response->stream_mode == HTTP_STREAM_NONE || response->stream_ended) return -1;
+
+    const char *bytes = (const char *)data;
+    while (length > 0) {
+        if (response->stream_failed) return -1;
+
+        size_t space = HTTP_STREAM_BUFFER - response->stream_length;
+        size_t count = length < space ? length : space;
+        memcpy(response->stream_buffer + HTTP_CHUNK_HEADER_SPACE + response->stream_length, bytes, count);
+        response->stream_length += count;
+        bytes += count;
+        length -= count;
+
+        if (response->stream_length == HTTP_STREAM_BUFFER && http_stream_flush(response) != 0) {
+            return -1;
+        }
+    }
+    return response->stream_failed ? -1 : 0;
+}
+
+int http_response_stream_end(http_response_t *response) {
+    if (!response || response->stream_mode == HTTP_STREAM_NONE) return -1;
+    if (response->stream_ended) return response->stream_failed ? -1 : 0;
+    response->stream_ended = 1;
+
+    if (http_stream_flush(response) == 0 && response->stream_mode == HTTP_STREAM_CHUNKED &&
+        http_send_all(response->client_socket, "0\r\n\r\n", 5) != 0) {
+        http_stream_fail(response, "ending the stream");
+    }
+
+    free(response->stream_buffer);
+    response->stream_buffer = NULL;
+    return response->stream_failed ? -1 : 0;
+}
+
+void http_response_stream_abort(http_response_t *response) {
+    if (response && response->stream_mode != HTTP_STREAM_NONE) {
+        response->stream_failed = 1;
+    }
+}
+
+int http_response_detach(http_response_t *response) {
+    if (!response || response->client_socket < 0 || response->stream_mode != HTTP_STREAM_NONE) {
+        return -1;
+    }
+
+    int client_socket = response->client_socket;
+    response->client_socket = -1;
+    response->detached = 1;
+    return client_socket;
+}
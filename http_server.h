@@ -11,6 +11,13 @@
 #define MAX_BODY_SIZE 65536
 #define MAX_REQUEST_SIZE 65536
 #define MAX_THREADS 100
+#define HTTP_STREAM_BUFFER 16384     // Body bytes buffered before a chunk is sent
+#define HTTP_STREAM_SEND_TIMEOUT 30  // Seconds a stalled client may block one write
+
+// Streaming states of a response
+#define HTTP_STREAM_NONE 0
+#define HTTP_STREAM_CHUNKED 1  // Transfer-Encoding: chunked
+#define HTTP_STREAM_CLOSE 2    // HTTP/1.0 client: the body ends when the connection closes
 
 typedef struct {
     char name[256];
@@ -33,6 +40,15 @@ typedef struct http_response {
     int header_count;
     char *body;
     size_t body_length;
+
+    // Streaming; headers go out at http_response_stream_begin()
+    int client_socket;
+    int stream_mode;           // HTTP_STREAM_*
+    int stream_failed;         // The client went away or stalled; writes are dropped
+    int stream_ended;
+    char *stream_buffer;       // Chunk header space, HTTP_STREAM_BUFFER of body, CRLF
+    size_t stream_length;
+    int detached;              // A handler took over the connection
 } http_response_t;
 
 typedef struct {
@@ -61,12 +77,30 @@ http_request_t *http_request_create(void);
 void http_request_destroy(http_request_t *request);
 const char *http_request_get_header(http_request_t *request, const char *name);
 const char *http_request_get_body(http_request_t *request);
+int http_request_get_query(http_request_t *request, const char *name, char *value, size_t size);
 
 http_response_t *http_response_create(void);
 void http_response_destroy(http_response_t *response);
 void http_response_set_status(http_response_t *response, int status);
 void http_response_set_header(http_response_t *response, const char *name, const char *value);
 void http_response_set_body(http_response_t *response, const char *body);
+void http_response_set_body_buffer(http_response_t *response, char *body, size_t length);
+
+// Streaming responses: set the status and headers, then begin, write any
+// number of times and end. Writes block while the client is slow to read,
+// so a handler never buffers more than HTTP_STREAM_BUFFER bytes. Each call
+// returns 0, or -1 once the client is gone; handle_client ends a stream the
+// handler left open. Aborting closes the connection without the final
+// chunk, so the client sees the body was cut short.
+int http_response_stream_begin(http_request_t *request, http_response_t *response);
+int http_response_stream_write(http_response_t *response, const void *data, size_t length);
+int http_response_stream_end(http_response_t *response);
+void http_response_stream_abort(http_response_t *response);
+
+// Hands the client socket to the caller, e.g. after a protocol upgrade;
+// nothing more is sent and the connection is left open. Returns the socket
+// or -1.
+int http_response_detach(http_response_t *response);
 
 // HTTP parsing
 int http_parse_request(const char *raw_request, http_request_t *request);
@@ -0,0 +1,402 @@
+#include "journal.h"
+#include "logger.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#define JOURNAL_INITIAL_BUFFER 4096
+
+// On-disk record header; the CRC covers everything after it plus the payload
+typedef struct {
+    uint32_t crc;
+    uint32_t length;
+    uint16_t type;
+    uint16_t reserved;
+} journal_record_header_t;
+
+static void journal_file_path(const journal_t *journal, uint64_t generation,
+                              char *out, size_t out_size) {
+    snprintf(out, out_size, "%s.%llu", journal->path, (unsigned long long)generation);
+}
+
+static uint32_t journal_record_crc(const journal_record_header_t *header, const void *data) {
+    uint32_t crc = crc32_update(0, &header->length, sizeof(header->length));
+    crc = crc32_update(crc, &header->type, sizeof(header->type));
+    crc = crc32_update(crc, &header->reserved, sizeof(header->reserved));
+    return crc32_update(crc, data, header->length);
+}
+
+static int journal_write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Replays one journal file. Returns the offset just past the last intact
+// record; *torn is set when trailing bytes had to be ignored.
+static off_t journal_replay_file(const char *file_path, journal_replay_fn replay,
+                                 void *replay_ctx, int *torn, uint64_t *records) {
+    FILE *file = fopen(file_path, "rb");
+    if (!file) return -1;
+
+    off_t good_offset = 0;
+    char *data = NULL;
+    size_t data_capacity = 0;
+    *torn = 0;
+
+    while (1) {
+        journal_record_header_t header;
+        size_t got = fread(&header, 1, sizeof(header), file);
+        if (got == 0) break;
+        if (got != sizeof(header) || header.length > JOURNAL_MAX_RECORD_SIZE) {
+            *torn = 1;
+            break;
+        }
+
+        if (header.length > data_capacity) {
+            char *grown = realloc(data, header.length);
+            if (!grown) {
+                *torn = 1;
+                break;
+            }
+            data = grown;
+            data_capacity = header.length;
+        }
+
+        if (fread(data, 1, header.length, file) != header.length ||
+            journal_record_crc(&header, data) != header.crc) {
+            *torn = 1;
+            break;
+        }
+
+        if (replay && replay(replay_ctx, header.type, data, header.length) != 0) {
+            log_warning("Journal record of type %u in %s could not be applied",
+                        header.type, file_path);
+        }
+
+        good_offset += (off_t)(sizeof(header) + header.length);
+        (*records)++;
+    }
+
+    free(data);
+    fclose(file);
+    return good_offset;
+}
+
+static void *journal_flusher(void *arg) {
+    journal_t *journal = (journal_t *)arg;
+
+    pthread_mutex_lock(&journal->mutex);
+
+    while (1) {
+        while (journal->running && journal->buffer_length == 0) {
+            pthread_cond_wait(&journal->flush_cond, &journal->mutex);
+        }
+
+        if (journal->buffer_length == 0) break;  // Stopped and drained
+
+        // Take the whole batch; appends continue into the other buffer
+        char *batch = journal->buffer;
+        size_t batch_length = journal->buffer_length;
+        size_t batch_capacity = journal->buffer_capacity;
+        uint64_t batch_lsn = journal->next_lsn - 1;
+
+        journal->buffer = journal->spare;
+        journal->buffer_capacity = journal->spare_capacity;
+        journal->buffer_length = 0;
+        journal->spare = batch;
+        journal->spare_capacity = batch_capacity;
+        journal->writing = 1;
+        int fd = journal->fd;
+
+        pthread_mutex_unlock(&journal->mutex);
+        int rc = journal_write_all(fd, batch, batch_length);
+        if (rc == 0) rc = fdatasync(fd);
+        pthread_mutex_lock(&journal->mutex);
+
+        journal->writing = 0;
+        if (rc != 0) {
+            journal->failed = 1;
+            log_error("Journal write failed: %s", strerror(errno));
+        } else if (batch_lsn > journal->durable_lsn) {
+            journal->durable_lsn = batch_lsn;
+        }
+        pthread_cond_broadcast(&journal->durable_cond);
+    }
+
+    pthread_mutex_unlock(&journal->mutex);
+    return NULL;
+}
+
+journal_t *journal_open(const char *path, uint64_t generation,
+                        journal_replay_fn replay, void *replay_ctx) {
+    if (!path) return NULL;
+
+    journal_t *journal = malloc(sizeof(journal_t));
+    if (!journal) {
+        log_error("Failed to allocate memory for journal");
+        return NULL;
+    }
+
+    memset(journal, 0, sizeof(journal_t));
+    strncpy(journal->path, path, sizeof(journal->path) - 1);
+    journal->fd = -1;
+    journal->next_lsn = 1;
+
+    // Take ownership before replaying anything
+    char lock_path[600];
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+    journal->lock_fd = open(lock_path, O_RDWR | O_CREAT, 0600);
+    if (journal->lock_fd < 0 || flock(journal->lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        int err = errno;
+        if (err == EWOULDBLOCK) {
+            log_error("Journal %s is in use by another process", path);
+        } else {
+            log_error("Failed to lock journal %s: %s", lock_path, strerror(err));
+        }
+        if (journal->lock_fd >= 0) close(journal->lock_fd);
+        free(journal);
+        errno = err;
+        return NULL;
+    }
+
+    // Replay every generation from the snapshot's onwards
+    char file_path[600];
+    uint64_t replayed = 0;
+    off_t last_good_offset = 0;
+    int last_torn = 0;
+    uint64_t gen = generation;
+    journal->generation = generation;
+
+    while (1) {
+        int torn = 0;
+        journal_file_path(journal, gen, file_path, sizeof(file_path));
+        off_t good_offset = journal_replay_file(file_path, replay, replay_ctx, &torn, &replayed);
+        if (good_offset < 0) break;
+
+        if (torn) {
+            log_warning("Journal %s has a torn or corrupt tail after %lld bytes",
+                        file_path, (long long)good_offset);
+        }
+        journal->generation = gen;
+        last_good_offset = good_offset;
+        last_torn = torn;
+        gen++;
+    }
+
+    journal_file_path(journal, journal->generation, file_path, sizeof(file_path));
+    journal->fd = open(file_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (journal->fd < 0) {
+        log_error("Failed to open journal %s: %s", file_path, strerror(errno));
+        close(journal->lock_fd);
+        free(journal);
+        return NULL;
+    }
+
+    // Cut off a partially written record so new appends start on a boundary
+    if (last_torn && ftruncate(journal->fd, last_good_offset) != 0) {
+        log_error("Failed to truncate torn journal tail: %s", strerror(errno));
+    }
+    sync_parent_directory(file_path);
+
+    journal->buffer = malloc(JOURNAL_INITIAL_BUFFER);
+    journal->spare = malloc(JOURNAL_INITIAL_BUFFER);
+    if (!journal->buffer || !journal->spare) {
+        log_error("Failed to allocate journal buffers");
+        free(journal->buffer);
+        free(journal->spare);
+        close(journal->fd);
+        close(journal->lock_fd);
+        free(journal);
+        return NULL;
+    }
+    journal->buffer_capacity = JOURNAL_INITIAL_BUFFER;
+    journal->spare_capacity = JOURNAL_INITIAL_BUFFER;
+
+    pthread_mutex_init(&journal->mutex, NULL);
+    pthread_cond_init(&journal->flush_cond, NULL);
+    pthread_cond_init(&journal->durable_cond, NULL);
+    journal->records_since_rotate = replayed;
+    journal->running = 1;
+
+    if (pthread_create(&journal->flusher, NULL, journal_flusher, journal) != 0) {
+        log_error("Failed to create journal flusher thread");
+        journal->running = 0;
+        journal_close(journal);
+        return NULL;
+    }
+
+    log_info("Journal %s opened at generation %llu (%llu records replayed)",
+             path, (unsigned long long)journal->generation, (unsigned long long)replayed);
+    return journal;
+}
+
+void journal_close(journal_t *journal) {
+    if (!journal) return;
+
+    pthread_mutex_lock(&journal->mutex);
+    int had_flusher = journal->running;
+    journal->running = 0;
+    pthread_cond_signal(&journal->flush_cond);
+    pthread_mutex_unlock(&journal->mutex);
+
+    if (had_flusher) {
+        pthread_join(journal->flusher, NULL);
+    }
+
+    if (journal->fd >= 0) {
+        close(journal->fd);
+    }
+    close(journal->lock_fd);
+
+    pthread_cond_destroy(&journal->durable_cond);
+    pthread_cond_destroy(&journal->flush_cond);
+    pthread_mutex_destroy(&journal->mutex);
+    free(journal->buffer);
+    free(journal->spare);
+    free(journal);
+}
+
+uint64_t journal_append(journal_t *journal, uint16_t type, const void *data, uint32_t length) {
+    if (!journal || (length > 0 && !data) || length > JOURNAL_MAX_RECORD_SIZE) return 0;
+
+    journal_record_header_t header;
+    header.length = length;
+    header.type = type;
+    header.reserved = 0;
+    header.crc = journal_record_crc(&header, data);
+
+    size_t record_size = sizeof(header) + length;
+
+    pthread_mutex_lock(&journal->mutex);
+
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->mutex);
+        return 0;
+    }
+
+    if (journal->buffer_length + record_size > journal->buffer_capacity) {
+        size_t capacity = journal->buffer_capacity * 2;
+        while (capacity < journal->buffer_length + record_size) capacity *= 2;
+        char *grown = realloc(journal->buffer, capacity);
+        if (!grown) {
+            pthread_mutex_unlock(&journal->mutex);
+            log_error("Failed to grow journal buffer");
+            return 0;
+        }
+        journal->buffer = grown;
+        journal->buffer_capacity = capacity;
+    }
+
+    memcpy(journal->buffer + journal->buffer_length, &header, sizeof(header));
+    if (length > 0) {
+        memcpy(journal->buffer + journal->buffer_length + sizeof(header), data, length);
+    }
+    journal->buffer_length += record_size;
+
+    uint64_t lsn = journal->next_lsn++;
+    journal->records_since_rotate++;
+    pthread_cond_signal(&journal->flush_cond);
+
+    pthread_mutex_unlock(&journal->mutex);
+    return lsn;
+}
+
+int journal_sync(journal_t *journal, uint64_t lsn) {
+    if (!journal || lsn == 0) return -1;
+
+    pthread_mutex_lock(&journal->mutex);
+    while (journal->durable_lsn < lsn && !journal->failed) {
+        pthread_cond_wait(&journal->durable_cond, &journal->mutex);
+    }
+    int rc = journal->durable_lsn >= lsn ? 0 : -1;
+    pthread_mutex_unlock(&journal->mutex);
+
+    return rc;
+}
+
+// Closes the current generation and starts the next one. Callers hold their
+// own state lock so that a snapshot taken right after reflects exactly the
+// records in generations before *new_generation.
+int journal_rotate(journal_t *journal, uint64_t *new_generation) {
+    if (!journal) return -1;
+
+    pthread_mutex_lock(&journal->mutex);
+
+    while (journal->writing) {
+        pthread_cond_wait(&journal->durable_cond, &journal->mutex);
+    }
+
+    if (journal->failed) {
+        pthread_mutex_unlock(&journal->mutex);
+        return -1;
+    }
+
+    // Finish the old generation synchronously
+    if (journal->buffer_length > 0) {
+        if (journal_write_all(journal->fd, journal->buffer, journal->buffer_length) != 0 ||
+            fdatasync(journal->fd) != 0) {
+            journal->failed = 1;
+            pthread_cond_broadcast(&journal->durable_cond);
+            pthread_mutex_unlock(&journal->mutex);
+            log_error("Journal write failed during rotation: %s", strerror(errno));
+            return -1;
+        }
+        journal->buffer_length = 0;
+        journal->durable_lsn = journal->next_lsn - 1;
+        pthread_cond_broadcast(&journal->durable_cond);
+    }
+
+    char file_path[600];
+    journal_file_path(journal, journal->generation + 1, file_path, sizeof(file_path));
+    int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0) {
+        pthread_mutex_unlock(&journal->mutex);
+        log_error("Failed to create journal %s: %s", file_path, strerror(errno));
+        return -1;
+    }
+    sync_parent_directory(file_path);
+
+    close(journal->fd);
+    journal->fd = fd;
+    journal->generation++;
+    journal->records_since_rotate = 0;
+    if (new_generation) *new_generation = journal->generation;
+
+    pthread_mutex_unlock(&journal->mutex);
+    return 0;
+}
+
+void journal_discard_before(journal_t *journal, uint64_t generation) {
+    if (!journal) return;
+
+    char file_path[600];
+    while (generation > 0) {
+        generation--;
+        journal_file_path(journal, generation, file_path, sizeof(file_path));
+        if (unlink(file_path) != 0) break;
+    }
+}
+
+uint64_t journal_pending_records(journal_t *journal) {
+    if (!journal) return 0;
+
+    pthread_mutex_lock(&journal->mutex);
+    uint64_t pending = journal->records_since_rotate;
+    pthread_mutex_unlock(&journal->mutex);
+    return pending;
+}
@@ -0,0 +1,67 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Append-only write-ahead journal with group commit.
+//
+// Records are appended to an in-memory buffer and written by a background
+// flusher thread, one write + fdatasync per batch. Callers that need
+// durability wait on the record's sequence number with journal_sync().
+//
+// Each journal file is "<path>.<generation>". A snapshot records the
+// generation to replay from; after the snapshot is safely on disk, older
+// generations are discarded. Recovery replays every generation from the
+// snapshot's onwards, stopping at the first torn or corrupt record.
+//
+// A journal has one owner: opening takes an exclusive flock on
+// "<path>.lock", so a second process can neither replay records the owner
+// is still writing nor interleave its own appends.
+
+#define JOURNAL_MAX_RECORD_SIZE (1024 * 1024)
+
+typedef int (*journal_replay_fn)(void *ctx, uint16_t type, const void *data, uint32_t length);
+
+typedef struct {
+    char path[512];
+    int fd;
+    int lock_fd;                  // Holds the flock on "<path>.lock"
+    uint64_t generation;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t flush_cond;    // Wakes the flusher when records arrive
+    pthread_cond_t durable_cond;  // Wakes journal_sync() waiters
+
+    char *buffer;                 // Records waiting to be written
+    size_t buffer_length;
+    size_t buffer_capacity;
+    char *spare;                  // Swapped in while the flusher writes
+    size_t spare_capacity;
+
+    uint64_t next_lsn;            // Sequence number of the next record
+    uint64_t durable_lsn;         // Every record below this is on disk
+    uint64_t records_since_rotate;
+    int writing;                  // Flusher is outside the lock doing I/O
+    int failed;                   // A write failed; the journal is read-only
+    int running;
+    pthread_t flusher;
+} journal_t;
+
+// Lifecycle; journal_open() fails with errno EWOULDBLOCK if another process
+// owns the journal
+journal_t *journal_open(const char *path, uint64_t generation,
+                        journal_replay_fn replay, void *replay_ctx);
+void journal_close(journal_t *journal);
+
+// Appending
+uint64_t journal_append(journal_t *journal, uint16_t type, const void *data, uint32_t length);
+int journal_sync(journal_t *journal, uint64_t lsn);
+
+// Compaction support
+int journal_rotate(journal_t *journal, uint64_t *new_generation);
+void journal_discard_before(journal_t *journal, uint64_t generation);
+uint64_t journal_pending_records(journal_t *journal);
+
+#endif
@@ -0,0 +1,647 @@
+#include "json.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    json_document_t *doc;
+    const char *pos;
+    const char *end;
+} json_parser_t;
+
+static void json_skip_space(json_parser_t *parser) {
+    while (parser->pos < parser->end &&
+           (*parser->pos == ' ' || *parser->pos == '\t' || *parser->pos == '\n' || *parser->pos == '\r')) {
+        parser->pos++;
+    }
+}
+
+static int json_add_token(json_parser_t *parser, uint8_t type, const char *start) {
+    json_document_t *doc = parser->doc;
+    if (doc->token_count >= JSON_MAX_TOKENS) return -1;
+
+    int index = doc->token_count++;
+    json_token_t *token = &doc->tokens[index];
+    token->type = type;
+    token->escaped = 0;
+    token->start = (uint32_t)(start - doc->text);
+    token->length = 0;
+    token->next = (uint16_t)doc->token_count;
+    return index;
+}
+
+static int json_is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int json_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Checks a string and records its extent; parser->pos is on the opening quote
+static int json_parse_string(json_parser_t *parser) {
+    const char *start = ++parser->pos;
+    int index = json_add_token(parser, JSON_STRING, start);
+    if (index < 0) return -1;
+
+    while (parser->pos < parser->end && *parser->pos != '"') {
+        unsigned char c = (unsigned char)*parser->pos;
+        if (c < 0x20) return -1;
+        if (c == '\\') {
+            parser->doc->tokens[index].escaped = 1;
+            if (++parser->pos >= parser->end) return -1;
+            switch (*parser->pos) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if (parser->end - parser->pos < 5 || !json_is_hex(parser->pos[1]) ||
+                        !json_is_hex(parser->pos[2]) || !json_is_hex(parser->pos[3]) ||
+                        !json_is_hex(parser->pos[4])) {
+                        return -1;
+                    }
+                    parser->pos += 4;
+                    break;
+                default:
+                    return -1;
+            }
+        }
+        parser->pos++;
+    }
+    if (parser->pos >= parser->end) return -1;
+
+    parser->doc->tokens[index].length = (uint32_t)(parser->pos - start);
+    parser->pos++;  // Closing quote
+    return 0;
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static int json_parse_number(json_parser_t *parser) {
+    const char *start = parser->pos;
+    const char *p = parser->pos;
+    const char *end = parser->end;
+
+    if (p < end && *p == '-') p++;
+    if (p >= end || !json_is_digit(*p)) return -1;
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && json_is_digit(*p)) p++;
+    }
+    if (p < end && *p == '.') {
+        if (++p >= end || !json_is_digit(*p)) return -1;
+        while (p < end && json_is_digit(*p)) p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) p++;
+        if (p >= end || !json_is_digit(*p)) return -1;
+        while (p < end && json_is_digit(*p)) p++;
+    }
+
+    int index = json_add_token(parser, JSON_NUMBER, start);
+    if (index < 0) return -1;
+    parser->doc->tokens[index].length = (uint32_t)(p - start);
+    parser->pos = p;
+    return 0;
+}
+
+static int json_parse_literal(json_parser_t *parser, const char *word, uint8_t type) {
+    size_t length = strlen(word);
+    if ((size_t)(parser->end - parser->pos) < length || memcmp(parser->pos, word, length) != 0) {
+        return -1;
+    }
+    int index = json_add_token(parser, type, parser->pos);
+    if (index < 0) return -1;
+    parser->doc->tokens[index].length = (uint32_t)length;
+    parser->pos += length;
+    return 0;
+}
+
+static int json_parse_value(json_parser_t *parser, int depth);
+
+// Objects and arrays; parser->pos is on the opening bracket
+static int json_parse_container(json_parser_t *parser, int depth) {
+    int is_object = *parser->pos == '{';
+    char close = is_object ? '}' : ']';
+    int index = json_add_token(parser, is_object ? JSON_OBJECT : JSON_ARRAY, parser->pos);
+    if (index < 0 || depth >= JSON_MAX_DEPTH) return -1;
+    const char *start = parser->pos++;
+
+    json_skip_space(parser);
+    if (parser->pos < parser->end && *parser->pos == close) {
+        parser->pos++;
+    } else {
+        for (;;) {
+            if (is_object) {
+                if (parser->pos >= parser->end || *parser->pos != '"' || json_parse_string(parser) != 0) {
+                    return -1;
+                }
+                json_skip_space(parser);
+                if (parser->pos >= parser->end || *parser->pos != ':') return -1;
+                parser->pos++;
+            }
+            if (json_parse_value(parser, depth + 1) != 0) return -1;
+
+            json_skip_space(parser);
+            if (parser->pos >= parser->end) return -1;
+            if (*parser->pos == close) {
+                parser->pos++;
+                break;
+            }
+            if (*parser->pos != ',') return -1;
+            parser->pos++;
+            json_skip_space(parser);
+        }
+    }
+
+    json_token_t *token = &parser->doc->tokens[index];
+    token->length = (uint32_t)(parser->pos - start);
+    token->next = (uint16_t)parser->doc->token_count;
+    return 0;
+}
+
+static int json_parse_value(json_parser_t *parser, int depth) {
+    json_skip_space(parser);
+    if (parser->pos >= parser->end) return -1;
+
+    switch (*parser->pos) {
+        case '{':
+        case '[': return json_parse_container(parser, depth);
+        case '"': return json_parse_string(parser);
+        case 't': return json_parse_literal(parser, "true", JSON_TRUE);
+        case 'f': return json_parse_literal(parser, "false", JSON_FALSE);
+        case 'n': return json_parse_literal(parser, "null", JSON_NULL);
+        default: return json_parse_number(parser);
+    }
+}
+
+// Tokenizes text, which must hold exactly one JSON value. Returns 0, or -1
+// if the text is not valid JSON or has more than JSON_MAX_TOKENS values.
+int json_parse(json_document_t *doc, const char *text, size_t length) {
+    if (!doc || !text || length > UINT32_MAX) return -1;
+
+    doc->text = text;
+    doc->length = length;
+    doc->token_count = 0;
+
+    json_parser_t parser = { doc, text, text + length };
+    if (json_parse_value(&parser, 0) != 0) {
+        doc->token_count = 0;
+        return -1;
+    }
+    json_skip_space(&parser);
+    if (parser.pos != parser.end) {
+        doc->token_count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+static int json_hex_value(const char *hex) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = hex[i];
+        value = value * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return value;
+}
+
+// Decodes the escapes of a validated string into out as UTF-8. Returns the
+// decoded length, or -1 if it does not fit in size - 1 bytes, holds a lone
+// surrogate or \u0000.
+static int json_unescape(const char *in, size_t length, char *out, size_t size) {
+    size_t written = 0;
+    const char *end = in + length;
+
+    while (in < end) {
+        char c = *in++;
+        if (c != '\\') {
+            if (written + 1 >= size) return -1;
+            out[written++] = c;
+            continue;
+        }
+
+        c = *in++;
+        uint32_t code;
+        switch (c) {
+            case 'b': code = '\b'; break;
+            case 'f': code = '\f'; break;
+            case 'n': code = '\n'; break;
+            case 'r': code = '\r'; break;
+            case 't': code = '\t'; break;
+            case 'u':
+                code = (uint32_t)json_hex_value(in);
+                in += 4;
+                if (code >= 0xDC00 && code <= 0xDFFF) return -1;
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    if (end - in < 6 || in[0] != '\\' || in[1] != 'u') return -1;
+                    uint32_t low = (uint32_t)json_hex_value(in + 2);
+                    if (low < 0xDC00 || low > 0xDFFF) return -1;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                }
+                break;
+            default: code = (unsigned char)c; break;  // " \ /
+        }
+        if (code == 0) return -1;
+
+        char utf8[4];
+        int bytes;
+        if (code < 0x80) {
+            utf8[0] = (char)code;
+            bytes = 1;
+        } else if (code < 0x800) {
+            utf8[0] = (char)(0xC0 | (code >> 6));
+            utf8[1] = (char)(0x80 | (code & 0x3F));
+            bytes = 2;
+        } else if (code < 0x10000) {
+            utf8[0] = (char)(0xE0 | (code >> 12));
+            utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+            utf8[2] = (char)(0x80 | (code & 0x3F));
+            bytes = 3;
+        } else {
+            utf8[0] = (char)(0xF0 | (code >> 18));
+            utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+            utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+            utf8[3] = (char)(0x80 | (code & 0x3F));
+            bytes = 4;
+        }
+        if (written + bytes >= size) return -1;
+        memcpy(out + written, utf8, bytes);
+        written += bytes;
+    }
+
+    out[written] = '\0';
+    return (int)written;
+}
+
+int json_token_string(const json_document_t *doc, int token, char *out, size_t size) {
+    if (!doc || token < 0 || token >= doc->token_count || !out || size == 0) return -1;
+
+    const json_token_t *string = &doc->tokens[token];
+    if (string->type != JSON_STRING) return -1;
+
+    const char *data = doc->text + string->start;
+    if (string->escaped) {
+        return json_unescape(data, string->length, out, size) < 0 ? -1 : 0;
+    }
+    // Embedded NUL bytes would silently truncate the copy
+    if (string->length >= size || memchr(data, '\0', string->length)) return -1;
+    memcpy(out, data, string->length);
+    out[string->length] = '\0';
+    return 0;
+}
+
+static int json_key_equals(const json_document_t *doc, const json_token_t *token, const char *key) {
+    size_t key_length = strlen(key);
+    const char *data = doc->text + token->start;
+    if (!token->escaped) {
+        return token->length == key_length && memcmp(data, key, key_length) == 0;
+    }
+
+    // Escaped keys are rare; decode into a small buffer to compare
+    char decoded[256];
+    return json_unescape(data, token->length, decoded, sizeof(decoded)) == (int)key_length &&
+           memcmp(decoded, key, key_length) == 0;
+}
+
+int json_find(const json_document_t *doc, int object, const char *key) {
+    if (!doc || !key || object < 0 || object >= doc->token_count ||
+        doc->tokens[object].type != JSON_OBJECT) {
+        return -1;
+    }
+
+    int end = doc->tokens[object].next;
+    for (int i = object + 1; i < end; i = doc->tokens[i + 1].next) {
+        if (json_key_equals(doc, &doc->tokens[i], key)) return i + 1;
+    }
+    return -1;
+}
+
+int json_get_string(const json_document_t *doc, const char *key, char *out, size_t size) {
+    return json_token_string(doc, json_find(doc, 0, key), out, size);
+}
+
+int json_get_view(const json_document_t *doc, const char *key, json_string_t *out) {
+    int token = json_find(doc, 0, key);
+    if (token < 0 || doc->tokens[token].type != JSON_STRING || !out) return -1;
+
+    out->data = doc->text + doc->tokens[token].start;
+    out->length = doc->tokens[token].length;
+    out->escaped = doc->tokens[token].escaped;
+    return 0;
+}
+
+// Integers only; fractions and exponents are rejected
+int json_get_int(const json_document_t *doc, const char *key, int64_t *out) {
+    int token = json_find(doc, 0, key);
+    if (token < 0 || doc->tokens[token].type != JSON_NUMBER || !out) return -1;
+
+    const json_token_t *number = &doc->tokens[token];
+    char digits[24];
+    if (number->length >= sizeof(digits)) return -1;
+    memcpy(digits, doc->text + number->start, number->length);
+    digits[number->length] = '\0';
+    if (strpbrk(digits, ".eE")) return -1;
+
+    errno = 0;
+    long long value = strtoll(digits, NULL, 10);
+    if (errno == ERANGE) return -1;
+    *out = (int64_t)value;
+    return 0;
+}
+
+int json_get_bool(const json_document_t *doc, const char *key, bool *out) {
+    int token = json_find(doc, 0, key);
+    if (token < 0 || !out) return -1;
+
+    uint8_t type = doc->tokens[token].type;
+    if (type != JSON_TRUE && type != JSON_FALSE) return -1;
+    *out = type == JSON_TRUE;
+    return 0;
+}
+
+// Writer
+
+void json_writer_init(json_writer_t *writer) {
+    memset(writer, 0, sizeof(*writer));
+}
+
+void json_writer_init_stream(json_writer_t *writer, json_flush_fn flush, void *ctx) {
+    memset(writer, 0, sizeof(*writer));
+    writer->flush = flush;
+    writer->flush_ctx = ctx;
+}
+
+static int json_writer_flush(json_writer_t *writer) {
+    if (writer->length == 0) return 0;
+    if (writer->flush(writer->flush_ctx, writer->data, writer->length) != 0) {
+        writer->error = 1;
+        return -1;
+    }
+    writer->length = 0;
+    return 0;
+}
+
+// Makes room for count more bytes, flushing a streaming writer first when
+// they would fill JSON_WRITER_CHUNK
+static int json_writer_reserve(json_writer_t *writer, size_t count) {
+    if (writer->error) return -1;
+    if (writer->flush && writer->length + count >= JSON_WRITER_CHUNK && json_writer_flush(writer) != 0) {
+        return -1;
+    }
+
+    size_t needed = writer->length + count + 1;  // Room for the terminator
+    if (needed <= writer->capacity) return 0;
+
+    size_t capacity = writer->capacity ? writer->capacity : (writer->flush ? JSON_WRITER_CHUNK : 256);
+    while (capacity < needed) capacity *= 2;
+    char *data = realloc(writer->data, capacity);
+    if (!data) {
+        writer->error = 1;
+        return -1;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+    return 0;
+}
+
+static void json_writer_append(json_writer_t *writer, const char *data, size_t length) {
+    if (json_writer_reserve(writer, length) != 0) return;
+    memcpy(writer->data + writer->length, data, length);
+    writer->length += length;
+}
+
+// Writes the comma that separates this value from the previous one
+static void json_writer_separate(json_writer_t *writer) {
+    if (writer->after_key) {
+        writer->after_key = false;
+        return;
+    }
+    uint32_t bit = 1u << writer->depth;
+    if (writer->has_items & bit) json_writer_append(writer, ",", 1);
+    writer->has_items |= bit;
+}
+
+static void json_writer_open(json_writer_t *writer, char bracket) {
+    json_writer_separate(writer);
+    if (writer->depth + 1 >= JSON_MAX_DEPTH) {
+        writer->error = 1;
+        return;
+    }
+    json_writer_append(writer, &bracket, 1);
+    writer->depth++;
+    writer->has_items &= ~(1u << writer->depth);
+}
+
+static void json_writer_close(json_writer_t *writer, char bracket) {
+    if (writer->depth == 0) {
+        writer->error = 1;
+        return;
+    }
+    writer->depth--;
+    json_writer_append(writer, &bracket, 1);
+}
+
+int json_writer_finish(json_writer_t *writer) {
+    if (writer->depth != 0) writer->error = 1;
+    if (!writer->error && writer->flush) json_writer_flush(writer);
+    if (!writer->error && writer->data) writer->data[writer->length] = '\0';
+    return writer->error ? -1 : 0;
+}
+
+// Hands the NUL-terminated output of a buffered writer to the caller, who
+// frees it; the writer is left empty
+char *json_writer_release(json_writer_t *writer, size_t *length_out) {
+    if (writer->error || json_writer_reserve(writer, 0) != 0) return NULL;
+
+    char *data = writer->data;
+    data[writer->length] = '\0';
+    if (length_out) *length_out = writer->length;
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+    return data;
+}
+
+void json_writer_free(json_writer_t *writer) {
+    free(writer->data);
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+}
+
+void json_write_begin_object(json_writer_t *writer) {
+    json_writer_open(writer, '{');
+}
+
+void json_write_end_object(json_writer_t *writer) {
+    json_writer_close(writer, '}');
+}
+
+void json_write_begin_array(json_writer_t *writer) {
+    json_writer_open(writer, '[');
+}
+
+void json_write_end_array(json_writer_t *writer) {
+    json_writer_close(writer, ']');
+}
+
+static void json_writer_quoted(json_writer_t *writer, const char *str, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    json_writer_append(writer, "\"", 1);
+    size_t run = 0;  // Bytes that need no escaping are copied a run at a time
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        json_writer_append(writer, str + run, i - run);
+        run = i + 1;
+        char escape[6] = { '\\', 0 };
+        size_t escape_length = 2;
+        switch (c) {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0xF];
+                escape_length = 6;
+                break;
+        }
+        json_writer_append(writer, escape, escape_length);
+    }
+    json_writer_append(writer, str + run, length - run);
+    json_writer_append(writer, "\"", 1);
+}
+
+void json_write_key(json_writer_t *writer, const char *key) {
+    json_writer_separate(writer);
+    json_writer_quoted(writer, key, strlen(key));
+    json_writer_append(writer, ":", 1);
+    writer->after_key = true;
+}
+
+void json_write_string(json_writer_t *writer, const char *str) {
+    if (!str) {
+        json_write_null(writer);
+        return;
+    }
+    json_write_string_n(writer, str, strlen(str));
+}
+
+void json_write_string_n(json_writer_t *writer, const char *str, size_t length) {
+    json_writer_separate(writer);
+    json_writer_quoted(writer, str, length);
+}
+
+// Formats value into the end of buf, returning where the digits start
+static char *json_format_uint(char *end, uint64_t value) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char *p = end;
+    while (value >= 100) {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+        value /= 100;
+        *--p = pairs[pair + 1];
+        *--p = pairs[pair];
+    }
+    if (value >= 10) {
+        *--p = pairs[value * 2 + 1];
+        *--p = pairs[value * 2];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return p;
+}
+
+void json_write_uint(json_writer_t *writer, uint64_t value) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *start = json_format_uint(end, value);
+    json_writer_separate(writer);
+    json_writer_append(writer, start, (size_t)(end - start));
+}
+
+void json_write_int(json_writer_t *writer, int64_t value) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char *start = json_format_uint(end, magnitude);
+    if (value < 0) *--start = '-';
+    json_writer_separate(writer);
+    json_writer_append(writer, start, (size_t)(end - start));
+}
+
+// value rounded to a fixed number of decimals (at most 9), e.g. percentages.
+// Values that JSON cannot represent, or too large for the fixed form, are null.
+void json_write_fixed(json_writer_t *writer, double value, int decimals) {
+    if (decimals < 0) decimals = 0;
+    if (decimals > 9) decimals = 9;
+
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; i++) scale *= 10;
+
+    double scaled = (value < 0 ? -value : value) * (double)scale + 0.5;
+    if (!(scaled < 9.0e18)) {  // Also catches NaN
+        json_write_null(writer);
+        return;
+    }
+
+    uint64_t units = (uint64_t)scaled;
+    char buf[48];
+    char *end = buf + sizeof(buf);
+    char *start = end;
+    if (decimals > 0) {
+        uint64_t fraction = units % scale;
+        for (int i = 0; i < decimals; i++) {
+            *--start = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        *--start = '.';
+    }
+    start = json_format_uint(start, units / scale);
+    if (value < 0 && units != 0) *--start = '-';
+
+    json_writer_separate(writer);
+    json_writer_append(writer, start, (size_t)(end - start));
+}
+
+void json_write_bool(json_writer_t *writer, bool value) {
+    json_writer_separate(writer);
+    if (value) {
+        json_writer_append(writer, "true", 4);
+    } else {
+        json_writer_append(writer, "false", 5);
+    }
+}
+
+void json_write_null(json_writer_t *writer) {
+    json_writer_separate(writer);
+    json_writer_append(writer, "null", 4);
+}
+
+void json_write_field_string(json_writer_t *writer, const char *key, const char *value) {
+    json_write_key(writer, key);
+    json_write_string(writer, value);
+}
+
+void json_write_field_int(json_writer_t *writer, const char *key, int64_t value) {
+    json_write_key(writer, key);
+    json_write_int(writer, value);
+}
+
+void json_write_field_bool(json_writer_t *writer, const char *key, bool value) {
+    json_write_key(writer, key);
+    json_write_bool(writer, value);
+}
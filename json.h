@@ -0,0 +1,121 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-pass JSON tokenizer for request bodies.
+//
+// json_parse() validates the whole document and records one token per
+// value in a fixed array inside the document, so parsing allocates
+// nothing. Tokens point into the caller's buffer; strings are only
+// unescaped when a handler copies them out, and only if they contain
+// escapes. The buffer must outlive the document.
+
+#define JSON_MAX_TOKENS 128  // Values per document; larger bodies are rejected
+#define JSON_MAX_DEPTH 16
+
+// Token types
+#define JSON_OBJECT 1
+#define JSON_ARRAY 2
+#define JSON_STRING 3
+#define JSON_NUMBER 4
+#define JSON_TRUE 5
+#define JSON_FALSE 6
+#define JSON_NULL 7
+
+typedef struct {
+    uint8_t type;
+    uint8_t escaped;      // String contains backslash escapes
+    uint16_t next;        // Index of the token after this value and everything inside it
+    uint32_t start;       // Offset into the text; strings exclude their quotes
+    uint32_t length;
+} json_token_t;
+
+typedef struct {
+    const char *text;
+    size_t length;
+    int token_count;
+    json_token_t tokens[JSON_MAX_TOKENS];  // Objects alternate key and value tokens
+} json_document_t;
+
+// A string as it appears in the text, escapes not decoded
+typedef struct {
+    const char *data;
+    size_t length;
+    bool escaped;
+} json_string_t;
+
+// Parsing
+int json_parse(json_document_t *doc, const char *text, size_t length);
+
+// Lookups in an object token (0 is the root); return the value's token or -1
+int json_find(const json_document_t *doc, int object, const char *key);
+
+// Typed fields of the root object. Each returns 0, or -1 if the field is
+// missing, has another type or does not fit.
+int json_get_string(const json_document_t *doc, const char *key, char *out, size_t size);
+int json_get_view(const json_document_t *doc, const char *key, json_string_t *out);
+int json_get_int(const json_document_t *doc, const char *key, int64_t *out);
+int json_get_bool(const json_document_t *doc, const char *key, bool *out);
+
+// Copies a string token into out, decoding escapes; -1 if it does not fit
+// or contains \u0000
+int json_token_string(const json_document_t *doc, int token, char *out, size_t size);
+
+// JSON writer for responses.
+//
+// Values are appended to a buffer that grows as needed; commas and string
+// escaping are handled by the writer, and numbers are formatted without
+// printf. A streaming writer hands the buffer to its flush callback each
+// time it reaches JSON_WRITER_CHUNK bytes instead of growing, so its memory
+// stays bounded however long the output is. Errors are sticky: after a
+// failed allocation or flush every call is a no-op and finish returns -1.
+
+#define JSON_WRITER_CHUNK 4096
+
+// Returns 0, or -1 to stop the writer
+typedef int (*json_flush_fn)(void *ctx, const void *data, size_t length);
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int error;
+    int depth;
+    uint32_t has_items;   // Bit per depth: the container already has a value
+    bool after_key;       // The next value belongs to a key, so needs no comma
+    json_flush_fn flush;  // NULL for a buffered writer
+    void *flush_ctx;
+} json_writer_t;
+
+// Writer lifecycle
+void json_writer_init(json_writer_t *writer);
+void json_writer_init_stream(json_writer_t *writer, json_flush_fn flush, void *ctx);
+int json_writer_finish(json_writer_t *writer);
+char *json_writer_release(json_writer_t *writer, size_t *length_out);
+void json_writer_free(json_writer_t *writer);
+
+// Containers
+void json_write_begin_object(json_writer_t *writer);
+void json_write_end_object(json_writer_t *writer);
+void json_write_begin_array(json_writer_t *writer);
+void json_write_end_array(json_writer_t *writer);
+void json_write_key(json_writer_t *writer, const char *key);
+
+// Values
+void json_write_string(json_writer_t *writer, const char *str);
+void json_write_string_n(json_writer_t *writer, const char *str, size_t length);
+void json_write_int(json_writer_t *writer, int64_t value);
+void json_write_uint(json_writer_t *writer, uint64_t value);
+void json_write_fixed(json_writer_t *writer, double value, int decimals);
+void json_write_bool(json_writer_t *writer, bool value);
+void json_write_null(json_writer_t *writer);
+
+// Object members: key followed by value
+void json_write_field_string(json_writer_t *writer, const char *key, const char *value);
+void json_write_field_int(json_writer_t *writer, const char *key, int64_t value);
+void json_write_field_bool(json_writer_t *writer, const char *key, bool value);
+
+#endif
@@ -6,30 +6,49 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
-#include <ctype.h>
+#include <limits.h>
 #include "http_server.h"
 #include "router.h"
 #include "logger.h"
 #include "template.h"
 #include "auth.h"
 #include "addresses.h"
+#include "addresses6.h"
+#include "json.h"
+#include "websocket.h"
+
+#define IPAM_PUBLISH_INTERVAL 5  // Seconds between ipam topic updates
 
 // Global server instance for signal handling
 http_server_t *global_server = NULL;
 
 // Maintenance Bool Variable
 bool maintenanceMode = false;
+// Issue stateless HMAC-signed tokens instead of server-side sessions
+bool signedTokenMode = false;
+// Keep sessions in shared memory so they outlive the process. The user and IP
+// stores have a single owner (flock), so a second process on the same data
+// directory refuses to start rather than sharing them.
+bool sharedSessionMode = false;
 // Global authentication context
 auth_context_t auth_context;
+// Global IP address manager
+ip_context_t ip_context;
+// Global IPv6 prefix delegation manager
+ip6_context_t ip6_context;
+// Global WebSocket event loop for dashboard clients
+websocket_server_t websocket_server;
+// Pub/sub topics: IP pool utilization (admins) and notices (everyone)
+int ipam_topic = -1;
+int notices_topic = -1;
+// Set by the signal handler; main() does the actual shutdown
+volatile sig_atomic_t shutdownRequested = 0;
 
-// Signal handler for graceful shutdown
+// Signal handler for graceful shutdown. Only sets a flag: the cleanup takes
+// locks that the interrupted thread might be holding.
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
-        log_info("Received shutdown signal, stopping server...");
-        if (global_server) {
-            http_server_stop(global_server);
-        }
-        exit(0);
+        shutdownRequested = 1;
     }
 }
 
@@ -114,14 +133,15 @@ void auth_handler(http_request_t *request, http_response_t *response) {
 }
 
 
+// Served by /api/status and pushed to dashboard WebSocket clients
+static const char status_json[] = "{\n  \"status\": \"running\",\n  \"server\": \"Advanced C Web Server\",\n  \"version\": \"1.0.0\"\n}";
+
 void handle_api_status(http_request_t *request, http_response_t *response) {
     template_context_t *ctx = template_context_create();
     template_context_set(ctx, "status", "running");
     template_context_set(ctx, "uptime", "available");
     
-    char *json_response = "{\n  \"status\": \"running\",\n  \"server\": \"Advanced C Web Server\",\n  \"version\": \"1.0.0\"\n}";
-    
-    http_response_set_body(response, json_response);
+    http_response_set_body(response, status_json);
     http_response_set_header(response, "Content-Type", "application/json");
     http_response_set_status(response, 200);
     
@@ -151,17 +171,25 @@ void handle_post_data(http_request_t *request, http_response_t *response) {
 
 // Authentication route handlers
 
-void trim_quotes(char *str) {
-    if (!str) return;
-    
-    size_t len = strlen(str);
-    if (len >= 2) {
-        if ((str[0] == '"' && str[len-1] == '"') || 
-            (str[0] == '\'' && str[len-1] == '\'')) {
-            memmove(str, str+1, len-2);
-            str[len-2] = '\0';
-        }
+// Writer callback for JSON writers and exports that streams into the
+// response passed as ctx
+static int response_stream_write(void *ctx, const void *data, size_t length) {
+    return http_response_stream_write((http_response_t *)ctx, data, length);
+}
+
+// Finishes writer and makes its output the response body
+static void json_writer_respond(http_response_t *response, int status, json_writer_t *writer) {
+    size_t length;
+    char *body = json_writer_finish(writer) == 0 ? json_writer_release(writer, &length) : NULL;
+    json_writer_free(writer);
+    if (!body) {
+        http_response_set_status(response, 500);
+        http_response_set_body(response, "{\"error\":\"Memory allocation failed\"}");
+    } else {
+        http_response_set_status(response, status);
+        http_response_set_body_buffer(response, body, length);
     }
+    http_response_set_header(response, "Content-Type", "application/json");
 }
 
 void handle_register(http_request_t *request, http_response_t *response) {
@@ -183,40 +211,15 @@ void handle_register(http_request_t *request, http_response_t *response) {
 
     log_info("Registration request body: %s", body);
 
-    // More flexible JSON parsing
     char username[MAX_USERNAME_LENGTH] = {0};
     char email[MAX_EMAIL_LENGTH] = {0};
     char password[MAX_PASSWORD_LENGTH] = {0};
 
-    // Try multiple JSON parsing patterns
-    int parsed = 0;
-    
-    // Pattern 1: Strict JSON with quotes
-    if (sscanf(body, "{\"username\":\"%[^\"]\",\"email\":\"%[^\"]\",\"password\":\"%[^\"]\"}", 
-               username, email, password) == 3) {
-        parsed = 1;
-    }
-    // Pattern 2: More flexible with whitespace
-    else if (sscanf(body, "{%*[ \t\n\r]\"username\"%*[ \t\n\r]:%*[ \t\n\r]\"%[^\"]\"%*[ \t\n\r],%*[ \t\n\r]\"email\"%*[ \t\n\r]:%*[ \t\n\r]\"%[^\"]\"%*[ \t\n\r],%*[ \t\n\r]\"password\"%*[ \t\n\r]:%*[ \t\n\r]\"%[^\"]\"", 
-                    username, email, password) == 3) {
-        parsed = 1;
-    }
-    // Pattern 3: Single quotes
-    else if (sscanf(body, "{'username':'%[^']','email':'%[^']','password':'%[^']'}", 
-                    username, email, password) == 3) {
-        parsed = 1;
-    }
-    // Pattern 4: No quotes around values
-    else if (sscanf(body, "{\"username\":%[^,],\"email\":%[^,],\"password\":%[^}]}", 
-                    username, email, password) == 3) {
-        // Remove potential quotes from values
-        trim_quotes(username);
-        trim_quotes(email);
-        trim_quotes(password);
-        parsed = 1;
-    }
-
-    if (!parsed) {
+    json_document_t doc;
+    if (json_parse(&doc, body, strlen(body)) != 0 ||
+        json_get_string(&doc, "username", username, sizeof(username)) != 0 ||
+        json_get_string(&doc, "email", email, sizeof(email)) != 0 ||
+        json_get_string(&doc, "password", password, sizeof(password)) != 0) {
         http_response_set_status(response, 400);
         http_response_set_body(response, "{\"error\":\"Invalid JSON format\"}");
         http_response_set_header(response, "Content-Type", "application/json");
@@ -243,11 +246,20 @@ void handle_register(http_request_t *request, http_response_t *response) {
             case -4: error_msg = "Password too weak"; break;
             case -5: error_msg = "User already exists"; break;
             case -6: error_msg = "Maximum users reached"; break;
+            case -7: error_msg = "Could not save user"; break;
+            case -8: error_msg = "Server busy, try again later"; break;
             default: error_msg = "Registration failed"; break;
         }
         snprintf(response_body, sizeof(response_body), 
                 "{\"success\":false,\"error\":\"%s\"}", error_msg);
-        http_response_set_status(response, 400);
+        if (result == -8) {
+            http_response_set_status(response, 503);
+            http_response_set_header(response, "Retry-After", "1");
+        } else if (result == -7) {
+            http_response_set_status(response, 500);
+        } else {
+            http_response_set_status(response, 400);
+        }
     }
     
     http_response_set_body(response, response_body);
@@ -277,20 +289,18 @@ void handle_login(http_request_t *request, http_response_t *response) {
     char username[MAX_USERNAME_LENGTH] = {0};
     char password[MAX_PASSWORD_LENGTH] = {0};
     
-    char *username_start = strstr(body, "\"username\":");
-    char *password_start = strstr(body, "\"password\":");
-    
-    if (!username_start || !password_start) {
+    json_document_t doc;
+    if (json_parse(&doc, body, strlen(body)) != 0) {
         http_response_set_status(response, 400);
-        http_response_set_body(response, "{\"error\":\"Username and password required\"}");
+        http_response_set_body(response, "{\"error\":\"Invalid JSON format\"}");
         http_response_set_header(response, "Content-Type", "application/json");
         return;
     }
-    
-    if (sscanf(username_start, "\"username\":\"%63[^\"]\"", username) != 1 ||
-        sscanf(password_start, "\"password\":\"%255[^\"]\"", password) != 1) {
+
+    if (json_get_string(&doc, "username", username, sizeof(username)) != 0 ||
+        json_get_string(&doc, "password", password, sizeof(password)) != 0) {
         http_response_set_status(response, 400);
-        http_response_set_body(response, "{\"error\":\"Invalid JSON format\"}");
+        http_response_set_body(response, "{\"error\":\"Username and password required\"}");
         http_response_set_header(response, "Content-Type", "application/json");
         return;
     }
@@ -301,17 +311,33 @@ void handle_login(http_request_t *request, http_response_t *response) {
     if (user_id > 0) {
         char *session_token = auth_create_session(&auth_context, user_id, "127.0.0.1");
         if (session_token) {
-            user_t *user = auth_get_user_by_id(&auth_context, user_id);
-            snprintf(response_body, sizeof(response_body), 
-                    "{\"success\":true,\"token\":\"%s\",\"user\":{\"id\":%d,\"username\":\"%s\",\"role\":\"%s\"}}", 
-                    session_token, user_id, user->username, auth_get_role_name(user->role));
+            user_t user;
+            auth_get_user_copy(&auth_context, user_id, &user);
+            json_writer_t writer;
+            json_writer_init(&writer);
+            json_write_begin_object(&writer);
+            json_write_field_bool(&writer, "success", true);
+            json_write_field_string(&writer, "token", session_token);
+            json_write_key(&writer, "user");
+            json_write_begin_object(&writer);
+            json_write_field_int(&writer, "id", user_id);
+            json_write_field_string(&writer, "username", user.username);
+            json_write_field_string(&writer, "role", auth_get_role_name(user.role));
+            json_write_end_object(&writer);
+            json_write_end_object(&writer);
             free(session_token);
-            http_response_set_status(response, 200);
+            json_writer_respond(response, 200, &writer);
+            return;
         } else {
             snprintf(response_body, sizeof(response_body), 
                     "{\"success\":false,\"error\":\"Session creation failed\"}");
             http_response_set_status(response, 500);
         }
+    } else if (user_id == -4) {
+        snprintf(response_body, sizeof(response_body), 
+                "{\"success\":false,\"error\":\"Server busy, try again later\"}");
+        http_response_set_status(response, 503);
+        http_response_set_header(response, "Retry-After", "1");
     } else {
         snprintf(response_body, sizeof(response_body), 
                 "{\"success\":false,\"error\":\"Invalid credentials\"}");
@@ -332,7 +358,7 @@ void handle_logout(http_request_t *request, http_response_t *response) {
         return;
     }
     
-    char token[MAX_SESSION_TOKEN_LENGTH];
+    char token[MAX_BEARER_TOKEN_LENGTH];
     if (auth_parse_bearer_token(auth_header, token) != 0) {
         http_response_set_status(response, 401);
         http_response_set_body(response, "{\"error\":\"Invalid authorization format\"}");
@@ -355,71 +381,849 @@ void handle_profile(http_request_t *request, http_response_t *response) {
     int user_id = auth_require_login(request, response, &auth_context);
     if (user_id < 0) return;  // Response already set by auth_require_login
     
-    user_t *user = auth_get_user_by_id(&auth_context, user_id);
-    if (!user) {
+    user_t user;
+    if (auth_get_user_copy(&auth_context, user_id, &user) != 0) {
         http_response_set_status(response, 404);
         http_response_set_body(response, "{\"error\":\"User not found\"}");
         http_response_set_header(response, "Content-Type", "application/json");
         return;
     }
     
-    char response_body[1024];
-    snprintf(response_body, sizeof(response_body), 
-            "{\"success\":true,\"user\":{\"id\":%d,\"username\":\"%s\",\"email\":\"%s\",\"role\":\"%s\",\"created_at\":%ld,\"last_login\":%ld}}", 
-            user->user_id, user->username, user->email, auth_get_role_name(user->role), 
-            user->created_at, user->last_login);
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_key(&writer, "user");
+    json_write_begin_object(&writer);
+    json_write_field_int(&writer, "id", user.user_id);
+    json_write_field_string(&writer, "username", user.username);
+    json_write_field_string(&writer, "email", user.email);
+    json_write_field_string(&writer, "role", auth_get_role_name(user.role));
+    json_write_field_int(&writer, "created_at", user.created_at);
+    json_write_field_int(&writer, "last_login", user.last_login);
+    json_write_end_object(&writer);
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+// Reads an integer query parameter into value, leaving it alone when the
+// parameter is absent; -1 if it is present but not a number
+static int query_int(http_request_t *request, const char *name, int *value) {
+    char str[16];
+    if (http_request_get_query(request, name, str, sizeof(str)) != 0) return 0;
     
-    http_response_set_status(response, 200);
-    http_response_set_body(response, response_body);
-    http_response_set_header(response, "Content-Type", "application/json");
+    char *end;
+    long number = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || number < INT_MIN || number > INT_MAX) return -1;
+    *value = (int)number;
+    return 0;
 }
 
+// GET /api/users?limit=100&cursor=N&role=admin&active=true&username_prefix=ab
+// &email_prefix=ab; next_cursor in the response fetches the following page
 void handle_users(http_request_t *request, http_response_t *response) {
     int user_id = auth_require_admin(request, response, &auth_context);
     if (user_id < 0) return;  // Response already set by auth_require_admin
     
-    // Build JSON array of users (admin endpoint)
-    char *response_body = malloc(8192);
-    if (!response_body) {
-        http_response_set_status(response, 500);
-        http_response_set_body(response, "{\"error\":\"Memory allocation failed\"}");
+    int limit = AUTH_LIST_DEFAULT_LIMIT, cursor = 0;
+    auth_user_filter_t filter = { -1, -1, NULL, NULL };
+    char role[16], active[8];
+    char username_prefix[MAX_USERNAME_LENGTH], email_prefix[MAX_EMAIL_LENGTH];
+    int valid = query_int(request, "limit", &limit) == 0 && limit > 0 &&
+                query_int(request, "cursor", &cursor) == 0 && cursor >= 0;
+    
+    if (valid && http_request_get_query(request, "role", role, sizeof(role)) == 0) {
+        for (int r = 0; r <= 3; r++) {
+            if (strcmp(role, auth_get_role_name(r)) == 0) filter.role = r;
+        }
+        valid = filter.role >= 0;
+    }
+    if (valid && http_request_get_query(request, "active", active, sizeof(active)) == 0) {
+        filter.is_active = strcmp(active, "true") == 0 ? 1 : strcmp(active, "false") == 0 ? 0 : -1;
+        valid = filter.is_active >= 0;
+    }
+    if (http_request_get_query(request, "username_prefix", username_prefix, sizeof(username_prefix)) == 0) {
+        filter.username_prefix = username_prefix;
+    }
+    if (http_request_get_query(request, "email_prefix", email_prefix, sizeof(email_prefix)) == 0) {
+        filter.email_prefix = email_prefix;
+    }
+    if (!valid) {
+        http_response_set_status(response, 400);
+        http_response_set_body(response, "{\"error\":\"Invalid limit, cursor, role or active parameter\"}");
         http_response_set_header(response, "Content-Type", "application/json");
         return;
     }
+    if (limit > AUTH_LIST_MAX_LIMIT) limit = AUTH_LIST_MAX_LIMIT;
     
-    strcpy(response_body, "{\"success\":true,\"users\":[");
-    
-    for (int i = 0; i < auth_context.user_count; i++) {
-        user_t *user = &auth_context.users[i];
-        char user_json[512];
-        snprintf(user_json, sizeof(user_json), 
-                "%s{\"id\":%d,\"username\":\"%s\",\"email\":\"%s\",\"role\":\"%s\",\"created_at\":%ld,\"last_login\":%ld,\"is_active\":%s}",
-                i > 0 ? "," : "", user->user_id, user->username, user->email, 
-                auth_get_role_name(user->role), user->created_at, user->last_login,
-                user->is_active ? "true" : "false");
-        strcat(response_body, user_json);
+    user_t *users = malloc((size_t)limit * sizeof(user_t));
+    int next_cursor = 0;
+    int count = users ? auth_list_users(&auth_context, &filter, cursor, limit, users, &next_cursor) : -1;
+    if (count < 0) {
+        free(users);
+        if (count == -2) {
+            http_response_set_status(response, 503);
+            http_response_set_header(response, "Retry-After", "1");
+            http_response_set_body(response, "{\"error\":\"User index is being built, try again later\"}");
+        } else if (count == -3) {
+            http_response_set_status(response, 400);
+            http_response_set_body(response, "{\"error\":\"Unknown cursor\"}");
+        } else {
+            http_response_set_status(response, 500);
+            http_response_set_body(response, "{\"error\":\"Memory allocation failed\"}");
+        }
+        http_response_set_header(response, "Content-Type", "application/json");
+        return;
     }
     
-    strcat(response_body, "]}");
-    
+    // Stream the page so the first users go out while the rest are encoded
     http_response_set_status(response, 200);
-    http_response_set_body(response, response_body);
     http_response_set_header(response, "Content-Type", "application/json");
+    if (http_response_stream_begin(request, response) != 0) {
+        free(users);
+        http_response_set_status(response, 500);
+        http_response_set_body(response, "{\"error\":\"Failed to start response\"}");
+        return;
+    }
     
-    free(response_body);
+    json_writer_t writer;
+    json_writer_init_stream(&writer, response_stream_write, response);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_key(&writer, "users");
+    json_write_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        user_t *user = &users[i];
+        json_write_begin_object(&writer);
+        json_write_field_int(&writer, "id", user->user_id);
+        json_write_field_string(&writer, "username", user->username);
+        json_write_field_string(&writer, "email", user->email);
+        json_write_field_string(&writer, "role", auth_get_role_name(user->role));
+        json_write_field_int(&writer, "created_at", user->created_at);
+        json_write_field_int(&writer, "last_login", user->last_login);
+        json_write_field_bool(&writer, "is_active", user->is_active);
+        json_write_end_object(&writer);
+    }
+    json_write_end_array(&writer);
+    json_write_key(&writer, "next_cursor");
+    if (next_cursor > 0) {
+        json_write_int(&writer, next_cursor);
+    } else {
+        json_write_null(&writer);
+    }
+    json_write_end_object(&writer);
+    // A failed flush leaves a truncated array, so cut the stream short
+    // instead of terminating it like a complete response
+    if (json_writer_finish(&writer) != 0) {
+        log_warning("User list response failed");
+        http_response_stream_abort(response);
+    } else {
+        http_response_stream_end(response);
+    }
+    json_writer_free(&writer);
+
+    free(users);
+}
+
+// IP address management API (admin only)
+
+#define API_OWNER_LIST_MAX 1024  // Allocations returned for one owner
+
+static void api_json_response(http_response_t *response, int status, const char *body) {
+    http_response_set_status(response, status);
+    http_response_set_body(response, body);
+    http_response_set_header(response, "Content-Type", "application/json");
+}
+
+// Parses the request body; handlers then read typed fields from doc
+static int api_parse_body(http_request_t *request, json_document_t *doc) {
+    const char *body = http_request_get_body(request);
+    return body ? json_parse(doc, body, strlen(body)) : -1;
+}
+
+static int api_body_int(const json_document_t *doc, const char *name, int *value) {
+    int64_t number;
+    if (json_get_int(doc, name, &number) != 0 || number < INT_MIN || number > INT_MAX) return -1;
+    *value = (int)number;
+    return 0;
+}
+
+// Names are kept printable: they appear in logs and the tab-separated export
+static int api_is_plain_string(const char *str) {
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\' || (unsigned char)*str < 0x20) return 0;
+    }
+    return 1;
+}
+
+// Writes the "pools" member shared by /api/ip/pools and the ipam topic;
+// -1 if out of memory
+static int json_write_ip_pools(json_writer_t *writer) {
+    address_pool_info_t *pools = malloc(MAX_POOLS * sizeof(address_pool_info_t));
+    int count = pools ? address_list_pools(&ip_context, pools, MAX_POOLS) : -1;
+    if (count < 0) {
+        free(pools);
+        return -1;
+    }
+
+    json_write_key(writer, "pools");
+    json_write_begin_array(writer);
+    for (int i = 0; i < count; i++) {
+        address_pool_info_t *pool = &pools[i];
+        uint32_t usable = pool->used_ips + pool->available_ips;
+        char network[INET_ADDRSTRLEN + 4];
+        snprintf(network, sizeof(network), "%s/%d", address_ip_to_string(pool->base_ip), pool->prefix_length);
+
+        json_write_begin_object(writer);
+        json_write_field_int(writer, "pool_number", pool->pool_number);
+        json_write_field_string(writer, "name", pool->pool_name);
+        json_write_field_string(writer, "network", network);
+        json_write_field_int(writer, "size", usable);
+        json_write_field_int(writer, "used", pool->used_ips);
+        json_write_field_int(writer, "available", pool->available_ips);
+        json_write_key(writer, "utilization");
+        json_write_fixed(writer, 100.0 * pool->used_ips / usable, 1);
+        json_write_end_object(writer);
+    }
+    json_write_end_array(writer);
+
+    free(pools);
+    return 0;
+}
+
+void handle_ip_pools(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    if (json_write_ip_pools(&writer) != 0) {
+        json_writer_free(&writer);
+        api_json_response(response, 500, "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+void handle_ip_pool_create(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    int pool_number;
+    char name[POOL_NAME_LENGTH], base_ip[INET_ADDRSTRLEN], netmask[INET_ADDRSTRLEN];
+    if (api_parse_body(request, &doc) != 0 ||
+        api_body_int(&doc, "pool_number", &pool_number) != 0 ||
+        json_get_string(&doc, "name", name, sizeof(name)) != 0 ||
+        json_get_string(&doc, "base_ip", base_ip, sizeof(base_ip)) != 0 ||
+        json_get_string(&doc, "netmask", netmask, sizeof(netmask)) != 0 ||
+        !api_is_plain_string(name)) {
+        api_json_response(response, 400,
+                "{\"error\":\"pool_number, name, base_ip and netmask required\"}");
+        return;
+    }
+
+    int result = address_create_pool(&ip_context, pool_number, name, base_ip, netmask);
+
+    char response_body[256];
+    if (result == 0) {
+        snprintf(response_body, sizeof(response_body),
+                "{\"success\":true,\"pool_number\":%d}", pool_number);
+        api_json_response(response, 201, response_body);
+        return;
+    }
+
+    const char *error_msg;
+    int status = 400;
+    switch (result) {
+        case -2: error_msg = "Invalid pool number"; break;
+        case -3: error_msg = "Pool already exists"; status = 409; break;
+        case -4: error_msg = "Maximum pools reached"; status = 409; break;
+        case -5: error_msg = "Invalid or unaligned base IP"; break;
+        case -6: error_msg = "Invalid netmask"; break;
+        case -7: error_msg = "Failed to save pool"; status = 500; break;
+        case -8: error_msg = "Pool overlaps an existing pool"; status = 409; break;
+        default: error_msg = "Pool creation failed"; break;
+    }
+    snprintf(response_body, sizeof(response_body),
+            "{\"success\":false,\"error\":\"%s\"}", error_msg);
+    api_json_response(response, status, response_body);
+}
+
+// Body: {"pool_number": N, "owner": "...", "sticky": true, "lease_seconds": N},
+// sticky and lease_seconds optional. A sticky allocation returns the owner's
+// previous address when it is still free; without a lease the address is
+// kept until it is released.
+void handle_ip_allocate(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    int pool_number;
+    char owner[ADDRESS_OWNER_LENGTH];
+    if (api_parse_body(request, &doc) != 0 ||
+        api_body_int(&doc, "pool_number", &pool_number) != 0 ||
+        json_get_string(&doc, "owner", owner, sizeof(owner)) != 0 ||
+        owner[0] == '\0' || !api_is_plain_string(owner)) {
+        api_json_response(response, 400, "{\"error\":\"pool_number and owner required\"}");
+        return;
+    }
+
+    int lease_seconds = 0;
+    if (json_find(&doc, 0, "lease_seconds") >= 0 &&
+        (api_body_int(&doc, "lease_seconds", &lease_seconds) != 0 || lease_seconds < 0)) {
+        api_json_response(response, 400, "{\"error\":\"lease_seconds must be a non-negative integer\"}");
+        return;
+    }
+
+    if (address_get_available_ips(&ip_context, pool_number) < 0) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Pool not found\"}");
+        return;
+    }
+
+    bool is_sticky = false;
+    json_get_bool(&doc, "sticky", &is_sticky);
+    unsigned int ip_address = address_allocate_leased(&ip_context, pool_number, owner,
+                                                      lease_seconds, is_sticky);
+    if (ip_address == 0) {
+        api_json_response(response, 409, "{\"success\":false,\"error\":\"No address available\"}");
+        return;
+    }
+
+    ip_t ip;
+    time_t expires_at = address_get_ip(&ip_context, ip_address, &ip) == 0 ? ip.expires_at : 0;
+
+    char response_body[256];
+    snprintf(response_body, sizeof(response_body),
+            "{\"success\":true,\"ip\":\"%s\",\"pool_number\":%d,\"expires_at\":%ld}",
+            address_ip_to_string(ip_address), pool_number, (long)expires_at);
+    api_json_response(response, 201, response_body);
+}
+
+void handle_ip_release(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    char ip_str[INET_ADDRSTRLEN];
+    unsigned int ip_address = 0;
+    if (api_parse_body(request, &doc) == 0 && json_get_string(&doc, "ip", ip_str, sizeof(ip_str)) == 0) {
+        ip_address = address_string_to_ip(ip_str);
+    }
+    if (ip_address == 0) {
+        api_json_response(response, 400, "{\"error\":\"Valid ip required\"}");
+        return;
+    }
+
+    int result = address_release_ip(&ip_context, ip_address);
+    if (result == 0) {
+        api_json_response(response, 200, "{\"success\":true}");
+    } else if (result == -3) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Address not allocated\"}");
+    } else {
+        api_json_response(response, 500, "{\"success\":false,\"error\":\"Failed to save release\"}");
+    }
+}
+
+// Body: {"ip": "...", "expires_at": <unix time>}; 0 makes the allocation permanent
+void handle_ip_renew(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    char ip_str[INET_ADDRSTRLEN];
+    int64_t expiry;
+    unsigned int ip_address = 0;
+    if (api_parse_body(request, &doc) == 0 &&
+        json_get_string(&doc, "ip", ip_str, sizeof(ip_str)) == 0 &&
+        json_get_int(&doc, "expires_at", &expiry) == 0) {
+        ip_address = address_string_to_ip(ip_str);
+    }
+    if (ip_address == 0) {
+        api_json_response(response, 400, "{\"error\":\"Valid ip and expires_at required\"}");
+        return;
+    }
+
+    int result = address_renew_allocation(&ip_context, ip_address, (time_t)expiry);
+    if (result == 0) {
+        api_json_response(response, 200, "{\"success\":true}");
+    } else if (result == -3) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Address not allocated\"}");
+    } else if (result == -4) {
+        api_json_response(response, 400, "{\"success\":false,\"error\":\"Expiry is in the past\"}");
+    } else {
+        api_json_response(response, 500, "{\"success\":false,\"error\":\"Failed to save renewal\"}");
+    }
+}
+
+// GET /api/ip/lookup?ip=10.0.0.5
+void handle_ip_lookup(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    char ip_str[INET_ADDRSTRLEN];
+    unsigned int ip_address = 0;
+    if (http_request_get_query(request, "ip", ip_str, sizeof(ip_str)) == 0) {
+        ip_address = address_string_to_ip(ip_str);
+    }
+    if (ip_address == 0) {
+        api_json_response(response, 400, "{\"error\":\"Valid ip query parameter required\"}");
+        return;
+    }
+
+    ip_t ip;
+    if (address_get_ip(&ip_context, ip_address, &ip) != 0) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Address is not in any pool\"}");
+        return;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_field_string(&writer, "ip", address_ip_to_string(ip.ip_address));
+    json_write_field_int(&writer, "pool_number", ip.pool_number);
+    json_write_field_bool(&writer, "used", ip.is_used);
+    json_write_field_string(&writer, "allocated_to", ip.allocated_to);
+    json_write_field_int(&writer, "allocation_time", ip.allocation_time);
+    json_write_field_int(&writer, "expires_at", ip.expires_at);
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+// GET /api/ip/owner?owner=vps-42 lists one owner's allocations
+void handle_ip_owner(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    char owner[ADDRESS_OWNER_LENGTH];
+    if (http_request_get_query(request, "owner", owner, sizeof(owner)) != 0 ||
+        owner[0] == '\0' || !api_is_plain_string(owner)) {
+        api_json_response(response, 400, "{\"error\":\"owner query parameter required\"}");
+        return;
+    }
+
+    ip_t *ips = malloc(API_OWNER_LIST_MAX * sizeof(ip_t));
+    int count = ips ? address_list_owner(&ip_context, owner, ips, API_OWNER_LIST_MAX) : -1;
+    if (count < 0) {
+        free(ips);
+        api_json_response(response, 500, "{\"error\":\"Memory allocation failed\"}");
+        return;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_field_string(&writer, "owner", owner);
+    json_write_key(&writer, "allocations");
+    json_write_begin_array(&writer);
+    for (int i = 0; i < count; i++) {
+        json_write_begin_object(&writer);
+        json_write_field_string(&writer, "ip", address_ip_to_string(ips[i].ip_address));
+        json_write_field_int(&writer, "pool_number", ips[i].pool_number);
+        json_write_field_int(&writer, "allocation_time", ips[i].allocation_time);
+        json_write_field_int(&writer, "expires_at", ips[i].expires_at);
+        json_write_end_object(&writer);
+    }
+    json_write_end_array(&writer);
+    json_write_end_object(&writer);
+
+    free(ips);
+    json_writer_respond(response, 200, &writer);
+}
+
+// GET /api/ip/export?format=text|binary streams every allocation in the
+// formats of --export-ips. Pool creation and deletion wait until it is done.
+void handle_ip_export(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    char format_str[8];
+    int format = ADDRESS_FORMAT_TEXT;
+    if (http_request_get_query(request, "format", format_str, sizeof(format_str)) == 0) {
+        if (strcmp(format_str, "binary") == 0) {
+            format = ADDRESS_FORMAT_BINARY;
+        } else if (strcmp(format_str, "text") != 0) {
+            api_json_response(response, 400, "{\"error\":\"format must be text or binary\"}");
+            return;
+        }
+    }
+
+    http_response_set_status(response, 200);
+    http_response_set_header(response, "Content-Type",
+                             format == ADDRESS_FORMAT_BINARY ? "application/octet-stream"
+                                                             : "text/tab-separated-values");
+    if (http_response_stream_begin(request, response) != 0) {
+        api_json_response(response, 500, "{\"error\":\"Failed to start response\"}");
+        return;
+    }
+
+    // A failure part way through can only be signalled by cutting the stream
+    // short: the terminating chunk is not sent
+    if (address_export(&ip_context, format, response_stream_write, response) != 0) {
+        log_warning("IP export over HTTP failed");
+        http_response_stream_abort(response);
+        return;
+    }
+    http_response_stream_end(response);
+}
+
+// IPv6 prefix delegation API (admin only)
+
+// Body: {"pool_number": N, "name": "...", "prefix": "2001:db8::/48", "delegated_length": 64}
+void handle_ip6_pool_create(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    int pool_number, delegated_length;
+    char name[POOL_NAME_LENGTH], prefix[INET6_ADDRSTRLEN + 4];
+    if (api_parse_body(request, &doc) != 0 ||
+        api_body_int(&doc, "pool_number", &pool_number) != 0 ||
+        json_get_string(&doc, "name", name, sizeof(name)) != 0 ||
+        json_get_string(&doc, "prefix", prefix, sizeof(prefix)) != 0 ||
+        api_body_int(&doc, "delegated_length", &delegated_length) != 0 ||
+        !api_is_plain_string(name)) {
+        api_json_response(response, 400,
+                "{\"error\":\"pool_number, name, prefix and delegated_length required\"}");
+        return;
+    }
+
+    int result = address6_create_pool(&ip6_context, pool_number, name, prefix, delegated_length);
+
+    char response_body[256];
+    if (result == 0) {
+        snprintf(response_body, sizeof(response_body),
+                "{\"success\":true,\"pool_number\":%d}", pool_number);
+        api_json_response(response, 201, response_body);
+        return;
+    }
+
+    const char *error_msg;
+    int status = 400;
+    switch (result) {
+        case -2: error_msg = "Invalid pool number"; break;
+        case -3: error_msg = "Pool already exists"; status = 409; break;
+        case -5: error_msg = "Invalid or unaligned prefix"; break;
+        case -6: error_msg = "Invalid delegated length"; break;
+        case -7: error_msg = "Failed to save pool"; status = 500; break;
+        case -8: error_msg = "Pool overlaps an existing pool"; status = 409; break;
+        default: error_msg = "Pool creation failed"; status = 500; break;
+    }
+    snprintf(response_body, sizeof(response_body),
+            "{\"success\":false,\"error\":\"%s\"}", error_msg);
+    api_json_response(response, status, response_body);
 }
 
+// Body: {"pool_number": N, "owner": "..."}
+void handle_ip6_allocate(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
 
+    json_document_t doc;
+    int pool_number;
+    char owner[ADDRESS_OWNER_LENGTH];
+    if (api_parse_body(request, &doc) != 0 ||
+        api_body_int(&doc, "pool_number", &pool_number) != 0 ||
+        json_get_string(&doc, "owner", owner, sizeof(owner)) != 0 ||
+        owner[0] == '\0' || !api_is_plain_string(owner)) {
+        api_json_response(response, 400, "{\"error\":\"pool_number and owner required\"}");
+        return;
+    }
 
+    struct in6_addr prefix;
+    int prefix_length;
+    int result = address6_allocate(&ip6_context, pool_number, owner, &prefix, &prefix_length);
+    if (result == -2) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Pool not found\"}");
+        return;
+    }
+    if (result == -3) {
+        api_json_response(response, 409, "{\"success\":false,\"error\":\"No prefix available\"}");
+        return;
+    }
+    if (result != 0) {
+        api_json_response(response, 500, "{\"success\":false,\"error\":\"Failed to save allocation\"}");
+        return;
+    }
 
+    char response_body[256];
+    snprintf(response_body, sizeof(response_body),
+            "{\"success\":true,\"prefix\":\"%s\",\"pool_number\":%d}",
+            address6_prefix_to_string(&prefix, prefix_length), pool_number);
+    api_json_response(response, 201, response_body);
+}
 
+// Body: {"prefix": "2001:db8:0:5::/64"}
+void handle_ip6_release(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
 
-int main() {
+    json_document_t doc;
+    char prefix_str[INET6_ADDRSTRLEN + 4];
+    struct in6_addr prefix;
+    int prefix_length;
+    if (api_parse_body(request, &doc) != 0 ||
+        json_get_string(&doc, "prefix", prefix_str, sizeof(prefix_str)) != 0 ||
+        address6_string_to_prefix(prefix_str, &prefix, &prefix_length) != 0) {
+        api_json_response(response, 400, "{\"error\":\"Valid prefix required\"}");
+        return;
+    }
+
+    int result = address6_release(&ip6_context, &prefix);
+    if (result == 0) {
+        api_json_response(response, 200, "{\"success\":true}");
+    } else if (result == -3) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Prefix not allocated\"}");
+    } else {
+        api_json_response(response, 500, "{\"success\":false,\"error\":\"Failed to save release\"}");
+    }
+}
+
+// GET /api/ip6/lookup?address=2001:db8:0:5::1
+void handle_ip6_lookup(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    char address_str[INET6_ADDRSTRLEN + 4];
+    struct in6_addr address;
+    int prefix_length;
+    if (http_request_get_query(request, "address", address_str, sizeof(address_str)) != 0 ||
+        address6_string_to_prefix(address_str, &address, &prefix_length) != 0) {
+        api_json_response(response, 400, "{\"error\":\"Valid address query parameter required\"}");
+        return;
+    }
+
+    ip6_t ip;
+    if (address6_lookup(&ip6_context, &address, &ip) != 0) {
+        api_json_response(response, 404, "{\"success\":false,\"error\":\"Address is not in any pool\"}");
+        return;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_field_string(&writer, "prefix", address6_prefix_to_string(&ip.prefix, ip.prefix_length));
+    json_write_field_int(&writer, "pool_number", ip.pool_number);
+    json_write_field_bool(&writer, "used", ip.is_used);
+    json_write_field_string(&writer, "allocated_to", ip.allocated_to);
+    json_write_field_int(&writer, "allocation_time", ip.allocation_time);
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+// WebSocket routes. Dashboards connect to /ws, get the server status
+// straight away and may then send {"subscribe": "<topic>"} or
+// {"unsubscribe": "<topic>"}.
+
+static void socket_reply(websocket_conn_t *conn, json_writer_t *writer) {
+    if (json_writer_finish(writer) == 0) {
+        websocket_send(conn, WS_OPCODE_TEXT, writer->data, writer->length);
+    }
+    json_writer_free(writer);
+}
+
+static void dashboard_socket_open(websocket_server_t *server, websocket_conn_t *conn) {
+    (void)server;
+    websocket_send(conn, WS_OPCODE_TEXT, status_json, sizeof(status_json) - 1);
+}
+
+static void dashboard_socket_message(websocket_server_t *server, websocket_conn_t *conn,
+                                     int opcode, const uint8_t *data, size_t length) {
+    json_document_t doc;
+    char name[WS_TOPIC_NAME];
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+
+    bool subscribe = false;
+    if (opcode == WS_OPCODE_TEXT && json_parse(&doc, (const char *)data, length) == 0) {
+        subscribe = json_get_string(&doc, "subscribe", name, sizeof(name)) == 0;
+        if (!subscribe && json_get_string(&doc, "unsubscribe", name, sizeof(name)) != 0) {
+            name[0] = '\0';
+        }
+    } else {
+        name[0] = '\0';
+    }
+
+    int topic = websocket_topic_find(server, name);
+    if (!name[0]) {
+        json_write_field_string(&writer, "error", "Expected {\"subscribe\": \"<topic>\"} or {\"unsubscribe\": \"<topic>\"}");
+    } else if (topic < 0 || (subscribe && websocket_subscribe(conn, topic) != 0)) {
+        json_write_field_string(&writer, "error", "Unknown topic or access denied");
+    } else {
+        if (!subscribe) websocket_unsubscribe(conn, topic);
+        json_write_field_string(&writer, subscribe ? "subscribed" : "unsubscribed", name);
+    }
+
+    json_write_end_object(&writer);
+    socket_reply(conn, &writer);
+}
+
+void handle_websocket(http_request_t *request, http_response_t *response) {
+    uint32_t allowed_topics = 1u << notices_topic;
+
+    // Admin clients may follow IP pool utilization too. Browsers cannot
+    // send an Authorization header with a WebSocket, so dashboards only
+    // see public topics.
+    if (http_request_get_header(request, "Authorization")) {
+        http_response_t *scratch = http_response_create();
+        if (scratch && auth_require_admin(request, scratch, &auth_context) >= 0) {
+            allowed_topics |= 1u << ipam_topic;
+        }
+        http_response_destroy(scratch);
+    }
+
+    websocket_upgrade(&websocket_server, request, response, allowed_topics);
+}
+
+// Body: {"message": "..."}; sent to every notices subscriber
+void handle_notice(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_document_t doc;
+    char message[1024];
+    if (api_parse_body(request, &doc) != 0 ||
+        json_get_string(&doc, "message", message, sizeof(message)) != 0 || !message[0]) {
+        api_json_response(response, 400, "{\"error\":\"message required\"}");
+        return;
+    }
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_string(&writer, "topic", "notices");
+    json_write_field_string(&writer, "message", message);
+    json_write_end_object(&writer);
+    if (json_writer_finish(&writer) != 0 ||
+        websocket_publish(&websocket_server, notices_topic, WS_OPCODE_TEXT, writer.data, writer.length) != 0) {
+        json_writer_free(&writer);
+        api_json_response(response, 500, "{\"error\":\"Failed to publish notice\"}");
+        return;
+    }
+    json_writer_free(&writer);
+
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_field_int(&writer, "subscribers", websocket_topic_subscribers(&websocket_server, notices_topic));
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+// GET /api/ws/stats: connections, and per topic the fan-out counters and
+// publish-to-delivery latency in microseconds
+void handle_websocket_stats(http_request_t *request, http_response_t *response) {
+    if (auth_require_admin(request, response, &auth_context) < 0) return;
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_bool(&writer, "success", true);
+    json_write_field_int(&writer, "connections", websocket_connection_count(&websocket_server));
+    json_write_key(&writer, "topics");
+    json_write_begin_array(&writer);
+    for (int i = 0; i < websocket_server.topic_count; i++) {
+        websocket_topic_stats_t stats;
+        if (websocket_topic_stats(&websocket_server, i, &stats) != 0) continue;
+
+        json_write_begin_object(&writer);
+        json_write_field_string(&writer, "name", websocket_server.topics[i].name);
+        json_write_field_string(&writer, "policy",
+                                websocket_server.topics[i].policy == WS_POLICY_COALESCE ? "coalesce" : "drop");
+        json_write_field_int(&writer, "subscribers", stats.subscribers);
+        json_write_key(&writer, "published");
+        json_write_uint(&writer, stats.published);
+        json_write_key(&writer, "delivered");
+        json_write_uint(&writer, stats.delivered);
+        json_write_key(&writer, "coalesced");
+        json_write_uint(&writer, stats.coalesced);
+        json_write_key(&writer, "dropped");
+        json_write_uint(&writer, stats.dropped);
+        json_write_key(&writer, "latency_us");
+        json_write_begin_object(&writer);
+        json_write_key(&writer, "avg");
+        json_write_uint(&writer, stats.latency_avg_us);
+        json_write_key(&writer, "p99");
+        json_write_uint(&writer, stats.latency_p99_us);
+        json_write_key(&writer, "max");
+        json_write_uint(&writer, stats.latency_max_us);
+        json_write_end_object(&writer);
+        json_write_end_object(&writer);
+    }
+    json_write_end_array(&writer);
+    json_write_end_object(&writer);
+    json_writer_respond(response, 200, &writer);
+}
+
+// Pushes pool utilization to ipam subscribers; called from main()'s loop
+static void publish_ip_pools(void) {
+    if (websocket_topic_subscribers(&websocket_server, ipam_topic) == 0) return;
+
+    json_writer_t writer;
+    json_writer_init(&writer);
+    json_write_begin_object(&writer);
+    json_write_field_string(&writer, "topic", "ipam");
+    if (json_write_ip_pools(&writer) == 0) {
+        json_write_end_object(&writer);
+        if (json_writer_finish(&writer) == 0) {
+            websocket_publish(&websocket_server, ipam_topic, WS_OPCODE_TEXT, writer.data, writer.length);
+        }
+    }
+    json_writer_free(&writer);
+}
+
+// Offline bulk transfer of the IP allocations, e.g. to migrate from another
+// IPAM: --import-ips FILE or --export-ips FILE, with --binary for the compact
+// format. "-" is stdin or stdout. Run with the server stopped.
+static int bulk_write_file(void *ctx, const void *data, size_t length) {
+    return fwrite(data, 1, length, (FILE *)ctx) == length ? 0 : -1;
+}
+
+static int run_ip_bulk(const char *command, const char *path, int format) {
+    int import = strcmp(command, "--import-ips") == 0;
+    bool standard = strcmp(path, "-") == 0;
+    FILE *file = standard ? (import ? stdin : stdout) : fopen(path, import ? "rb" : "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+
+    if (address_init(&ip_context) != 0) {
+        fprintf(stderr, "Failed to initialize IP address management\n");
+        if (!standard) fclose(file);
+        return 1;
+    }
+
+    int rc;
+    if (import) {
+        address_import_stats_t stats;
+        rc = address_import(&ip_context, file, format, &stats);
+        fprintf(stderr, "Imported %llu, already allocated %llu, invalid %llu",
+                (unsigned long long)stats.imported, (unsigned long long)stats.conflicts,
+                (unsigned long long)stats.invalid);
+        if (stats.first_invalid) {
+            fprintf(stderr, " (first at record %llu)", (unsigned long long)stats.first_invalid);
+        }
+        fprintf(stderr, "\n");
+    } else {
+        rc = address_export(&ip_context, format, bulk_write_file, file);
+        if (fflush(file) != 0) rc = -1;
+    }
+
+    address_cleanup(&ip_context);
+    if (!standard && fclose(file) != 0) rc = -1;
+    if (rc != 0) fprintf(stderr, "IP %s failed\n", import ? "import" : "export");
+    return rc == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
     // Initialize logger
     if (logger_init("server.log") != 0) {
         fprintf(stderr, "Failed to initialize logger\n");
         return 1;
     }
+
+    if (argc >= 3 && (strcmp(argv[1], "--import-ips") == 0 || strcmp(argv[1], "--export-ips") == 0)) {
+        int format = argc >= 4 && strcmp(argv[3], "--binary") == 0 ? ADDRESS_FORMAT_BINARY
+                                                                   : ADDRESS_FORMAT_TEXT;
+        int rc = run_ip_bulk(argv[1], argv[2], format);
+        logger_cleanup();
+        return rc;
+    }
     
     log_info("Starting Advanced C Web Server...");
     
@@ -428,7 +1232,35 @@ int main() {
         log_error("Failed to initialize authentication system");
         return 1;
     }
+    auth_context.signed_tokens = signedTokenMode;
+    if (sharedSessionMode) {
+        auth_enable_shared_sessions(&auth_context, AUTH_SHARED_SESSIONS_NAME);
+    }
     
+    // Initialize IP address management
+    if (address_init(&ip_context) != 0) {
+        log_error("Failed to initialize IP address management");
+        return 1;
+    }
+    if (address6_init(&ip6_context) != 0) {
+        log_error("Failed to initialize IPv6 address management");
+        return 1;
+    }
+    
+    if (websocket_server_init(&websocket_server, dashboard_socket_open, dashboard_socket_message, NULL) != 0) {
+        log_error("Failed to start WebSocket event loop");
+        return 1;
+    }
+    // A client that falls behind only needs the latest utilization, but
+    // must not miss notices
+    ipam_topic = websocket_topic_create(&websocket_server, "ipam", WS_POLICY_COALESCE);
+    notices_topic = websocket_topic_create(&websocket_server, "notices", WS_POLICY_DROP);
+    // Handlers shift by the topic ids to build subscription masks
+    if (ipam_topic < 0 || notices_topic < 0) {
+        log_error("Failed to create WebSocket topics");
+        return 1;
+    }
+
     // Set up signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -447,6 +1279,7 @@ int main() {
     router_add_route(server->router, "GET", "/api/status", handle_api_status);
     router_add_route(server->router, "POST", "/submit", handle_post_data);
     router_add_route(server->router, "GET", "/server", handle_server);
+    router_add_route(server->router, "GET", "/ws", handle_websocket);
 
     
     // Authentication routes
@@ -456,6 +1289,24 @@ int main() {
     router_add_route(server->router, "GET", "/api/profile", handle_profile);
     router_add_route(server->router, "GET", "/api/users", handle_users);
     
+    // IP address management routes
+    router_add_route(server->router, "GET", "/api/ip/pools", handle_ip_pools);
+    router_add_route(server->router, "POST", "/api/ip/pools", handle_ip_pool_create);
+    router_add_route(server->router, "POST", "/api/ip/allocate", handle_ip_allocate);
+    router_add_route(server->router, "POST", "/api/ip/release", handle_ip_release);
+    router_add_route(server->router, "POST", "/api/ip/renew", handle_ip_renew);
+    router_add_route(server->router, "GET", "/api/ip/lookup", handle_ip_lookup);
+    router_add_route(server->router, "GET", "/api/ip/owner", handle_ip_owner);
+    router_add_route(server->router, "GET", "/api/ip/export", handle_ip_export);
+    router_add_route(server->router, "POST", "/api/ip6/pools", handle_ip6_pool_create);
+    router_add_route(server->router, "POST", "/api/ip6/allocate", handle_ip6_allocate);
+    router_add_route(server->router, "POST", "/api/ip6/release", handle_ip6_release);
+    router_add_route(server->router, "GET", "/api/ip6/lookup", handle_ip6_lookup);
+    
+    // WebSocket pub/sub routes
+    router_add_route(server->router, "POST", "/api/notices", handle_notice);
+    router_add_route(server->router, "GET", "/api/ws/stats", handle_websocket_stats);
+    
     // Maintenance Check.
     if (maintenanceMode) {
         router_add_route(server->router, "GET", "/", handle_maintenance);
@@ -471,11 +1322,22 @@ int main() {
     log_info("  GET  / - Home page");
     log_info("  GET  /api/status - Server status API");
     log_info("  POST /submit - Handle form submissions");
+    log_info("  GET  /ws - WebSocket status updates and topic subscriptions");
     log_info("  POST /api/register - User registration");
     log_info("  POST /api/login - User authentication");
     log_info("  POST /api/logout - User logout");
     log_info("  GET  /api/profile - User profile (requires auth)");
-    log_info("  GET  /api/users - List all users (admin only)");
+    log_info("  GET  /api/users - List users, paginated and filtered (admin only)");
+    log_info("  GET  /api/ip/pools - IP pools and utilization (admin only)");
+    log_info("  POST /api/ip/pools - Create an IP pool (admin only)");
+    log_info("  POST /api/ip/allocate, /api/ip/release, /api/ip/renew - IP allocations (admin only)");
+    log_info("  GET  /api/ip/lookup?ip= - Look up an IP (admin only)");
+    log_info("  GET  /api/ip/owner?owner= - One owner's allocations (admin only)");
+    log_info("  GET  /api/ip/export?format= - Stream all IP allocations (admin only)");
+    log_info("  POST /api/ip6/pools, /api/ip6/allocate, /api/ip6/release - IPv6 prefixes (admin only)");
+    log_info("  GET  /api/ip6/lookup?address= - Look up an IPv6 address (admin only)");
+    log_info("  POST /api/notices - Publish a notice to WebSocket clients (admin only)");
+    log_info("  GET  /api/ws/stats - WebSocket topics and delivery latency (admin only)");
     log_info("  Static files served from /static");
     
     // Start server
@@ -487,13 +1349,23 @@ int main() {
     
     log_info("Server started successfully on http://0.0.0.0:5000");
     
-    // Keep main thread alive
-    while (1) {
+    // Keep main thread alive, pushing pool utilization as it goes
+    unsigned int ticks = 0;
+    while (!shutdownRequested) {
         sleep(1);
+        if (++ticks % IPAM_PUBLISH_INTERVAL == 0) {
+            publish_ip_pools();
+        }
     }
     
-    // Cleanup
+    log_info("Received shutdown signal, stopping server...");
+    http_server_stop(server);
+    websocket_server_cleanup(&websocket_server);
+    
+    // Cleanup; this persists users, sessions and IP pools
     auth_cleanup(&auth_context);
+    address_cleanup(&ip_context);
+    address6_cleanup(&ip6_context);
     http_server_destroy(server);
     logger_cleanup();
     
@@ -175,9 +175,10 @@ void router_handle_request(router_t *router, http_request_t *request, http_respo
 int route_matches(const char *pattern, const char *path) {
     if (!pattern || !path) return 0;
     
-    // Simple exact match for now
+    // Exact match on the path; the query string is left to the handler
     // TODO: Implement wildcard and parameter matching
-    return strcmp(pattern, path) == 0;
+    size_t path_length = strcspn(path, "?");
+    return strlen(pattern) == path_length && strncmp(pattern, path, path_length) == 0;
 }
 
 void handle_static_file(const char *file_path, http_response_t *response) {
@@ -0,0 +1,342 @@
+#include "session_shm.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define SESSION_SHM_READY_WAIT_MS 2000
+
+static size_t session_shm_size(uint32_t capacity) {
+    return sizeof(session_shm_header_t) + (size_t)capacity * sizeof(session_shm_slot_t);
+}
+
+// Used while waiting for another process to finish creating the table
+static void session_shm_pause_ms(void) {
+    struct timespec delay = { 0, 1000000 };
+    nanosleep(&delay, NULL);
+}
+
+static void session_shm_slot_begin(session_shm_slot_t *slot) {
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void session_shm_slot_end(session_shm_slot_t *slot) {
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Takes the writer lock. A previous owner that died mid-write can only have
+// left slots with an odd seq; those are turned into tombstones.
+static int session_shm_lock(session_shm_t *shm) {
+    int rc = pthread_mutex_lock(&shm->header->lock);
+    if (rc == 0) return 0;
+    if (rc != EOWNERDEAD) return -1;
+
+    log_warning("Session table owner died while writing, repairing");
+    for (uint32_t i = 0; i < shm->header->capacity; i++) {
+        session_shm_slot_t *slot = &shm->slots[i];
+        if (slot->seq & 1) {
+            slot->state = SESSION_SHM_DELETED;
+            slot->session.is_valid = 0;
+            __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    pthread_mutex_consistent(&shm->header->lock);
+    return 0;
+}
+
+static int session_shm_init_header(session_shm_header_t *header, uint32_t capacity) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc != 0) return -1;
+
+    header->magic = SESSION_SHM_MAGIC;
+    header->version = SESSION_SHM_VERSION;
+    header->slot_size = sizeof(session_shm_slot_t);
+    header->capacity = capacity;
+    header->active = 0;
+    __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+session_shm_t *session_shm_open(const char *name, uint32_t capacity) {
+    if (!name || capacity == 0 || (capacity & (capacity - 1)) != 0) return NULL;
+
+    session_shm_t *shm = malloc(sizeof(session_shm_t));
+    if (!shm) {
+        log_error("Failed to allocate memory for shared session table");
+        return NULL;
+    }
+    memset(shm, 0, sizeof(session_shm_t));
+    strncpy(shm->name, name, sizeof(shm->name) - 1);
+
+    // Exactly one process wins the exclusive create and initializes the table
+    int creator = 1;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        creator = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        log_error("Failed to open shared session table %s: %s", name, strerror(errno));
+        free(shm);
+        return NULL;
+    }
+
+    if (creator) {
+        shm->map_size = session_shm_size(capacity);
+        if (ftruncate(fd, (off_t)shm->map_size) != 0) {
+            log_error("Failed to size shared session table %s: %s", name, strerror(errno));
+            close(fd);
+            shm_unlink(name);
+            free(shm);
+            return NULL;
+        }
+    } else {
+        // The creator may not have sized the region yet
+        struct stat st;
+        int waited = 0;
+        while (fstat(fd, &st) == 0 && st.st_size == 0 && waited < SESSION_SHM_READY_WAIT_MS) {
+            session_shm_pause_ms();
+            waited++;
+        }
+        if (st.st_size < (off_t)sizeof(session_shm_header_t)) {
+            log_error("Shared session table %s was never initialized", name);
+            close(fd);
+            free(shm);
+            return NULL;
+        }
+        shm->map_size = (size_t)st.st_size;
+    }
+
+    void *map = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_error("Failed to map shared session table %s: %s", name, strerror(errno));
+        if (creator) shm_unlink(name);
+        free(shm);
+        return NULL;
+    }
+
+    shm->header = (session_shm_header_t *)map;
+    shm->slots = (session_shm_slot_t *)((char *)map + sizeof(session_shm_header_t));
+
+    if (creator) {
+        if (session_shm_init_header(shm->header, capacity) != 0) {
+            log_error("Failed to initialize shared session table lock");
+            session_shm_close(shm);
+            shm_unlink(name);
+            return NULL;
+        }
+    } else {
+        int waited = 0;
+        while (!__atomic_load_n(&shm->header->ready, __ATOMIC_ACQUIRE) &&
+               waited < SESSION_SHM_READY_WAIT_MS) {
+            session_shm_pause_ms();
+            waited++;
+        }
+
+        session_shm_header_t *header = shm->header;
+        if (!header->ready || header->magic != SESSION_SHM_MAGIC ||
+            header->version != SESSION_SHM_VERSION ||
+            header->slot_size != sizeof(session_shm_slot_t) ||
+            shm->map_size < session_shm_size(header->capacity)) {
+            log_error("Shared session table %s is incompatible with this build", name);
+            session_shm_close(shm);
+            return NULL;
+        }
+    }
+
+    log_info("Shared session table %s %s with %u slots", name,
+             creator ? "created" : "attached", shm->header->capacity);
+    return shm;
+}
+
+void session_shm_close(session_shm_t *shm) {
+    if (!shm) return;
+
+    if (shm->header) {
+        munmap(shm->header, shm->map_size);
+    }
+    free(shm);
+}
+
+int session_shm_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+// Removes the live session in slot index. The slot becomes a tombstone, or
+// empty if the next slot is empty, in which case tombstones right before it
+// are reclaimed too. The caller holds the lock.
+static void session_shm_release(session_shm_t *shm, uint32_t index) {
+    uint32_t mask = shm->header->capacity - 1;
+    session_shm_slot_t *slot = &shm->slots[index];
+
+    session_shm_slot_begin(slot);
+    slot->session.is_valid = 0;
+    slot->state = SESSION_SHM_DELETED;
+    session_shm_slot_end(slot);
+    shm->header->active--;
+
+    while (slot->state == SESSION_SHM_DELETED &&
+           shm->slots[(index + 1) & mask].state == SESSION_SHM_EMPTY) {
+        session_shm_slot_begin(slot);
+        slot->state = SESSION_SHM_EMPTY;
+        session_shm_slot_end(slot);
+        index = (index - 1) & mask;
+        slot = &shm->slots[index];
+    }
+}
+
+// Stores a new session in the first free, deleted or expired slot on its
+// probe path. Returns -1 when the table is full.
+int session_shm_insert(session_shm_t *shm, uint64_t hash, const session_t *session) {
+    if (!shm || !session) return -1;
+    if (session_shm_lock(shm) != 0) return -1;
+
+    uint32_t mask = shm->header->capacity - 1;
+    time_t now = session->created_at;
+    int rc = -1;
+
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        session_shm_slot_t *slot = &shm->slots[(hash + probe) & mask];
+        if (slot->state == SESSION_SHM_LIVE && slot->session.is_valid &&
+            now < slot->session.expires_at) {
+            continue;
+        }
+
+        if (slot->state == SESSION_SHM_LIVE && slot->session.is_valid) {
+            shm->header->active--;  // Overwriting an expired session
+        }
+
+        session_shm_slot_begin(slot);
+        slot->hash = hash;
+        slot->session = *session;
+        slot->state = SESSION_SHM_LIVE;
+        session_shm_slot_end(slot);
+
+        shm->header->active++;
+        rc = 0;
+        break;
+    }
+
+    pthread_mutex_unlock(&shm->header->lock);
+    return rc;
+}
+
+// Lock-free: a slot read that overlapped a writer is simply retried
+int session_shm_lookup(session_shm_t *shm, uint64_t hash, const char *token, session_t *session_out) {
+    if (!shm || !token) return -1;
+
+    uint32_t mask = shm->header->capacity - 1;
+
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        session_shm_slot_t *slot = &shm->slots[(hash + probe) & mask];
+        unsigned int before, after;
+        uint32_t state;
+        uint64_t slot_hash;
+        session_t session;
+        int matched;
+
+        do {
+            before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if (before & 1) continue;
+            state = slot->state;
+            slot_hash = slot->hash;
+            matched = state == SESSION_SHM_LIVE && slot_hash == hash;
+            if (matched) memcpy(&session, &slot->session, sizeof(session_t));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            after = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+        } while ((before & 1) || before != after);
+
+        if (state == SESSION_SHM_EMPTY) return -1;
+        if (matched && strncmp(session.token, token, sizeof(session.token)) == 0) {
+            if (session_out) *session_out = session;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int session_shm_invalidate(session_shm_t *shm, uint64_t hash, const char *token) {
+    if (!shm || !token) return -1;
+    if (session_shm_lock(shm) != 0) return -1;
+
+    uint32_t mask = shm->header->capacity - 1;
+    int rc = -1;
+
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        session_shm_slot_t *slot = &shm->slots[(hash + probe) & mask];
+        if (slot->state == SESSION_SHM_EMPTY) break;
+        if (slot->state != SESSION_SHM_LIVE || slot->hash != hash ||
+            strncmp(slot->session.token, token, sizeof(slot->session.token)) != 0) {
+            continue;
+        }
+
+        if (slot->session.is_valid) {
+            session_shm_release(shm, (uint32_t)((hash + probe) & mask));
+            rc = 0;
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&shm->header->lock);
+    return rc;
+}
+
+// Turns tombstones back into empty slots where no probe chain can run
+// through them: any tombstone directly followed by an empty slot. Walking
+// backwards from each empty slot clears whole runs; the caller holds the lock.
+static void session_shm_sweep(session_shm_t *shm) {
+    uint32_t capacity = shm->header->capacity;
+    uint32_t mask = capacity - 1;
+    uint32_t start = 0;
+
+    while (start < capacity && shm->slots[start].state != SESSION_SHM_EMPTY) start++;
+    if (start == capacity) return;  // No empty slot to anchor on
+
+    int after_empty = 1;
+    for (uint32_t step = 1; step <= capacity; step++) {
+        session_shm_slot_t *slot = &shm->slots[(start - step) & mask];
+        if (slot->state == SESSION_SHM_DELETED && after_empty) {
+            session_shm_slot_begin(slot);
+            slot->state = SESSION_SHM_EMPTY;
+            session_shm_slot_end(slot);
+        } else {
+            after_empty = slot->state == SESSION_SHM_EMPTY;
+        }
+    }
+}
+
+// Turns expired sessions into tombstones and reclaims the tombstones it can.
+// Returns how many sessions were expired.
+int session_shm_expire(session_shm_t *shm, time_t now) {
+    if (!shm) return 0;
+    if (session_shm_lock(shm) != 0) return 0;
+
+    int expired = 0;
+    for (uint32_t i = 0; i < shm->header->capacity; i++) {
+        session_shm_slot_t *slot = &shm->slots[i];
+        if (slot->state == SESSION_SHM_LIVE && slot->session.is_valid &&
+            now >= slot->session.expires_at) {
+            session_shm_release(shm, i);
+            expired++;
+        }
+    }
+    session_shm_sweep(shm);
+
+    pthread_mutex_unlock(&shm->header->lock);
+    return expired;
+}
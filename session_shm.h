@@ -0,0 +1,64 @@
+#ifndef SESSION_SHM_H
+#define SESSION_SHM_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "auth.h"
+
+// Session table in POSIX shared memory, so several webserver processes on
+// one host see the same sessions.
+//
+// The table is open-addressed with linear probing and a fixed capacity. Each
+// slot carries the token hash and a seqlock counter: readers probe without
+// taking any lock and retry a slot only if a writer was in it. Writers
+// serialize on a process-shared robust mutex in the header; if a process dies
+// holding it, the next writer repairs any half-written slot and carries on.
+//
+// Only sessions are shared. The user store and journals are locked by the
+// process that opens them, so one webserver owns a data directory at a time.
+
+#define SESSION_SHM_MAGIC 0x4d485353  // "SSHM"
+#define SESSION_SHM_VERSION 1
+
+typedef struct {
+    unsigned int seq;    // Odd while a writer is changing the slot
+    uint32_t state;      // SESSION_SHM_EMPTY, _LIVE or _DELETED
+    uint64_t hash;
+    session_t session;
+} session_shm_slot_t;
+
+#define SESSION_SHM_EMPTY 0
+#define SESSION_SHM_LIVE 1
+#define SESSION_SHM_DELETED 2  // Tombstone, keeps probe chains intact
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;    // Guards against processes built with another session_t
+    uint32_t capacity;     // Power of two
+    int ready;             // Set once the creator has initialized the table
+    int active;
+    pthread_mutex_t lock;  // PTHREAD_PROCESS_SHARED + PTHREAD_MUTEX_ROBUST
+} session_shm_header_t;
+
+struct session_shm {
+    char name[64];
+    size_t map_size;
+    session_shm_header_t *header;
+    session_shm_slot_t *slots;
+};
+
+typedef struct session_shm session_shm_t;
+
+// Lifecycle; the first process to open a name creates and sizes the table
+session_shm_t *session_shm_open(const char *name, uint32_t capacity);
+void session_shm_close(session_shm_t *shm);
+int session_shm_unlink(const char *name);
+
+// Sessions, keyed by the caller's 64-bit token hash
+int session_shm_insert(session_shm_t *shm, uint64_t hash, const session_t *session);
+int session_shm_lookup(session_shm_t *shm, uint64_t hash, const char *token, session_t *session_out);
+int session_shm_invalidate(session_shm_t *shm, uint64_t hash, const char *token);
+int session_shm_expire(session_shm_t *shm, time_t now);
+
+#endif
@@ -7,7 +7,9 @@
 const AppState = {
     serverStatus: 'unknown',
     lastUpdate: null,
-    autoRefresh: false
+    autoRefresh: false,
+    statusSocket: null,
+    socketRetryDelay: 1000
 };
 
 // DOM Content Loaded Event
@@ -15,6 +17,7 @@ document.addEventListener('DOMContentLoaded', function() {
     initializeApp();
     setupEventListeners();
     checkServerStatus();
+    connectStatusSocket();
     
     // Add fade-in animation to main content
     const mainContent = document.querySelector('main');
@@ -113,6 +116,58 @@ async function checkServerStatus() {
     }
 }
 
+/**
+ * Receive status updates and notices over a WebSocket instead of polling.
+ * Reconnects with backoff; until then /api/status is used.
+ */
+function connectStatusSocket() {
+    if (!('WebSocket' in window)) return;
+    
+    const protocol = window.location.protocol === 'https:' ? 'wss:' : 'ws:';
+    const socket = new WebSocket(`${protocol}//${window.location.host}/ws`);
+    AppState.statusSocket = socket;
+    
+    socket.addEventListener('open', function() {
+        AppState.socketRetryDelay = 1000;
+        socket.send(JSON.stringify({ subscribe: 'notices' }));
+    });
+    
+    socket.addEventListener('message', function(event) {
+        try {
+            const data = JSON.parse(event.data);
+            if (data.topic === 'notices') {
+                // showNotification renders HTML, so pass the text escaped
+                const text = document.createElement('span');
+                text.textContent = data.message;
+                showNotification(text.innerHTML, 'warning');
+            } else if (data.status) {
+                AppState.serverStatus = data.status;
+                AppState.lastUpdate = new Date();
+                updateStatusIndicators(data);
+            }
+        } catch (error) {
+            console.error('Invalid status message:', error);
+        }
+    });
+    
+    socket.addEventListener('close', function() {
+        AppState.statusSocket = null;
+        checkServerStatus();
+        setTimeout(connectStatusSocket, AppState.socketRetryDelay);
+        AppState.socketRetryDelay = Math.min(AppState.socketRetryDelay * 2, 30000);
+    });
+}
+
+/**
+ * Poll only while the status socket is down
+ */
+function refreshServerStatus() {
+    const socket = AppState.statusSocket;
+    if (!socket || socket.readyState !== WebSocket.OPEN) {
+        checkServerStatus();
+    }
+}
+
 /**
  * Update status indicators in the UI
  */
@@ -210,7 +265,7 @@ function addAutoRefreshControl() {
             AppState.autoRefresh = this.checked;
             
             if (AppState.autoRefresh) {
-                AppState.refreshInterval = setInterval(checkServerStatus, 30000); // 30 seconds
+                AppState.refreshInterval = setInterval(refreshServerStatus, 30000); // 30 seconds
                 showNotification('Auto-refresh enabled', 'info');
             } else {
                 if (AppState.refreshInterval) {
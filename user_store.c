@@ -0,0 +1,254 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS, MAP_NORESERVE
+#include "user_store.h"
+#include "logger.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+static uint32_t user_store_header_checksum(const user_store_header_t *header) {
+    return crc32_compute(header, offsetof(user_store_header_t, checksum));
+}
+
+static user_store_header_t *user_store_header_slot(user_store_t *store, int slot) {
+    return (user_store_header_t *)(store->base + slot * (USER_STORE_HEADER_BYTES / 2));
+}
+
+static int user_store_header_valid(const user_store_t *store, const user_store_header_t *header) {
+    return header->magic == USER_STORE_MAGIC &&
+           header->version == USER_STORE_VERSION &&
+           header->record_size == store->record_size &&
+           header->checksum == user_store_header_checksum(header);
+}
+
+// Maps the file from mapped_bytes up to new_size inside the reserved range
+static int user_store_map_tail(user_store_t *store, size_t new_size) {
+    if (new_size <= store->mapped_bytes) return 0;
+
+    void *tail = mmap(store->base + store->mapped_bytes, new_size - store->mapped_bytes,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, store->fd,
+                      (off_t)store->mapped_bytes);
+    if (tail == MAP_FAILED) {
+        log_error("Failed to map user store %s: %s", store->path, strerror(errno));
+        return -1;
+    }
+
+    store->mapped_bytes = new_size;
+    __atomic_store_n(&store->capacity, (new_size - USER_STORE_HEADER_BYTES) / store->record_size,
+                     __ATOMIC_RELEASE);
+    return 0;
+}
+
+user_store_t *user_store_open(const char *path, size_t record_size) {
+    if (!path || record_size == 0) return NULL;
+
+    user_store_t *store = malloc(sizeof(user_store_t));
+    if (!store) {
+        log_error("Failed to allocate memory for user store");
+        return NULL;
+    }
+
+    memset(store, 0, sizeof(user_store_t));
+    strncpy(store->path, path, sizeof(store->path) - 1);
+    store->record_size = record_size;
+    store->current_slot = 1;  // The first checkpoint goes to slot 0
+
+    store->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (store->fd < 0) {
+        log_error("Failed to open user store %s: %s", path, strerror(errno));
+        free(store);
+        return NULL;
+    }
+    
+    // Released when the descriptor closes, including when the process dies
+    if (flock(store->fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            log_error("User store %s is in use by another process", path);
+        } else {
+            log_error("Failed to lock user store %s: %s", path, strerror(errno));
+        }
+        close(store->fd);
+        free(store);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(store->fd, &st) != 0) {
+        log_error("Failed to stat user store %s: %s", path, strerror(errno));
+        close(store->fd);
+        free(store);
+        return NULL;
+    }
+
+    size_t file_size = (size_t)st.st_size;
+    if (file_size < USER_STORE_HEADER_BYTES + USER_STORE_GROW_BYTES) {
+        file_size = USER_STORE_HEADER_BYTES + USER_STORE_GROW_BYTES;
+        if (ftruncate(store->fd, (off_t)file_size) != 0) {
+            log_error("Failed to size user store %s: %s", path, strerror(errno));
+            close(store->fd);
+            free(store);
+            return NULL;
+        }
+    }
+
+    // Reserve address space once; growth maps into it without moving records
+    store->base = mmap(NULL, USER_STORE_RESERVE_BYTES, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    store->seq = mmap(NULL, (USER_STORE_RESERVE_BYTES / record_size) * sizeof(unsigned int),
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (store->base == MAP_FAILED || store->seq == MAP_FAILED) {
+        log_error("Failed to reserve address space for user store: %s", strerror(errno));
+        if (store->base != MAP_FAILED) munmap(store->base, USER_STORE_RESERVE_BYTES);
+        if (store->seq != MAP_FAILED) {
+            munmap(store->seq, (USER_STORE_RESERVE_BYTES / record_size) * sizeof(unsigned int));
+        }
+        close(store->fd);
+        free(store);
+        return NULL;
+    }
+
+    pthread_mutex_init(&store->grow_mutex, NULL);
+
+    if (user_store_map_tail(store, file_size) != 0) {
+        user_store_close(store);
+        return NULL;
+    }
+
+    // Pick the newest intact checkpoint header
+    for (int slot = 0; slot < 2; slot++) {
+        user_store_header_t *header = user_store_header_slot(store, slot);
+        if (user_store_header_valid(store, header) &&
+            (store->current.magic == 0 || header->sequence > store->current.sequence)) {
+            store->current = *header;
+            store->current_slot = slot;
+        }
+    }
+
+    if (store->current.magic == 0 && st.st_size > 0) {
+        int blank = 1;
+        for (int slot = 0; slot < 2 && blank; slot++) {
+            blank = user_store_header_slot(store, slot)->magic == 0;
+        }
+        if (!blank) {
+            log_error("User store %s has no valid header", path);
+            user_store_close(store);
+            return NULL;
+        }
+    }
+
+    if (store->current.count > store->capacity) {
+        log_error("User store %s is truncated (%llu records, room for %llu)", path,
+                  (unsigned long long)store->current.count, (unsigned long long)store->capacity);
+        user_store_close(store);
+        return NULL;
+    }
+
+    log_info("User store %s opened: %llu records, capacity %llu", path,
+             (unsigned long long)store->current.count, (unsigned long long)store->capacity);
+    return store;
+}
+
+void user_store_close(user_store_t *store) {
+    if (!store) return;
+
+    if (store->base && store->base != MAP_FAILED) {
+        if (store->mapped_bytes > 0) {
+            msync(store->base, store->mapped_bytes, MS_SYNC);
+        }
+        munmap(store->base, USER_STORE_RESERVE_BYTES);
+    }
+    if (store->seq && store->seq != MAP_FAILED) {
+        munmap(store->seq, (USER_STORE_RESERVE_BYTES / store->record_size) * sizeof(unsigned int));
+    }
+    if (store->fd >= 0) {
+        close(store->fd);
+    }
+
+    pthread_mutex_destroy(&store->grow_mutex);
+    free(store);
+}
+
+uint64_t user_store_max_records(const user_store_t *store) {
+    if (!store) return 0;
+    return (USER_STORE_RESERVE_BYTES - USER_STORE_HEADER_BYTES) / store->record_size;
+}
+
+// Makes sure at least `records` records fit, extending the file and mapping
+int user_store_reserve(user_store_t *store, uint64_t records) {
+    if (!store) return -1;
+    if (records <= __atomic_load_n(&store->capacity, __ATOMIC_ACQUIRE)) return 0;
+    if (records > user_store_max_records(store)) return -1;
+
+    pthread_mutex_lock(&store->grow_mutex);
+
+    int rc = 0;
+    if (records > store->capacity) {
+        size_t needed = USER_STORE_HEADER_BYTES + records * store->record_size;
+        size_t new_size = store->mapped_bytes;
+        while (new_size < needed) {
+            new_size += new_size < 64 * USER_STORE_GROW_BYTES ? new_size : 64 * USER_STORE_GROW_BYTES;
+        }
+        if (new_size > USER_STORE_RESERVE_BYTES) new_size = USER_STORE_RESERVE_BYTES;
+
+        if (ftruncate(store->fd, (off_t)new_size) != 0) {
+            log_error("Failed to grow user store %s: %s", store->path, strerror(errno));
+            rc = -1;
+        } else {
+            rc = user_store_map_tail(store, new_size);
+        }
+    }
+
+    pthread_mutex_unlock(&store->grow_mutex);
+    return rc;
+}
+
+void *user_store_record(user_store_t *store, uint64_t index) {
+    return store->base + USER_STORE_HEADER_BYTES + index * store->record_size;
+}
+
+uint64_t user_store_count(const user_store_t *store) {
+    return store ? store->current.count : 0;
+}
+
+uint64_t user_store_generation(const user_store_t *store) {
+    return store ? store->current.generation : 0;
+}
+
+// Flushes records to disk, then publishes a new header in the other slot
+int user_store_checkpoint(user_store_t *store, uint64_t count, uint64_t generation) {
+    if (!store || count > store->capacity) return -1;
+
+    size_t records_end = USER_STORE_HEADER_BYTES + count * store->record_size;
+    if (count > 0 && msync(store->base + USER_STORE_HEADER_BYTES,
+                           records_end - USER_STORE_HEADER_BYTES, MS_SYNC) != 0) {
+        log_error("Failed to flush user store %s: %s", store->path, strerror(errno));
+        return -1;
+    }
+
+    user_store_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = USER_STORE_MAGIC;
+    header.version = USER_STORE_VERSION;
+    header.record_size = (uint32_t)store->record_size;
+    header.sequence = store->current.sequence + 1;
+    header.count = count;
+    header.generation = generation;
+    header.checksum = user_store_header_checksum(&header);
+
+    int slot = 1 - store->current_slot;
+    memcpy(user_store_header_slot(store, slot), &header, sizeof(header));
+    if (msync(store->base, USER_STORE_HEADER_BYTES, MS_SYNC) != 0) {
+        log_error("Failed to flush user store header %s: %s", store->path, strerror(errno));
+        return -1;
+    }
+
+    store->current = header;
+    store->current_slot = slot;
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Memory-mapped, growable file of fixed-size user records.
+//
+// The first page holds two header slots that are written alternately at each
+// checkpoint; opening picks the newest slot whose checksum verifies, so a torn
+// header write falls back to the previous checkpoint. Records follow the
+// header page. The whole store lives inside one reserved virtual range, so
+// growing only maps the new tail and record pointers stay valid for the
+// lifetime of the store. Opening never touches the records, so it costs the
+// same no matter how many users exist.
+//
+// Records are mapped shared but only one process may own the store: opening
+// takes an exclusive flock on the file and fails while another process holds
+// it, since two writers would hand out the same user ids.
+
+#define USER_STORE_MAGIC 0x31535255    // "URS1"
+#define USER_STORE_VERSION 1
+#define USER_STORE_HEADER_BYTES 4096
+#define USER_STORE_GROW_BYTES (1024 * 1024)
+#define USER_STORE_RESERVE_BYTES (1ULL << 34)  // Upper bound on the mapping (16 GB)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;  // Guards against opening a file built with another user_t
+    uint32_t reserved;
+    uint64_t sequence;     // Incremented at each checkpoint; the higher valid slot wins
+    uint64_t count;        // Records covered by the checkpoint
+    uint64_t generation;   // Journal generation to replay from
+    uint32_t pad;
+    uint32_t checksum;     // CRC-32 of every field above
+} user_store_header_t;
+
+typedef struct {
+    char path[512];
+    int fd;
+    size_t record_size;
+    char *base;                  // Start of the reserved range
+    size_t mapped_bytes;         // Bytes of the file currently mapped
+    uint64_t capacity;           // Records that fit in the mapped file
+    unsigned int *seq;           // In-memory seqlock counters, never persisted
+    user_store_header_t current; // Header of the last checkpoint
+    int current_slot;
+    pthread_mutex_t grow_mutex;
+} user_store_t;
+
+// Lifecycle
+user_store_t *user_store_open(const char *path, size_t record_size);
+void user_store_close(user_store_t *store);
+
+// Records
+int user_store_reserve(user_store_t *store, uint64_t records);
+void *user_store_record(user_store_t *store, uint64_t index);
+uint64_t user_store_max_records(const user_store_t *store);
+
+// Checkpoint state
+uint64_t user_store_count(const user_store_t *store);
+uint64_t user_store_generation(const user_store_t *store);
+int user_store_checkpoint(user_store_t *store, uint64_t count, uint64_t generation);
+
+#endif
@@ -6,6 +6,22 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32_build_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+}
 
 char *trim_whitespace(char *str) {
     if (!str) return NULL;
@@ -119,6 +135,43 @@ char *get_file_extension(const char *filename) {
     return strdup(dot + 1);
 }
 
+// Makes a newly created or renamed file's directory entry durable
+void sync_parent_directory(const char *path) {
+    if (!path) return;
+    
+    char dir[1024];
+    strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *slash = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+    
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length) {
+    pthread_once(&crc32_table_once, crc32_build_table);
+    
+    const unsigned char *bytes = (const unsigned char *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc32_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t crc32_compute(const void *data, size_t length) {
+    return crc32_update(0, data, length);
+}
+
 void safe_free(void **ptr) {
     if (ptr && *ptr) {
         free(*ptr);
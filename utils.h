@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 // String utilities
 char *trim_whitespace(char *str);
@@ -14,6 +15,11 @@ int string_starts_with(const char *str, const char *prefix);
 int file_exists(const char *filename);
 size_t get_file_size(const char *filename);
 char *get_file_extension(const char *filename);
+void sync_parent_directory(const char *path);
+
+// Checksum utilities (CRC-32, IEEE polynomial)
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length);
+uint32_t crc32_compute(const void *data, size_t length);
 
 // Memory utilities
 void safe_free(void **ptr);
@@ -0,0 +1,1051 @@
+#include "websocket.h"
+#include "crypto.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_MAX_HEADER 14   // 2 + 8 byte length + 4 byte mask
+
+static void websocket_drop(websocket_conn_t *conn);
+
+// Clients mask every frame (RFC 6455 section 5.3). The mask repeats every
+// four bytes, so it is XORed a vector or word at a time; the byte loop only
+// handles the tail.
+static void websocket_unmask(uint8_t *data, size_t length, const uint8_t mask[4]) {
+    size_t i = 0;
+    uint32_t key;
+    memcpy(&key, mask, 4);
+
+#ifdef __SSE2__
+    __m128i key128 = _mm_set1_epi32((int)key);
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        _mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(block, key128));
+    }
+#endif
+
+    uint64_t key64 = ((uint64_t)key << 32) | key;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        word ^= key64;
+        memcpy(data + i, &word, 8);
+    }
+    for (; i < length; i++) {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+// Text messages must be UTF-8 (RFC 6455 section 8.1)
+static int websocket_valid_utf8(const uint8_t *data, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        // Skip ASCII eight bytes at a time
+        if (i + 8 <= length) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        uint8_t c = data[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        size_t extra;
+        uint32_t min;
+        uint32_t code;
+        if ((c & 0xE0) == 0xC0) {
+            extra = 1; min = 0x80; code = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            extra = 2; min = 0x800; code = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            extra = 3; min = 0x10000; code = c & 0x07;
+        } else {
+            return 0;
+        }
+        if (i + extra >= length) return 0;
+        for (size_t j = 1; j <= extra; j++) {
+            if ((data[i + j] & 0xC0) != 0x80) return 0;
+            code = (code << 6) | (data[i + j] & 0x3F);
+        }
+        if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) return 0;
+        i += extra + 1;
+    }
+    return 1;
+}
+
+// Server frames are never masked; returns the header length
+static size_t websocket_frame_header(uint8_t header[WS_MAX_HEADER], int opcode, size_t length) {
+    header[0] = 0x80 | (uint8_t)opcode;
+    if (length < 126) {
+        header[1] = (uint8_t)length;
+        return 2;
+    }
+    if (length <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = (uint8_t)(length >> 8);
+        header[3] = (uint8_t)length;
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        header[2 + i] = (uint8_t)((uint64_t)length >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+static void websocket_want_write(websocket_conn_t *conn, int want) {
+    if (conn->want_write == want) return;
+
+    struct epoll_event event;
+    event.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    event.data.ptr = conn;
+    if (epoll_ctl(conn->server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) == 0) {
+        conn->want_write = want;
+    }
+}
+
+static uint64_t websocket_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Frames the payload once; the caller holds the only reference
+static websocket_frame_t *websocket_frame_create(int opcode, const void *data, size_t length, int topic) {
+    uint8_t header[WS_MAX_HEADER];
+    size_t header_length = websocket_frame_header(header, opcode, length);
+
+    websocket_frame_t *frame = malloc(sizeof(websocket_frame_t) + header_length + length);
+    if (!frame) return NULL;
+    frame->next = NULL;
+    frame->refs = 1;
+    frame->topic = topic;
+    frame->published = websocket_now();
+    frame->length = header_length + length;
+    memcpy(frame->data, header, header_length);
+    if (length > 0) memcpy(frame->data + header_length, data, length);
+    return frame;
+}
+
+static void websocket_frame_release(websocket_frame_t *frame) {
+    if (--frame->refs == 0) {
+        free(frame);
+    }
+}
+
+// A subscriber has the whole frame: record how long it took
+static void websocket_delivered(websocket_server_t *server, const websocket_frame_t *frame) {
+    if (frame->topic < 0) return;
+
+    websocket_topic_t *topic = &server->topics[frame->topic];
+    uint64_t latency = websocket_now() - frame->published;
+    uint64_t micros = latency / 1000;
+    int bucket = 0;
+    while (micros > 0 && bucket < WS_LATENCY_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+
+    __atomic_fetch_add(&topic->delivered, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&topic->latency_total, latency, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&topic->latency_buckets[bucket], 1, __ATOMIC_RELAXED);
+    if (latency > __atomic_load_n(&topic->latency_max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&topic->latency_max, latency, __ATOMIC_RELAXED);
+    }
+}
+
+static int websocket_would_block(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+// Drops a client whose queue would pass WS_SEND_QUEUE_LIMIT with frame
+static void websocket_overflow(websocket_conn_t *conn, const websocket_frame_t *frame) {
+    log_warning("WebSocket client %d is not reading, dropping it", conn->fd);
+    if (frame->topic >= 0) {
+        __atomic_fetch_add(&conn->server->topics[frame->topic].dropped, 1, __ATOMIC_RELAXED);
+    }
+    websocket_drop(conn);
+}
+
+// Puts the unsent part of a frame on the connection's queue, taking a
+// reference instead of copying it
+static int websocket_queue(websocket_conn_t *conn, websocket_frame_t *frame, size_t offset) {
+    size_t remaining = frame->length - offset;
+    if (conn->send_bytes + remaining > WS_SEND_QUEUE_LIMIT) {
+        websocket_overflow(conn, frame);
+        return -1;
+    }
+
+    websocket_send_t *item = malloc(sizeof(websocket_send_t));
+    if (!item) {
+        websocket_drop(conn);
+        return -1;
+    }
+    item->next = NULL;
+    item->frame = frame;
+    item->offset = offset;
+    frame->refs++;
+
+    if (conn->send_tail) {
+        conn->send_tail->next = item;
+    } else {
+        conn->send_head = item;
+    }
+    conn->send_tail = item;
+    conn->send_bytes += remaining;
+    websocket_want_write(conn, 1);
+    return 0;
+}
+
+// Sends a shared frame to one connection, or queues what the socket did
+// not take. Behind a backlog, a coalescing topic replaces its own unsent
+// message rather than adding another.
+static int websocket_deliver(websocket_conn_t *conn, websocket_frame_t *frame) {
+    if (conn->dead) return -1;
+
+    if (conn->send_head) {
+        websocket_server_t *server = conn->server;
+        if (frame->topic >= 0 && server->topics[frame->topic].policy == WS_POLICY_COALESCE) {
+            // The head may be partly sent, so it is never replaced
+            for (websocket_send_t *item = conn->send_head->next; item; item = item->next) {
+                if (item->frame->topic == frame->topic) {
+                    // A newer message may be larger than the one it replaces
+                    size_t send_bytes = conn->send_bytes - item->frame->length + frame->length;
+                    if (send_bytes > WS_SEND_QUEUE_LIMIT) {
+                        websocket_overflow(conn, frame);
+                        return -1;
+                    }
+                    conn->send_bytes = send_bytes;
+                    websocket_frame_release(item->frame);
+                    item->frame = frame;
+                    frame->refs++;
+                    __atomic_fetch_add(&server->topics[frame->topic].coalesced, 1, __ATOMIC_RELAXED);
+                    return 0;
+                }
+            }
+        }
+        return websocket_queue(conn, frame, 0);
+    }
+
+    ssize_t written = send(conn->fd, frame->data, frame->length, MSG_NOSIGNAL);
+    if (written < 0) {
+        if (!websocket_would_block()) {
+            websocket_drop(conn);
+            return -1;
+        }
+        written = 0;
+    }
+    if ((size_t)written == frame->length) {
+        websocket_delivered(conn->server, frame);
+        return 0;
+    }
+    return websocket_queue(conn, frame, (size_t)written);
+}
+
+// Writes queued frames until the socket is full
+static void websocket_flush(websocket_conn_t *conn) {
+    while (conn->send_head) {
+        websocket_send_t *item = conn->send_head;
+        websocket_frame_t *frame = item->frame;
+        ssize_t written = send(conn->fd, frame->data + item->offset, frame->length - item->offset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (websocket_would_block()) return;
+            websocket_drop(conn);
+            return;
+        }
+        item->offset += (size_t)written;
+        conn->send_bytes -= (size_t)written;
+        if (item->offset < frame->length) return;
+
+        websocket_delivered(conn->server, frame);
+        conn->send_head = item->next;
+        if (!conn->send_head) conn->send_tail = NULL;
+        websocket_frame_release(frame);
+        free(item);
+    }
+
+    websocket_want_write(conn, 0);
+    if (conn->closing) {
+        websocket_drop(conn);
+    }
+}
+
+int websocket_send(websocket_conn_t *conn, int opcode, const void *data, size_t length) {
+    if (!conn || conn->dead || conn->closing) return -1;
+
+    uint8_t header[WS_MAX_HEADER];
+    size_t header_length = websocket_frame_header(header, opcode, length);
+    size_t sent = 0;
+
+    // With nothing queued, try the socket before building a frame
+    if (!conn->send_head) {
+        struct iovec iov[2];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_length;
+        iov[1].iov_base = (void *)data;
+        iov[1].iov_len = length;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = length > 0 ? 2 : 1;
+
+        ssize_t written = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (!websocket_would_block()) {
+                websocket_drop(conn);
+                return -1;
+            }
+            written = 0;
+        }
+        sent = (size_t)written;
+        if (sent == header_length + length) return 0;
+    }
+
+    websocket_frame_t *frame = websocket_frame_create(opcode, data, length, -1);
+    if (!frame) {
+        websocket_drop(conn);
+        return -1;
+    }
+    int rc = websocket_queue(conn, frame, sent);
+    websocket_frame_release(frame);
+    return rc;
+}
+
+void websocket_close(websocket_conn_t *conn, uint16_t code) {
+    if (!conn || conn->dead || conn->closing) return;
+
+    uint8_t payload[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    if (websocket_send(conn, WS_OPCODE_CLOSE, payload, sizeof(payload)) != 0) return;
+
+    // The socket closes once the close frame has been sent
+    conn->closing = 1;
+    if (!conn->send_head) {
+        websocket_drop(conn);
+    }
+}
+
+// Closes the socket and removes the connection from the server. The struct
+// is freed after the current batch of events, which may still refer to it.
+static void websocket_drop(websocket_conn_t *conn) {
+    if (conn->dead) return;
+    websocket_server_t *server = conn->server;
+
+    conn->dead = 1;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+
+    for (int topic = 0; topic < server->topic_count; topic++) {
+        if (conn->topics & (1u << topic)) {
+            __atomic_fetch_sub(&server->topics[topic].subscribers, 1, __ATOMIC_RELAXED);
+        }
+    }
+    conn->topics = 0;
+
+    int last = server->connection_count - 1;
+    server->connections[conn->index] = server->connections[last];
+    server->connections[conn->index]->index = conn->index;
+    server->connections[last] = NULL;
+    __atomic_store_n(&server->connection_count, last, __ATOMIC_RELAXED);
+
+    conn->next_dead = server->dead;
+    server->dead = conn;
+}
+
+static void websocket_conn_free(websocket_conn_t *conn) {
+    websocket_send_t *item = conn->send_head;
+    while (item) {
+        websocket_send_t *next = item->next;
+        websocket_frame_release(item->frame);
+        free(item);
+        item = next;
+    }
+    free(conn->partial);
+    free(conn->message);
+    free(conn);
+}
+
+static void websocket_message(websocket_conn_t *conn, int opcode, const uint8_t *data, size_t length) {
+    if (opcode == WS_OPCODE_TEXT && !websocket_valid_utf8(data, length)) {
+        websocket_close(conn, WS_CLOSE_INVALID_DATA);
+        return;
+    }
+    websocket_server_t *server = conn->server;
+    if (server->on_message) {
+        server->on_message(server, conn, opcode, data, length);
+    }
+}
+
+// Close codes a peer may send (RFC 6455 section 7.4): the defined ones
+// except 1004-1006 and 1015, which are reserved or must never be sent, plus
+// the ranges for libraries and applications
+static int websocket_valid_close_code(uint16_t code) {
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) ||
+           (code >= 3000 && code <= 4999);
+}
+
+static void websocket_control(websocket_conn_t *conn, int opcode, const uint8_t *payload, size_t length) {
+    switch (opcode) {
+        case WS_OPCODE_PING:
+            websocket_send(conn, WS_OPCODE_PONG, payload, length);
+            break;
+        case WS_OPCODE_PONG:
+            conn->ping_sent = 0;
+            break;
+        case WS_OPCODE_CLOSE: {
+            // Echo the client's code and close once it is sent. The payload
+            // is empty or a code followed by a UTF-8 reason (section 5.5.1).
+            uint16_t code = WS_CLOSE_NORMAL;
+            if (length == 1) {
+                code = WS_CLOSE_PROTOCOL_ERROR;
+            } else if (length >= 2) {
+                code = (uint16_t)((payload[0] << 8) | payload[1]);
+                if (!websocket_valid_close_code(code)) {
+                    code = WS_CLOSE_PROTOCOL_ERROR;
+                } else if (!websocket_valid_utf8(payload + 2, length - 2)) {
+                    code = WS_CLOSE_INVALID_DATA;
+                }
+            }
+            websocket_close(conn, code);
+            break;
+        }
+        default:
+            websocket_close(conn, WS_CLOSE_PROTOCOL_ERROR);
+            break;
+    }
+}
+
+static void websocket_on_frame(websocket_conn_t *conn, int fin, int opcode, uint8_t *payload, size_t length) {
+    if (opcode & 0x8) {
+        if (!fin || length > 125) {
+            websocket_close(conn, WS_CLOSE_PROTOCOL_ERROR);
+            return;
+        }
+        websocket_control(conn, opcode, payload, length);
+        return;
+    }
+
+    if (opcode == WS_OPCODE_CONTINUATION) {
+        if (!conn->message_opcode) {
+            websocket_close(conn, WS_CLOSE_PROTOCOL_ERROR);
+            return;
+        }
+        if (conn->message_length + length > WS_MAX_MESSAGE) {
+            websocket_close(conn, WS_CLOSE_TOO_BIG);
+            return;
+        }
+        memcpy(conn->message + conn->message_length, payload, length);
+        conn->message_length += length;
+        if (fin) {
+            websocket_message(conn, conn->message_opcode, conn->message, conn->message_length);
+            free(conn->message);
+            conn->message = NULL;
+            conn->message_length = 0;
+            conn->message_opcode = 0;
+        }
+        return;
+    }
+
+    if ((opcode != WS_OPCODE_TEXT && opcode != WS_OPCODE_BINARY) || conn->message_opcode) {
+        websocket_close(conn, WS_CLOSE_PROTOCOL_ERROR);
+        return;
+    }
+
+    if (fin) {
+        // Unfragmented messages are delivered straight from the read buffer
+        websocket_message(conn, opcode, payload, length);
+        return;
+    }
+
+    conn->message = malloc(WS_MAX_MESSAGE);
+    if (!conn->message) {
+        websocket_drop(conn);
+        return;
+    }
+    memcpy(conn->message, payload, length);
+    conn->message_length = length;
+    conn->message_opcode = opcode;
+}
+
+// Handles every complete frame in data; returns the bytes consumed
+static size_t websocket_parse(websocket_conn_t *conn, uint8_t *data, size_t length) {
+    size_t offset = 0;
+
+    while (!conn->dead && !conn->closing) {
+        size_t available = length - offset;
+        if (available < 2) break;
+
+        uint8_t *frame = data + offset;
+        int fin = frame[0] & 0x80;
+        int opcode = frame[0] & 0x0F;
+        uint8_t length7 = frame[1] & 0x7F;
+
+        if ((frame[0] & 0x70) || !(frame[1] & 0x80)) {
+            // No extensions are negotiated and clients must mask
+            websocket_close(conn, WS_CLOSE_PROTOCOL_ERROR);
+            break;
+        }
+
+        size_t header_length = 2 + (length7 == 126 ? 2 : length7 == 127 ? 8 : 0) + 4;
+        if (available < header_length) break;
+
+        uint64_t payload_length = length7;
+        if (length7 == 126) {
+            payload_length = ((uint64_t)frame[2] << 8) | frame[3];
+        } else if (length7 == 127) {
+            payload_length = 0;
+            for (int i = 0; i < 8; i++) {
+                payload_length = (payload_length << 8) | frame[2 + i];
+            }
+        }
+        if (payload_length > WS_MAX_MESSAGE) {
+            websocket_close(conn, WS_CLOSE_TOO_BIG);
+            break;
+        }
+        if (available < header_length + payload_length) break;
+
+        uint8_t *payload = frame + header_length;
+        websocket_unmask(payload, (size_t)payload_length, payload - 4);
+        websocket_on_frame(conn, fin, opcode, payload, (size_t)payload_length);
+        offset += header_length + (size_t)payload_length;
+    }
+
+    // After a close nothing more from the client is read
+    return (conn->dead || conn->closing) ? length : offset;
+}
+
+static void websocket_read(websocket_server_t *server, websocket_conn_t *conn) {
+    uint8_t *buffer = server->read_buffer;
+    size_t length = conn->partial_length;
+
+    // Resume the unfinished frame in front of the new bytes
+    if (conn->partial) {
+        memcpy(buffer, conn->partial, length);
+        free(conn->partial);
+        conn->partial = NULL;
+        conn->partial_length = 0;
+    }
+
+    ssize_t received = recv(conn->fd, buffer + length, WS_READ_SIZE, 0);
+    if (received <= 0) {
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            received = 0;
+        } else {
+            websocket_drop(conn);
+            return;
+        }
+    }
+    length += (size_t)received;
+    conn->last_seen = time(NULL);
+
+    size_t consumed = websocket_parse(conn, buffer, length);
+    if (conn->dead || consumed == length) return;
+
+    conn->partial = malloc(length - consumed);
+    if (!conn->partial) {
+        websocket_drop(conn);
+        return;
+    }
+    memcpy(conn->partial, buffer + consumed, length - consumed);
+    conn->partial_length = length - consumed;
+}
+
+static void websocket_add(websocket_server_t *server, int fd, uint32_t allowed_topics) {
+    if (server->connection_count >= WS_MAX_CONNECTIONS) {
+        log_warning("WebSocket connection limit reached, refusing client");
+        close(fd);
+        return;
+    }
+
+    if (server->connection_count == server->connection_capacity) {
+        int capacity = server->connection_capacity ? server->connection_capacity * 2 : 64;
+        websocket_conn_t **connections = realloc(server->connections, capacity * sizeof(websocket_conn_t *));
+        if (!connections) {
+            close(fd);
+            return;
+        }
+        server->connections = connections;
+        server->connection_capacity = capacity;
+    }
+
+    websocket_conn_t *conn = calloc(1, sizeof(websocket_conn_t));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->server = server;
+    conn->fd = fd;
+    conn->allowed_topics = allowed_topics;
+    conn->last_seen = time(NULL);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        log_error("Failed to add WebSocket client to the event loop: %s", strerror(errno));
+        close(fd);
+        free(conn);
+        return;
+    }
+
+    conn->index = server->connection_count;
+    server->connections[conn->index] = conn;
+    __atomic_store_n(&server->connection_count, server->connection_count + 1, __ATOMIC_RELAXED);
+
+    if (server->on_open) {
+        server->on_open(server, conn);
+    }
+}
+
+// Picks up sockets and messages queued by other threads
+static void websocket_take_pending(websocket_server_t *server) {
+    uint64_t value;
+    if (read(server->wake_fd, &value, sizeof(value)) < 0) {
+        // Nothing to clear; the queues are checked regardless
+    }
+
+    pthread_mutex_lock(&server->pending_lock);
+    websocket_pending_t *pending = server->pending;
+    int pending_count = server->pending_count;
+    server->pending = NULL;
+    server->pending_count = 0;
+    server->pending_capacity = 0;
+    websocket_frame_t *frames = server->pending_frames;
+    server->pending_frames = NULL;
+    server->pending_frames_tail = NULL;
+    pthread_mutex_unlock(&server->pending_lock);
+
+    for (int i = 0; i < pending_count; i++) {
+        websocket_add(server, pending[i].fd, pending[i].allowed_topics);
+    }
+    free(pending);
+
+    while (frames) {
+        websocket_frame_t *frame = frames;
+        frames = frame->next;
+        uint32_t mask = frame->topic >= 0 ? 1u << frame->topic : 0;
+
+        // Backwards, since a dropped client is swapped with the last one
+        for (int i = server->connection_count - 1; i >= 0; i--) {
+            websocket_conn_t *conn = server->connections[i];
+            if (conn->closing || (mask && !(conn->topics & mask))) continue;
+            websocket_deliver(conn, frame);
+        }
+        websocket_frame_release(frame);
+    }
+}
+
+// Pings quiet clients and drops those that did not answer in time
+static void websocket_keepalive(websocket_server_t *server, time_t now) {
+    for (int i = server->connection_count - 1; i >= 0; i--) {
+        websocket_conn_t *conn = server->connections[i];
+        if (conn->ping_sent) {
+            if (now - conn->ping_sent >= WS_PONG_TIMEOUT) {
+                websocket_drop(conn);
+            }
+        } else if (now - conn->last_seen >= WS_PING_INTERVAL && !conn->closing) {
+            conn->ping_sent = now;
+            websocket_send(conn, WS_OPCODE_PING, NULL, 0);
+        }
+    }
+}
+
+static void *websocket_loop(void *arg) {
+    websocket_server_t *server = (websocket_server_t *)arg;
+    struct epoll_event events[WS_MAX_EVENTS];
+    time_t last_sweep = time(NULL);
+
+    while (server->running) {
+        int count = epoll_wait(server->epoll_fd, events, WS_MAX_EVENTS, 1000);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            log_error("WebSocket event loop failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == NULL) {
+                websocket_take_pending(server);
+                continue;
+            }
+
+            websocket_conn_t *conn = events[i].data.ptr;
+            if (conn->dead) continue;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                websocket_read(server, conn);
+            }
+            if (!conn->dead && (events[i].events & EPOLLOUT)) {
+                websocket_flush(conn);
+            }
+        }
+
+        time_t now = time(NULL);
+        if (now != last_sweep) {
+            websocket_keepalive(server, now);
+            last_sweep = now;
+        }
+
+        while (server->dead) {
+            websocket_conn_t *conn = server->dead;
+            server->dead = conn->next_dead;
+            websocket_conn_free(conn);
+        }
+    }
+
+    return NULL;
+}
+
+static void websocket_wake(websocket_server_t *server) {
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        // The counter is already non-zero, so the loop will wake anyway
+    }
+}
+
+int websocket_server_init(websocket_server_t *server, websocket_open_fn on_open,
+                          websocket_message_fn on_message, void *user_data) {
+    if (!server) return -1;
+
+    memset(server, 0, sizeof(websocket_server_t));
+    server->on_open = on_open;
+    server->on_message = on_message;
+    server->user_data = user_data;
+    server->wake_fd = -1;
+
+    // Room for the largest unfinished frame plus one read behind it
+    server->read_buffer = malloc(WS_MAX_HEADER + WS_MAX_MESSAGE + WS_READ_SIZE);
+    if (!server->read_buffer) {
+        log_error("Failed to allocate WebSocket read buffer");
+        return -1;
+    }
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->epoll_fd < 0) {
+        log_error("Failed to create WebSocket event loop: %s", strerror(errno));
+        free(server->read_buffer);
+        return -1;
+    }
+
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (server->wake_fd < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &event) != 0) {
+        log_error("Failed to set up WebSocket wakeups: %s", strerror(errno));
+        if (server->wake_fd >= 0) close(server->wake_fd);
+        close(server->epoll_fd);
+        free(server->read_buffer);
+        return -1;
+    }
+
+    pthread_mutex_init(&server->pending_lock, NULL);
+    server->running = 1;
+
+    if (pthread_create(&server->thread, NULL, websocket_loop, server) != 0) {
+        log_error("Failed to start WebSocket event loop");
+        pthread_mutex_destroy(&server->pending_lock);
+        close(server->wake_fd);
+        close(server->epoll_fd);
+        free(server->read_buffer);
+        server->running = 0;
+        return -1;
+    }
+
+    log_info("WebSocket event loop started");
+    return 0;
+}
+
+void websocket_server_cleanup(websocket_server_t *server) {
+    if (!server || !server->running) return;
+
+    server->running = 0;
+    websocket_wake(server);
+    pthread_join(server->thread, NULL);
+
+    // Tell clients the server is going away; best effort, nothing is retried
+    for (int i = server->connection_count - 1; i >= 0; i--) {
+        websocket_conn_t *conn = server->connections[i];
+        websocket_close(conn, WS_CLOSE_GOING_AWAY);
+        websocket_drop(conn);
+    }
+    while (server->dead) {
+        websocket_conn_t *conn = server->dead;
+        server->dead = conn->next_dead;
+        websocket_conn_free(conn);
+    }
+
+    for (int i = 0; i < server->pending_count; i++) {
+        close(server->pending[i].fd);
+    }
+    free(server->pending);
+    websocket_frame_t *frame = server->pending_frames;
+    while (frame) {
+        websocket_frame_t *next = frame->next;
+        free(frame);
+        frame = next;
+    }
+
+    free(server->connections);
+    free(server->read_buffer);
+    close(server->wake_fd);
+    close(server->epoll_fd);
+    pthread_mutex_destroy(&server->pending_lock);
+    log_info("WebSocket event loop stopped");
+}
+
+int websocket_topic_create(websocket_server_t *server, const char *name, int policy) {
+    if (!server || !name || server->topic_count >= WS_MAX_TOPICS ||
+        (policy != WS_POLICY_DROP && policy != WS_POLICY_COALESCE)) {
+        return -1;
+    }
+    if (websocket_topic_find(server, name) >= 0) return -1;
+
+    websocket_topic_t *topic = &server->topics[server->topic_count];
+    memset(topic, 0, sizeof(websocket_topic_t));
+    strncpy(topic->name, name, sizeof(topic->name) - 1);
+    topic->policy = policy;
+    return server->topic_count++;
+}
+
+int websocket_topic_find(websocket_server_t *server, const char *name) {
+    if (!server || !name) return -1;
+
+    for (int i = 0; i < server->topic_count; i++) {
+        if (strcmp(server->topics[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int websocket_subscribe(websocket_conn_t *conn, int topic) {
+    if (!conn || conn->dead || topic < 0 || topic >= conn->server->topic_count ||
+        !(conn->allowed_topics & (1u << topic))) {
+        return -1;
+    }
+
+    if (!(conn->topics & (1u << topic))) {
+        conn->topics |= 1u << topic;
+        __atomic_fetch_add(&conn->server->topics[topic].subscribers, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+void websocket_unsubscribe(websocket_conn_t *conn, int topic) {
+    if (!conn || conn->dead || topic < 0 || topic >= conn->server->topic_count) return;
+
+    if (conn->topics & (1u << topic)) {
+        conn->topics &= ~(1u << topic);
+        __atomic_fetch_sub(&conn->server->topics[topic].subscribers, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Hands a frame to the loop, which fans it out
+static int websocket_enqueue_frame(websocket_server_t *server, websocket_frame_t *frame) {
+    pthread_mutex_lock(&server->pending_lock);
+    if (server->pending_frames_tail) {
+        server->pending_frames_tail->next = frame;
+    } else {
+        server->pending_frames = frame;
+    }
+    server->pending_frames_tail = frame;
+    pthread_mutex_unlock(&server->pending_lock);
+
+    websocket_wake(server);
+    return 0;
+}
+
+int websocket_publish(websocket_server_t *server, int topic, int opcode, const void *data, size_t length) {
+    if (!server || !server->running || topic < 0 || topic >= server->topic_count) return -1;
+
+    websocket_frame_t *frame = websocket_frame_create(opcode, data, length, topic);
+    if (!frame) return -1;
+    __atomic_fetch_add(&server->topics[topic].published, 1, __ATOMIC_RELAXED);
+    return websocket_enqueue_frame(server, frame);
+}
+
+int websocket_broadcast(websocket_server_t *server, int opcode, const void *data, size_t length) {
+    if (!server || !server->running) return -1;
+
+    websocket_frame_t *frame = websocket_frame_create(opcode, data, length, -1);
+    if (!frame) return -1;
+    return websocket_enqueue_frame(server, frame);
+}
+
+int websocket_connection_count(websocket_server_t *server) {
+    if (!server) return 0;
+    return __atomic_load_n(&server->connection_count, __ATOMIC_RELAXED);
+}
+
+int websocket_topic_subscribers(websocket_server_t *server, int topic) {
+    if (!server || topic < 0 || topic >= server->topic_count) return 0;
+    return __atomic_load_n(&server->topics[topic].subscribers, __ATOMIC_RELAXED);
+}
+
+int websocket_topic_stats(websocket_server_t *server, int topic, websocket_topic_stats_t *stats_out) {
+    if (!server || !stats_out || topic < 0 || topic >= server->topic_count) return -1;
+
+    websocket_topic_t *t = &server->topics[topic];
+    memset(stats_out, 0, sizeof(websocket_topic_stats_t));
+    stats_out->subscribers = __atomic_load_n(&t->subscribers, __ATOMIC_RELAXED);
+    stats_out->published = __atomic_load_n(&t->published, __ATOMIC_RELAXED);
+    stats_out->delivered = __atomic_load_n(&t->delivered, __ATOMIC_RELAXED);
+    stats_out->coalesced = __atomic_load_n(&t->coalesced, __ATOMIC_RELAXED);
+    stats_out->dropped = __atomic_load_n(&t->dropped, __ATOMIC_RELAXED);
+    stats_out->latency_max_us = __atomic_load_n(&t->latency_max, __ATOMIC_RELAXED) / 1000;
+
+    uint64_t buckets[WS_LATENCY_BUCKETS];
+    uint64_t count = 0;
+    for (int i = 0; i < WS_LATENCY_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n(&t->latency_buckets[i], __ATOMIC_RELAXED);
+        count += buckets[i];
+    }
+    if (count == 0) return 0;
+
+    stats_out->latency_avg_us = __atomic_load_n(&t->latency_total, __ATOMIC_RELAXED) / count / 1000;
+
+    // Bucket i holds latencies below 2^i microseconds
+    uint64_t target = count - count / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < WS_LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            stats_out->latency_p99_us = 1ULL << i;
+            break;
+        }
+    }
+    return 0;
+}
+
+// True if a comma separated header contains token, ignoring case
+static int websocket_header_has_token(const char *value, const char *token) {
+    size_t token_length = strlen(token);
+    const char *p = value;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        const char *start = p;
+        while (*p && *p != ',') p++;
+        const char *end = p;
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        if ((size_t)(end - start) == token_length && strncasecmp(start, token, token_length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int websocket_send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+int websocket_upgrade(websocket_server_t *server, http_request_t *request, http_response_t *response,
+                      uint32_t allowed_topics) {
+    const char *upgrade = http_request_get_header(request, "Upgrade");
+    const char *connection = http_request_get_header(request, "Connection");
+    const char *key = http_request_get_header(request, "Sec-WebSocket-Key");
+    const char *version = http_request_get_header(request, "Sec-WebSocket-Version");
+
+    if (!server || !server->running) {
+        http_response_set_status(response, 503);
+        http_response_set_body(response, "WebSocket service unavailable");
+        return -1;
+    }
+
+    if (strcmp(request->method, "GET") != 0 || !upgrade || strcasecmp(upgrade, "websocket") != 0 ||
+        !connection || !websocket_header_has_token(connection, "upgrade") ||
+        !key || strlen(key) != 24) {
+        http_response_set_status(response, 400);
+        http_response_set_body(response, "Expected a WebSocket handshake");
+        return -1;
+    }
+
+    if (!version || strcmp(version, "13") != 0) {
+        http_response_set_status(response, 426);
+        http_response_set_header(response, "Sec-WebSocket-Version", "13");
+        http_response_set_body(response, "Unsupported WebSocket version");
+        return -1;
+    }
+
+    // Sec-WebSocket-Accept (RFC 6455 section 4.2.2)
+    char concatenated[24 + sizeof(WS_GUID)];
+    memcpy(concatenated, key, 24);
+    memcpy(concatenated + 24, WS_GUID, sizeof(WS_GUID));
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    sha1(concatenated, strlen(concatenated), digest);
+    char accept[32];
+    base64_encode(digest, sizeof(digest), accept, sizeof(accept));
+
+    int fd = http_response_detach(response);
+    if (fd < 0) {
+        http_response_set_status(response, 500);
+        http_response_set_body(response, "Internal Server Error");
+        return -1;
+    }
+
+    char handshake[256];
+    int length = snprintf(handshake, sizeof(handshake),
+                          "HTTP/1.1 101 Switching Protocols\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Accept: %s\r\n"
+                          "\r\n", accept);
+    if (websocket_send_all(fd, handshake, (size_t)length) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&server->pending_lock);
+    if (server->pending_count == server->pending_capacity) {
+        int capacity = server->pending_capacity ? server->pending_capacity * 2 : 16;
+        websocket_pending_t *pending = realloc(server->pending, capacity * sizeof(websocket_pending_t));
+        if (!pending) {
+            pthread_mutex_unlock(&server->pending_lock);
+            close(fd);
+            return -1;
+        }
+        server->pending = pending;
+        server->pending_capacity = capacity;
+    }
+    server->pending[server->pending_count].fd = fd;
+    server->pending[server->pending_count].allowed_topics = allowed_topics;
+    server->pending_count++;
+    pthread_mutex_unlock(&server->pending_lock);
+
+    websocket_wake(server);
+    return 0;
+}
@@ -0,0 +1,180 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "http_server.h"
+
+#define WS_MAX_CONNECTIONS 65536
+#define WS_MAX_MESSAGE 65536             // Largest message a client may send
+#define WS_READ_SIZE 65536               // Bytes read from a socket at a time
+#define WS_SEND_QUEUE_LIMIT (1024 * 1024)  // Bytes queued for one client before it is dropped
+#define WS_PING_INTERVAL 30              // Seconds of silence before the server pings
+#define WS_PONG_TIMEOUT 10               // Seconds a client has to answer
+#define WS_MAX_EVENTS 256
+#define WS_MAX_TOPICS 32
+#define WS_TOPIC_NAME 32
+#define WS_LATENCY_BUCKETS 24            // Powers of two of microseconds
+
+// What a topic does with a subscriber that is not keeping up
+#define WS_POLICY_DROP 0      // Disconnect it once WS_SEND_QUEUE_LIMIT bytes are queued
+#define WS_POLICY_COALESCE 1  // Replace its unsent message with the newest one
+
+// Opcodes (RFC 6455 section 5.2)
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+// Close codes (RFC 6455 section 7.4.1)
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_GOING_AWAY 1001
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_INVALID_DATA 1007
+#define WS_CLOSE_TOO_BIG 1009
+
+// WebSocket connections are served by one event loop thread instead of a
+// thread each. After the handshake on a connection thread the socket is
+// handed to the loop, which reads frames with a buffer shared by every
+// connection, so an idle client costs its connection struct and nothing
+// else. Callbacks run on the loop thread and may send or close there;
+// other threads use websocket_publish() and websocket_broadcast().
+//
+// Published messages are framed once into a refcounted buffer, and every
+// subscriber's send queue points at that buffer instead of a copy. Frame
+// refcounts are only touched on the loop thread.
+
+typedef struct websocket_server websocket_server_t;
+typedef struct websocket_conn websocket_conn_t;
+
+typedef void (*websocket_open_fn)(websocket_server_t *server, websocket_conn_t *conn);
+typedef void (*websocket_message_fn)(websocket_server_t *server, websocket_conn_t *conn,
+                                     int opcode, const uint8_t *data, size_t length);
+
+// An encoded frame shared by every queue it is sent from
+typedef struct websocket_frame {
+    struct websocket_frame *next;  // Publish queue
+    int refs;
+    int topic;                     // -1 for broadcasts and direct sends
+    uint64_t published;            // CLOCK_MONOTONIC nanoseconds
+    size_t length;
+    uint8_t data[];
+} websocket_frame_t;
+
+// A frame waiting in one connection's send queue
+typedef struct websocket_send {
+    struct websocket_send *next;
+    websocket_frame_t *frame;
+    size_t offset;                 // Bytes already sent
+} websocket_send_t;
+
+// An upgraded socket waiting to join the loop
+typedef struct {
+    int fd;
+    uint32_t allowed_topics;
+} websocket_pending_t;
+
+// Counters are written by the loop thread and read atomically elsewhere
+typedef struct {
+    char name[WS_TOPIC_NAME];
+    int policy;
+    int subscribers;
+    uint64_t published;
+    uint64_t delivered;
+    uint64_t coalesced;            // Messages replaced before a slow subscriber got them
+    uint64_t dropped;              // Subscribers disconnected for falling behind
+    uint64_t latency_total;        // Publish to delivery, nanoseconds
+    uint64_t latency_max;
+    uint64_t latency_buckets[WS_LATENCY_BUCKETS];
+} websocket_topic_t;
+
+typedef struct {
+    int subscribers;
+    uint64_t published;
+    uint64_t delivered;
+    uint64_t coalesced;
+    uint64_t dropped;
+    uint64_t latency_avg_us;
+    uint64_t latency_p99_us;       // Upper bound of the histogram bucket
+    uint64_t latency_max_us;
+} websocket_topic_stats_t;
+
+struct websocket_conn {
+    websocket_server_t *server;
+    int fd;
+    int index;                     // Position in server->connections
+    int closing;                   // Close frame queued; the socket closes once it is sent
+    int dead;                      // Closed, freed after the current batch of events
+    int want_write;                // Registered for EPOLLOUT
+    time_t last_seen;
+    time_t ping_sent;              // 0 when no ping is outstanding
+    uint8_t *partial;              // Start of a frame that has not fully arrived
+    size_t partial_length;
+    uint8_t *message;              // Fragments of a message being reassembled
+    size_t message_length;
+    int message_opcode;            // 0 when no fragmented message is in progress
+    uint32_t topics;               // Bit per subscribed topic
+    uint32_t allowed_topics;       // Topics the client may subscribe to
+    websocket_send_t *send_head;
+    websocket_send_t *send_tail;
+    size_t send_bytes;
+    websocket_conn_t *next_dead;
+};
+
+struct websocket_server {
+    int epoll_fd;
+    int wake_fd;                   // eventfd that wakes the loop for pending work
+    pthread_t thread;
+    int running;
+    uint8_t *read_buffer;          // Shared by all connections; room for a partial frame plus a read
+    websocket_conn_t **connections;
+    int connection_count;
+    int connection_capacity;
+    websocket_conn_t *dead;
+    websocket_open_fn on_open;
+    websocket_message_fn on_message;
+    void *user_data;
+    websocket_topic_t topics[WS_MAX_TOPICS];
+    int topic_count;
+
+    pthread_mutex_t pending_lock;  // Guards the queues other threads fill
+    websocket_pending_t *pending;  // Upgraded sockets waiting to join the loop
+    int pending_count;
+    int pending_capacity;
+    websocket_frame_t *pending_frames;     // Published, not yet fanned out
+    websocket_frame_t *pending_frames_tail;
+};
+
+// Server lifecycle
+int websocket_server_init(websocket_server_t *server, websocket_open_fn on_open,
+                          websocket_message_fn on_message, void *user_data);
+void websocket_server_cleanup(websocket_server_t *server);
+
+// Topics are created before the HTTP server starts; returns the topic or -1
+int websocket_topic_create(websocket_server_t *server, const char *name, int policy);
+int websocket_topic_find(websocket_server_t *server, const char *name);
+
+// Route handler side: completes the RFC 6455 handshake and moves the
+// connection to the loop, or sets an error response. allowed_topics has a
+// bit per topic the client may subscribe to. Returns 0 on upgrade.
+int websocket_upgrade(websocket_server_t *server, http_request_t *request, http_response_t *response,
+                      uint32_t allowed_topics);
+
+// Loop thread only, e.g. from callbacks
+int websocket_send(websocket_conn_t *conn, int opcode, const void *data, size_t length);
+void websocket_close(websocket_conn_t *conn, uint16_t code);
+int websocket_subscribe(websocket_conn_t *conn, int topic);
+void websocket_unsubscribe(websocket_conn_t *conn, int topic);
+
+// Any thread
+int websocket_publish(websocket_server_t *server, int topic, int opcode, const void *data, size_t length);
+int websocket_broadcast(websocket_server_t *server, int opcode, const void *data, size_t length);
+int websocket_connection_count(websocket_server_t *server);
+int websocket_topic_subscribers(websocket_server_t *server, int topic);
+int websocket_topic_stats(websocket_server_t *server, int topic, websocket_topic_stats_t *stats_out);
+
+#endif